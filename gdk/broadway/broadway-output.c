@@ -18,6 +18,7 @@ struct BroadwayOutput {
   GString *buf;
   int error;
   guint32 serial;
+  guint64 bytes_sent;
 };
 
 static void
@@ -67,6 +68,7 @@ broadway_output_flush (BroadwayOutput *output)
   broadway_output_send_cmd (output, TRUE, BROADWAY_WS_BINARY,
                             output->buf->str, output->buf->len);
 
+  output->bytes_sent += output->buf->len;
   g_string_set_size (output->buf, 0);
 
   return !output->error;
@@ -100,6 +102,13 @@ broadway_output_get_next_serial (BroadwayOutput *output)
   return output->serial;
 }
 
+/* Includes data that is not flushed yet */
+guint64
+broadway_output_get_bytes_sent (BroadwayOutput *output)
+{
+  return output->bytes_sent + output->buf->len;
+}
+
 void
 broadway_output_set_next_serial (BroadwayOutput *output,
                                  guint32 serial)
@@ -143,13 +152,13 @@ append_uint16 (BroadwayOutput *output, guint32 v)
 }
 
 static void
-append_uint32 (BroadwayOutput *output, guint32 v)
+string_append_uint32 (GString *string, guint32 v)
 {
-  gsize old_len = output->buf->len;
+  gsize old_len = string->len;
   guint8 *buf;
 
-  g_string_set_size (output->buf, old_len + 4);
-  buf = (guint8 *)output->buf->str + old_len;
+  g_string_set_size (string, old_len + 4);
+  buf = (guint8 *)string->str + old_len;
   buf[0] = (v >> 0) & 0xff;
   buf[1] = (v >> 8) & 0xff;
   buf[2] = (v >> 16) & 0xff;
@@ -157,15 +166,9 @@ append_uint32 (BroadwayOutput *output, guint32 v)
 }
 
 static void
-patch_uint32 (BroadwayOutput *output, guint32 v, gsize offset)
+append_uint32 (BroadwayOutput *output, guint32 v)
 {
-  guint8 *buf;
-
-  buf = (guint8 *)output->buf->str + offset;
-  buf[0] = (v >> 0) & 0xff;
-  buf[1] = (v >> 8) & 0xff;
-  buf[2] = (v >> 16) & 0xff;
-  buf[3] = (v >> 24) & 0xff;
+  string_append_uint32 (output->buf, v);
 }
 
 
@@ -314,7 +317,7 @@ broadway_output_set_transient_for (BroadwayOutput *output,
 static gint append_node_depth = -1;
 
 static void
-append_type (BroadwayOutput *output, guint32 type, BroadwayNode *node)
+append_type (GString *nodes, guint32 type, BroadwayNode *node)
 {
 #ifdef DEBUG_NODE_SENDING
   g_print ("%*s%s", append_node_depth*2, "", broadway_node_type_names[type]);
@@ -323,7 +326,7 @@ append_type (BroadwayOutput *output, guint32 type, BroadwayNode *node)
   g_print ("\n");
 #endif
 
-  append_uint32 (output, type);
+  string_append_uint32 (nodes, type);
 }
 
 
@@ -345,7 +348,7 @@ append_type (BroadwayOutput *output, guint32 type, BroadwayNode *node)
  *
  ***********************************/
 static void
-append_node (BroadwayOutput *output,
+append_node (GString        *nodes,
              BroadwayNode   *node,
              BroadwayNode   *old_node,
              gboolean        all_parents_are_kept)
@@ -358,16 +361,16 @@ append_node (BroadwayOutput *output,
     {
       if (broadway_node_deep_equal (node, old_node))
         {
-          append_type (output, BROADWAY_NODE_KEEP_ALL, node);
+          append_type (nodes, BROADWAY_NODE_KEEP_ALL, node);
           goto out;
         }
 
       if (all_parents_are_kept)
         {
-          append_type (output, BROADWAY_NODE_KEEP_THIS, node);
-          append_uint32 (output, node->n_children);
+          append_type (nodes, BROADWAY_NODE_KEEP_THIS, node);
+          string_append_uint32 (nodes, node->n_children);
           for (i = 0; i < node->n_children; i++)
-            append_node (output, node->children[i],
+            append_node (nodes, node->children[i],
                          i < old_node->n_children ? old_node->children[i] : NULL,
                          TRUE);
 
@@ -375,11 +378,11 @@ append_node (BroadwayOutput *output,
         }
     }
 
-  append_type (output, node->type, node);
+  append_type (nodes, node->type, node);
   for (i = 0; i < node->n_data; i++)
-    append_uint32 (output, node->data[i]);
+    string_append_uint32 (nodes, node->data[i]);
   for (i = 0; i < node->n_children; i++)
-    append_node (output,
+    append_node (nodes,
                  node->children[i],
                  (old_node != NULL && i < old_node->n_children) ? old_node->children[i] : NULL,
                  FALSE);
@@ -388,33 +391,43 @@ append_node (BroadwayOutput *output,
   append_node_depth--;
 }
 
-void
-broadway_output_surface_set_nodes (BroadwayOutput *output,
-                                   int             id,
-                                   BroadwayNode   *root,
-                                   BroadwayNode   *old_root)
+/* Serializes @root as a diff against @old_root, which the browser
+ * must have applied last. Returns %NULL if nothing changed. */
+GBytes *
+broadway_output_serialize_nodes (BroadwayNode *root,
+                                 BroadwayNode *old_root)
 {
-  gsize size_pos, start, end;
+  GString *nodes;
 
   /* Early return if nothing changed */
   if (old_root != NULL &&
       broadway_node_deep_equal (root, old_root))
-    return;
+    return NULL;
 
-  write_header (output, BROADWAY_OP_SET_NODES);
+  nodes = g_string_new ("");
+#ifdef DEBUG_NODE_SENDING
+  g_print ("====== node tree =======\n");
+#endif
+  append_node (nodes, root, old_root, TRUE);
 
-  append_uint16 (output, id);
+  return g_string_free_to_bytes (nodes);
+}
 
-  size_pos = output->buf->len;
-  append_uint32 (output, 0);
+void
+broadway_output_surface_set_nodes (BroadwayOutput *output,
+                                   int             id,
+                                   GBytes         *nodes)
+{
+  gsize len;
+  gconstpointer data;
 
-  start = output->buf->len;
-#ifdef DEBUG_NODE_SENDING
-  g_print ("====== node tree for %d =======\n", id);
-#endif
-  append_node (output, root, old_root, TRUE);
-  end = output->buf->len;
-  patch_uint32 (output, (end - start) / 4, size_pos);
+  data = g_bytes_get_data (nodes, &len);
+
+  write_header (output, BROADWAY_OP_SET_NODES);
+
+  append_uint16 (output, id);
+  append_uint32 (output, len / 4);
+  g_string_append_len (output->buf, data, len);
 }
 
 void
@@ -429,6 +442,26 @@ broadway_output_upload_texture (BroadwayOutput *output,
   g_string_append_len (output->buf, g_bytes_get_data (texture, NULL), len);
 }
 
+/* Creates texture @id by drawing @patch over texture @base_id at
+ * @x, @y. @base_id may be @id itself. */
+void
+broadway_output_patch_texture (BroadwayOutput *output,
+                               guint32 id,
+                               guint32 base_id,
+                               guint32 x,
+                               guint32 y,
+                               GBytes *patch)
+{
+  gsize len = g_bytes_get_size (patch);
+  write_header (output, BROADWAY_OP_PATCH_TEXTURE);
+  append_uint32 (output, id);
+  append_uint32 (output, base_id);
+  append_uint32 (output, x);
+  append_uint32 (output, y);
+  append_uint32 (output, (guint32)len);
+  g_string_append_len (output->buf, g_bytes_get_data (patch, NULL), len);
+}
+
 void
 broadway_output_release_texture (BroadwayOutput *output,
                                  guint32 id)
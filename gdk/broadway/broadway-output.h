@@ -25,6 +25,7 @@ int             broadway_output_has_error           (BroadwayOutput *output);
 void            broadway_output_set_next_serial     (BroadwayOutput *output,
                                                      guint32         serial);
 guint32         broadway_output_get_next_serial     (BroadwayOutput *output);
+guint64         broadway_output_get_bytes_sent      (BroadwayOutput *output);
 void            broadway_output_new_surface         (BroadwayOutput *output,
                                                      int             id,
                                                      int             x,
@@ -57,13 +58,20 @@ void            broadway_output_move_resize_surface (BroadwayOutput *output,
 void            broadway_output_set_transient_for   (BroadwayOutput *output,
                                                      int             id,
                                                      int             parent_id);
+GBytes *        broadway_output_serialize_nodes     (BroadwayNode   *root,
+                                                     BroadwayNode   *old_root);
 void            broadway_output_surface_set_nodes   (BroadwayOutput *output,
                                                      int             id,
-                                                     BroadwayNode   *root,
-                                                     BroadwayNode   *old_root);
+                                                     GBytes         *nodes);
 void            broadway_output_upload_texture      (BroadwayOutput *output,
                                                      guint32         id,
                                                      GBytes         *texture);
+void            broadway_output_patch_texture       (BroadwayOutput *output,
+                                                     guint32         id,
+                                                     guint32         base_id,
+                                                     guint32         x,
+                                                     guint32         y,
+                                                     GBytes         *patch);
 void            broadway_output_release_texture     (BroadwayOutput *output,
                                                      guint32         id);
 void            broadway_output_grab_pointer        (BroadwayOutput *output,
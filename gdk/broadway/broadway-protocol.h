@@ -77,6 +77,7 @@ typedef enum {
   BROADWAY_OP_SET_SHOW_KEYBOARD = 'k',
   BROADWAY_OP_UPLOAD_TEXTURE = 't',
   BROADWAY_OP_RELEASE_TEXTURE = 'T',
+  BROADWAY_OP_PATCH_TEXTURE = 'x',
   BROADWAY_OP_SET_NODES = 'n',
   BROADWAY_OP_ROUNDTRIP = 'F',
 } BroadwayOpType;
@@ -230,11 +231,16 @@ typedef struct {
   guint32 parent;
 } BroadwayRequestSetTransientFor;
 
+/* If base_id is not 0, the data only covers the part of the texture
+ * at x, y that differs from the texture base_id */
 typedef struct {
   BroadwayRequestBase base;
   guint32 id;
   guint32 offset;
   guint32 size;
+  guint32 base_id;
+  guint32 x;
+  guint32 y;
 } BroadwayRequestUploadTexture;
 
 typedef struct {
@@ -36,11 +36,24 @@
 #endif
 
 
+/* Apps send a roundtrip after each frame and wait for the reply before
+ * drawing the next one. We reply right away while some web client has
+ * less than max_frames_in_flight frames unacknowledged, and otherwise
+ * hold the reply until one catches up. The app's frame clock stays
+ * frozen meanwhile, so intermediate frames are never drawn.
+ *
+ * Clients that are further behind than that don't get the frames the
+ * faster ones are shown. Once they catch up they are sent the current
+ * node trees, diffed against the ones they got last. */
 typedef struct {
   int id;
   guint32 tag;
+  gint64 sent_time;
+  guint64 bytes_sent; /* Output position at the end of the frame */
 } BroadwayOutstandingRoundtrip;
 
+#define DEFAULT_MAX_FRAMES_IN_FLIGHT 3
+
 typedef struct BroadwayInput BroadwayInput;
 typedef struct BroadwaySurface BroadwaySurface;
 struct _BroadwayServer {
@@ -51,11 +64,10 @@ struct _BroadwayServer {
   char *ssl_cert;
   char *ssl_key;
   GSocketService *service;
-  BroadwayOutput *output;
   guint32 id_counter;
   guint32 saved_serial;
   guint64 last_seen_time;
-  BroadwayInput *input;
+  GList *clients; /* BroadwayInput, only the first one sends input */
   GList *input_messages;
   guint process_input_idle;
 
@@ -66,7 +78,10 @@ struct _BroadwayServer {
   gint show_keyboard;
 
   guint32 next_texture_id;
-  GHashTable *textures;
+  GHashTable *textures; /* id => BroadwayTexture */
+  GHashTable *texture_contents; /* GBytes => BroadwayTexture, for full uploads */
+  GQueue unused_textures; /* Unreferenced textures the browser still has, oldest first */
+  gsize unused_textures_size;
 
   guint32 screen_width;
   guint32 screen_height;
@@ -88,7 +103,8 @@ struct _BroadwayServer {
   guint32 future_state;
   int future_mouse_in_surface;
 
-  GList *outstanding_roundtrips;
+  GQueue held_roundtrips; /* Apps waiting for a reply, oldest first */
+  guint max_frames_in_flight;
 };
 
 struct _BroadwayServerClass
@@ -113,6 +129,12 @@ struct BroadwayInput {
   gboolean seen_time;
   gint64 time_base;
   gboolean active;
+
+  GList *outstanding_roundtrips; /* Oldest first */
+  BroadwayServerStats stats;
+  guint64 acked_bytes;
+  GHashTable *sent_nodes; /* surface id => last node tree sent */
+  GHashTable *stale_surfaces; /* Surfaces that changed while we were behind */
 };
 
 struct BroadwaySurface {
@@ -128,8 +150,28 @@ struct BroadwaySurface {
   BroadwayNode *nodes;
 };
 
-static void broadway_server_resync_surfaces (BroadwayServer *server);
-static void send_outstanding_roundtrips (BroadwayServer *server);
+/* Textures with identical contents are only sent to the browser once.
+ * Unreferenced ones are kept around up to a budget, so that reuploads of
+ * the same image (e.g. by another surface or after a redraw) are free.
+ * Patched textures keep their base alive so they can be resent. */
+typedef struct BroadwayTexture BroadwayTexture;
+struct BroadwayTexture {
+  guint32 id;
+  int refcount;
+  GBytes *bytes;
+  BroadwayTexture *base; /* NULL unless bytes is a patch for base */
+  guint32 x;
+  guint32 y;
+  GList *unused_link;
+};
+
+/* Encoded bytes of unreferenced textures the browser may keep */
+#define UNUSED_TEXTURES_BUDGET (16 * 1024 * 1024)
+
+static void broadway_server_resync_surfaces (BroadwayServer *server,
+                                             BroadwayInput  *client);
+static void broadway_server_remove_client (BroadwayServer *server,
+                                           BroadwayInput  *client);
 
 static GType broadway_server_get_type (void);
 
@@ -145,6 +187,22 @@ broadway_node_free (BroadwayNode *node)
   g_free (node);
 }
 
+/* Node trees are shared between the surface and the clients that got
+ * it last, so we can diff against them */
+static BroadwayNode *
+broadway_node_ref (BroadwayNode *root)
+{
+  root->refcount++;
+  return root;
+}
+
+static void
+broadway_node_unref (BroadwayNode *root)
+{
+  if (--root->refcount == 0)
+    broadway_node_free (root);
+}
+
 gboolean
 broadway_node_equal (BroadwayNode     *a,
                      BroadwayNode     *b)
@@ -203,8 +261,11 @@ broadway_server_init (BroadwayServer *server)
   server->last_seen_time = 1;
   server->surface_id_hash = g_hash_table_new (NULL, NULL);
   server->id_counter = 0;
-  server->textures = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
-                                            (GDestroyNotify)g_bytes_unref);
+  server->max_frames_in_flight = DEFAULT_MAX_FRAMES_IN_FLIGHT;
+  g_queue_init (&server->held_roundtrips);
+  server->textures = g_hash_table_new (g_direct_hash, g_direct_equal);
+  server->texture_contents = g_hash_table_new (g_bytes_hash, g_bytes_equal);
+  g_queue_init (&server->unused_textures);
 
   root = g_new0 (BroadwaySurface, 1);
   root->id = server->id_counter++;
@@ -219,6 +280,17 @@ broadway_server_init (BroadwayServer *server)
                        root);
 }
 
+static void
+broadway_texture_free_cb (gpointer key,
+                          gpointer value,
+                          gpointer user_data)
+{
+  BroadwayTexture *texture = value;
+
+  g_bytes_unref (texture->bytes);
+  g_free (texture);
+}
+
 static void
 broadway_server_finalize (GObject *object)
 {
@@ -227,7 +299,12 @@ broadway_server_finalize (GObject *object)
   g_free (server->address);
   g_free (server->ssl_cert);
   g_free (server->ssl_key);
+  g_hash_table_foreach (server->textures, broadway_texture_free_cb, NULL);
   g_hash_table_destroy (server->textures);
+  g_hash_table_destroy (server->texture_contents);
+  g_queue_clear (&server->unused_textures);
+  g_queue_foreach (&server->held_roundtrips, (GFunc) g_free, NULL);
+  g_queue_clear (&server->held_roundtrips);
 
   G_OBJECT_CLASS (broadway_server_parent_class)->finalize (object);
 }
@@ -244,7 +321,7 @@ static void
 broadway_surface_free (BroadwaySurface *surface)
 {
   if (surface->nodes)
-    broadway_node_free (surface->nodes);
+    broadway_node_unref (surface->nodes);
   g_free (surface);
 }
 
@@ -274,9 +351,27 @@ broadway_input_free (BroadwayInput *input)
   g_object_unref (input->connection);
   g_byte_array_free (input->buffer, FALSE);
   g_source_destroy (input->source);
+  broadway_output_free (input->output);
+  g_list_free_full (input->outstanding_roundtrips, g_free);
+  g_hash_table_destroy (input->sent_nodes);
+  g_hash_table_destroy (input->stale_surfaces);
   g_free (input);
 }
 
+/* The client that sends input, NULL if there is none */
+static BroadwayInput *
+broadway_server_get_primary_client (BroadwayServer *server)
+{
+  return server->clients ? server->clients->data : NULL;
+}
+
+static gboolean
+client_is_behind (BroadwayServer *server,
+                  BroadwayInput  *client)
+{
+  return g_list_length (client->outstanding_roundtrips) >= server->max_frames_in_flight;
+}
+
 static void
 update_event_state (BroadwayServer *server,
                     BroadwayInputMsg *message)
@@ -508,6 +603,92 @@ queue_input_message (BroadwayServer *server, BroadwayInputMsg *msg)
   server->input_messages = g_list_append (server->input_messages, g_memdup (msg, sizeof (BroadwayInputMsg)));
 }
 
+static void
+broadway_server_roundtrip_reply (BroadwayServer *server,
+                                 gint            id,
+                                 guint32         tag,
+                                 gboolean        local);
+
+static void client_send_stale_nodes (BroadwayServer *server,
+                                     BroadwayInput  *client);
+
+/* Replies to held roundtrips, oldest first, once some client has room */
+static void
+reply_to_held_roundtrips (BroadwayServer *server)
+{
+  BroadwayOutstandingRoundtrip *rt;
+  GList *l;
+
+  for (l = server->clients; l != NULL; l = l->next)
+    {
+      if (!client_is_behind (server, l->data))
+        break;
+    }
+
+  if (server->clients != NULL && l == NULL)
+    return;
+
+  while ((rt = g_queue_pop_head (&server->held_roundtrips)) != NULL)
+    {
+      broadway_server_roundtrip_reply (server, rt->id, rt->tag, server->clients == NULL);
+      g_free (rt);
+    }
+}
+
+static void
+frame_acked (BroadwayServer               *server,
+             BroadwayInput                *client,
+             BroadwayOutstandingRoundtrip *rt)
+{
+  BroadwayServerStats *stats = &client->stats;
+  gint64 rtt = g_get_monotonic_time () - rt->sent_time;
+
+  /* Smoothed like TCP does */
+  if (stats->frames_acked == 0)
+    {
+      stats->rtt = rtt;
+      stats->min_rtt = rtt;
+      stats->max_rtt = rtt;
+    }
+  else
+    {
+      stats->rtt = (7 * stats->rtt + rtt) / 8;
+      stats->min_rtt = MIN (stats->min_rtt, rtt);
+      stats->max_rtt = MAX (stats->max_rtt, rtt);
+    }
+  stats->frames_acked++;
+
+  client->acked_bytes = MAX (client->acked_bytes, rt->bytes_sent);
+
+  if (!client_is_behind (server, client))
+    client_send_stale_nodes (server, client);
+
+  reply_to_held_roundtrips (server);
+}
+
+/* Apps get their replies from reply_to_held_roundtrips(), the ones
+ * from the browsers just acknowledge frames */
+static void
+roundtrip_acked (BroadwayInput *input,
+                 guint32        id,
+                 guint32        tag)
+{
+  GList *l;
+
+  for (l = input->outstanding_roundtrips; l != NULL; l = l->next)
+    {
+      BroadwayOutstandingRoundtrip *rt = l->data;
+
+      if (rt->id == id && rt->tag == tag)
+        {
+          input->outstanding_roundtrips = g_list_delete_link (input->outstanding_roundtrips, l);
+          frame_acked (input->server, input, rt);
+          g_free (rt);
+          break;
+        }
+    }
+}
+
 static void
 parse_input_message (BroadwayInput *input, const unsigned char *message)
 {
@@ -515,7 +696,6 @@ parse_input_message (BroadwayInput *input, const unsigned char *message)
   BroadwayInputMsg msg;
   guint32 *p;
   gint64 time_;
-  GList *l;
 
   memset (&msg, 0, sizeof (msg));
 
@@ -525,6 +705,14 @@ parse_input_message (BroadwayInput *input, const unsigned char *message)
   msg.base.serial = ntohl (*p++);
   time_ = ntohl (*p++);
 
+  /* Other clients only watch, we just need their acks */
+  if (input != broadway_server_get_primary_client (server))
+    {
+      if (msg.base.type == BROADWAY_EVENT_ROUNDTRIP_NOTIFY)
+        roundtrip_acked (input, ntohl (p[0]), ntohl (p[1]));
+      return;
+    }
+
   if (time_ == 0) {
     time_ = server->last_seen_time;
   } else {
@@ -595,22 +783,8 @@ parse_input_message (BroadwayInput *input, const unsigned char *message)
   case BROADWAY_EVENT_ROUNDTRIP_NOTIFY:
     msg.roundtrip_notify.id = ntohl (*p++);
     msg.roundtrip_notify.tag = ntohl (*p++);
-    msg.roundtrip_notify.local = FALSE;
-
-    /* Remove matched outstanding roundtrips */
-    for (l = server->outstanding_roundtrips; l != NULL; l = l->next)
-      {
-        BroadwayOutstandingRoundtrip *rt = l->data;
-
-        if (rt->id == msg.roundtrip_notify.id &&
-            rt->tag == msg.roundtrip_notify.tag)
-          {
-            server->outstanding_roundtrips = g_list_delete_link (server->outstanding_roundtrips, l);
-            g_free (rt);
-            break;
-          }
-      }
-    break;
+    roundtrip_acked (input, msg.roundtrip_notify.id, msg.roundtrip_notify.tag);
+    return;
 
   case BROADWAY_EVENT_SCREEN_SIZE_CHANGED:
     msg.screen_resize_notify.width = ntohl (*p++);
@@ -791,13 +965,7 @@ broadway_server_read_all_input_nonblocking (BroadwayInput *input)
           return TRUE;
         }
 
-      if (input->server->input == input)
-        {
-          send_outstanding_roundtrips (input->server);
-
-          input->server->input = NULL;
-        }
-      broadway_input_free (input);
+      broadway_server_remove_client (input->server, input);
       if (res < 0)
         {
           g_printerr ("input error %s\n", error->message);
@@ -815,7 +983,7 @@ broadway_server_read_all_input_nonblocking (BroadwayInput *input)
 static void
 broadway_server_consume_all_input (BroadwayServer *server)
 {
-  broadway_server_read_all_input_nonblocking (server->input);
+  broadway_server_read_all_input_nonblocking (broadway_server_get_primary_client (server));
 
   /* Since we're parsing input but not processing the resulting messages
      we might not get a readable callback on the stream, so queue an idle to
@@ -836,14 +1004,19 @@ input_data_cb (GObject  *stream,
   if (input->active)
     process_input_messages (server);
 
+  /* Acks may have let us send frames the client skipped */
+  broadway_server_flush (server);
+
   return TRUE;
 }
 
 guint32
 broadway_server_get_next_serial (BroadwayServer *server)
 {
-  if (server->output)
-    return broadway_output_get_next_serial (server->output);
+  BroadwayInput *primary = broadway_server_get_primary_client (server);
+
+  if (primary)
+    return broadway_output_get_next_serial (primary->output);
 
   return server->saved_serial;
 }
@@ -857,10 +1030,12 @@ broadway_server_get_screen_size (BroadwayServer   *server,
   *height = server->root->height;
 }
 
+/* Local replies are for frames that no web client will see */
 static void
-broadway_server_fake_roundtrip_reply (BroadwayServer *server,
-                                      gint            id,
-                                      guint32         tag)
+broadway_server_roundtrip_reply (BroadwayServer *server,
+                                 gint            id,
+                                 guint32         tag,
+                                 gboolean        local)
 {
   BroadwayInputMsg msg;
 
@@ -869,7 +1044,7 @@ broadway_server_fake_roundtrip_reply (BroadwayServer *server,
   msg.base.time = server->last_seen_time;
   msg.roundtrip_notify.id = id;
   msg.roundtrip_notify.tag = tag;
-  msg.roundtrip_notify.local = 1;
+  msg.roundtrip_notify.local = local;
 
   queue_input_message (server, &msg);
   queue_process_input_at_idle (server);
@@ -878,13 +1053,15 @@ broadway_server_fake_roundtrip_reply (BroadwayServer *server,
 void
 broadway_server_flush (BroadwayServer *server)
 {
-  if (server->output &&
-      !broadway_output_flush (server->output))
+  GList *l, *next;
+
+  for (l = server->clients; l != NULL; l = next)
     {
-      server->saved_serial = broadway_output_get_next_serial (server->output);
-      broadway_output_free (server->output);
-      server->output = NULL;
-      send_outstanding_roundtrips (server);
+      BroadwayInput *client = l->data;
+
+      next = l->next;
+      if (!broadway_output_flush (client->output))
+        broadway_server_remove_client (server, client);
     }
 }
 
@@ -893,17 +1070,82 @@ broadway_server_roundtrip (BroadwayServer *server,
                            gint            id,
                            guint32         tag)
 {
-  if (server->output)
+  BroadwayOutstandingRoundtrip *held;
+  GList *l;
+
+  if (server->clients == NULL)
+    {
+      broadway_server_roundtrip_reply (server, id, tag, TRUE);
+      return;
+    }
+
+  for (l = server->clients; l != NULL; l = l->next)
     {
-      BroadwayOutstandingRoundtrip *rt = g_new0 (BroadwayOutstandingRoundtrip, 1);
+      BroadwayInput *client = l->data;
+      BroadwayOutstandingRoundtrip *rt;
+
+      /* It didn't get the frame either */
+      if (client_is_behind (server, client))
+        {
+          client->stats.frames_skipped++;
+          continue;
+        }
+
+      rt = g_new0 (BroadwayOutstandingRoundtrip, 1);
       rt->id = id;
       rt->tag = tag;
-      server->outstanding_roundtrips = g_list_prepend (server->outstanding_roundtrips, rt);
+      rt->sent_time = g_get_monotonic_time ();
 
-      broadway_output_roundtrip (server->output, id, tag);
+      broadway_output_roundtrip (client->output, id, tag);
+      rt->bytes_sent = broadway_output_get_bytes_sent (client->output);
+
+      client->outstanding_roundtrips = g_list_append (client->outstanding_roundtrips, rt);
     }
-  else
-    broadway_server_fake_roundtrip_reply (server, id, tag);
+
+  held = g_new0 (BroadwayOutstandingRoundtrip, 1);
+  held->id = id;
+  held->tag = tag;
+  g_queue_push_tail (&server->held_roundtrips, held);
+
+  reply_to_held_roundtrips (server);
+}
+
+/* The number of frames a browser may not have acknowledged yet
+ * before it stops getting new ones, and apps have to wait if all
+ * browsers are that far behind */
+void
+broadway_server_set_max_frames_in_flight (BroadwayServer *server,
+                                          guint           max_frames)
+{
+  GList *l;
+
+  server->max_frames_in_flight = MAX (max_frames, 1);
+
+  for (l = server->clients; l != NULL; l = l->next)
+    {
+      if (!client_is_behind (server, l->data))
+        client_send_stale_nodes (server, l->data);
+    }
+
+  reply_to_held_roundtrips (server);
+}
+
+/* Returns FALSE if there is no web client with index @client */
+gboolean
+broadway_server_get_stats (BroadwayServer      *server,
+                           guint                client,
+                           BroadwayServerStats *stats)
+{
+  BroadwayInput *input = g_list_nth_data (server->clients, client);
+
+  if (input == NULL)
+    return FALSE;
+
+  *stats = input->stats;
+  stats->frames_in_flight = g_list_length (input->outstanding_roundtrips);
+  stats->bytes_in_flight = broadway_output_get_bytes_sent (input->output) - input->acked_bytes;
+
+  return TRUE;
 }
 
 static const char *
@@ -1058,6 +1300,8 @@ start_input (HttpRequest *request)
 
   input->output =
     broadway_output_new (g_io_stream_get_output_stream (request->connection), 0);
+  input->sent_nodes = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify) broadway_node_unref);
+  input->stale_surfaces = g_hash_table_new (NULL, NULL);
 
   /* This will free and close the data input stream, but we got all the buffered content already */
   http_request_free (request);
@@ -1076,66 +1320,69 @@ start_input (HttpRequest *request)
   g_strfreev (lines);
 }
 
-static void
-send_outstanding_roundtrips (BroadwayServer *server)
-{
-  GList *l;
-
-  for (l = server->outstanding_roundtrips; l != NULL; l = l->next)
-    {
-      BroadwayOutstandingRoundtrip *rt = l->data;
-      broadway_server_fake_roundtrip_reply (server, rt->id, rt->tag);
-    }
-
-  g_list_free_full (server->outstanding_roundtrips, g_free);
-  server->outstanding_roundtrips = NULL;
-}
-
 static void
 start (BroadwayInput *input)
 {
   BroadwayServer *server;
+  BroadwayInput *primary;
 
   input->active = TRUE;
 
   server = BROADWAY_SERVER (input->server);
 
-  if (server->output)
-    {
-      send_outstanding_roundtrips (server);
-      broadway_output_disconnected (server->output);
-      broadway_output_flush (server->output);
-    }
-
-  if (server->input != NULL)
-    {
-      send_outstanding_roundtrips (server);
-      broadway_input_free (server->input);
-      server->input = NULL;
-    }
-
-  server->input = input;
+  /* Keep serials going up, they have to match the primary client's */
+  primary = broadway_server_get_primary_client (server);
+  if (primary)
+    broadway_output_set_next_serial (input->output,
+                                     broadway_output_get_next_serial (primary->output));
+  else
+    broadway_output_set_next_serial (input->output, server->saved_serial);
 
-  if (server->output)
-    {
-      server->saved_serial = broadway_output_get_next_serial (server->output);
-      broadway_output_free (server->output);
-    }
-  server->output = input->output;
+  server->clients = g_list_append (server->clients, input);
 
-  broadway_output_set_next_serial (server->output, server->saved_serial);
-  broadway_output_flush (server->output);
+  broadway_output_flush (input->output);
 
-  broadway_server_resync_surfaces (server);
+  broadway_server_resync_surfaces (server, input);
 
   if (server->pointer_grab_surface_id != -1)
-    broadway_output_grab_pointer (server->output,
+    broadway_output_grab_pointer (input->output,
                                   server->pointer_grab_surface_id,
                                   server->pointer_grab_owner_events);
 
+  broadway_output_flush (input->output);
+
   process_input_messages (server);
 }
 
+static void
+broadway_server_remove_client (BroadwayServer *server,
+                               BroadwayInput  *client)
+{
+  guint32 serial;
+
+  serial = broadway_output_get_next_serial (client->output);
+
+  if (client == broadway_server_get_primary_client (server))
+    {
+      server->saved_serial = serial;
+
+      /* The next client takes over input */
+      if (server->clients->next)
+        {
+          BroadwayInput *next = server->clients->next->data;
+
+          if (broadway_output_get_next_serial (next->output) < serial)
+            broadway_output_set_next_serial (next->output, serial);
+        }
+    }
+
+  server->clients = g_list_remove (server->clients, client);
+  broadway_input_free (client);
+
+  /* Apps may have waited for it */
+  reply_to_held_roundtrips (server);
+}
+
 static void
 send_data (HttpRequest *request,
            const char *mimetype,
@@ -1427,7 +1674,7 @@ broadway_server_query_mouse (BroadwayServer *server,
                              gint32             *root_y,
                              guint32            *mask)
 {
-  if (server->output)
+  if (server->clients)
     {
       broadway_server_consume_all_input (server);
       if (root_x)
@@ -1457,6 +1704,7 @@ broadway_server_destroy_surface (BroadwayServer *server,
                                  gint id)
 {
   BroadwaySurface *surface;
+  GList *l;
 
   if (server->mouse_in_surface_id == id)
     {
@@ -1467,9 +1715,14 @@ broadway_server_destroy_surface (BroadwayServer *server,
   if (server->pointer_grab_surface_id == id)
     server->pointer_grab_surface_id = -1;
 
-  if (server->output)
-    broadway_output_destroy_surface (server->output,
-                                     id);
+  for (l = server->clients; l != NULL; l = l->next)
+    {
+      BroadwayInput *client = l->data;
+
+      broadway_output_destroy_surface (client->output, id);
+      g_hash_table_remove (client->sent_nodes, GINT_TO_POINTER (id));
+      g_hash_table_remove (client->stale_surfaces, GINT_TO_POINTER (id));
+    }
 
   surface = broadway_server_lookup_surface (server, id);
   if (surface != NULL)
@@ -1487,6 +1740,7 @@ broadway_server_surface_show (BroadwayServer *server,
 {
   BroadwaySurface *surface;
   gboolean sent = FALSE;
+  GList *l;
 
   surface = broadway_server_lookup_surface (server, id);
   if (surface == NULL)
@@ -1494,9 +1748,11 @@ broadway_server_surface_show (BroadwayServer *server,
 
   surface->visible = TRUE;
 
-  if (server->output)
+  for (l = server->clients; l != NULL; l = l->next)
     {
-      broadway_output_show_surface (server->output, surface->id);
+      BroadwayInput *client = l->data;
+
+      broadway_output_show_surface (client->output, surface->id);
       sent = TRUE;
     }
 
@@ -1509,6 +1765,7 @@ broadway_server_surface_hide (BroadwayServer *server,
 {
   BroadwaySurface *surface;
   gboolean sent = FALSE;
+  GList *l;
 
   surface = broadway_server_lookup_surface (server, id);
   if (surface == NULL)
@@ -1525,9 +1782,11 @@ broadway_server_surface_hide (BroadwayServer *server,
   if (server->pointer_grab_surface_id == id)
     server->pointer_grab_surface_id = -1;
 
-  if (server->output)
+  for (l = server->clients; l != NULL; l = l->next)
     {
-      broadway_output_hide_surface (server->output, surface->id);
+      BroadwayInput *client = l->data;
+
+      broadway_output_hide_surface (client->output, surface->id);
       sent = TRUE;
     }
   return sent;
@@ -1538,6 +1797,7 @@ broadway_server_surface_raise (BroadwayServer *server,
                                gint id)
 {
   BroadwaySurface *surface;
+  GList *l;
 
   surface = broadway_server_lookup_surface (server, id);
   if (surface == NULL)
@@ -1546,21 +1806,30 @@ broadway_server_surface_raise (BroadwayServer *server,
   server->surfaces = g_list_remove (server->surfaces, surface);
   server->surfaces = g_list_append (server->surfaces, surface);
 
-  if (server->output)
-    broadway_output_raise_surface (server->output, surface->id);
+  for (l = server->clients; l != NULL; l = l->next)
+    {
+      BroadwayInput *client = l->data;
+
+      broadway_output_raise_surface (client->output, surface->id);
+    }
 }
 
 void
 broadway_server_set_show_keyboard (BroadwayServer *server,
                                    gboolean show)
 {
+  GList *l;
+
   server->show_keyboard = show;
 
-  if (server->output)
+  for (l = server->clients; l != NULL; l = l->next)
     {
-      broadway_output_set_show_keyboard (server->output, server->show_keyboard);
-      broadway_server_flush (server);
+      BroadwayInput *client = l->data;
+
+      broadway_output_set_show_keyboard (client->output, server->show_keyboard);
     }
+
+  broadway_server_flush (server);
 }
 
 void
@@ -1568,6 +1837,7 @@ broadway_server_surface_lower (BroadwayServer *server,
                                gint id)
 {
   BroadwaySurface *surface;
+  GList *l;
 
   surface = broadway_server_lookup_surface (server, id);
   if (surface == NULL)
@@ -1576,8 +1846,12 @@ broadway_server_surface_lower (BroadwayServer *server,
   server->surfaces = g_list_remove (server->surfaces, surface);
   server->surfaces = g_list_prepend (server->surfaces, surface);
 
-  if (server->output)
-    broadway_output_lower_surface (server->output, surface->id);
+  for (l = server->clients; l != NULL; l = l->next)
+    {
+      BroadwayInput *client = l->data;
+
+      broadway_output_lower_surface (client->output, surface->id);
+    }
 }
 
 void
@@ -1585,6 +1859,7 @@ broadway_server_surface_set_transient_for (BroadwayServer *server,
                                            gint id, gint parent)
 {
   BroadwaySurface *surface;
+  GList *l;
 
   surface = broadway_server_lookup_surface (server, id);
   if (surface == NULL)
@@ -1592,17 +1867,88 @@ broadway_server_surface_set_transient_for (BroadwayServer *server,
 
   surface->transient_for = parent;
 
-  if (server->output)
+  for (l = server->clients; l != NULL; l = l->next)
     {
-      broadway_output_set_transient_for (server->output, surface->id, surface->transient_for);
-      broadway_server_flush (server);
+      BroadwayInput *client = l->data;
+
+      broadway_output_set_transient_for (client->output, surface->id, surface->transient_for);
     }
+
+  broadway_server_flush (server);
 }
 
 gboolean
 broadway_server_has_client (BroadwayServer *server)
 {
-  return server->output != NULL;
+  return server->clients != NULL;
+}
+
+/* A node tree serialized as a diff against old_root, NULL if unchanged */
+typedef struct {
+  BroadwayNode *old_root;
+  GBytes *nodes;
+} SerializedNodes;
+
+/* Sends the current nodes of @surface to @client, diffed against the
+ * ones it got last. As all clients usually got the same tree last,
+ * the diff is only serialized once per frame and looked up in @cache,
+ * if given. */
+static void
+client_send_nodes (BroadwayServer  *server,
+                   BroadwayInput   *client,
+                   BroadwaySurface *surface,
+                   GArray          *cache)
+{
+  SerializedNodes serialized = { NULL, NULL };
+  BroadwayNode *old_root;
+  guint i;
+
+  old_root = g_hash_table_lookup (client->sent_nodes, GINT_TO_POINTER (surface->id));
+  if (old_root == surface->nodes)
+    return;
+
+  for (i = 0; cache != NULL && i < cache->len; i++)
+    {
+      serialized = g_array_index (cache, SerializedNodes, i);
+      if (serialized.old_root == old_root)
+        break;
+    }
+
+  if (cache == NULL || i == cache->len)
+    {
+      serialized.old_root = old_root;
+      serialized.nodes = broadway_output_serialize_nodes (surface->nodes, old_root);
+      if (cache)
+        g_array_append_val (cache, serialized);
+    }
+
+  if (serialized.nodes)
+    broadway_output_surface_set_nodes (client->output, surface->id, serialized.nodes);
+
+  g_hash_table_insert (client->sent_nodes, GINT_TO_POINTER (surface->id),
+                       broadway_node_ref (surface->nodes));
+
+  if (cache == NULL && serialized.nodes)
+    g_bytes_unref (serialized.nodes);
+}
+
+static void
+client_send_stale_nodes (BroadwayServer *server,
+                         BroadwayInput  *client)
+{
+  GHashTableIter iter;
+  gpointer key;
+
+  g_hash_table_iter_init (&iter, client->stale_surfaces);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      BroadwaySurface *surface = broadway_server_lookup_surface (server, GPOINTER_TO_INT (key));
+
+      if (surface != NULL && surface->nodes != NULL)
+        client_send_nodes (server, client, surface, NULL);
+
+      g_hash_table_iter_remove (&iter);
+    }
 }
 
 /* passes ownership of nodes */
@@ -1612,46 +1958,209 @@ broadway_server_surface_set_nodes (BroadwayServer   *server,
                                    BroadwayNode     *root)
 {
   BroadwaySurface *surface;
+  BroadwayNode *old_root;
+  GArray *cache;
+  GList *l;
+  guint i;
 
   surface = broadway_server_lookup_surface (server, id);
   if (surface == NULL)
+    {
+      broadway_node_unref (root);
+      return;
+    }
+
+  old_root = surface->nodes;
+  surface->nodes = root;
+
+  cache = g_array_new (FALSE, FALSE, sizeof (SerializedNodes));
+
+  for (l = server->clients; l != NULL; l = l->next)
+    {
+      BroadwayInput *client = l->data;
+
+      if (client_is_behind (server, client))
+        g_hash_table_add (client->stale_surfaces, GINT_TO_POINTER (surface->id));
+      else
+        client_send_nodes (server, client, surface, cache);
+    }
+
+  for (i = 0; i < cache->len; i++)
+    {
+      SerializedNodes *serialized = &g_array_index (cache, SerializedNodes, i);
+
+      if (serialized->nodes)
+        g_bytes_unref (serialized->nodes);
+    }
+  g_array_free (cache, TRUE);
+
+  if (old_root)
+    broadway_node_unref (old_root);
+}
+
+static void texture_unref (BroadwayServer  *server,
+                           BroadwayTexture *texture);
+
+static void
+texture_destroy (BroadwayServer  *server,
+                 BroadwayTexture *texture)
+{
+  GList *l;
+
+  g_hash_table_remove (server->textures, GINT_TO_POINTER (texture->id));
+  if (texture->base == NULL)
+    g_hash_table_remove (server->texture_contents, texture->bytes);
+
+  for (l = server->clients; l != NULL; l = l->next)
+    {
+      BroadwayInput *client = l->data;
+
+      broadway_output_release_texture (client->output, texture->id);
+    }
+
+  if (texture->base)
+    texture_unref (server, texture->base);
+
+  g_bytes_unref (texture->bytes);
+  g_free (texture);
+}
+
+static void
+texture_unref (BroadwayServer  *server,
+               BroadwayTexture *texture)
+{
+  if (--texture->refcount > 0)
     return;
 
-  if (server->output != NULL)
-    broadway_output_surface_set_nodes (server->output, surface->id,
-                                       root,
-                                       surface->nodes);
+  /* Patched textures can't be found by content, so they're of no use */
+  if (texture->base != NULL)
+    {
+      texture_destroy (server, texture);
+      return;
+    }
 
-  if (surface->nodes)
-    broadway_node_free (surface->nodes);
-  surface->nodes = root;
+  g_queue_push_tail (&server->unused_textures, texture);
+  texture->unused_link = server->unused_textures.tail;
+  server->unused_textures_size += g_bytes_get_size (texture->bytes);
+
+  while (server->unused_textures_size > UNUSED_TEXTURES_BUDGET)
+    {
+      BroadwayTexture *oldest = g_queue_pop_head (&server->unused_textures);
+
+      oldest->unused_link = NULL;
+      server->unused_textures_size -= g_bytes_get_size (oldest->bytes);
+      texture_destroy (server, oldest);
+    }
+}
+
+static void
+texture_ref (BroadwayServer  *server,
+             BroadwayTexture *texture)
+{
+  if (texture->unused_link)
+    {
+      g_queue_delete_link (&server->unused_textures, texture->unused_link);
+      texture->unused_link = NULL;
+      server->unused_textures_size -= g_bytes_get_size (texture->bytes);
+    }
+
+  texture->refcount++;
 }
 
 guint32
 broadway_server_upload_texture (BroadwayServer   *server,
-                                GBytes           *texture)
+                                GBytes           *bytes)
 {
-  guint32 id;
+  BroadwayTexture *texture;
+  GList *l;
+
+  texture = g_hash_table_lookup (server->texture_contents, bytes);
+  if (texture)
+    {
+      texture_ref (server, texture);
+      return texture->id;
+    }
+
+  texture = g_new0 (BroadwayTexture, 1);
+  texture->id = ++server->next_texture_id;
+  texture->refcount = 1;
+  texture->bytes = g_bytes_ref (bytes);
+  g_hash_table_insert (server->textures, GINT_TO_POINTER (texture->id), texture);
+  g_hash_table_insert (server->texture_contents, texture->bytes, texture);
+
+  for (l = server->clients; l != NULL; l = l->next)
+    {
+      BroadwayInput *client = l->data;
+
+      broadway_output_upload_texture (client->output, texture->id, bytes);
+    }
+
+  return texture->id;
+}
+
+/* Creates a texture from texture @base_id with @patch drawn at @x, @y */
+guint32
+broadway_server_patch_texture (BroadwayServer   *server,
+                               guint32           base_id,
+                               guint32           x,
+                               guint32           y,
+                               GBytes           *patch)
+{
+  BroadwayTexture *base, *texture;
+  GList *l;
 
-  id = ++server->next_texture_id;
-  g_hash_table_replace (server->textures,
-                        GINT_TO_POINTER (id),
-                        g_bytes_ref (texture));
+  base = g_hash_table_lookup (server->textures, GINT_TO_POINTER (base_id));
+  if (base == NULL)
+    return 0;
+
+  texture = g_new0 (BroadwayTexture, 1);
+  texture->id = ++server->next_texture_id;
+  texture->refcount = 1;
+  texture->bytes = g_bytes_ref (patch);
+  texture->base = base;
+  texture->x = x;
+  texture->y = y;
+  texture_ref (server, base);
+  g_hash_table_insert (server->textures, GINT_TO_POINTER (texture->id), texture);
+
+  for (l = server->clients; l != NULL; l = l->next)
+    {
+      BroadwayInput *client = l->data;
 
-  if (server->output)
-    broadway_output_upload_texture (server->output, id, texture);
+      broadway_output_patch_texture (client->output, texture->id, base_id, x, y, patch);
+    }
 
-  return id;
+  return texture->id;
 }
 
 void
 broadway_server_release_texture (BroadwayServer   *server,
                                  guint32           id)
 {
-  g_hash_table_remove (server->textures, GINT_TO_POINTER (id));
+  BroadwayTexture *texture;
+
+  texture = g_hash_table_lookup (server->textures, GINT_TO_POINTER (id));
+  if (texture)
+    texture_unref (server, texture);
+}
+
+/* Sends the contents of @texture as texture @id to a new client.
+ * Patched textures are rebuilt from their bases under @id, as the
+ * bases may be gone by now. */
+static void
+texture_resend (BroadwayOutput  *output,
+                BroadwayTexture *texture,
+                guint32          id)
+{
+  if (texture->base == NULL)
+    {
+      broadway_output_upload_texture (output, id, texture->bytes);
+      return;
+    }
 
-  if (server->output)
-    broadway_output_release_texture (server->output, id);
+  texture_resend (output, texture->base, id);
+  broadway_output_patch_texture (output, id, id,
+                                 texture->x, texture->y, texture->bytes);
 }
 
 gboolean
@@ -1666,6 +2175,7 @@ broadway_server_surface_move_resize (BroadwayServer *server,
   BroadwaySurface *surface;
   gboolean with_resize;
   gboolean sent = FALSE;
+  GList *l;
 
   surface = broadway_server_lookup_surface (server, id);
   if (surface == NULL)
@@ -1675,15 +2185,18 @@ broadway_server_surface_move_resize (BroadwayServer *server,
   surface->width = width;
   surface->height = height;
 
-  if (server->output != NULL)
+  for (l = server->clients; l != NULL; l = l->next)
     {
-      broadway_output_move_resize_surface (server->output,
+      BroadwayInput *client = l->data;
+
+      broadway_output_move_resize_surface (client->output,
                                            surface->id,
                                            with_move, x, y,
                                            with_resize, surface->width, surface->height);
       sent = TRUE;
     }
-  else
+
+  if (!sent)
     {
       if (with_move)
         {
@@ -1726,6 +2239,8 @@ broadway_server_grab_pointer (BroadwayServer *server,
                               guint32 event_mask,
                               guint32 time_)
 {
+  GList *l;
+
   if (server->pointer_grab_surface_id != -1 &&
       time_ != 0 && server->pointer_grab_time > time_)
     return GDK_GRAB_ALREADY_GRABBED;
@@ -1738,14 +2253,17 @@ broadway_server_grab_pointer (BroadwayServer *server,
   server->pointer_grab_owner_events = owner_events;
   server->pointer_grab_time = time_;
 
-  if (server->output)
+  for (l = server->clients; l != NULL; l = l->next)
     {
-      broadway_output_grab_pointer (server->output,
+      BroadwayInput *client = l->data;
+
+      broadway_output_grab_pointer (client->output,
                                     id,
                                     owner_events);
-      broadway_server_flush (server);
     }
 
+  broadway_server_flush (server);
+
   /* TODO: What about surface grab events if we're not connected? */
 
   return GDK_GRAB_SUCCESS;
@@ -1756,6 +2274,7 @@ broadway_server_ungrab_pointer (BroadwayServer *server,
                                 guint32    time_)
 {
   guint32 serial;
+  GList *l;
 
   if (server->pointer_grab_surface_id != -1 &&
       time_ != 0 && server->pointer_grab_time > time_)
@@ -1763,16 +2282,17 @@ broadway_server_ungrab_pointer (BroadwayServer *server,
 
   /* TODO: What about surface grab events if we're not connected? */
 
-  if (server->output)
-    {
-      serial = broadway_output_ungrab_pointer (server->output);
-      broadway_server_flush (server);
-    }
-  else
+  /* The primary client's serial is the one that counts */
+  serial = server->saved_serial;
+  for (l = g_list_last (server->clients); l != NULL; l = l->prev)
     {
-      serial = server->saved_serial;
+      BroadwayInput *client = l->data;
+
+      serial = broadway_output_ungrab_pointer (client->output);
     }
 
+  broadway_server_flush (server);
+
   server->pointer_grab_surface_id = -1;
 
   return serial;
@@ -1787,6 +2307,7 @@ broadway_server_new_surface (BroadwayServer *server,
                              gboolean is_temp)
 {
   BroadwaySurface *surface;
+  GList *l;
 
   surface = g_new0 (BroadwaySurface, 1);
   surface->id = server->id_counter++;
@@ -1808,36 +2329,37 @@ broadway_server_new_surface (BroadwayServer *server,
 
   server->surfaces = g_list_append (server->surfaces, surface);
 
-  if (server->output)
-    broadway_output_new_surface (server->output,
-                                 surface->id,
-                                 surface->x,
-                                 surface->y,
-                                 surface->width,
-                                 surface->height,
-                                 surface->is_temp);
-  else
+  for (l = server->clients; l != NULL; l = l->next)
+    {
+      BroadwayInput *client = l->data;
+
+      broadway_output_new_surface (client->output,
+                                   surface->id,
+                                   surface->x,
+                                   surface->y,
+                                   surface->width,
+                                   surface->height,
+                                   surface->is_temp);
+    }
+
+  if (server->clients == NULL)
     fake_configure_notify (server, surface);
 
   return surface->id;
 }
 
 static void
-broadway_server_resync_surfaces (BroadwayServer *server)
+broadway_server_resync_surfaces (BroadwayServer *server,
+                                 BroadwayInput  *client)
 {
   GHashTableIter iter;
   gpointer key, value;
   GList *l;
 
-  if (server->output == NULL)
-    return;
-
   /* First upload all textures */
   g_hash_table_iter_init (&iter, server->textures);
   while (g_hash_table_iter_next (&iter, &key, &value))
-    broadway_output_upload_texture (server->output,
-                                    GPOINTER_TO_INT (key),
-                                    (GBytes *)value);
+    texture_resend (client->output, value, GPOINTER_TO_INT (key));
 
   /* Then create all surfaces */
   for (l = server->surfaces; l != NULL; l = l->next)
@@ -1847,7 +2369,7 @@ broadway_server_resync_surfaces (BroadwayServer *server)
       if (surface->id == 0)
         continue; /* Skip root */
 
-      broadway_output_new_surface (server->output,
+      broadway_output_new_surface (client->output,
                                    surface->id,
                                    surface->x,
                                    surface->y,
@@ -1865,19 +2387,18 @@ broadway_server_resync_surfaces (BroadwayServer *server)
         continue; /* Skip root */
 
       if (surface->transient_for != -1)
-        broadway_output_set_transient_for (server->output, surface->id,
+        broadway_output_set_transient_for (client->output, surface->id,
                                            surface->transient_for);
 
       if (surface->nodes)
-        broadway_output_surface_set_nodes (server->output, surface->id,
-                                           surface->nodes, NULL);
+        client_send_nodes (server, client, surface, NULL);
 
       if (surface->visible)
-        broadway_output_show_surface (server->output, surface->id);
+        broadway_output_show_surface (client->output, surface->id);
     }
 
   if (server->show_keyboard)
-    broadway_output_set_show_keyboard (server->output, TRUE);
+    broadway_output_set_show_keyboard (client->output, TRUE);
 
-  broadway_server_flush (server);
+  broadway_output_flush (client->output);
 }
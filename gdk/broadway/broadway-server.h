@@ -20,7 +20,21 @@ typedef struct _BroadwayServerClass BroadwayServerClass;
 
 typedef struct _BroadwayNode BroadwayNode;
 
+/* Frame delivery to a web client. Times are in microseconds, round
+ * trips are measured from the end of a frame to the browser
+ * acknowledging that it displayed it. */
+typedef struct {
+  guint frames_in_flight; /* Not acknowledged by the browser yet */
+  guint64 bytes_in_flight;
+  guint64 frames_acked;
+  guint64 frames_skipped; /* Not sent as the browser was too far behind */
+  gint64 rtt; /* Smoothed */
+  gint64 min_rtt;
+  gint64 max_rtt;
+} BroadwayServerStats;
+
 struct _BroadwayNode {
+  guint32 refcount; /* Only used for roots */
   guint32 type;
   guint32 hash; /* deep hash */
   guint32 n_children;
@@ -46,6 +60,11 @@ void                broadway_server_sync                      (BroadwayServer  *
 void                broadway_server_roundtrip                 (BroadwayServer  *server,
                                                                gint             id,
                                                                guint32          tag);
+void                broadway_server_set_max_frames_in_flight  (BroadwayServer  *server,
+                                                               guint            max_frames);
+gboolean            broadway_server_get_stats                 (BroadwayServer  *server,
+                                                               guint            client,
+                                                               BroadwayServerStats *stats);
 void                broadway_server_get_screen_size           (BroadwayServer  *server,
                                                                guint32         *width,
                                                                guint32         *height);
@@ -95,6 +114,11 @@ gboolean            broadway_server_surface_translate         (BroadwayServer  *
                                                                gint             dy);
 guint32             broadway_server_upload_texture            (BroadwayServer  *server,
                                                                GBytes          *texture);
+guint32             broadway_server_patch_texture             (BroadwayServer  *server,
+                                                               guint32          base_id,
+                                                               guint32          x,
+                                                               guint32          y,
+                                                               GBytes          *patch);
 void                broadway_server_release_texture           (BroadwayServer  *server,
                                                                guint32          id);
 cairo_surface_t   * broadway_server_create_surface            (int              width,
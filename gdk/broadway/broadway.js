@@ -82,6 +82,8 @@ var realSurfaceWithMouse = 0;
 var surfaceWithMouse = 0;
 var surfaces = {};
 var textures = {};
+var textureImages = {};
+var pendingPatch = null;
 var stackingOrder = [];
 var outstandingCommands = new Array();
 var inputSocket = null;
@@ -246,9 +248,13 @@ function cmdDeleteSurface(id)
     delete surfaces[id];
 }
 
+/* Roundtrips end frames, and the server uses the reply to pace apps,
+   so only reply once the frame is on screen */
 function cmdRoundtrip(id, tag)
 {
-    sendInput("F", [id, tag]);
+    window.requestAnimationFrame(function() {
+        sendInput("F", [id, tag]);
+    });
 }
 
 function cmdMoveResizeSurface(id, has_pos, x, y, has_size, w, h)
@@ -709,16 +715,72 @@ function cmdSurfaceSetNodes(id, node_data)
 
 function cmdUploadTexture(id, data)
 {
-    var blob = new Blob([data],{type: "image/png"});
+    // Large photos are sent as JPEG
+    var type = (data.length > 1 && data[0] == 0xff && data[1] == 0xd8) ? "image/jpeg" : "image/png";
+    var blob = new Blob([data],{type: type});
     var url = window.URL.createObjectURL(blob);
     textures[id] = url;
 }
 
+function getTextureImage(id)
+{
+    var image = textureImages[id];
+    if (!image) {
+        image = new Image();
+        image.src = textures[id];
+        textureImages[id] = image;
+    }
+    return image;
+}
+
+/* Returns false if it has to wait for images to load, it is called
+   again via handleOutstanding() once they have */
+function cmdPatchTexture(id, baseId, x, y, data)
+{
+    var base = getTextureImage(baseId);
+
+    if (!pendingPatch || pendingPatch.id != id) {
+        var url = window.URL.createObjectURL(new Blob([data],{type: "image/png"}));
+        pendingPatch = { id: id, url: url, image: new Image() };
+        pendingPatch.image.onload = pendingPatch.image.onerror = handleOutstanding;
+        pendingPatch.image.src = url;
+    }
+
+    if (!base.complete) {
+        base.onload = base.onerror = handleOutstanding;
+        return false;
+    }
+    if (!pendingPatch.image.complete)
+        return false;
+
+    var patch = pendingPatch.image;
+    var canvas = document.createElement("canvas");
+    canvas.width = base.naturalWidth;
+    canvas.height = base.naturalHeight;
+    var context = canvas.getContext("2d");
+    try {
+        context.drawImage(base, 0, 0);
+        context.clearRect(x, y, patch.naturalWidth, patch.naturalHeight);
+        context.drawImage(patch, x, y);
+    } catch (e) {
+        log("Failed to patch texture " + id + ": " + e);
+    }
+
+    window.URL.revokeObjectURL(pendingPatch.url);
+    pendingPatch = null;
+
+    if (id in textures)
+        cmdReleaseTexture(id);
+    textures[id] = canvas.toDataURL("image/png");
+    return true;
+}
+
 function cmdReleaseTexture(id)
 {
     var url = textures[id];
     window.URL.revokeObjectURL(url);
     delete textures[id];
+    delete textureImages[id];
 }
 
 function cmdGrabPointer(id, ownerEvents)
@@ -744,6 +806,7 @@ function handleCommands(cmd)
 
     while (cmd.pos < cmd.length) {
         var id, x, y, w, h, q;
+        var start = cmd.pos;
         var command = cmd.get_char();
         lastSerial = cmd.get_32();
         switch (command) {
@@ -821,6 +884,18 @@ function handleCommands(cmd)
             cmdUploadTexture(id, data);
             break;
 
+        case 'x': // Patch texture
+            id = cmd.get_32();
+            var baseId = cmd.get_32();
+            x = cmd.get_32();
+            y = cmd.get_32();
+            var patchData = cmd.get_data();
+            if (!cmdPatchTexture(id, baseId, x, y, patchData)) {
+                cmd.pos = start;
+                return false;
+            }
+            break;
+
         case 'T': // Release texture
             id = cmd.get_32();
             cmdReleaseTexture(id);
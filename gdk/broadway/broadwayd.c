@@ -297,6 +297,7 @@ decode_nodes (BroadwayClient *client,
   }
 
   node = g_malloc (sizeof(BroadwayNode) + (size - 1) * sizeof(guint32) + n_children * sizeof (BroadwayNode *));
+  node->refcount = 1;
   node->type = type;
   node->n_children = n_children;
   node->children = (BroadwayNode **)((char *)node + sizeof(BroadwayNode) + (size - 1) * sizeof(guint32));
@@ -448,7 +449,21 @@ client_handle_request (BroadwayClient *client,
           close (fd);
 
           texture = g_bytes_new_take (data, request->upload_texture.size);
-          global_id = broadway_server_upload_texture (server, texture);
+          if (request->upload_texture.base_id != 0)
+            {
+              guint32 base_id;
+
+              base_id = GPOINTER_TO_INT (g_hash_table_lookup (client->textures,
+                                                              GINT_TO_POINTER (request->upload_texture.base_id)));
+              global_id = broadway_server_patch_texture (server, base_id,
+                                                         request->upload_texture.x,
+                                                         request->upload_texture.y,
+                                                         texture);
+              if (global_id == 0)
+                g_warning ("Patch for unknown texture %d", request->upload_texture.base_id);
+            }
+          else
+            global_id = broadway_server_upload_texture (server, texture);
           g_bytes_unref (texture);
 
           g_hash_table_replace (client->textures,
@@ -634,6 +649,21 @@ incoming_client (GSocketService    *service,
   return TRUE;
 }
 
+static gboolean
+print_stats_cb (gpointer user_data)
+{
+  BroadwayServerStats stats;
+  guint i;
+
+  for (i = 0; broadway_server_get_stats (server, i, &stats); i++)
+    g_print ("client %u: rtt %.1f ms (min %.1f, max %.1f), in flight %u frames %" G_GUINT64_FORMAT " bytes, "
+             "acked %" G_GUINT64_FORMAT " frames, skipped %" G_GUINT64_FORMAT "\n",
+             i, stats.rtt / 1000.0, stats.min_rtt / 1000.0, stats.max_rtt / 1000.0,
+             stats.frames_in_flight, stats.bytes_in_flight,
+             stats.frames_acked, stats.frames_skipped);
+
+  return G_SOURCE_CONTINUE;
+}
 
 int
 main (int argc, char *argv[])
@@ -648,6 +678,8 @@ main (int argc, char *argv[])
   int http_port = 0;
   char *ssl_cert = NULL;
   char *ssl_key = NULL;
+  int max_frames = 0;
+  int stats_interval = 0;
   const char *display;
   int port = 0;
   const GOptionEntry entries[] = {
@@ -658,6 +690,8 @@ main (int argc, char *argv[])
 #endif
     { "cert", 'c', 0, G_OPTION_ARG_STRING, &ssl_cert, "SSL certificate path", "PATH" },
     { "key", 'k', 0, G_OPTION_ARG_STRING, &ssl_key, "SSL key path", "PATH" },
+    { "max-frames", 'f', 0, G_OPTION_ARG_INT, &max_frames, "Frames the browser may lag behind", "FRAMES" },
+    { "stats", 's', 0, G_OPTION_ARG_INT, &stats_interval, "Print frame statistics every SECONDS", "SECONDS" },
     { NULL }
   };
 
@@ -725,6 +759,11 @@ main (int argc, char *argv[])
       return 1;
     }
 
+  if (max_frames > 0)
+    broadway_server_set_max_frames_in_flight (server, max_frames);
+  if (stats_interval > 0)
+    g_timeout_add_seconds (stats_interval, print_stats_cb, NULL);
+
   listener = g_socket_service_new ();
   if (!g_socket_listener_add_address (G_SOCKET_LISTENER (listener),
                                       address,
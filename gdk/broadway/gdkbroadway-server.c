@@ -639,32 +639,230 @@ write_png_cb (void         *closure,
   return CAIRO_STATUS_SUCCESS;
 }
 
-guint32
-gdk_broadway_server_upload_texture (GdkBroadwayServer *server,
-                                    GdkTexture        *texture)
+static gboolean
+write_jpeg_cb (const gchar  *buf,
+               gsize         count,
+               GError      **error,
+               gpointer      closure)
+{
+  return write_png_cb (closure, (const guchar *) buf, count) == CAIRO_STATUS_SUCCESS;
+}
+
+/* Textures smaller than this are sent losslessly */
+#define JPEG_MIN_PIXELS (128 * 128)
+
+/* BROADWAY_JPEG_QUALITY from 1 to 100 enables lossy compression, which
+ * is off by default */
+static int
+get_jpeg_quality (void)
+{
+  static int quality = -1;
+
+  if (quality < 0)
+    {
+      const char *env = g_getenv ("BROADWAY_JPEG_QUALITY");
+
+      quality = env ? CLAMP (atoi (env), 0, 100) : 0;
+    }
+
+  return quality;
+}
+
+/* Whether the image is opaque and has enough distinct colors to be a
+ * photo, which JPEG handles much better than PNG */
+static gboolean
+is_photographic (cairo_surface_t *surface)
+{
+  int width = cairo_image_surface_get_width (surface);
+  int height = cairo_image_surface_get_height (surface);
+  int stride = cairo_image_surface_get_stride (surface);
+  const guchar *data = cairo_image_surface_get_data (surface);
+  GHashTable *colors;
+  gboolean result;
+  int x, y, step;
+
+  if (width * height < JPEG_MIN_PIXELS)
+    return FALSE;
+
+  for (y = 0; y < height; y++)
+    {
+      const guint32 *row = (const guint32 *) (data + y * stride);
+
+      for (x = 0; x < width; x++)
+        {
+          if ((row[x] >> 24) != 0xff)
+            return FALSE;
+        }
+    }
+
+  /* Sample about 1000 pixels */
+  colors = g_hash_table_new (NULL, NULL);
+  step = MAX (1, (width * height) / 1024);
+  for (x = 0; x < width * height; x += step)
+    {
+      const guint32 *row = (const guint32 *) (data + (x / width) * stride);
+
+      g_hash_table_add (colors, GUINT_TO_POINTER (row[x % width] & 0xffffff));
+    }
+  result = g_hash_table_size (colors) > 256;
+  g_hash_table_destroy (colors);
+
+  return result;
+}
+
+/* Sends @surface as texture @id, as a patch for @base_id at @x, @y
+ * if @base_id is not 0 */
+static void
+upload_surface (GdkBroadwayServer *server,
+                cairo_surface_t   *surface,
+                guint32            id,
+                guint32            base_id,
+                int                x,
+                int                y)
 {
-  guint32 id;
-  cairo_surface_t *surface = gdk_texture_download_surface (texture);
   BroadwayRequestUploadTexture msg;
   PngData data;
-
-  id = server->next_texture_id++;
+  int quality;
 
   data.fd = open_shared_memory ();
   data.size = 0;
-  cairo_surface_write_to_png_stream (surface, write_png_cb, &data);
+
+  quality = get_jpeg_quality ();
+  if (quality > 0 && base_id == 0 && is_photographic (surface))
+    {
+      GdkPixbuf *pixbuf;
+      char *quality_str;
+
+      pixbuf = gdk_pixbuf_get_from_surface (surface, 0, 0,
+                                            cairo_image_surface_get_width (surface),
+                                            cairo_image_surface_get_height (surface));
+      quality_str = g_strdup_printf ("%d", quality);
+      gdk_pixbuf_save_to_callback (pixbuf, write_jpeg_cb, &data, "jpeg", NULL,
+                                   "quality", quality_str, NULL);
+      g_free (quality_str);
+      g_object_unref (pixbuf);
+    }
+  else
+    cairo_surface_write_to_png_stream (surface, write_png_cb, &data);
 
   msg.id = id;
   msg.offset = 0;
   msg.size = data.size;
+  msg.base_id = base_id;
+  msg.x = x;
+  msg.y = y;
 
   /* This passes ownership of fd */
   gdk_broadway_server_send_fd_message (server, msg,
                                        BROADWAY_REQUEST_UPLOAD_TEXTURE, data.fd);
+}
+
+guint32
+gdk_broadway_server_upload_texture (GdkBroadwayServer *server,
+                                    GdkTexture        *texture)
+{
+  cairo_surface_t *surface = gdk_texture_download_surface (texture);
+  guint32 id;
+
+  id = server->next_texture_id++;
+  upload_surface (server, surface, id, 0, 0, 0);
+  cairo_surface_destroy (surface);
 
   return id;
 }
 
+/* Changes of more than this fraction of a texture are sent in full */
+#define MAX_PATCH_FRACTION 0.5
+
+/* Uploads @texture as the changed area relative to @base, which must
+ * have been uploaded as @base_id. Returns 0 if that isn't worth it. */
+guint32
+gdk_broadway_server_upload_texture_patch (GdkBroadwayServer *server,
+                                          GdkTexture        *texture,
+                                          GdkTexture        *base,
+                                          guint32            base_id)
+{
+  cairo_surface_t *surface, *base_surface, *patch;
+  int width, height, stride, base_stride;
+  int x, y, x1, y1, x2, y2;
+  const guchar *data, *base_data;
+  guint32 id;
+  cairo_t *cr;
+
+  width = gdk_texture_get_width (texture);
+  height = gdk_texture_get_height (texture);
+  if (width != gdk_texture_get_width (base) ||
+      height != gdk_texture_get_height (base))
+    return 0;
+
+  surface = gdk_texture_download_surface (texture);
+  base_surface = gdk_texture_download_surface (base);
+  data = cairo_image_surface_get_data (surface);
+  stride = cairo_image_surface_get_stride (surface);
+  base_data = cairo_image_surface_get_data (base_surface);
+  base_stride = cairo_image_surface_get_stride (base_surface);
+
+  /* Bounding box of the changed pixels */
+  x1 = width;
+  y1 = height;
+  x2 = y2 = 0;
+  for (y = 0; y < height; y++)
+    {
+      const guint32 *row = (const guint32 *) (data + y * stride);
+      const guint32 *base_row = (const guint32 *) (base_data + y * base_stride);
+
+      if (memcmp (row, base_row, width * 4) == 0)
+        continue;
+
+      y1 = MIN (y1, y);
+      y2 = y + 1;
+      for (x = 0; x < x1; x++)
+        {
+          if (row[x] != base_row[x])
+            {
+              x1 = x;
+              break;
+            }
+        }
+      for (x = width; x > x2; x--)
+        {
+          if (row[x - 1] != base_row[x - 1])
+            {
+              x2 = x;
+              break;
+            }
+        }
+    }
+
+  cairo_surface_destroy (base_surface);
+
+  /* Nothing changed, still send a pixel so the texture gets its own id */
+  if (y2 == 0)
+    {
+      x1 = y1 = 0;
+      x2 = y2 = 1;
+    }
+
+  if ((x2 - x1) * (y2 - y1) > MAX_PATCH_FRACTION * width * height)
+    {
+      cairo_surface_destroy (surface);
+      return 0;
+    }
+
+  patch = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, x2 - x1, y2 - y1);
+  cr = cairo_create (patch);
+  cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+  cairo_set_source_surface (cr, surface, -x1, -y1);
+  cairo_paint (cr);
+  cairo_destroy (cr);
+  cairo_surface_destroy (surface);
+
+  id = server->next_texture_id++;
+  upload_surface (server, patch, id, base_id, x1, y1);
+  cairo_surface_destroy (patch);
+
+  return id;
+}
 
 void
 gdk_broadway_server_release_texture (GdkBroadwayServer *server,
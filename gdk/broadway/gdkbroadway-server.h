@@ -64,6 +64,10 @@ gboolean           _gdk_broadway_server_surface_translate         (GdkBroadwaySe
 								  gint                dy);
 guint32             gdk_broadway_server_upload_texture           (GdkBroadwayServer  *server,
                                                                   GdkTexture         *texture);
+guint32             gdk_broadway_server_upload_texture_patch     (GdkBroadwayServer  *server,
+                                                                  GdkTexture         *texture,
+                                                                  GdkTexture         *base,
+                                                                  guint32             base_id);
 void                gdk_broadway_server_release_texture          (GdkBroadwayServer  *server,
                                                                   guint32             id);
 void               gdk_broadway_server_surface_set_nodes          (GdkBroadwayServer *server,
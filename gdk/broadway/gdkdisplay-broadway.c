@@ -351,10 +351,15 @@ gdk_broadway_display_get_last_seen_time (GdkDisplay *display)
 
 typedef struct {
   int id;
+  int patch_depth; /* Number of patches the browser applies to build it */
   GdkDisplay *display;
   GList *textures;
 } BroadwayTextureData;
 
+/* Bounds the number of textures broadwayd keeps alive for rebuilding
+ * a patched texture */
+#define MAX_PATCH_DEPTH 8
+
 static void
 broadway_texture_data_free (BroadwayTextureData *data)
 {
@@ -365,25 +370,60 @@ broadway_texture_data_free (BroadwayTextureData *data)
   g_free (data);
 }
 
+static BroadwayTextureData *
+set_texture_data (GdkDisplay *display,
+                  GdkTexture *texture,
+                  guint32     id,
+                  int         patch_depth)
+{
+  BroadwayTextureData *data;
+
+  data = g_new0 (BroadwayTextureData, 1);
+  data->id = id;
+  data->patch_depth = patch_depth;
+  data->display = g_object_ref (display);
+  g_object_set_data_full (G_OBJECT (texture), "broadway-data", data, (GDestroyNotify)broadway_texture_data_free);
+
+  return data;
+}
+
 guint32
 gdk_broadway_display_ensure_texture (GdkDisplay *display,
                                      GdkTexture *texture)
+{
+  return gdk_broadway_display_ensure_texture_with_base (display, texture, NULL);
+}
+
+/* Like gdk_broadway_display_ensure_texture(), but if @base is an
+ * uploaded texture of the same size with mostly the same contents,
+ * only the changed area of @texture is sent. */
+guint32
+gdk_broadway_display_ensure_texture_with_base (GdkDisplay *display,
+                                               GdkTexture *texture,
+                                               GdkTexture *base)
 {
   GdkBroadwayDisplay *broadway_display = GDK_BROADWAY_DISPLAY (display);
-  BroadwayTextureData *data;
+  BroadwayTextureData *data, *base_data;
+  guint32 id;
 
   data = g_object_get_data (G_OBJECT (texture), "broadway-data");
-  if (data == NULL)
-    {
-      guint32 id = gdk_broadway_server_upload_texture (broadway_display->server, texture);
+  if (data != NULL)
+    return data->id;
 
-      data = g_new0 (BroadwayTextureData, 1);
-      data->id = id;
-      data->display = g_object_ref (display);
-      g_object_set_data_full (G_OBJECT (texture), "broadway-data", data, (GDestroyNotify)broadway_texture_data_free);
+  base_data = base ? g_object_get_data (G_OBJECT (base), "broadway-data") : NULL;
+  if (base_data != NULL &&
+      base_data->display == display &&
+      base_data->patch_depth < MAX_PATCH_DEPTH)
+    {
+      id = gdk_broadway_server_upload_texture_patch (broadway_display->server,
+                                                     texture, base, base_data->id);
+      if (id != 0)
+        return set_texture_data (display, texture, id, base_data->patch_depth + 1)->id;
     }
 
-  return data->id;
+  id = gdk_broadway_server_upload_texture (broadway_display->server, texture);
+
+  return set_texture_data (display, texture, id, 0)->id;
 }
 
 static void
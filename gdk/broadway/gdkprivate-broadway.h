@@ -40,6 +40,9 @@
 
 guint32 gdk_broadway_display_ensure_texture (GdkDisplay *display,
                                              GdkTexture *texture);
+guint32 gdk_broadway_display_ensure_texture_with_base (GdkDisplay *display,
+                                                       GdkTexture *texture,
+                                                       GdkTexture *base);
 
 void gdk_broadway_surface_set_nodes (GdkSurface *surface,
                                      GArray *nodes,
@@ -106,6 +106,7 @@ typedef struct {
   guint has_gl_framebuffer_blit : 1;
   guint has_frame_terminator : 1;
   guint has_unpack_subimage : 1;
+  guint has_sync : 1;
   guint has_debug_output : 1;
   guint extensions_checked : 1;
   guint debug_enabled : 1;
@@ -442,6 +443,36 @@ gdk_gl_context_has_unpack_subimage (GdkGLContext *context)
   return priv->has_unpack_subimage;
 }
 
+gboolean
+gdk_gl_context_has_sync (GdkGLContext *context)
+{
+  GdkGLContextPrivate *priv = gdk_gl_context_get_instance_private (context);
+
+  return priv->has_sync;
+}
+
+/* Whether @context and @other are in the same share group, so that
+ * textures of one of them can be used in the other */
+gboolean
+gdk_gl_context_is_shared (GdkGLContext *context,
+                          GdkGLContext *other)
+{
+  GdkGLContext *root, *other_root;
+
+  g_return_val_if_fail (GDK_IS_GL_CONTEXT (context), FALSE);
+  g_return_val_if_fail (GDK_IS_GL_CONTEXT (other), FALSE);
+
+  root = gdk_gl_context_get_shared_context (context);
+  if (root == NULL)
+    root = context;
+
+  other_root = gdk_gl_context_get_shared_context (other);
+  if (other_root == NULL)
+    other_root = other;
+
+  return root == other_root;
+}
+
 /**
  * gdk_gl_context_set_debug_enabled:
  * @context: a #GdkGLContext
@@ -896,6 +927,7 @@ gdk_gl_context_check_extensions (GdkGLContext *context)
       priv->has_frame_terminator = FALSE;
 
       priv->has_unpack_subimage = epoxy_has_gl_extension ("GL_EXT_unpack_subimage");
+      priv->has_sync = priv->gl_version >= 30;
     }
   else
     {
@@ -905,6 +937,7 @@ gdk_gl_context_check_extensions (GdkGLContext *context)
       priv->has_gl_framebuffer_blit = epoxy_has_gl_extension ("GL_EXT_framebuffer_blit");
       priv->has_frame_terminator = epoxy_has_gl_extension ("GL_GREMEDY_frame_terminator");
       priv->has_unpack_subimage = TRUE;
+      priv->has_sync = priv->gl_version >= 32 || epoxy_has_gl_extension ("GL_ARB_sync");
 
       /* We asked for a core profile, but we didn't get one, so we're in legacy mode */
       if (priv->gl_version < 32)
@@ -21,6 +21,7 @@
 #include "gdkgltextureprivate.h"
 
 #include "gdkcairo.h"
+#include "gdkglcontextprivate.h"
 #include "gdktextureprivate.h"
 
 #include <epoxy/gl.h>
@@ -31,6 +32,10 @@ struct _GdkGLTexture {
   GdkGLContext *context;
   guint id;
 
+  /* Signals when the commands drawing the texture are done,
+   * for users in other contexts of the share group */
+  GLsync sync;
+
   cairo_surface_t *saved;
 
   GDestroyNotify destroy;
@@ -43,11 +48,34 @@ struct _GdkGLTextureClass {
 
 G_DEFINE_TYPE (GdkGLTexture, gdk_gl_texture, GDK_TYPE_TEXTURE)
 
+static void
+gdk_gl_texture_clear_sync (GdkGLTexture *self)
+{
+  GdkGLContext *current;
+
+  if (self->sync == NULL)
+    return;
+
+  current = gdk_gl_context_get_current ();
+  if (current == NULL || !gdk_gl_context_is_shared (current, self->context))
+    gdk_gl_context_make_current (self->context);
+
+  glDeleteSync (self->sync);
+  self->sync = NULL;
+
+  if (current == NULL)
+    gdk_gl_context_clear_current ();
+  else if (current != gdk_gl_context_get_current ())
+    gdk_gl_context_make_current (current);
+}
+
 static void
 gdk_gl_texture_dispose (GObject *object)
 {
   GdkGLTexture *self = GDK_GL_TEXTURE (object);
 
+  gdk_gl_texture_clear_sync (self);
+
   if (self->destroy)
     {
       self->destroy (self->data);
@@ -131,6 +159,20 @@ gdk_gl_texture_get_id (GdkGLTexture *self)
   return self->id;
 }
 
+/* Makes the commands of the current context, which must share with
+ * the texture's context, wait until the texture has been drawn */
+void
+gdk_gl_texture_wait_sync (GdkGLTexture *self)
+{
+  if (self->sync == NULL)
+    return;
+
+  /* This only blocks the GPU, not us. The fence is kept until the
+   * texture is released, as every context using the texture has to
+   * wait for it, and waiting again once it is signaled costs nothing. */
+  glWaitSync (self->sync, 0, GL_TIMEOUT_IGNORED);
+}
+
 /**
  * gdk_gl_texture_release:
  * @self: a #GdkTexture wrapping a GL texture
@@ -164,6 +206,8 @@ gdk_gl_texture_release (GdkGLTexture *self)
 
   cairo_destroy (cr);
 
+  gdk_gl_texture_clear_sync (self);
+
   if (self->destroy)
     {
       self->destroy (self->data);
@@ -218,6 +262,15 @@ gdk_gl_texture_new (GdkGLContext   *context,
   self->destroy = destroy;
   self->data = data;
 
+  /* Usually the texture has just been drawn, so let other contexts
+   * sharing it know when that is done */
+  if (gdk_gl_context_get_current () == context &&
+      gdk_gl_context_has_sync (context))
+    {
+      self->sync = glFenceSync (GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      glFlush ();
+    }
+
   return GDK_TEXTURE (self);
 }
 
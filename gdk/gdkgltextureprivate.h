@@ -9,6 +9,7 @@ G_BEGIN_DECLS
 
 GdkGLContext *          gdk_gl_texture_get_context      (GdkGLTexture           *self);
 guint                   gdk_gl_texture_get_id           (GdkGLTexture           *self);
+void                    gdk_gl_texture_wait_sync        (GdkGLTexture           *self);
 
 G_END_DECLS
 
@@ -21,6 +21,12 @@
 
 #include "gdkmemorytextureprivate.h"
 
+#include <string.h>
+
+#ifdef HAVE_X86_INTRINSICS
+#include <immintrin.h>
+#endif
+
 struct _GdkMemoryTexture
 {
   GdkTexture parent_instance;
@@ -38,6 +44,24 @@ struct _GdkMemoryTextureClass
 
 G_DEFINE_TYPE (GdkMemoryTexture, gdk_memory_texture, GDK_TYPE_TEXTURE)
 
+static void convert_yuv (guchar          *dest_data,
+                         gsize            dest_stride,
+                         GdkMemoryFormat  dest_format,
+                         const guchar    *src_data,
+                         gsize            src_stride,
+                         GdkMemoryFormat  src_format,
+                         gsize            src_height,
+                         gsize            x,
+                         gsize            y,
+                         gsize            width,
+                         gsize            height);
+
+static gboolean
+gdk_memory_format_is_yuv (GdkMemoryFormat format)
+{
+  return format == GDK_MEMORY_NV12 || format == GDK_MEMORY_I420;
+}
+
 static gsize
 gdk_memory_format_bytes_per_pixel (GdkMemoryFormat format)
 {
@@ -55,6 +79,28 @@ gdk_memory_format_bytes_per_pixel (GdkMemoryFormat format)
     case GDK_MEMORY_B8G8R8:
       return 3;
 
+    case GDK_MEMORY_R16G16B16:
+    case GDK_MEMORY_R16G16B16_FLOAT:
+      return 6;
+
+    case GDK_MEMORY_R16G16B16A16_PREMULTIPLIED:
+    case GDK_MEMORY_R16G16B16A16:
+    case GDK_MEMORY_R16G16B16A16_FLOAT_PREMULTIPLIED:
+    case GDK_MEMORY_R16G16B16A16_FLOAT:
+      return 8;
+
+    case GDK_MEMORY_R32G32B32_FLOAT:
+      return 12;
+
+    case GDK_MEMORY_R32G32B32A32_FLOAT_PREMULTIPLIED:
+    case GDK_MEMORY_R32G32B32A32_FLOAT:
+      return 16;
+
+    /* Of the Y plane */
+    case GDK_MEMORY_NV12:
+    case GDK_MEMORY_I420:
+      return 1;
+
     case GDK_MEMORY_N_FORMATS:
     default:
       g_assert_not_reached ();
@@ -80,6 +126,19 @@ gdk_memory_texture_download (GdkTexture         *texture,
 {
   GdkMemoryTexture *self = GDK_MEMORY_TEXTURE (texture);
 
+  if (gdk_memory_format_is_yuv (self->format))
+    {
+      convert_yuv (data, stride,
+                   GDK_MEMORY_CAIRO_FORMAT_ARGB32,
+                   g_bytes_get_data (self->bytes, NULL),
+                   self->stride,
+                   self->format,
+                   gdk_texture_get_height (texture),
+                   area->x, area->y,
+                   area->width, area->height);
+      return;
+    }
+
   gdk_memory_convert (data, stride,
                       GDK_MEMORY_CAIRO_FORMAT_ARGB32,
                       (guchar *) g_bytes_get_data (self->bytes, NULL)
@@ -275,7 +334,9 @@ typedef void (* ConversionFunc) (guchar       *dest_data,
                                  gsize         width,
                                  gsize         height);
 
-static ConversionFunc converters[GDK_MEMORY_N_FORMATS][2] =
+/* Only the 8 bit formats use these, the others go through rows of
+ * premultiplied floats or through convert_yuv() */
+static ConversionFunc converters[GDK_MEMORY_R16G16B16][2] =
 {
   { convert_memcpy, convert_swizzle3210 },
   { convert_swizzle3210, convert_memcpy },
@@ -287,6 +348,526 @@ static ConversionFunc converters[GDK_MEMORY_N_FORMATS][2] =
   { convert_swizzle_opaque_3012, convert_swizzle_opaque_0321 }
 };
 
+/* IEEE 754 half to float, including denormals, infinities and NaN */
+static inline float
+half_to_float (guint16 h)
+{
+  union { guint32 i; float f; } u;
+  guint32 sign = (guint32) (h & 0x8000) << 16;
+  guint32 exponent = (h >> 10) & 0x1F;
+  guint32 mantissa = h & 0x3FF;
+
+  if (exponent == 0)
+    {
+      u.f = mantissa * (1.0f / (1 << 24));
+      u.i |= sign;
+    }
+  else if (exponent == 31)
+    u.i = sign | 0x7F800000 | (mantissa << 13);
+  else
+    u.i = sign | ((exponent + 112) << 23) | (mantissa << 13);
+
+  return u.f;
+}
+
+/* Loads a row into RGBA floats */
+typedef void (* LoadFunc) (float        *dest,
+                           const guchar *src,
+                           gsize         width);
+
+#define LOAD(name, type, n_channels, TO_FLOAT) \
+static void \
+load_ ## name (float        *dest, \
+               const guchar *src, \
+               gsize         width) \
+{ \
+  const type *s = (const type *) src; \
+  gsize x; \
+\
+  for (x = 0; x < width; x++) \
+    { \
+      dest[4 * x + 0] = TO_FLOAT (s[n_channels * x + 0]); \
+      dest[4 * x + 1] = TO_FLOAT (s[n_channels * x + 1]); \
+      dest[4 * x + 2] = TO_FLOAT (s[n_channels * x + 2]); \
+      dest[4 * x + 3] = n_channels == 4 ? TO_FLOAT (s[n_channels * x + 3]) : 1.0f; \
+    } \
+}
+
+#define U16_TO_FLOAT(v) ((v) * (1.0f / 65535.0f))
+#define FLOAT_TO_FLOAT(v) (v)
+
+LOAD(u16_rgb, guint16, 3, U16_TO_FLOAT)
+LOAD(u16_rgba, guint16, 4, U16_TO_FLOAT)
+LOAD(half_rgb, guint16, 3, half_to_float)
+LOAD(half_rgba, guint16, 4, half_to_float)
+LOAD(float_rgb, float, 3, FLOAT_TO_FLOAT)
+LOAD(float_rgba, float, 4, FLOAT_TO_FLOAT)
+
+static void
+premultiply_row (float *row,
+                 gsize  width)
+{
+  gsize x;
+
+  for (x = 0; x < width; x++)
+    {
+      row[4 * x + 0] *= row[4 * x + 3];
+      row[4 * x + 1] *= row[4 * x + 3];
+      row[4 * x + 2] *= row[4 * x + 3];
+    }
+}
+
+/* Stores premultiplied RGBA floats as one of the 2 default formats */
+static void
+store_row (guchar      *dest,
+           const float *src,
+           gsize        width,
+           gboolean     argb)
+{
+  gsize x;
+  int i;
+
+  for (x = 0; x < width; x++)
+    {
+      guchar c[4];
+
+      for (i = 0; i < 4; i++)
+        c[i] = (guchar) (CLAMP (src[4 * x + i], 0.0f, 1.0f) * 255.0f + 0.5f);
+
+      if (argb)
+        {
+          dest[4 * x + 0] = c[3];
+          dest[4 * x + 1] = c[0];
+          dest[4 * x + 2] = c[1];
+          dest[4 * x + 3] = c[2];
+        }
+      else
+        {
+          dest[4 * x + 0] = c[2];
+          dest[4 * x + 1] = c[1];
+          dest[4 * x + 2] = c[0];
+          dest[4 * x + 3] = c[3];
+        }
+    }
+}
+
+/* BT.601 limited range in 8.8 fixed point */
+static inline guchar
+clamp_byte (int v)
+{
+  return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+static inline void
+yuv_to_pixel (guchar   *dest,
+              int       y,
+              int       u,
+              int       v,
+              gboolean  argb)
+{
+  int c = 298 * (y - 16) + 128;
+  int d = u - 128;
+  int e = v - 128;
+  guchar r, g, b;
+
+  r = clamp_byte ((c + 409 * e) >> 8);
+  g = clamp_byte ((c - 100 * d - 208 * e) >> 8);
+  b = clamp_byte ((c + 516 * d) >> 8);
+
+  if (argb)
+    {
+      dest[0] = 0xFF;
+      dest[1] = r;
+      dest[2] = g;
+      dest[3] = b;
+    }
+  else
+    {
+      dest[0] = b;
+      dest[1] = g;
+      dest[2] = r;
+      dest[3] = 0xFF;
+    }
+}
+
+/* Converts pixels @x to @x + @width of a row. The chroma for pixel i
+ * is at u[i / 2 * uv_step] and v[i / 2 * uv_step]. */
+typedef void (* YuvRowFunc) (guchar       *dest,
+                             const guchar *y_row,
+                             const guchar *u_row,
+                             const guchar *v_row,
+                             gsize         uv_step,
+                             gsize         x,
+                             gsize         width,
+                             gboolean      argb);
+
+static void
+yuv_row (guchar       *dest,
+         const guchar *y_row,
+         const guchar *u_row,
+         const guchar *v_row,
+         gsize         uv_step,
+         gsize         x,
+         gsize         width,
+         gboolean      argb)
+{
+  gsize i;
+
+  for (i = x; i < x + width; i++)
+    yuv_to_pixel (dest + 4 * (i - x), y_row[i], u_row[i / 2 * uv_step], v_row[i / 2 * uv_step], argb);
+}
+
+#ifdef HAVE_X86_INTRINSICS
+
+static void __attribute__ ((target ("sse2")))
+load_u16_rgba_sse2 (float        *dest,
+                    const guchar *src,
+                    gsize         width)
+{
+  const __m128 scale = _mm_set1_ps (1.0f / 65535.0f);
+  const __m128i zero = _mm_setzero_si128 ();
+  gsize x;
+
+  /* 2 pixels at a time */
+  for (x = 0; x + 2 <= width; x += 2)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) (src + 8 * x));
+
+      _mm_storeu_ps (dest + 4 * x, _mm_mul_ps (_mm_cvtepi32_ps (_mm_unpacklo_epi16 (v, zero)), scale));
+      _mm_storeu_ps (dest + 4 * x + 4, _mm_mul_ps (_mm_cvtepi32_ps (_mm_unpackhi_epi16 (v, zero)), scale));
+    }
+
+  load_u16_rgba (dest + 4 * x, src + 8 * x, width - x);
+}
+
+static void __attribute__ ((target ("f16c")))
+load_half_rgba_f16c (float        *dest,
+                     const guchar *src,
+                     gsize         width)
+{
+  gsize x;
+
+  for (x = 0; x < width; x++)
+    _mm_storeu_ps (dest + 4 * x, _mm_cvtph_ps (_mm_loadl_epi64 ((const __m128i *) (src + 8 * x))));
+}
+
+static void __attribute__ ((target ("sse2")))
+premultiply_row_sse2 (float *row,
+                      gsize  width)
+{
+  const __m128 alpha_mask = _mm_castsi128_ps (_mm_set_epi32 (-1, 0, 0, 0));
+  gsize x;
+
+  for (x = 0; x < width; x++)
+    {
+      __m128 v = _mm_loadu_ps (row + 4 * x);
+      __m128 a = _mm_shuffle_ps (v, v, _MM_SHUFFLE (3, 3, 3, 3));
+
+      v = _mm_or_ps (_mm_andnot_ps (alpha_mask, _mm_mul_ps (v, a)),
+                     _mm_and_ps (alpha_mask, v));
+      _mm_storeu_ps (row + 4 * x, v);
+    }
+}
+
+static inline __m128i __attribute__ ((target ("sse2")))
+float_pixel_to_int_sse2 (__m128   v,
+                         gboolean argb)
+{
+  const __m128 zero = _mm_setzero_ps ();
+  const __m128 one = _mm_set1_ps (1.0f);
+  const __m128 scale = _mm_set1_ps (255.0f);
+
+  v = _mm_mul_ps (_mm_min_ps (_mm_max_ps (v, zero), one), scale);
+  if (argb)
+    v = _mm_shuffle_ps (v, v, _MM_SHUFFLE (2, 1, 0, 3));
+  else
+    v = _mm_shuffle_ps (v, v, _MM_SHUFFLE (3, 0, 1, 2));
+
+  return _mm_cvtps_epi32 (v);
+}
+
+static void __attribute__ ((target ("sse2")))
+store_row_sse2 (guchar      *dest,
+                const float *src,
+                gsize        width,
+                gboolean     argb)
+{
+  gsize x;
+
+  /* 4 pixels at a time */
+  for (x = 0; x + 4 <= width; x += 4)
+    {
+      __m128i p0 = float_pixel_to_int_sse2 (_mm_loadu_ps (src + 4 * x), argb);
+      __m128i p1 = float_pixel_to_int_sse2 (_mm_loadu_ps (src + 4 * x + 4), argb);
+      __m128i p2 = float_pixel_to_int_sse2 (_mm_loadu_ps (src + 4 * x + 8), argb);
+      __m128i p3 = float_pixel_to_int_sse2 (_mm_loadu_ps (src + 4 * x + 12), argb);
+
+      _mm_storeu_si128 ((__m128i *) (dest + 4 * x),
+                        _mm_packus_epi16 (_mm_packs_epi32 (p0, p1), _mm_packs_epi32 (p2, p3)));
+    }
+
+  store_row (dest + 4 * x, src + 4 * x, width - x, argb);
+}
+
+/* 8 pixels at a time. The chroma contributions are computed once per
+ * chroma sample with pmaddwd on (U, V) pairs and then duplicated. */
+static void __attribute__ ((target ("sse2")))
+yuv_row_sse2 (guchar       *dest,
+              const guchar *y_row,
+              const guchar *u_row,
+              const guchar *v_row,
+              gsize         uv_step,
+              gsize         x,
+              gsize         width,
+              gboolean      argb)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i alpha = _mm_set1_epi8 ((char) 0xFF);
+  const __m128i y_offset = _mm_set1_epi16 (16);
+  const __m128i uv_offset = _mm_set1_epi16 (128);
+  const __m128i round = _mm_set1_epi32 (128);
+  const __m128i y_coeff = _mm_set_epi16 (0, 298, 0, 298, 0, 298, 0, 298);
+  const __m128i r_coeff = _mm_set_epi16 (409, 0, 409, 0, 409, 0, 409, 0);
+  const __m128i g_coeff = _mm_set_epi16 (-208, -100, -208, -100, -208, -100, -208, -100);
+  const __m128i b_coeff = _mm_set_epi16 (0, 516, 0, 516, 0, 516, 0, 516);
+  gsize i, end;
+
+  i = x;
+  end = x + width;
+
+  /* Chroma pairs start at even pixels */
+  if (i % 2 == 1 && i < end)
+    {
+      yuv_row (dest, y_row, u_row, v_row, uv_step, i, 1, argb);
+      i++;
+    }
+
+  for (; i + 8 <= end; i += 8)
+    {
+      __m128i y, uv, c_lo, c_hi, r, g, b, r_lo, r_hi, g_lo, g_hi, b_lo, b_hi, p_lo, p_hi;
+      guchar *d = dest + 4 * (i - x);
+
+      y = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *) (y_row + i)), zero);
+      y = _mm_sub_epi16 (y, y_offset);
+
+      if (uv_step == 2)
+        uv = _mm_loadl_epi64 ((const __m128i *) (u_row + i));
+      else
+        {
+          guint32 u4, v4;
+
+          memcpy (&u4, u_row + i / 2, 4);
+          memcpy (&v4, v_row + i / 2, 4);
+          uv = _mm_unpacklo_epi8 (_mm_cvtsi32_si128 (u4), _mm_cvtsi32_si128 (v4));
+        }
+      uv = _mm_sub_epi16 (_mm_unpacklo_epi8 (uv, zero), uv_offset);
+
+      /* 298 * (Y - 16) + 128 for pixels 0-3 and 4-7 */
+      c_lo = _mm_add_epi32 (_mm_madd_epi16 (_mm_unpacklo_epi16 (y, zero), y_coeff), round);
+      c_hi = _mm_add_epi32 (_mm_madd_epi16 (_mm_unpackhi_epi16 (y, zero), y_coeff), round);
+
+      r = _mm_madd_epi16 (uv, r_coeff);
+      g = _mm_madd_epi16 (uv, g_coeff);
+      b = _mm_madd_epi16 (uv, b_coeff);
+
+      r_lo = _mm_srai_epi32 (_mm_add_epi32 (c_lo, _mm_unpacklo_epi32 (r, r)), 8);
+      r_hi = _mm_srai_epi32 (_mm_add_epi32 (c_hi, _mm_unpackhi_epi32 (r, r)), 8);
+      g_lo = _mm_srai_epi32 (_mm_add_epi32 (c_lo, _mm_unpacklo_epi32 (g, g)), 8);
+      g_hi = _mm_srai_epi32 (_mm_add_epi32 (c_hi, _mm_unpackhi_epi32 (g, g)), 8);
+      b_lo = _mm_srai_epi32 (_mm_add_epi32 (c_lo, _mm_unpacklo_epi32 (b, b)), 8);
+      b_hi = _mm_srai_epi32 (_mm_add_epi32 (c_hi, _mm_unpackhi_epi32 (b, b)), 8);
+
+      r = _mm_packus_epi16 (_mm_packs_epi32 (r_lo, r_hi), zero);
+      g = _mm_packus_epi16 (_mm_packs_epi32 (g_lo, g_hi), zero);
+      b = _mm_packus_epi16 (_mm_packs_epi32 (b_lo, b_hi), zero);
+
+      if (argb)
+        {
+          __m128i ar = _mm_unpacklo_epi8 (alpha, r);
+          __m128i gb = _mm_unpacklo_epi8 (g, b);
+
+          p_lo = _mm_unpacklo_epi16 (ar, gb);
+          p_hi = _mm_unpackhi_epi16 (ar, gb);
+        }
+      else
+        {
+          __m128i bg = _mm_unpacklo_epi8 (b, g);
+          __m128i ra = _mm_unpacklo_epi8 (r, alpha);
+
+          p_lo = _mm_unpacklo_epi16 (bg, ra);
+          p_hi = _mm_unpackhi_epi16 (bg, ra);
+        }
+
+      _mm_storeu_si128 ((__m128i *) d, p_lo);
+      _mm_storeu_si128 ((__m128i *) (d + 16), p_hi);
+    }
+
+  if (i < end)
+    yuv_row (dest + 4 * (i - x), y_row, u_row, v_row, uv_step, i, end - i, argb);
+}
+
+#endif /* HAVE_X86_INTRINSICS */
+
+typedef struct {
+  LoadFunc load_u16_rgba;
+  LoadFunc load_half_rgba;
+  void (* premultiply_row) (float *row, gsize width);
+  void (* store_row) (guchar *dest, const float *src, gsize width, gboolean argb);
+  YuvRowFunc yuv_row;
+} RowFuncs;
+
+static const RowFuncs *
+get_row_funcs (void)
+{
+  static RowFuncs funcs;
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized))
+    {
+      funcs.load_u16_rgba = load_u16_rgba;
+      funcs.load_half_rgba = load_half_rgba;
+      funcs.premultiply_row = premultiply_row;
+      funcs.store_row = store_row;
+      funcs.yuv_row = yuv_row;
+
+#ifdef HAVE_X86_INTRINSICS
+      if (__builtin_cpu_supports ("sse2"))
+        {
+          funcs.load_u16_rgba = load_u16_rgba_sse2;
+          funcs.premultiply_row = premultiply_row_sse2;
+          funcs.store_row = store_row_sse2;
+          funcs.yuv_row = yuv_row_sse2;
+        }
+      if (__builtin_cpu_supports ("f16c"))
+        funcs.load_half_rgba = load_half_rgba_f16c;
+#endif
+
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return &funcs;
+}
+
+static void
+convert_float (guchar          *dest_data,
+               gsize            dest_stride,
+               GdkMemoryFormat  dest_format,
+               const guchar    *src_data,
+               gsize            src_stride,
+               GdkMemoryFormat  src_format,
+               gsize            width,
+               gsize            height)
+{
+  const RowFuncs *funcs = get_row_funcs ();
+  gboolean premultiply = FALSE;
+  LoadFunc load;
+  float *row;
+  gsize y;
+
+  switch ((int) src_format)
+    {
+    case GDK_MEMORY_R16G16B16:
+      load = load_u16_rgb;
+      break;
+    case GDK_MEMORY_R16G16B16A16_PREMULTIPLIED:
+      load = funcs->load_u16_rgba;
+      break;
+    case GDK_MEMORY_R16G16B16A16:
+      load = funcs->load_u16_rgba;
+      premultiply = TRUE;
+      break;
+    case GDK_MEMORY_R16G16B16_FLOAT:
+      load = load_half_rgb;
+      break;
+    case GDK_MEMORY_R16G16B16A16_FLOAT_PREMULTIPLIED:
+      load = funcs->load_half_rgba;
+      break;
+    case GDK_MEMORY_R16G16B16A16_FLOAT:
+      load = funcs->load_half_rgba;
+      premultiply = TRUE;
+      break;
+    case GDK_MEMORY_R32G32B32_FLOAT:
+      load = load_float_rgb;
+      break;
+    case GDK_MEMORY_R32G32B32A32_FLOAT_PREMULTIPLIED:
+      load = load_float_rgba;
+      break;
+    case GDK_MEMORY_R32G32B32A32_FLOAT:
+      load = load_float_rgba;
+      premultiply = TRUE;
+      break;
+    default:
+      g_assert_not_reached ();
+      return;
+    }
+
+  row = g_new (float, 4 * width);
+
+  for (y = 0; y < height; y++)
+    {
+      load (row, src_data, width);
+      if (premultiply)
+        funcs->premultiply_row (row, width);
+      funcs->store_row (dest_data, row, width, dest_format == GDK_MEMORY_A8R8G8B8_PREMULTIPLIED);
+
+      dest_data += dest_stride;
+      src_data += src_stride;
+    }
+
+  g_free (row);
+}
+
+/* Converts the area at @x, @y of a YUV image of @src_height rows */
+static void
+convert_yuv (guchar          *dest_data,
+             gsize            dest_stride,
+             GdkMemoryFormat  dest_format,
+             const guchar    *src_data,
+             gsize            src_stride,
+             GdkMemoryFormat  src_format,
+             gsize            src_height,
+             gsize            x,
+             gsize            y,
+             gsize            width,
+             gsize            height)
+{
+  const RowFuncs *funcs = get_row_funcs ();
+  const guchar *u_plane, *v_plane;
+  gsize uv_stride, uv_step, row;
+
+  if (src_format == GDK_MEMORY_NV12)
+    {
+      uv_stride = src_stride;
+      uv_step = 2;
+      u_plane = src_data + src_stride * src_height;
+      v_plane = u_plane + 1;
+    }
+  else
+    {
+      g_assert (src_format == GDK_MEMORY_I420);
+
+      uv_stride = (src_stride + 1) / 2;
+      uv_step = 1;
+      u_plane = src_data + src_stride * src_height;
+      v_plane = u_plane + uv_stride * ((src_height + 1) / 2);
+    }
+
+  for (row = y; row < y + height; row++)
+    {
+      funcs->yuv_row (dest_data,
+                      src_data + row * src_stride,
+                      u_plane + row / 2 * uv_stride,
+                      v_plane + row / 2 * uv_stride,
+                      uv_step,
+                      x, width,
+                      dest_format == GDK_MEMORY_A8R8G8B8_PREMULTIPLIED);
+
+      dest_data += dest_stride;
+    }
+}
+
+/* For YUV formats, @src_data must point to the start of the image and
+ * @width and @height must be its size */
 void
 gdk_memory_convert (guchar          *dest_data,
                     gsize            dest_stride,
@@ -300,5 +881,10 @@ gdk_memory_convert (guchar          *dest_data,
   g_assert (dest_format < 2);
   g_assert (src_format < GDK_MEMORY_N_FORMATS);
 
-  converters[src_format][dest_format] (dest_data, dest_stride, src_data, src_stride, width, height);
+  if (src_format < G_N_ELEMENTS (converters))
+    converters[src_format][dest_format] (dest_data, dest_stride, src_data, src_stride, width, height);
+  else if (gdk_memory_format_is_yuv (src_format))
+    convert_yuv (dest_data, dest_stride, dest_format, src_data, src_stride, src_format, height, 0, 0, width, height);
+  else
+    convert_float (dest_data, dest_stride, dest_format, src_data, src_stride, src_format, width, height);
 }
@@ -40,6 +40,22 @@ G_BEGIN_DECLS
  * @GDK_MEMORY_A8B8G8R8: 4 bytes; for alpha, blue, green, red.
  * @GDK_MEMORY_R8G8B8: 3 bytes; for red, green, blue. The data is opaque.
  * @GDK_MEMORY_B8G8R8: 3 bytes; for blue, green, red. The data is opaque.
+ * @GDK_MEMORY_R16G16B16: 3 guint16s; for red, green, blue. The data is opaque.
+ * @GDK_MEMORY_R16G16B16A16_PREMULTIPLIED: 4 guint16s; for red, green, blue, alpha.
+ *     The color values are premultiplied with the alpha value.
+ * @GDK_MEMORY_R16G16B16A16: 4 guint16s; for red, green, blue, alpha.
+ * @GDK_MEMORY_R16G16B16_FLOAT: 3 half floats; for red, green, blue. The data is opaque.
+ * @GDK_MEMORY_R16G16B16A16_FLOAT_PREMULTIPLIED: 4 half floats; for red, green, blue, alpha.
+ *     The color values are premultiplied with the alpha value.
+ * @GDK_MEMORY_R16G16B16A16_FLOAT: 4 half floats; for red, green, blue, alpha.
+ * @GDK_MEMORY_R32G32B32_FLOAT: 3 floats; for red, green, blue. The data is opaque.
+ * @GDK_MEMORY_R32G32B32A32_FLOAT_PREMULTIPLIED: 4 floats; for red, green, blue, alpha.
+ *     The color values are premultiplied with the alpha value.
+ * @GDK_MEMORY_R32G32B32A32_FLOAT: 4 floats; for red, green, blue, alpha.
+ * @GDK_MEMORY_NV12: 8 bit YUV 4:2:0 with a plane of Y samples followed by
+ *     a plane of interleaved U and V samples. The data is opaque.
+ * @GDK_MEMORY_I420: 8 bit YUV 4:2:0 with a plane of Y samples followed by
+ *     a plane of U samples and a plane of V samples. The data is opaque.
  * @GDK_MEMORY_N_FORMATS: The number of formats. This value will change as
  *     more formats get added, so do not rely on its concrete integer.
  *
@@ -51,6 +67,17 @@ G_BEGIN_DECLS
  * CAIRO_FORMAT_ARGB32 is represented by different #GdkMemoryFormats on
  * architectures with different endiannesses.
  * 
+ * Formats with more than 8 bits per channel store each channel in
+ * native endianness, 16 bit floats are IEEE 754 half precision floats.
+ * Values of float formats outside of the 0 to 1 range are clamped.
+ *
+ * The YUV formats use BT.601 limited range, like most video decoders
+ * produce. For them, the stride is the stride of the Y plane and each
+ * plane directly follows the previous one. The chroma planes have half
+ * the height, rounded up, and the U and V planes of %GDK_MEMORY_I420
+ * also have half the stride, rounded up. YUV formats can only be used
+ * as input.
+ *
  * Its naming is modelled after VkFormat (see
  * https://www.khronos.org/registry/vulkan/specs/1.0/html/vkspec.html#VkFormat
  * for details).
@@ -64,6 +91,17 @@ typedef enum {
   GDK_MEMORY_A8B8G8R8,
   GDK_MEMORY_R8G8B8,
   GDK_MEMORY_B8G8R8,
+  GDK_MEMORY_R16G16B16,
+  GDK_MEMORY_R16G16B16A16_PREMULTIPLIED,
+  GDK_MEMORY_R16G16B16A16,
+  GDK_MEMORY_R16G16B16_FLOAT,
+  GDK_MEMORY_R16G16B16A16_FLOAT_PREMULTIPLIED,
+  GDK_MEMORY_R16G16B16A16_FLOAT,
+  GDK_MEMORY_R32G32B32_FLOAT,
+  GDK_MEMORY_R32G32B32A32_FLOAT_PREMULTIPLIED,
+  GDK_MEMORY_R32G32B32A32_FLOAT,
+  GDK_MEMORY_NV12,
+  GDK_MEMORY_I420,
 
   GDK_MEMORY_N_FORMATS
 } GdkMemoryFormat;
@@ -416,6 +416,170 @@ gdk_texture_new_from_file (GFile   *file,
   return texture;
 }
 
+typedef struct
+{
+  GFile *file;
+  int width;
+  int height;
+} TextureLoadData;
+
+static void
+texture_load_data_free (gpointer data)
+{
+  TextureLoadData *load = data;
+
+  g_object_unref (load->file);
+  g_slice_free (TextureLoadData, load);
+}
+
+/* Scale down to fit the requested size, keeping the aspect ratio.
+ * Loaders that support it decode directly at that size. */
+static void
+texture_load_size_prepared (GdkPixbufLoader *loader,
+                            int              width,
+                            int              height,
+                            gpointer         user_data)
+{
+  TextureLoadData *load = user_data;
+  double scale = 1.0;
+
+  if (load->width > 0)
+    scale = MIN (scale, (double) load->width / width);
+  if (load->height > 0)
+    scale = MIN (scale, (double) load->height / height);
+
+  if (scale < 1.0)
+    gdk_pixbuf_loader_set_size (loader,
+                                MAX (1, (int) (width * scale + 0.5)),
+                                MAX (1, (int) (height * scale + 0.5)));
+}
+
+static void
+texture_load_thread (GTask        *task,
+                     gpointer      source_object,
+                     gpointer      task_data,
+                     GCancellable *cancellable)
+{
+  TextureLoadData *load = task_data;
+  GdkPixbufLoader *loader;
+  GInputStream *stream;
+  GdkPixbuf *pixbuf;
+  GError *error = NULL;
+  guchar buffer[64 * 1024];
+  gssize n_read;
+
+  stream = G_INPUT_STREAM (g_file_read (load->file, cancellable, &error));
+  if (stream == NULL)
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  loader = gdk_pixbuf_loader_new ();
+  g_signal_connect (loader, "size-prepared", G_CALLBACK (texture_load_size_prepared), load);
+
+  while ((n_read = g_input_stream_read (stream, buffer, sizeof (buffer), cancellable, &error)) > 0)
+    {
+      if (!gdk_pixbuf_loader_write (loader, buffer, n_read, &error))
+        break;
+    }
+
+  if (error == NULL)
+    gdk_pixbuf_loader_close (loader, &error);
+  else
+    gdk_pixbuf_loader_close (loader, NULL);
+
+  g_object_unref (stream);
+
+  if (error == NULL)
+    {
+      pixbuf = gdk_pixbuf_loader_get_pixbuf (loader);
+      if (pixbuf)
+        g_task_return_pointer (task, gdk_texture_new_for_pixbuf (pixbuf), g_object_unref);
+      else
+        g_task_return_new_error (task, GDK_PIXBUF_ERROR, GDK_PIXBUF_ERROR_FAILED,
+                                 "Image file did not contain any image");
+    }
+  else
+    g_task_return_error (task, error);
+
+  g_object_unref (loader);
+}
+
+/**
+ * gdk_texture_new_from_file_async:
+ * @file: #GFile to load
+ * @width: the width to fit the image into, or -1
+ * @height: the height to fit the image into, or -1
+ * @cancellable: (allow-none): optional #GCancellable object, %NULL to ignore
+ * @callback: (scope async): a #GAsyncReadyCallback to call when the
+ *     texture is loaded
+ * @user_data: (closure): the data to pass to callback function
+ *
+ * Asynchronously creates a new texture by loading an image from a file,
+ * like gdk_texture_new_from_file() does. The image is decoded in a
+ * worker thread.
+ *
+ * If @width or @height are positive, the image is scaled down to fit
+ * into them, preserving its aspect ratio. Image formats that support it
+ * are decoded directly at that size, which is a lot faster than
+ * decoding the full image, so use this for thumbnails. Images are
+ * never scaled up.
+ *
+ * Resources can be loaded with a `resource://` #GFile.
+ *
+ * When the operation is finished, @callback will be called in the
+ * thread-default main context of the calling thread. You can then call
+ * gdk_texture_new_from_file_finish() to get the result.
+ */
+void
+gdk_texture_new_from_file_async (GFile               *file,
+                                 int                  width,
+                                 int                  height,
+                                 GCancellable        *cancellable,
+                                 GAsyncReadyCallback  callback,
+                                 gpointer             user_data)
+{
+  TextureLoadData *load;
+  GTask *task;
+
+  g_return_if_fail (G_IS_FILE (file));
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  load = g_slice_new (TextureLoadData);
+  load->file = g_object_ref (file);
+  load->width = width;
+  load->height = height;
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gdk_texture_new_from_file_async);
+  g_task_set_task_data (task, load, texture_load_data_free);
+  g_task_set_return_on_cancel (task, TRUE);
+  g_task_run_in_thread (task, texture_load_thread);
+  g_object_unref (task);
+}
+
+/**
+ * gdk_texture_new_from_file_finish:
+ * @result: a #GAsyncResult
+ * @error: Return location for an error
+ *
+ * Finishes an asynchronous texture load started with
+ * gdk_texture_new_from_file_async().
+ *
+ * Returns: (transfer full) (nullable): a newly-created #GdkTexture or
+ *     %NULL if an error occured
+ */
+GdkTexture *
+gdk_texture_new_from_file_finish (GAsyncResult  *result,
+                                  GError       **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+  g_return_val_if_fail (g_task_get_source_tag (G_TASK (result)) == gdk_texture_new_from_file_async, NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
 /**
  * gdk_texture_get_width:
  * @texture: a #GdkTexture
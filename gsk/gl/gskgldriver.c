@@ -5,14 +5,30 @@
 #include "gskdebugprivate.h"
 #include "gskprofilerprivate.h"
 #include "gdk/gdktextureprivate.h"
+#include "gdk/gdkglcontextprivate.h"
 #include "gdk/gdkgltextureprivate.h"
+#include "gdk/gdkmemorytextureprivate.h"
 
 #include <gdk/gdk.h>
 #include <epoxy/gl.h>
+#include <string.h>
+
+/* Blurred shadow textures are dropped after not being used for this
+ * many frames, or earlier if the cache grows beyond its budget */
+#define SHADOW_CACHE_MAX_AGE 60
+#define SHADOW_CACHE_BUDGET  (16 * 1024 * 1024)
+
+/* Offscreen render targets are kept around for reuse in later frames
+ * until they have not been used for this many frames, or until the idle
+ * ones take up more than the budget */
+#define RENDER_TARGET_MAX_AGE 60
+#define RENDER_TARGET_BUDGET  (32 * 1024 * 1024)
 
  typedef struct {
   GLuint fbo_id;
   GLuint depth_stencil_id;
+  guint has_depth_buffer : 1;
+  guint has_stencil_buffer : 1;
 } Fbo;
 
 typedef struct {
@@ -23,14 +39,27 @@ typedef struct {
   GLuint mag_filter;
   Fbo fbo;
   GdkTexture *user;
+  guint64 last_used_frame;
   guint in_use : 1;
   guint permanent : 1;
+  /* Storage has been allocated with glTexImage2D() */
+  guint initialized : 1;
+  /* The internal format of that storage */
+  GLenum internal_format;
 
   /* TODO: Make this optional and not for every texture... */
   TextureSlice *slices;
   guint n_slices;
 } Texture;
 
+typedef struct {
+  ShadowKey key;
+  int texture_id;
+  gsize size;
+  guint64 last_used_frame;
+  GList link;
+} ShadowCacheEntry;
+
 struct _GskGLDriver
 {
   GObject parent_instance;
@@ -41,12 +70,28 @@ struct _GskGLDriver
     GQuark created_textures;
     GQuark reused_textures;
     GQuark surface_uploads;
+    GQuark memory_uploads;
+    GQuark shared_textures;
+    GQuark texture_readbacks;
+    GQuark render_targets;
+    GQuark reused_render_targets;
   } counters;
 
   Fbo default_fbo;
 
   GHashTable *textures;
 
+  /* Pixel unpack buffer for memory textures that need converting */
+  GLuint upload_buffer;
+
+  /* ShadowKey -> ShadowCacheEntry */
+  GHashTable *shadow_cache;
+  /* Most recently used entries first */
+  GQueue shadow_lru;
+  gsize shadow_cache_size;
+
+  guint64 frame_counter;
+
   const Texture *bound_source_texture;
   const Fbo *bound_fbo;
 
@@ -99,6 +144,34 @@ texture_free (gpointer data)
   g_slice_free (Texture, t);
 }
 
+G_STATIC_ASSERT (sizeof (ShadowKey) % sizeof (guint32) == 0);
+
+static guint
+shadow_key_hash (gconstpointer data)
+{
+  const guint32 *words = data;
+  guint hash = 0;
+  gsize i;
+
+  for (i = 0; i < sizeof (ShadowKey) / sizeof (guint32); i++)
+    hash = (hash << 5) - hash + words[i];
+
+  return hash;
+}
+
+static gboolean
+shadow_key_equal (gconstpointer a,
+                  gconstpointer b)
+{
+  return memcmp (a, b, sizeof (ShadowKey)) == 0;
+}
+
+static void
+shadow_cache_entry_free (gpointer data)
+{
+  g_slice_free (ShadowCacheEntry, data);
+}
+
 static void
 gsk_gl_driver_set_texture_parameters (GskGLDriver *self,
                                       int          min_filter,
@@ -119,8 +192,12 @@ gsk_gl_driver_finalize (GObject *gobject)
   gdk_gl_context_make_current (self->gl_context);
 
   g_clear_pointer (&self->textures, g_hash_table_unref);
+  g_clear_pointer (&self->shadow_cache, g_hash_table_unref);
   g_clear_object (&self->profiler);
 
+  if (self->upload_buffer != 0)
+    glDeleteBuffers (1, &self->upload_buffer);
+
   if (self->gl_context == gdk_gl_context_get_current ())
     gdk_gl_context_clear_current ();
 
@@ -139,34 +216,59 @@ static void
 gsk_gl_driver_init (GskGLDriver *self)
 {
   self->textures = g_hash_table_new_full (NULL, NULL, NULL, texture_free);
+  self->shadow_cache = g_hash_table_new_full (shadow_key_hash, shadow_key_equal,
+                                              NULL, shadow_cache_entry_free);
 
   self->max_texture_size = -1;
+}
+
+GskGLDriver *
+gsk_gl_driver_new (GdkGLContext *context,
+                   GskProfiler  *profiler)
+{
+  GskGLDriver *self;
+  g_return_val_if_fail (GDK_IS_GL_CONTEXT (context), NULL);
+  g_return_val_if_fail (GSK_IS_PROFILER (profiler), NULL);
+
+  self = (GskGLDriver *) g_object_new (GSK_TYPE_GL_DRIVER, NULL);
+  self->gl_context = context;
+  /* Share the renderer's profiler, so the counters show up with its own */
+  self->profiler = g_object_ref (profiler);
 
 #ifdef G_ENABLE_DEBUG
-  self->profiler = gsk_profiler_new ();
   self->counters.created_textures = gsk_profiler_add_counter (self->profiler,
                                                               "created_textures",
-                                                              "Textures created this frame",
+                                                              "Textures created",
                                                               TRUE);
   self->counters.reused_textures = gsk_profiler_add_counter (self->profiler,
                                                              "reused_textures",
-                                                             "Textures reused this frame",
+                                                             "Textures reused",
                                                              TRUE);
   self->counters.surface_uploads = gsk_profiler_add_counter (self->profiler,
                                                              "surface_uploads",
-                                                             "Texture uploads from surfaces this frame",
+                                                             "Texture uploads from surfaces",
+                                                             TRUE);
+  self->counters.memory_uploads = gsk_profiler_add_counter (self->profiler,
+                                                            "memory_uploads",
+                                                            "Texture uploads from memory textures",
+                                                            TRUE);
+  self->counters.shared_textures = gsk_profiler_add_counter (self->profiler,
+                                                             "shared_textures",
+                                                             "GL textures used from other contexts",
                                                              TRUE);
+  self->counters.texture_readbacks = gsk_profiler_add_counter (self->profiler,
+                                                               "texture_readbacks",
+                                                               "GL textures read back from other contexts",
+                                                               TRUE);
+  self->counters.render_targets = gsk_profiler_add_counter (self->profiler,
+                                                            "render_targets",
+                                                            "Render targets created",
+                                                            TRUE);
+  self->counters.reused_render_targets = gsk_profiler_add_counter (self->profiler,
+                                                                   "reused_render_targets",
+                                                                   "Render targets reused from earlier frames",
+                                                                   TRUE);
 #endif
-}
-
-GskGLDriver *
-gsk_gl_driver_new (GdkGLContext *context)
-{
-  GskGLDriver *self;
-  g_return_val_if_fail (GDK_IS_GL_CONTEXT (context), NULL);
-
-  self = (GskGLDriver *) g_object_new (GSK_TYPE_GL_DRIVER, NULL);
-  self->gl_context = context;
 
   return self;
 }
@@ -178,6 +280,7 @@ gsk_gl_driver_begin_frame (GskGLDriver *self)
   g_return_if_fail (!self->in_frame);
 
   self->in_frame = TRUE;
+  self->frame_counter++;
 
   if (self->max_texture_size < 0)
     {
@@ -198,10 +301,49 @@ gsk_gl_driver_begin_frame (GskGLDriver *self)
   glUseProgram (0);
 
   glActiveTexture (GL_TEXTURE0);
+}
 
-#ifdef G_ENABLE_DEBUG
-  gsk_profiler_reset (self->profiler);
-#endif
+static void
+gsk_gl_driver_trim_shadow_cache (GskGLDriver *self)
+{
+  GList *l, *prev;
+
+  for (l = self->shadow_lru.tail; l != NULL; l = prev)
+    {
+      ShadowCacheEntry *entry = l->data;
+
+      prev = l->prev;
+
+      /* Still referenced by the ops of this frame */
+      if (entry->last_used_frame == self->frame_counter)
+        break;
+
+      if (self->shadow_cache_size <= SHADOW_CACHE_BUDGET &&
+          self->frame_counter - entry->last_used_frame < SHADOW_CACHE_MAX_AGE)
+        break;
+
+      g_queue_unlink (&self->shadow_lru, &entry->link);
+      self->shadow_cache_size -= entry->size;
+      gsk_gl_driver_destroy_texture (self, entry->texture_id);
+      g_hash_table_remove (self->shadow_cache, &entry->key);
+    }
+
+  /* Shadows rendered this frame don't need their framebuffer anymore */
+  for (l = self->shadow_lru.head; l != NULL; l = l->next)
+    {
+      ShadowCacheEntry *entry = l->data;
+      Texture *t;
+
+      if (entry->last_used_frame != self->frame_counter)
+        break;
+
+      t = g_hash_table_lookup (self->textures, GINT_TO_POINTER (entry->texture_id));
+      if (t->fbo.fbo_id != 0)
+        {
+          fbo_clear (&t->fbo);
+          memset (&t->fbo, 0, sizeof (Fbo));
+        }
+    }
 }
 
 void
@@ -210,6 +352,8 @@ gsk_gl_driver_end_frame (GskGLDriver *self)
   g_return_if_fail (GSK_IS_GL_DRIVER (self));
   g_return_if_fail (self->in_frame);
 
+  gsk_gl_driver_trim_shadow_cache (self);
+
   self->bound_source_texture = NULL;
   self->bound_fbo = NULL;
 
@@ -226,23 +370,46 @@ gsk_gl_driver_end_frame (GskGLDriver *self)
 #endif
 
   GSK_NOTE (OPENGL,
-            g_message ("*** Frame end: textures=%d",
-                     g_hash_table_size (self->textures)));
+            g_message ("*** Frame end: textures=%d, cached shadows=%d (%" G_GSIZE_FORMAT " bytes)",
+                     g_hash_table_size (self->textures),
+                     g_hash_table_size (self->shadow_cache),
+                     self->shadow_cache_size));
 
   self->in_frame = FALSE;
 }
 
+static int
+compare_last_used_frame (gconstpointer a,
+                         gconstpointer b)
+{
+  const Texture *ta = *(const Texture **) a;
+  const Texture *tb = *(const Texture **) b;
+
+  /* Most recently used first */
+  if (ta->last_used_frame > tb->last_used_frame)
+    return -1;
+  if (ta->last_used_frame < tb->last_used_frame)
+    return 1;
+
+  return 0;
+}
+
 int
 gsk_gl_driver_collect_textures (GskGLDriver *self)
 {
   GHashTableIter iter;
   gpointer value_p = NULL;
+  GPtrArray *render_targets;
+  gsize pool_size = 0;
+  guint pooled = 0;
   int old_size;
+  guint i;
 
   g_return_val_if_fail (GSK_IS_GL_DRIVER (self), 0);
   g_return_val_if_fail (!self->in_frame, 0);
 
   old_size = g_hash_table_size (self->textures);
+  render_targets = g_ptr_array_new ();
 
   g_hash_table_iter_init (&iter, self->textures);
   while (g_hash_table_iter_next (&iter, NULL, &value_p))
@@ -252,20 +419,41 @@ gsk_gl_driver_collect_textures (GskGLDriver *self)
       if (t->user || t->permanent)
         continue;
 
-      if (t->in_use)
+      /* Render targets keep their framebuffer, so they can be
+       * reused as they are in the next frames */
+      if (t->fbo.fbo_id != 0)
         {
           t->in_use = FALSE;
-
-          if (t->fbo.fbo_id != 0)
-            {
-              fbo_clear (&t->fbo);
-              t->fbo.fbo_id = 0;
-            }
+          g_ptr_array_add (render_targets, t);
         }
+      else if (t->in_use)
+        t->in_use = FALSE;
       else
         g_hash_table_iter_remove (&iter);
     }
 
+  g_ptr_array_sort (render_targets, compare_last_used_frame);
+  for (i = 0; i < render_targets->len; i++)
+    {
+      Texture *t = g_ptr_array_index (render_targets, i);
+      gsize size = t->width * t->height * 4;
+
+      if (self->frame_counter - t->last_used_frame >= RENDER_TARGET_MAX_AGE ||
+          (pool_size + size > RENDER_TARGET_BUDGET && t->last_used_frame != self->frame_counter))
+        {
+          g_hash_table_remove (self->textures, GINT_TO_POINTER (t->texture_id));
+          continue;
+        }
+
+      pool_size += size;
+      pooled++;
+    }
+
+  GSK_NOTE (OPENGL, g_message ("Render target pool: %u targets, %" G_GSIZE_FORMAT " bytes",
+                               pooled, pool_size));
+
+  g_ptr_array_unref (render_targets);
+
   return old_size - g_hash_table_size (self->textures);
 }
 
@@ -307,6 +495,8 @@ gsk_gl_driver_get_fbo (GskGLDriver *self,
   return &t->fbo;
 }
 
+/* Returns an unused texture of the given size, preferring
+ * render targets that still have their framebuffer */
 static Texture *
 find_texture_by_size (GHashTable *textures,
                       int         width,
@@ -314,17 +504,24 @@ find_texture_by_size (GHashTable *textures,
 {
   GHashTableIter iter;
   gpointer value_p = NULL;
+  Texture *found = NULL;
 
   g_hash_table_iter_init (&iter, textures);
   while (g_hash_table_iter_next (&iter, NULL, &value_p))
     {
       Texture *t = value_p;
 
-      if (t->width == width && t->height == height)
+      if (t->width != width || t->height != height ||
+          t->in_use || t->user != NULL || t->permanent)
+        continue;
+
+      if (t->fbo.fbo_id != 0)
         return t;
+
+      found = t;
     }
 
-  return NULL;
+  return found;
 }
 
 static Texture *
@@ -352,11 +549,15 @@ create_texture (GskGLDriver *self,
     }
 
   t = find_texture_by_size (self->textures, width, height);
-  if (t != NULL && !t->in_use && t->user == NULL)
+  if (t != NULL)
     {
       GSK_NOTE (OPENGL, g_message ("Reusing Texture(%d) for size %dx%d",
                                  t->texture_id, t->width, t->height));
       t->in_use = TRUE;
+      t->last_used_frame = self->frame_counter;
+      /* Like a new texture, the previous user may have had mipmaps */
+      t->min_filter = GL_NEAREST;
+      t->mag_filter = GL_NEAREST;
 
 #ifdef G_ENABLE_DEBUG
       gsk_profiler_counter_inc (self->profiler, self->counters.reused_textures);
@@ -373,6 +574,7 @@ create_texture (GskGLDriver *self,
   t->min_filter = GL_NEAREST;
   t->mag_filter = GL_NEAREST;
   t->in_use = TRUE;
+  t->last_used_frame = self->frame_counter;
   g_hash_table_insert (self->textures, GINT_TO_POINTER (texture_id), t);
 #ifdef G_ENABLE_DEBUG
   gsk_profiler_counter_inc (self->profiler, self->counters.created_textures);
@@ -498,24 +700,44 @@ gsk_gl_driver_get_texture_for_texture (GskGLDriver *self,
                                        int          mag_filter)
 {
   Texture *t;
-  cairo_surface_t *surface;
+  cairo_surface_t *surface = NULL;
 
   if (GDK_IS_GL_TEXTURE (texture))
     {
-      GdkGLContext *texture_context = gdk_gl_texture_get_context ((GdkGLTexture *)texture);
+      GdkGLTexture *gl_texture = (GdkGLTexture *) texture;
+      GdkGLContext *texture_context = gdk_gl_texture_get_context (gl_texture);
 
-      if (texture_context != self->gl_context)
+      if (texture_context == self->gl_context)
+        {
+          /* A GL texture from the same GL context is a simple task... */
+          return gdk_gl_texture_get_id (gl_texture);
+        }
+      else if (texture_context != NULL &&
+               gdk_gl_context_is_shared (texture_context, self->gl_context))
+        {
+          /* ...and so is one from a context we share textures with,
+           * as long as we wait for it to be drawn */
+          gdk_gl_texture_wait_sync (gl_texture);
+#ifdef G_ENABLE_DEBUG
+          gsk_profiler_counter_inc (self->profiler, self->counters.shared_textures);
+#endif
+          return gdk_gl_texture_get_id (gl_texture);
+        }
+      else if (texture_context != NULL)
         {
           /* In this case, we have to temporarily make the texture's context the current one,
            * download its data into our context and then create a texture from it. */
           gdk_gl_context_make_current (texture_context);
           surface = gdk_texture_download_surface (texture);
           gdk_gl_context_make_current (self->gl_context);
+#ifdef G_ENABLE_DEBUG
+          gsk_profiler_counter_inc (self->profiler, self->counters.texture_readbacks);
+#endif
         }
       else
         {
-          /* A GL texture from the same GL context is a simple task... */
-          return gdk_gl_texture_get_id ((GdkGLTexture *)texture);
+          /* Released, its contents have been saved */
+          surface = gdk_texture_download_surface (texture);
         }
     }
   else
@@ -528,21 +750,47 @@ gsk_gl_driver_get_texture_for_texture (GskGLDriver *self,
             return t->texture_id;
         }
 
-      surface = gdk_texture_download_surface (texture);
+      /* Memory textures are uploaded from their own bytes, without
+       * going through a cairo surface first. GLES lacks the BGRA
+       * formats we would need for that. */
+      if (!GDK_IS_MEMORY_TEXTURE (texture) ||
+          gdk_gl_context_get_use_es (self->gl_context))
+        surface = gdk_texture_download_surface (texture);
     }
 
   t = create_texture (self, gdk_texture_get_width (texture), gdk_texture_get_height (texture));
 
   if (gdk_texture_set_render_data (texture, self, t, gsk_gl_driver_release_texture))
-    t->user = texture;
+    {
+      t->user = texture;
+
+      /* Don't keep the framebuffer of a pooled render target alive */
+      if (t->fbo.fbo_id != 0)
+        {
+          fbo_clear (&t->fbo);
+          memset (&t->fbo, 0, sizeof (Fbo));
+        }
+    }
 
   gsk_gl_driver_bind_source_texture (self, t->texture_id);
-  gsk_gl_driver_init_texture_with_surface (self,
-                                           t->texture_id,
-                                           surface,
-                                           min_filter,
-                                           mag_filter);
-  cairo_surface_destroy (surface);
+
+  if (surface != NULL)
+    {
+      gsk_gl_driver_init_texture_with_surface (self,
+                                               t->texture_id,
+                                               surface,
+                                               min_filter,
+                                               mag_filter);
+      cairo_surface_destroy (surface);
+    }
+  else
+    {
+      gsk_gl_driver_init_texture_with_memory (self,
+                                              t->texture_id,
+                                              GDK_MEMORY_TEXTURE (texture),
+                                              min_filter,
+                                              mag_filter);
+    }
 
   return t->texture_id;
 }
@@ -593,7 +841,23 @@ gsk_gl_driver_create_render_target (GskGLDriver *self,
     return -1;
 
   if (t->fbo.fbo_id != 0)
-    fbo_clear (&t->fbo);
+    {
+      /* A pooled render target from an earlier frame */
+      if (t->fbo.has_depth_buffer == add_depth_buffer &&
+          t->fbo.has_stencil_buffer == add_stencil_buffer)
+        {
+#ifdef G_ENABLE_DEBUG
+          gsk_profiler_counter_inc (self->profiler, self->counters.reused_render_targets);
+#endif
+          return t->fbo.fbo_id;
+        }
+
+      fbo_clear (&t->fbo);
+    }
+
+#ifdef G_ENABLE_DEBUG
+  gsk_profiler_counter_inc (self->profiler, self->counters.render_targets);
+#endif
 
   glGenFramebuffers (1, &fbo_id);
   glBindFramebuffer (GL_FRAMEBUFFER, fbo_id);
@@ -624,6 +888,8 @@ gsk_gl_driver_create_render_target (GskGLDriver *self,
 
   t->fbo.fbo_id = fbo_id;
   t->fbo.depth_stencil_id = depth_stencil_buffer_id;
+  t->fbo.has_depth_buffer = !!add_depth_buffer;
+  t->fbo.has_stencil_buffer = !!add_stencil_buffer;
 
   g_assert_cmphex (glCheckFramebufferStatus (GL_FRAMEBUFFER), ==, GL_FRAMEBUFFER_COMPLETE);
   glBindFramebuffer (GL_FRAMEBUFFER, self->default_fbo.fbo_id);
@@ -726,10 +992,19 @@ gsk_gl_driver_init_texture_empty (GskGLDriver *self,
 
   gsk_gl_driver_set_texture_parameters (self, t->min_filter, t->mag_filter);
 
-  if (gdk_gl_context_get_use_es (self->gl_context))
-    glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA8, t->width, t->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-  else
-    glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA8, t->width, t->height, 0, GL_BGRA, GL_UNSIGNED_BYTE, NULL);
+  /* Reused textures already have storage of the right size, and
+   * render targets get cleared before they are drawn to. Memory
+   * textures may have left storage in a different format though. */
+  if (!t->initialized || t->internal_format != GL_RGBA8)
+    {
+      if (gdk_gl_context_get_use_es (self->gl_context))
+        glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA8, t->width, t->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+      else
+        glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA8, t->width, t->height, 0, GL_BGRA, GL_UNSIGNED_BYTE, NULL);
+
+      t->initialized = TRUE;
+      t->internal_format = GL_RGBA8;
+    }
 
   glBindTexture (GL_TEXTURE_2D, 0);
 }
@@ -761,6 +1036,8 @@ gsk_gl_driver_init_texture_with_surface (GskGLDriver     *self,
   gsk_gl_driver_set_texture_parameters (self, min_filter, mag_filter);
 
   gdk_cairo_surface_upload_to_gl (surface, GL_TEXTURE_2D, t->width, t->height, NULL);
+  t->initialized = TRUE;
+  t->internal_format = GL_RGBA8;
 
 #ifdef G_ENABLE_DEBUG
   gsk_profiler_counter_inc (self->profiler, self->counters.surface_uploads);
@@ -772,3 +1049,261 @@ gsk_gl_driver_init_texture_with_surface (GskGLDriver     *self,
   if (t->min_filter != GL_NEAREST)
     glGenerateMipmap (GL_TEXTURE_2D);
 }
+
+/* Returns the internal format, format and type to upload @format with
+ * if GL can take it as it is, i.e. it is premultiplied or opaque. High
+ * bit depth formats keep their precision in the texture. Only used with
+ * desktop GL, see gsk_gl_driver_get_texture_for_texture(). */
+static gboolean
+gl_format_for_memory_format (GdkMemoryFormat  format,
+                             GLenum          *gl_internal_format,
+                             GLenum          *gl_format,
+                             GLenum          *gl_type,
+                             gsize           *bpp)
+{
+  switch (format)
+    {
+    case GDK_MEMORY_B8G8R8A8_PREMULTIPLIED:
+      *gl_internal_format = GL_RGBA8;
+      *gl_format = GL_BGRA;
+      *gl_type = GL_UNSIGNED_BYTE;
+      *bpp = 4;
+      return TRUE;
+
+    case GDK_MEMORY_A8R8G8B8_PREMULTIPLIED:
+      *gl_internal_format = GL_RGBA8;
+      *gl_format = GL_BGRA;
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+      *gl_type = GL_UNSIGNED_INT_8_8_8_8;
+#else
+      *gl_type = GL_UNSIGNED_INT_8_8_8_8_REV;
+#endif
+      *bpp = 4;
+      return TRUE;
+
+    case GDK_MEMORY_R8G8B8:
+      *gl_internal_format = GL_RGBA8;
+      *gl_format = GL_RGB;
+      *gl_type = GL_UNSIGNED_BYTE;
+      *bpp = 3;
+      return TRUE;
+
+    case GDK_MEMORY_B8G8R8:
+      *gl_internal_format = GL_RGBA8;
+      *gl_format = GL_BGR;
+      *gl_type = GL_UNSIGNED_BYTE;
+      *bpp = 3;
+      return TRUE;
+
+    case GDK_MEMORY_R16G16B16:
+      *gl_internal_format = GL_RGBA16;
+      *gl_format = GL_RGB;
+      *gl_type = GL_UNSIGNED_SHORT;
+      *bpp = 6;
+      return TRUE;
+
+    case GDK_MEMORY_R16G16B16A16_PREMULTIPLIED:
+      *gl_internal_format = GL_RGBA16;
+      *gl_format = GL_RGBA;
+      *gl_type = GL_UNSIGNED_SHORT;
+      *bpp = 8;
+      return TRUE;
+
+    case GDK_MEMORY_R16G16B16_FLOAT:
+      *gl_internal_format = GL_RGBA16F;
+      *gl_format = GL_RGB;
+      *gl_type = GL_HALF_FLOAT;
+      *bpp = 6;
+      return TRUE;
+
+    case GDK_MEMORY_R16G16B16A16_FLOAT_PREMULTIPLIED:
+      *gl_internal_format = GL_RGBA16F;
+      *gl_format = GL_RGBA;
+      *gl_type = GL_HALF_FLOAT;
+      *bpp = 8;
+      return TRUE;
+
+    case GDK_MEMORY_R32G32B32_FLOAT:
+      *gl_internal_format = GL_RGBA32F;
+      *gl_format = GL_RGB;
+      *gl_type = GL_FLOAT;
+      *bpp = 12;
+      return TRUE;
+
+    case GDK_MEMORY_R32G32B32A32_FLOAT_PREMULTIPLIED:
+      *gl_internal_format = GL_RGBA32F;
+      *gl_format = GL_RGBA;
+      *gl_type = GL_FLOAT;
+      *bpp = 16;
+      return TRUE;
+
+    case GDK_MEMORY_B8G8R8A8:
+    case GDK_MEMORY_A8R8G8B8:
+    case GDK_MEMORY_R8G8B8A8:
+    case GDK_MEMORY_A8B8G8R8:
+    case GDK_MEMORY_R16G16B16A16:
+    case GDK_MEMORY_R16G16B16A16_FLOAT:
+    case GDK_MEMORY_R32G32B32A32_FLOAT:
+    case GDK_MEMORY_NV12:
+    case GDK_MEMORY_I420:
+    case GDK_MEMORY_N_FORMATS:
+    default:
+      return FALSE;
+    }
+}
+
+/* Uploads the bytes of @texture without an intermediate cairo surface.
+ * Formats GL can't take are premultiplied straight into a pixel unpack
+ * buffer, whose old storage is orphaned so the driver doesn't have to
+ * wait for the previous upload from it to finish. Needs desktop GL for
+ * the BGRA formats. */
+void
+gsk_gl_driver_init_texture_with_memory (GskGLDriver      *self,
+                                        int               texture_id,
+                                        GdkMemoryTexture *texture,
+                                        int               min_filter,
+                                        int               mag_filter)
+{
+  GdkMemoryFormat format;
+  const guchar *data;
+  gsize stride, bpp;
+  GLenum gl_internal_format, gl_format, gl_type;
+  Texture *t;
+
+  g_return_if_fail (GSK_IS_GL_DRIVER (self));
+  g_return_if_fail (!gdk_gl_context_get_use_es (self->gl_context));
+
+  t = gsk_gl_driver_get_texture (self, texture_id);
+  if (t == NULL)
+    {
+      g_critical ("No texture %d found.", texture_id);
+      return;
+    }
+
+  if (self->bound_source_texture != t)
+    {
+      g_critical ("You must bind the texture before initializing it.");
+      return;
+    }
+
+  format = gdk_memory_texture_get_format (texture);
+  data = gdk_memory_texture_get_data (texture);
+  stride = gdk_memory_texture_get_stride (texture);
+
+  gsk_gl_driver_set_texture_parameters (self, min_filter, mag_filter);
+
+  if (gl_format_for_memory_format (format, &gl_internal_format, &gl_format, &gl_type, &bpp) &&
+      stride % bpp == 0)
+    {
+      glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+      glPixelStorei (GL_UNPACK_ROW_LENGTH, stride / bpp);
+      glTexImage2D (GL_TEXTURE_2D, 0, gl_internal_format, t->width, t->height, 0, gl_format, gl_type, data);
+      glPixelStorei (GL_UNPACK_ROW_LENGTH, 0);
+      glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
+      t->internal_format = gl_internal_format;
+    }
+  else
+    {
+      gsize size = t->width * t->height * 4;
+      guchar *mem;
+
+      if (self->upload_buffer == 0)
+        glGenBuffers (1, &self->upload_buffer);
+
+      glBindBuffer (GL_PIXEL_UNPACK_BUFFER, self->upload_buffer);
+      glBufferData (GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+      mem = glMapBufferRange (GL_PIXEL_UNPACK_BUFFER, 0, size,
+                              GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+      if (mem != NULL)
+        {
+          gdk_memory_convert (mem, t->width * 4, GDK_MEMORY_DEFAULT,
+                              data, stride, format,
+                              t->width, t->height);
+          glUnmapBuffer (GL_PIXEL_UNPACK_BUFFER);
+          glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA8, t->width, t->height, 0,
+                        GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, NULL);
+          glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+      else
+        {
+          glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+
+          mem = g_malloc (size);
+          gdk_memory_convert (mem, t->width * 4, GDK_MEMORY_DEFAULT,
+                              data, stride, format,
+                              t->width, t->height);
+          glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA8, t->width, t->height, 0,
+                        GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, mem);
+          g_free (mem);
+        }
+
+      t->internal_format = GL_RGBA8;
+    }
+
+#ifdef G_ENABLE_DEBUG
+  gsk_profiler_counter_inc (self->profiler, self->counters.memory_uploads);
+#endif
+
+  t->min_filter = min_filter;
+  t->mag_filter = mag_filter;
+  t->initialized = TRUE;
+
+  if (t->min_filter != GL_NEAREST)
+    glGenerateMipmap (GL_TEXTURE_2D);
+}
+
+/* Returns the texture previously passed to gsk_gl_driver_cache_shadow()
+ * for @key, or 0 if there is none. */
+int
+gsk_gl_driver_lookup_shadow (GskGLDriver     *self,
+                             const ShadowKey *key)
+{
+  ShadowCacheEntry *entry;
+
+  g_return_val_if_fail (GSK_IS_GL_DRIVER (self), 0);
+
+  entry = g_hash_table_lookup (self->shadow_cache, key);
+  if (entry == NULL)
+    return 0;
+
+  entry->last_used_frame = self->frame_counter;
+  g_queue_unlink (&self->shadow_lru, &entry->link);
+  g_queue_push_head_link (&self->shadow_lru, &entry->link);
+
+  return entry->texture_id;
+}
+
+/* Keeps @texture_id alive across frames, so later shadows with the
+ * same @key can use it instead of blurring again. */
+void
+gsk_gl_driver_cache_shadow (GskGLDriver     *self,
+                            const ShadowKey *key,
+                            int              texture_id)
+{
+  ShadowCacheEntry *entry;
+  Texture *t;
+
+  g_return_if_fail (GSK_IS_GL_DRIVER (self));
+  g_return_if_fail (g_hash_table_lookup (self->shadow_cache, key) == NULL);
+
+  t = gsk_gl_driver_get_texture (self, texture_id);
+  if (t == NULL)
+    {
+      g_critical ("No texture %d found.", texture_id);
+      return;
+    }
+
+  t->permanent = TRUE;
+
+  entry = g_slice_new0 (ShadowCacheEntry);
+  entry->key = *key;
+  entry->texture_id = texture_id;
+  entry->size = t->width * t->height * 4;
+  entry->last_used_frame = self->frame_counter;
+  entry->link.data = entry;
+
+  g_hash_table_insert (self->shadow_cache, &entry->key, entry);
+  g_queue_push_head_link (&self->shadow_lru, &entry->link);
+  self->shadow_cache_size += entry->size;
+}
@@ -5,6 +5,9 @@
 #include <gdk/gdk.h>
 #include <graphene.h>
 
+#include "gskprofilerprivate.h"
+#include "gskroundedrectprivate.h"
+
 G_BEGIN_DECLS
 
 #define GSK_TYPE_GL_DRIVER (gsk_gl_driver_get_type ())
@@ -21,8 +24,18 @@ typedef struct {
   guint texture_id;
 } TextureSlice;
 
+/* Everything the blurred texture of an outset shadow depends on.
+ * Must be zeroed before filling it, since it is compared bytewise. */
+typedef struct {
+  GdkRGBA color;
+  GskRoundedRect outline;
+  float blur_radius;
+  float scale;
+} ShadowKey;
+
 
-GskGLDriver *   gsk_gl_driver_new                       (GdkGLContext    *context);
+GskGLDriver *   gsk_gl_driver_new                       (GdkGLContext    *context,
+                                                         GskProfiler     *profiler);
 
 int             gsk_gl_driver_get_max_texture_size      (GskGLDriver     *driver);
 
@@ -56,6 +69,11 @@ void            gsk_gl_driver_init_texture_with_surface (GskGLDriver     *driver
                                                          cairo_surface_t *surface,
                                                          int              min_filter,
                                                          int              mag_filter);
+void            gsk_gl_driver_init_texture_with_memory  (GskGLDriver     *driver,
+                                                         int              texture_id,
+                                                         GdkMemoryTexture *texture,
+                                                         int              min_filter,
+                                                         int              mag_filter);
 
 void            gsk_gl_driver_destroy_texture           (GskGLDriver     *driver,
                                                          int              texture_id);
@@ -66,6 +84,12 @@ void            gsk_gl_driver_slice_texture             (GskGLDriver     *self,
                                                          TextureSlice   **out_slices,
                                                          guint           *out_n_slices);
 
+int             gsk_gl_driver_lookup_shadow             (GskGLDriver     *driver,
+                                                         const ShadowKey *key);
+void            gsk_gl_driver_cache_shadow              (GskGLDriver     *driver,
+                                                         const ShadowKey *key,
+                                                         int              texture_id);
+
 G_END_DECLS
 
 #endif /* __GSK_GL_DRIVER_PRIVATE_H__ */
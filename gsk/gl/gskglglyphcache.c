@@ -8,6 +8,7 @@
 #include <graphene.h>
 #include <cairo.h>
 #include <epoxy/gl.h>
+#include <string.h>
 
 /* Parameters for our cache eviction strategy.
  *
@@ -15,7 +16,9 @@
  * Glyphs that have not been used for the MAX_AGE frames are considered old. We keep
  * count of the pixels of each atlas that are taken up by old glyphs. We check the
  * fraction of old pixels every CHECK_INTERVAL frames, and if it is above MAX_OLD, then
- * we drop the atlas an all the glyphs contained in it from the cache.
+ * we compact the atlas: the old glyphs are dropped from the cache and the remaining
+ * ones are packed again, making room for new glyphs. Atlases that end up empty are
+ * dropped, unless they are the last one.
  */
 
 #define MAX_AGE 60
@@ -24,18 +27,30 @@
 
 #define ATLAS_SIZE 512
 
+/* Glyphs are packed with a skyline: for each span of x coordinates we
+ * remember the lowest free y coordinate, and place new glyphs at the
+ * lowest possible position. A border of 1 pixel is kept around every
+ * glyph so filtering doesn't pick up pixels of its neighbours. */
+typedef struct
+{
+  int x, y;
+  int width;
+} SkylineNode;
+
 typedef struct
 {
   PangoFont *font;
   PangoGlyph glyph;
   guint scale; /* times 1024 */
+  guint xshift; /* in 1/GSK_SUBPIXEL_POSITIONS pixels */
 } GlyphCacheKey;
 
 typedef struct
 {
   GlyphCacheKey *key;
   GskGLCachedGlyph *value;
-  cairo_surface_t *surface;
+  int x, y;
+  int width, height;
 } DirtyGlyph;
 
 
@@ -46,6 +61,15 @@ static void     glyph_cache_key_free   (gpointer      v);
 static void     glyph_cache_value_free (gpointer      v);
 static void     dirty_glyph_free       (gpointer      v);
 
+static void
+atlas_reset_skyline (GskGLGlyphAtlas *atlas)
+{
+  SkylineNode node = { 1, 1, atlas->width - 2 };
+
+  g_array_set_size (atlas->skyline, 0);
+  g_array_append_val (atlas->skyline, node);
+}
+
 static GskGLGlyphAtlas *
 create_atlas (GskGLGlyphCache *cache)
 {
@@ -54,12 +78,13 @@ create_atlas (GskGLGlyphCache *cache)
   atlas = g_new0 (GskGLGlyphAtlas, 1);
   atlas->width = ATLAS_SIZE;
   atlas->height = ATLAS_SIZE;
-  atlas->y0 = 1;
-  atlas->y = 1;
-  atlas->x = 1;
+  atlas->skyline = g_array_new (FALSE, FALSE, sizeof (SkylineNode));
+  atlas_reset_skyline (atlas);
   atlas->image = NULL;
   atlas->num_glyphs = 0;
   atlas->dirty_glyphs = NULL;
+  atlas->stride = cairo_format_stride_for_width (CAIRO_FORMAT_ARGB32, atlas->width);
+  atlas->data = g_malloc0 (atlas->stride * atlas->height);
 
   return atlas;
 }
@@ -75,6 +100,8 @@ free_atlas (gpointer v)
       g_free (atlas->image);
     }
   g_list_free_full (atlas->dirty_glyphs, dirty_glyph_free);
+  g_array_unref (atlas->skyline);
+  g_free (atlas->data);
   g_free (atlas);
 }
 
@@ -90,6 +117,17 @@ gsk_gl_glyph_cache_init (GskGLGlyphCache *self,
 
   self->renderer = renderer;
   self->gl_driver = gl_driver;
+
+#ifdef G_ENABLE_DEBUG
+  self->counters.hits = gsk_profiler_add_counter (gsk_renderer_get_profiler (renderer),
+                                                  "glyph-cache-hits",
+                                                  "Glyphs found in the glyph cache this frame",
+                                                  TRUE);
+  self->counters.misses = gsk_profiler_add_counter (gsk_renderer_get_profiler (renderer),
+                                                    "glyph-cache-misses",
+                                                    "Glyphs added to the glyph cache this frame",
+                                                    TRUE);
+#endif
 }
 
 void
@@ -120,7 +158,8 @@ glyph_cache_equal (gconstpointer v1, gconstpointer v2)
 
   return key1->font == key2->font &&
          key1->glyph == key2->glyph &&
-         key1->scale == key2->scale;
+         key1->scale == key2->scale &&
+         key1->xshift == key2->xshift;
 }
 
 static guint
@@ -128,7 +167,7 @@ glyph_cache_hash (gconstpointer v)
 {
   const GlyphCacheKey *key = v;
 
-  return GPOINTER_TO_UINT (key->font) ^ key->glyph ^ key->scale;
+  return GPOINTER_TO_UINT (key->font) ^ key->glyph ^ key->scale ^ (key->xshift << 24);
 }
 
 static void
@@ -149,11 +188,163 @@ glyph_cache_value_free (gpointer v)
 static void
 dirty_glyph_free (gpointer v)
 {
-  DirtyGlyph *glyph = v;
+  g_free (v);
+}
+
+static void
+atlas_add_dirty_rect (GskGLGlyphAtlas *atlas,
+                      int              x,
+                      int              y,
+                      int              width,
+                      int              height)
+{
+  cairo_rectangle_int_t rect = { x, y, width, height };
+
+  if (atlas->dirty_rect.width == 0)
+    atlas->dirty_rect = rect;
+  else
+    gdk_rectangle_union (&atlas->dirty_rect, &rect, &atlas->dirty_rect);
+}
+
+/* Returns the y coordinate a rectangle of the given size would be placed at
+ * when its left edge is aligned with skyline node @index, or -1 if it does
+ * not fit there. */
+static int
+skyline_fit (const GskGLGlyphAtlas *atlas,
+             guint                  index,
+             int                    width,
+             int                    height)
+{
+  const SkylineNode *node = &g_array_index (atlas->skyline, SkylineNode, index);
+  int width_left = width;
+  int y = node->y;
+  guint i;
+
+  if (node->x + width > atlas->width - 1)
+    return -1;
+
+  for (i = index; width_left > 0; i ++)
+    {
+      node = &g_array_index (atlas->skyline, SkylineNode, i);
+
+      y = MAX (y, node->y);
+      if (y + height > atlas->height - 1)
+        return -1;
+
+      width_left -= node->width;
+    }
+
+  return y;
+}
+
+static void
+skyline_insert (GskGLGlyphAtlas *atlas,
+                guint            index,
+                int              x,
+                int              y,
+                int              width,
+                int              height)
+{
+  SkylineNode new_node = { x, y + height, width };
+  guint i;
+
+  g_array_insert_val (atlas->skyline, index, new_node);
+
+  /* Cut the nodes that are now covered by the new one */
+  for (i = index + 1; i < atlas->skyline->len; i ++)
+    {
+      const SkylineNode *prev = &g_array_index (atlas->skyline, SkylineNode, i - 1);
+      SkylineNode *node = &g_array_index (atlas->skyline, SkylineNode, i);
+      int shrink;
+
+      if (node->x >= prev->x + prev->width)
+        break;
+
+      shrink = prev->x + prev->width - node->x;
+      node->x += shrink;
+      node->width -= shrink;
+
+      if (node->width > 0)
+        break;
+
+      g_array_remove_index (atlas->skyline, i);
+      i --;
+    }
+
+  /* Merge neighbours at the same height */
+  for (i = 0; i + 1 < atlas->skyline->len; i ++)
+    {
+      SkylineNode *node = &g_array_index (atlas->skyline, SkylineNode, i);
+      const SkylineNode *next = &g_array_index (atlas->skyline, SkylineNode, i + 1);
+
+      if (node->y == next->y)
+        {
+          node->width += next->width;
+          g_array_remove_index (atlas->skyline, i + 1);
+          i --;
+        }
+    }
+}
+
+static gboolean
+atlas_allocate (GskGLGlyphAtlas *atlas,
+                int              width,
+                int              height,
+                int             *out_x,
+                int             *out_y)
+{
+  int best_y = G_MAXINT;
+  int best_width = G_MAXINT;
+  int best_index = -1;
+  guint i;
+
+  /* Leave room for the border */
+  width += 1;
+  height += 1;
+
+  for (i = 0; i < atlas->skyline->len; i ++)
+    {
+      const SkylineNode *node = &g_array_index (atlas->skyline, SkylineNode, i);
+      int y = skyline_fit (atlas, i, width, height);
+
+      if (y < 0)
+        continue;
+
+      if (y + height < best_y ||
+          (y + height == best_y && node->width < best_width))
+        {
+          best_y = y + height;
+          best_width = node->width;
+          best_index = i;
+          *out_x = node->x;
+          *out_y = y;
+        }
+    }
+
+  if (best_index < 0)
+    return FALSE;
+
+  skyline_insert (atlas, best_index, *out_x, *out_y, width, height);
+
+  return TRUE;
+}
+
+static void
+place_glyph (GskGLGlyphAtlas  *atlas,
+             GskGLCachedGlyph *value,
+             int               x,
+             int               y,
+             int               width,
+             int               height)
+{
+  value->tx = (float)x / atlas->width;
+  value->ty = (float)y / atlas->height;
+  value->tw = (float)width / atlas->width;
+  value->th = (float)height / atlas->height;
 
-  if (glyph->surface)
-    cairo_surface_destroy (glyph->surface);
-  g_free (glyph);
+  value->atlas = atlas;
+
+  atlas->num_glyphs++;
 }
 
 static void
@@ -166,55 +357,42 @@ add_to_cache (GskGLGlyphCache  *cache,
   DirtyGlyph *dirty;
   int width = value->draw_width * key->scale / 1024;
   int height = value->draw_height * key->scale / 1024;
+  int x, y;
 
-  for (i = 0; i < cache->atlases->len; i++)
+  if (width + 3 > ATLAS_SIZE || height + 3 > ATLAS_SIZE)
     {
-      int x, y, y0;
+      GSK_RENDERER_NOTE (cache->renderer, GLYPH_CACHE,
+                g_message ("Glyph of size %dx%d is too large for the cache", width, height));
+      return;
+    }
 
+  for (i = 0; i < cache->atlases->len; i++)
+    {
       atlas = g_ptr_array_index (cache->atlases, i);
-      x = atlas->x;
-      y = atlas->y;
-      y0 = atlas->y0;
-
-      if (atlas->x + width + 1 >= atlas->width)
-        {
-          /* start a new row */
-          y0 = y + 1;
-          x = 1;
-        }
 
-      if (y0 + height + 1 >= atlas->height)
-        continue;
-
-      atlas->y0 = y0;
-      atlas->x = x;
-      atlas->y = y;
-      break;
+      if (atlas_allocate (atlas, width, height, &x, &y))
+        break;
     }
 
   if (i == cache->atlases->len)
     {
       atlas = create_atlas (cache);
       g_ptr_array_add (cache->atlases, atlas);
-    }
 
-  value->tx = (float)atlas->x / atlas->width;
-  value->ty = (float)atlas->y0 / atlas->height;
-  value->tw = (float)width / atlas->width;
-  value->th = (float)height / atlas->height;
+      atlas_allocate (atlas, width, height, &x, &y);
+    }
 
-  value->atlas = atlas;
+  place_glyph (atlas, value, x, y, width, height);
 
   dirty = g_new0 (DirtyGlyph, 1);
   dirty->key = key;
   dirty->value = value;
+  dirty->x = x;
+  dirty->y = y;
+  dirty->width = width;
+  dirty->height = height;
   atlas->dirty_glyphs = g_list_prepend (atlas->dirty_glyphs, dirty);
 
-  atlas->x = atlas->x + width + 1;
-  atlas->y = MAX (atlas->y, atlas->y0 + height + 1);
-
-  atlas->num_glyphs++;
-
 #ifdef G_ENABLE_DEBUG
   if (GSK_RENDERER_DEBUG_CHECK (cache->renderer, GLYPH_CACHE))
     {
@@ -222,20 +400,19 @@ add_to_cache (GskGLGlyphCache  *cache,
       for (i = 0; i < cache->atlases->len; i++)
         {
           atlas = g_ptr_array_index (cache->atlases, i);
-          g_print ("\tGskGLGlyphAtlas %d (%dx%d): %d glyphs (%d dirty), %.2g%% old pixels, filled to %d, %d / %d\n",
+          g_print ("\tGskGLGlyphAtlas %d (%dx%d): %d glyphs (%d dirty), %.2g%% old pixels, %d skyline nodes\n",
                    i, atlas->width, atlas->height,
                    atlas->num_glyphs, g_list_length (atlas->dirty_glyphs),
                    100.0 * (double)atlas->old_pixels / (double)(atlas->width * atlas->height),
-                   atlas->x, atlas->y0, atlas->y);
+                   atlas->skyline->len);
         }
     }
 #endif
 }
 
 static void
-render_glyph (const GskGLGlyphAtlas *atlas,
-              DirtyGlyph            *glyph,
-              GskImageRegion        *region)
+render_glyph (GskGLGlyphAtlas *atlas,
+              DirtyGlyph      *glyph)
 {
   GlyphCacheKey *key = glyph->key;
   GskGLCachedGlyph *value = glyph->value;
@@ -249,9 +426,11 @@ render_glyph (const GskGLGlyphAtlas *atlas,
   if (G_UNLIKELY (!scaled_font || cairo_scaled_font_status (scaled_font) != CAIRO_STATUS_SUCCESS))
     return;
 
-  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
-                                        value->draw_width * key->scale / 1024,
-                                        value->draw_height * key->scale / 1024);
+  /* Draw straight into our copy of the atlas */
+  surface = cairo_image_surface_create_for_data (atlas->data + glyph->y * atlas->stride + glyph->x * 4,
+                                                 CAIRO_FORMAT_ARGB32,
+                                                 glyph->width, glyph->height,
+                                                 atlas->stride);
   cairo_surface_set_device_scale (surface, key->scale / 1024.0, key->scale / 1024.0);
 
   cr = cairo_create (surface);
@@ -265,6 +444,8 @@ render_glyph (const GskGLGlyphAtlas *atlas,
     glyph_info.geometry.x_offset = 0;
   else
     glyph_info.geometry.x_offset = - value->draw_x * 1024;
+  /* The subpixel shift is in device pixels */
+  glyph_info.geometry.x_offset += key->xshift * 1024 * 1024 / (GSK_SUBPIXEL_POSITIONS * key->scale);
   glyph_info.geometry.y_offset = - value->draw_y * 1024;
 
   glyph_string.num_glyphs = 1;
@@ -273,39 +454,147 @@ render_glyph (const GskGLGlyphAtlas *atlas,
   pango_cairo_show_glyph_string (cr, key->font, &glyph_string);
   cairo_destroy (cr);
 
-  glyph->surface = surface;
+  cairo_surface_finish (surface);
+  cairo_surface_destroy (surface);
 
-  region->data = cairo_image_surface_get_data (surface);
-  region->width = cairo_image_surface_get_width (surface);
-  region->height = cairo_image_surface_get_height (surface);
-  region->stride = cairo_image_surface_get_stride (surface);
-  region->x = (gsize)(value->tx * atlas->width);
-  region->y = (gsize)(value->ty * atlas->height);
+  atlas_add_dirty_rect (atlas, glyph->x, glyph->y, glyph->width, glyph->height);
 }
 
 static void
-upload_dirty_glyphs (GskGLGlyphCache *self,
+render_dirty_glyphs (GskGLGlyphCache *self,
                      GskGLGlyphAtlas *atlas)
 {
   GList *l;
-  guint num_regions;
-  GskImageRegion *regions;
-  int i;
 
-  num_regions = g_list_length (atlas->dirty_glyphs);
-  regions = alloca (sizeof (GskImageRegion) * num_regions);
+  for (l = atlas->dirty_glyphs; l; l = l->next)
+    render_glyph (atlas, (DirtyGlyph *)l->data);
+
+  GSK_RENDERER_NOTE (self->renderer, GLYPH_CACHE,
+            g_message ("rendered %d glyphs to cache", g_list_length (atlas->dirty_glyphs)));
+
+  g_list_free_full (atlas->dirty_glyphs, dirty_glyph_free);
+  atlas->dirty_glyphs = NULL;
+}
+
+static void
+upload_dirty_glyphs (GskGLGlyphCache *self,
+                     GskGLGlyphAtlas *atlas)
+{
+  const cairo_rectangle_int_t *rect = &atlas->dirty_rect;
+  GskImageRegion region;
 
-  for (l = atlas->dirty_glyphs, i = 0; l; l = l->next, i++)
-    render_glyph (atlas, (DirtyGlyph *)l->data, &regions[i]);
+  if (atlas->dirty_glyphs != NULL)
+    render_dirty_glyphs (self, atlas);
+
+  if (rect->width == 0 || rect->height == 0)
+    return;
+
+  /* All new glyphs of an atlas go up in one go */
+  region.data = atlas->data + rect->y * atlas->stride + rect->x * 4;
+  region.width = rect->width;
+  region.height = rect->height;
+  region.stride = atlas->stride;
+  region.x = rect->x;
+  region.y = rect->y;
 
   GSK_RENDERER_NOTE (self->renderer, GLYPH_CACHE,
-            g_message ("uploading %d glyphs to cache", num_regions));
+            g_message ("uploading %dx%d region to cache", rect->width, rect->height));
 
+  gsk_gl_image_upload_regions (atlas->image, self->gl_driver, 1, &region);
 
-  gsk_gl_image_upload_regions (atlas->image, self->gl_driver, num_regions, regions);
+  memset (&atlas->dirty_rect, 0, sizeof (cairo_rectangle_int_t));
+}
 
-  g_list_free_full (atlas->dirty_glyphs, dirty_glyph_free);
-  atlas->dirty_glyphs = NULL;
+static int
+compare_glyph_height (gconstpointer a,
+                      gconstpointer b)
+{
+  const DirtyGlyph *ga = *(const DirtyGlyph **) a;
+  const DirtyGlyph *gb = *(const DirtyGlyph **) b;
+
+  return gb->height - ga->height;
+}
+
+/* Drops the old glyphs of @atlas and packs the remaining ones again.
+ * Returns the number of glyphs that were dropped. */
+static guint
+compact_atlas (GskGLGlyphCache *self,
+               GskGLGlyphAtlas *atlas)
+{
+  GHashTableIter iter;
+  GlyphCacheKey *key;
+  GskGLCachedGlyph *value;
+  GPtrArray *glyphs;
+  guchar *old_data;
+  guint dropped = 0;
+  guint i;
+
+  /* Make sure the old contents are complete before moving them around */
+  render_dirty_glyphs (self, atlas);
+
+  glyphs = g_ptr_array_new_with_free_func (g_free);
+
+  g_hash_table_iter_init (&iter, self->hash_table);
+  while (g_hash_table_iter_next (&iter, (gpointer *)&key, (gpointer *)&value))
+    {
+      DirtyGlyph *glyph;
+
+      if (value->atlas != atlas)
+        continue;
+
+      if (self->timestamp - value->timestamp >= MAX_AGE)
+        {
+          g_hash_table_iter_remove (&iter);
+          dropped++;
+          continue;
+        }
+
+      glyph = g_new0 (DirtyGlyph, 1);
+      glyph->key = key;
+      glyph->value = value;
+      glyph->x = (int)(value->tx * atlas->width);
+      glyph->y = (int)(value->ty * atlas->height);
+      glyph->width = key->scale * value->draw_width / 1024;
+      glyph->height = key->scale * value->draw_height / 1024;
+      g_ptr_array_add (glyphs, glyph);
+    }
+
+  /* Tall glyphs first packs a lot tighter */
+  g_ptr_array_sort (glyphs, compare_glyph_height);
+
+  old_data = atlas->data;
+  atlas->data = g_malloc0 (atlas->stride * atlas->height);
+  atlas_reset_skyline (atlas);
+  atlas->num_glyphs = 0;
+  atlas->old_pixels = 0;
+
+  for (i = 0; i < glyphs->len; i ++)
+    {
+      DirtyGlyph *glyph = g_ptr_array_index (glyphs, i);
+      int x, y, row;
+
+      if (!atlas_allocate (atlas, glyph->width, glyph->height, &x, &y))
+        {
+          /* Will be added to another atlas when used again */
+          g_hash_table_remove (self->hash_table, glyph->key);
+          dropped++;
+          continue;
+        }
+
+      for (row = 0; row < glyph->height; row ++)
+        memcpy (atlas->data + (y + row) * atlas->stride + x * 4,
+                old_data + (glyph->y + row) * atlas->stride + glyph->x * 4,
+                glyph->width * 4);
+
+      place_glyph (atlas, glyph->value, x, y, glyph->width, glyph->height);
+    }
+
+  g_free (old_data);
+  g_ptr_array_unref (glyphs);
+
+  atlas_add_dirty_rect (atlas, 0, 0, atlas->width, atlas->height);
+
+  return dropped;
 }
 
 const GskGLCachedGlyph *
@@ -313,6 +602,7 @@ gsk_gl_glyph_cache_lookup (GskGLGlyphCache *cache,
                            gboolean         create,
                            PangoFont       *font,
                            PangoGlyph       glyph,
+                           guint            xshift,
                            float            scale)
 {
   GskGLCachedGlyph *value;
@@ -321,11 +611,16 @@ gsk_gl_glyph_cache_lookup (GskGLGlyphCache *cache,
                                &(GlyphCacheKey) {
                                  .font = font,
                                  .glyph = glyph,
-                                 .scale = (guint)(scale * 1024)
+                                 .scale = (guint)(scale * 1024),
+                                 .xshift = xshift
                                });
 
   if (value)
     {
+#ifdef G_ENABLE_DEBUG
+      gsk_profiler_counter_inc (gsk_renderer_get_profiler (cache->renderer), cache->counters.hits);
+#endif
+
       if (cache->timestamp - value->timestamp >= MAX_AGE)
         {
           GskGLGlyphAtlas *atlas = value->atlas;
@@ -342,6 +637,10 @@ gsk_gl_glyph_cache_lookup (GskGLGlyphCache *cache,
       GlyphCacheKey *key;
       PangoRectangle ink_rect;
 
+#ifdef G_ENABLE_DEBUG
+      gsk_profiler_counter_inc (gsk_renderer_get_profiler (cache->renderer), cache->counters.misses);
+#endif
+
       key = g_new0 (GlyphCacheKey, 1);
       value = g_new0 (GskGLCachedGlyph, 1);
 
@@ -355,13 +654,22 @@ gsk_gl_glyph_cache_lookup (GskGLGlyphCache *cache,
       value->timestamp = cache->timestamp;
       value->atlas = NULL; /* For now */
 
+      /* Shifted glyphs can bleed into the next pixel */
+      if (xshift != 0 && ink_rect.width > 0)
+        value->draw_width += 1;
+
       key->font = g_object_ref (font);
       key->glyph = glyph;
       key->scale = (guint)(scale * 1024);
+      key->xshift = xshift;
 
       if (ink_rect.width > 0 && ink_rect.height > 0)
         add_to_cache (cache, key, value);
 
+      /* Glyphs that didn't fit are not drawn */
+      if (value->atlas == NULL)
+        value->draw_width = value->draw_height = 0;
+
       g_hash_table_insert (cache->hash_table, key, value);
     }
 
@@ -381,14 +689,34 @@ gsk_gl_glyph_cache_get_glyph_image (GskGLGlyphCache *self,
     {
       atlas->image = g_new0 (GskGLImage, 1);
       gsk_gl_image_create (atlas->image, self->gl_driver, atlas->width, atlas->height);
+      /* The texture starts out undefined, including the borders */
+      atlas_add_dirty_rect (atlas, 0, 0, atlas->width, atlas->height);
     }
 
-  if (atlas->dirty_glyphs)
-    upload_dirty_glyphs (self, atlas);
-
   return atlas->image;
 }
 
+/* Uploads all glyphs added since the last call. This needs to happen
+ * after the ops of a frame have been collected, and before they are
+ * executed. */
+void
+gsk_gl_glyph_cache_upload (GskGLGlyphCache *self)
+{
+  guint i;
+
+  for (i = 0; i < self->atlases->len; i ++)
+    {
+      GskGLGlyphAtlas *atlas = g_ptr_array_index (self->atlases, i);
+
+      /* Nothing drawn from this atlas yet */
+      if (atlas->image == NULL)
+        continue;
+
+      if (atlas->dirty_glyphs != NULL || atlas->dirty_rect.width > 0)
+        upload_dirty_glyphs (self, atlas);
+    }
+}
+
 void
 gsk_gl_glyph_cache_begin_frame (GskGLGlyphCache *self)
 {
@@ -420,7 +748,7 @@ gsk_gl_glyph_cache_begin_frame (GskGLGlyphCache *self)
         }
     }
 
-  /* look for atlases to drop, and create a mapping of updated texture indices */
+  /* look for atlases to compact */
   for (i = self->atlases->len - 1; i >= 0; i--)
     {
       GskGLGlyphAtlas *atlas = g_ptr_array_index (self->atlases, i);
@@ -428,25 +756,23 @@ gsk_gl_glyph_cache_begin_frame (GskGLGlyphCache *self)
       if (atlas->old_pixels > MAX_OLD * atlas->width * atlas->height)
         {
           GSK_RENDERER_NOTE(self->renderer, GLYPH_CACHE,
-                   g_message ("Dropping atlas %d (%g.2%% old)",
+                   g_message ("Compacting atlas %d (%g.2%% old)",
                             i, 100.0 * (double)atlas->old_pixels / (double)(atlas->width * atlas->height)));
 
-          if (atlas->image)
-            {
-              gsk_gl_image_destroy (atlas->image, self->gl_driver);
-              atlas->image->texture_id = 0;
-            }
+          dropped += compact_atlas (self, atlas);
 
-          /* Remove all glyphs that point to this atlas */
-          g_hash_table_iter_init (&iter, self->hash_table);
-          while (g_hash_table_iter_next (&iter, (gpointer *)&key, (gpointer *)&value))
+          if (atlas->num_glyphs == 0 && self->atlases->len > 1)
             {
-              if (value->atlas == atlas)
-                g_hash_table_iter_remove (&iter);
-            }
-          /* TODO: The above loop inside this other loop could be slow... */
+              GSK_RENDERER_NOTE(self->renderer, GLYPH_CACHE, g_message ("Dropping empty atlas %d", i));
 
-          g_ptr_array_remove_index (self->atlases, i);
+              if (atlas->image)
+                {
+                  gsk_gl_image_destroy (atlas->image, self->gl_driver);
+                  atlas->image->texture_id = 0;
+                }
+
+              g_ptr_array_remove_index (self->atlases, i);
+            }
         }
     }
 
@@ -16,6 +16,11 @@ typedef struct
   GPtrArray *atlases;
 
   guint64 timestamp;
+
+  struct {
+    GQuark hits;
+    GQuark misses;
+  } counters;
 } GskGLGlyphCache;
 
 
@@ -23,10 +28,16 @@ typedef struct
 {
   GskGLImage *image;
   int width, height;
-  int x, y, y0;
+  GArray *skyline;
   int num_glyphs;
   GList *dirty_glyphs;
   guint old_pixels;
+
+  /* CPU copy of the atlas contents, and the part of it that
+   * still needs to be uploaded to the texture */
+  guchar *data;
+  int stride;
+  cairo_rectangle_int_t dirty_rect;
 } GskGLGlyphAtlas;
 
 typedef struct
@@ -53,10 +64,12 @@ void                     gsk_gl_glyph_cache_free            (GskGLGlyphCache
 void                     gsk_gl_glyph_cache_begin_frame     (GskGLGlyphCache        *self);
 GskGLImage *             gsk_gl_glyph_cache_get_glyph_image (GskGLGlyphCache        *self,
                                                              const GskGLCachedGlyph *glyph);
+void                     gsk_gl_glyph_cache_upload          (GskGLGlyphCache        *self);
 const GskGLCachedGlyph * gsk_gl_glyph_cache_lookup          (GskGLGlyphCache        *self,
                                                              gboolean                create,
                                                              PangoFont              *font,
                                                              PangoGlyph              glyph,
+                                                             guint                   xshift,
                                                              float                   scale);
 
 #endif
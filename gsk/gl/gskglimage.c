@@ -1,5 +1,6 @@
 
 #include "gskglimageprivate.h"
+#include "gdk/gdkglcontextprivate.h"
 #include <epoxy/gl.h>
 
 void
@@ -47,19 +48,48 @@ gsk_gl_image_upload_regions (GskGLImage           *self,
                              guint                 n_regions,
                              const GskImageRegion *regions)
 {
+  GdkGLContext *context;
+  gboolean has_row_length;
+  int major, minor;
   guint i;
 
+  gsk_gl_driver_bind_source_texture (gl_driver, self->texture_id);
+  glBindTexture (GL_TEXTURE_2D, self->texture_id);
+
+  /* GL_UNPACK_ROW_LENGTH is available on desktop GL, OpenGL ES >= 3.0, or if
+   * the GL_EXT_unpack_subimage extension for OpenGL ES 2.0 is available
+   */
+  context = gdk_gl_context_get_current ();
+  gdk_gl_context_get_version (context, &major, &minor);
+  has_row_length = !gdk_gl_context_get_use_es (context) ||
+                   major >= 3 ||
+                   gdk_gl_context_has_unpack_subimage (context);
+
   for (i = 0; i < n_regions; i ++)
     {
       const GskImageRegion *region = &regions[i];
 
-      gsk_gl_driver_bind_source_texture (gl_driver, self->texture_id);
-      glBindTexture (GL_TEXTURE_2D, self->texture_id);
+      /* Regions may be part of a larger image */
+      if (has_row_length)
+        {
+          glPixelStorei (GL_UNPACK_ROW_LENGTH, region->stride / 4);
+          glTexSubImage2D (GL_TEXTURE_2D, 0, region->x, region->y, region->width, region->height,
+                           GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, region->data);
+        }
+      else
+        {
+          gsize y;
 
-      glTexSubImage2D (GL_TEXTURE_2D, 0, region->x, region->y, region->width, region->height,
-                       GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, region->data);
+          for (y = 0; y < region->height; y++)
+            glTexSubImage2D (GL_TEXTURE_2D, 0, region->x, region->y + y, region->width, 1,
+                             GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV,
+                             region->data + y * region->stride);
+        }
     }
 
+  if (has_row_length)
+    glPixelStorei (GL_UNPACK_ROW_LENGTH, 0);
+
 #ifdef G_ENABLE_DEBUG
   /*gsk_gl_driver_bind_source_texture (gl_driver, self->texture_id);*/
   /*gsk_gl_image_dump (self, gl_driver, "/home/baedert/atlases/test_dump.png");*/
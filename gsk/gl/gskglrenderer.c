@@ -271,6 +271,10 @@ struct _GskGLRenderer
   struct {
     GQuark frames;
     GQuark draw_calls;
+    GQuark unbatched_draw_calls;
+    GQuark shadow_cache_hits;
+    GQuark shadow_cache_misses;
+    GQuark offscreens_avoided;
   } profile_counters;
   struct {
     GQuark cpu_time;
@@ -279,6 +283,8 @@ struct _GskGLRenderer
 #endif
 
   cairo_region_t *render_region;
+  /* render_region in device pixels, nodes outside of it are culled */
+  graphene_rect_t render_region_bounds;
 };
 
 struct _GskGLRendererClass
@@ -398,27 +404,32 @@ render_text_node (GskGLRenderer   *self,
     {
       const PangoGlyphInfo *gi = &glyphs[i];
       const GskGLCachedGlyph *glyph;
-      int glyph_x, glyph_y, glyph_w, glyph_h;
+      float glyph_x, glyph_origin_x;
+      int glyph_y, glyph_w, glyph_h;
       float tx, ty, tx2, ty2;
+      guint xshift;
       double cx;
       double cy;
 
       if (gi->glyph == PANGO_GLYPH_EMPTY)
         continue;
 
+      cx = (double)(x_position + gi->geometry.x_offset) / PANGO_SCALE;
+      cy = (double)(gi->geometry.y_offset) / PANGO_SCALE;
+
+      glyph_origin_x = gsk_glyph_snap_x (x + cx, text_scale, &xshift);
+
       glyph = gsk_gl_glyph_cache_lookup (&self->glyph_cache,
                                          TRUE,
                                          (PangoFont *)font,
                                          gi->glyph,
+                                         xshift,
                                          text_scale);
 
       /* e.g. whitespace */
       if (glyph->draw_width <= 0 || glyph->draw_height <= 0)
         goto next;
 
-      cx = (double)(x_position + gi->geometry.x_offset) / PANGO_SCALE;
-      cy = (double)(gi->geometry.y_offset) / PANGO_SCALE;
-
       ops_set_texture (builder, gsk_gl_glyph_cache_get_glyph_image (&self->glyph_cache,
                                                                     glyph)->texture_id);
 
@@ -427,7 +438,7 @@ render_text_node (GskGLRenderer   *self,
       tx2 = tx + glyph->tw;
       ty2 = ty + glyph->th;
 
-      glyph_x = x + cx + glyph->draw_x;
+      glyph_x = glyph_origin_x + glyph->draw_x;
       glyph_y = y + cy + glyph->draw_y;
       glyph_w = glyph->draw_width;
       glyph_h = glyph->draw_height;
@@ -737,19 +748,141 @@ render_transform_node (GskGLRenderer   *self,
   ops_set_modelview (builder, &prev_mv);
 }
 
+static inline void
+count_offscreen_avoided (GskGLRenderer *self)
+{
+#ifdef G_ENABLE_DEBUG
+  gsk_profiler_counter_inc (gsk_renderer_get_profiler (GSK_RENDERER (self)),
+                            self->profile_counters.offscreens_avoided);
+#endif
+}
+
+/* Whether the draws for @node don't overlap each other, so an opacity
+ * can be applied to each of them instead of to an offscreen rendering */
+static gboolean
+node_is_non_overlapping (GskRenderNode *node)
+{
+  switch (gsk_render_node_get_node_type (node))
+    {
+    case GSK_CONTAINER_NODE:
+      if (gsk_container_node_get_n_children (node) == 0)
+        return TRUE;
+      if (gsk_container_node_get_n_children (node) == 1)
+        return node_is_non_overlapping (gsk_container_node_get_child (node, 0));
+      return FALSE;
+
+    case GSK_OFFSET_NODE:
+      return node_is_non_overlapping (gsk_offset_node_get_child (node));
+
+    case GSK_TRANSFORM_NODE:
+      return node_is_non_overlapping (gsk_transform_node_get_child (node));
+
+    case GSK_OPACITY_NODE:
+      return node_is_non_overlapping (gsk_opacity_node_get_child (node));
+
+    case GSK_CLIP_NODE:
+      return node_is_non_overlapping (gsk_clip_node_get_child (node));
+
+    case GSK_ROUNDED_CLIP_NODE:
+      return node_is_non_overlapping (gsk_rounded_clip_node_get_child (node));
+
+    case GSK_DEBUG_NODE:
+      return node_is_non_overlapping (gsk_debug_node_get_child (node));
+
+    /* These draw their child directly in the cases render_blur_node()
+     * and render_cross_fade_node() avoid the offscreen for */
+    case GSK_BLUR_NODE:
+      if (gsk_blur_node_get_radius (node) <= 0)
+        return node_is_non_overlapping (gsk_blur_node_get_child (node));
+      return TRUE;
+
+    case GSK_CROSS_FADE_NODE:
+      if (gsk_cross_fade_node_get_progress (node) <= 0)
+        return node_is_non_overlapping (gsk_cross_fade_node_get_start_child (node));
+      if (gsk_cross_fade_node_get_progress (node) >= 1)
+        return node_is_non_overlapping (gsk_cross_fade_node_get_end_child (node));
+      return TRUE;
+
+    /* A single draw, or draws next to each other */
+    case GSK_COLOR_NODE:
+    case GSK_TEXTURE_NODE:
+    case GSK_LINEAR_GRADIENT_NODE:
+    case GSK_TEXT_NODE:
+    case GSK_BORDER_NODE:
+    case GSK_INSET_SHADOW_NODE:
+    case GSK_OUTSET_SHADOW_NODE:
+    case GSK_COLOR_MATRIX_NODE:
+    /* These use the fallback */
+    case GSK_REPEATING_LINEAR_GRADIENT_NODE:
+    case GSK_BLEND_NODE:
+    case GSK_REPEAT_NODE:
+    case GSK_CAIRO_NODE:
+      return TRUE;
+
+    case GSK_SHADOW_NODE:
+    case GSK_NOT_A_RENDER_NODE:
+    default:
+      return FALSE;
+    }
+}
+
 static inline void
 render_opacity_node (GskGLRenderer   *self,
                      GskRenderNode   *node,
                      RenderOpBuilder *builder)
 {
+  GskRenderNode *child = gsk_opacity_node_get_child (node);
+  float opacity = gsk_opacity_node_get_opacity (node);
   float prev_opacity;
 
-  prev_opacity = ops_set_opacity (builder,
-                                  builder->current_opacity * gsk_opacity_node_get_opacity (node));
+  if (opacity <= 0)
+    {
+      count_offscreen_avoided (self);
+      return;
+    }
+
+  if (opacity >= 1.0f || node_is_non_overlapping (child))
+    {
+      if (opacity < 1.0f)
+        count_offscreen_avoided (self);
+
+      prev_opacity = ops_set_opacity (builder, builder->current_opacity * opacity);
+
+      gsk_gl_renderer_add_render_ops (self, child, builder);
+
+      ops_set_opacity (builder, prev_opacity);
+    }
+  else
+    {
+      const float min_x = builder->dx + node->bounds.origin.x;
+      const float min_y = builder->dy + node->bounds.origin.y;
+      const float max_x = min_x + node->bounds.size.width;
+      const float max_y = min_y + node->bounds.size.height;
+      int texture_id;
+      gboolean is_offscreen;
+
+      /* Overlapping draws would blend with each other, so draw the
+       * child opaquely and apply the opacity to the result */
+      prev_opacity = ops_set_opacity (builder, 1.0f);
+      add_offscreen_ops (self, builder, min_x, max_x, min_y, max_y,
+                         child,
+                         &texture_id, &is_offscreen, TRUE, TRUE);
+      ops_set_opacity (builder, prev_opacity * opacity);
+
+      ops_set_program (builder, &self->blit_program);
+      ops_set_texture (builder, texture_id);
+      ops_draw (builder, (GskQuadVertex[GL_N_VERTICES]) {
+        { { min_x, min_y }, { 0, 1 }, },
+        { { min_x, max_y }, { 0, 0 }, },
+        { { max_x, min_y }, { 1, 1 }, },
 
-  gsk_gl_renderer_add_render_ops (self, gsk_opacity_node_get_child (node), builder);
+        { { max_x, max_y }, { 1, 0 }, },
+        { { min_x, max_y }, { 0, 0 }, },
+        { { max_x, min_y }, { 1, 1 }, },
+      });
 
-  ops_set_opacity (builder, prev_opacity);
+      ops_set_opacity (builder, prev_opacity);
+    }
 }
 
 static inline void
@@ -948,6 +1081,14 @@ render_blur_node (GskGLRenderer       *self,
   int texture_id;
   gboolean is_offscreen;
   RenderOp op;
+
+  if (gsk_blur_node_get_radius (node) <= 0)
+    {
+      count_offscreen_avoided (self);
+      gsk_gl_renderer_add_render_ops (self, gsk_blur_node_get_child (node), builder);
+      return;
+    }
+
   add_offscreen_ops (self, builder, min_x, max_x, min_y, max_y,
                      gsk_blur_node_get_child (node),
                      &texture_id, &is_offscreen, FALSE, TRUE);
@@ -1071,6 +1212,7 @@ render_outset_shadow_node (GskGLRenderer       *self,
   int prev_render_target;
   int texture_id, render_target;
   int blurred_texture_id, blurred_render_target;
+  ShadowKey key;
 
   /* offset_outline is the minimal outline we need to draw the given drop shadow,
    * enlarged by the spread and offset by the blur radius. */
@@ -1092,77 +1234,99 @@ render_outset_shadow_node (GskGLRenderer       *self,
   texture_width = offset_outline.bounds.size.width   + blur_extra;
   texture_height = offset_outline.bounds.size.height + blur_extra;
 
-  texture_id = gsk_gl_driver_create_texture (self->gl_driver, texture_width, texture_height);
-  gsk_gl_driver_bind_source_texture (self->gl_driver, texture_id);
-  gsk_gl_driver_init_texture_empty (self->gl_driver, texture_id);
-  render_target = gsk_gl_driver_create_render_target (self->gl_driver, texture_id, FALSE, FALSE);
+  memset (&key, 0, sizeof (key));
+  key.color = *gsk_outset_shadow_node_peek_color (node);
+  key.outline = offset_outline;
+  key.blur_radius = blur_radius;
+  key.scale = ops_get_scale (builder);
 
+  prev_clip = builder->current_clip;
+  blurred_texture_id = gsk_gl_driver_lookup_shadow (self->gl_driver, &key);
 
-  graphene_matrix_init_ortho (&item_proj,
-                              0, texture_width, 0, texture_height,
-                              ORTHO_NEAR_PLANE, ORTHO_FAR_PLANE);
-  graphene_matrix_scale (&item_proj, 1, -1, 1);
-  graphene_matrix_init_identity (&identity);
+#ifdef G_ENABLE_DEBUG
+  gsk_profiler_counter_inc (gsk_renderer_get_profiler (GSK_RENDERER (self)),
+                            blurred_texture_id != 0 ? self->profile_counters.shadow_cache_hits
+                                                    : self->profile_counters.shadow_cache_misses);
+#endif
 
-  prev_render_target = ops_set_render_target (builder, render_target);
-  op.op = OP_CLEAR;
-  ops_add (builder, &op);
-  prev_projection = ops_set_projection (builder, &item_proj);
-  prev_modelview = ops_set_modelview (builder, &identity);
-  prev_viewport = ops_set_viewport (builder, &GRAPHENE_RECT_INIT (0, 0, texture_width, texture_height));
+  /* The blurred texture only depends on the key, so it can be shared
+   * between all shadows with the same shape, color and radius. */
+  if (blurred_texture_id == 0)
+    {
+      texture_id = gsk_gl_driver_create_texture (self->gl_driver, texture_width, texture_height);
+      gsk_gl_driver_bind_source_texture (self->gl_driver, texture_id);
+      gsk_gl_driver_init_texture_empty (self->gl_driver, texture_id);
+      render_target = gsk_gl_driver_create_render_target (self->gl_driver, texture_id, FALSE, FALSE);
+
+
+      graphene_matrix_init_ortho (&item_proj,
+                                  0, texture_width, 0, texture_height,
+                                  ORTHO_NEAR_PLANE, ORTHO_FAR_PLANE);
+      graphene_matrix_scale (&item_proj, 1, -1, 1);
+      graphene_matrix_init_identity (&identity);
+
+      prev_render_target = ops_set_render_target (builder, render_target);
+      op.op = OP_CLEAR;
+      ops_add (builder, &op);
+      prev_projection = ops_set_projection (builder, &item_proj);
+      prev_modelview = ops_set_modelview (builder, &identity);
+      prev_viewport = ops_set_viewport (builder, &GRAPHENE_RECT_INIT (0, 0, texture_width, texture_height));
+
+      /* Draw outline */
+      ops_set_program (builder, &self->color_program);
+      prev_clip = ops_set_clip (builder, &offset_outline);
+      ops_set_color (builder, gsk_outset_shadow_node_peek_color (node));
+      ops_draw (builder, (GskQuadVertex[GL_N_VERTICES]) {
+        { { 0,                            }, { 0, 1 }, },
+        { { 0,             texture_height }, { 0, 0 }, },
+        { { texture_width,                }, { 1, 1 }, },
 
-  /* Draw outline */
-  ops_set_program (builder, &self->color_program);
-  prev_clip = ops_set_clip (builder, &offset_outline);
-  ops_set_color (builder, gsk_outset_shadow_node_peek_color (node));
-  ops_draw (builder, (GskQuadVertex[GL_N_VERTICES]) {
-    { { 0,                            }, { 0, 1 }, },
-    { { 0,             texture_height }, { 0, 0 }, },
-    { { texture_width,                }, { 1, 1 }, },
-
-    { { texture_width, texture_height }, { 1, 0 }, },
-    { { 0,             texture_height }, { 0, 0 }, },
-    { { texture_width,                }, { 1, 1 }, },
-  });
-
-  blurred_texture_id = gsk_gl_driver_create_texture (self->gl_driver, texture_width, texture_height);
-  gsk_gl_driver_bind_source_texture (self->gl_driver, blurred_texture_id);
-  gsk_gl_driver_init_texture_empty (self->gl_driver, blurred_texture_id);
-  blurred_render_target = gsk_gl_driver_create_render_target (self->gl_driver, blurred_texture_id, TRUE, TRUE);
-
-  ops_set_render_target (builder, blurred_render_target);
-  op.op = OP_CLEAR;
-  ops_add (builder, &op);
+        { { texture_width, texture_height }, { 1, 0 }, },
+        { { 0,             texture_height }, { 0, 0 }, },
+        { { texture_width,                }, { 1, 1 }, },
+      });
 
-  gsk_rounded_rect_init_from_rect (&blit_clip,
-                                   &GRAPHENE_RECT_INIT (0, 0, texture_width, texture_height), 0.0f);
+      blurred_texture_id = gsk_gl_driver_create_texture (self->gl_driver, texture_width, texture_height);
+      gsk_gl_driver_bind_source_texture (self->gl_driver, blurred_texture_id);
+      gsk_gl_driver_init_texture_empty (self->gl_driver, blurred_texture_id);
+      blurred_render_target = gsk_gl_driver_create_render_target (self->gl_driver, blurred_texture_id, TRUE, TRUE);
 
-  ops_set_program (builder, &self->blur_program);
-  op.op = OP_CHANGE_BLUR;
-  op.blur.size.width = texture_width;
-  op.blur.size.height = texture_height;
-  op.blur.radius = blur_radius;
-  ops_add (builder, &op);
+      ops_set_render_target (builder, blurred_render_target);
+      op.op = OP_CLEAR;
+      ops_add (builder, &op);
 
-  ops_set_clip (builder, &blit_clip);
-  ops_set_texture (builder, texture_id);
-  ops_draw (builder, (GskQuadVertex[GL_N_VERTICES]) {
-    { { 0,             0              }, { 0, 1 }, },
-    { { 0,             texture_height }, { 0, 0 }, },
-    { { texture_width, 0              }, { 1, 1 }, },
+      gsk_rounded_rect_init_from_rect (&blit_clip,
+                                       &GRAPHENE_RECT_INIT (0, 0, texture_width, texture_height), 0.0f);
 
-    { { texture_width, texture_height }, { 1, 0 }, },
-    { { 0,             texture_height }, { 0, 0 }, },
-    { { texture_width, 0              }, { 1, 1 }, },
-  });
+      ops_set_program (builder, &self->blur_program);
+      op.op = OP_CHANGE_BLUR;
+      op.blur.size.width = texture_width;
+      op.blur.size.height = texture_height;
+      op.blur.radius = blur_radius;
+      ops_add (builder, &op);
 
+      ops_set_clip (builder, &blit_clip);
+      ops_set_texture (builder, texture_id);
+      ops_draw (builder, (GskQuadVertex[GL_N_VERTICES]) {
+        { { 0,             0              }, { 0, 1 }, },
+        { { 0,             texture_height }, { 0, 0 }, },
+        { { texture_width, 0              }, { 1, 1 }, },
 
-  ops_set_clip (builder, &prev_clip);
+        { { texture_width, texture_height }, { 1, 0 }, },
+        { { 0,             texture_height }, { 0, 0 }, },
+        { { texture_width, 0              }, { 1, 1 }, },
+      });
 
-  ops_set_viewport (builder, &prev_viewport);
-  ops_set_modelview (builder, &prev_modelview);
-  ops_set_projection (builder, &prev_projection);
-  ops_set_render_target (builder, prev_render_target);
+
+      ops_set_clip (builder, &prev_clip);
+
+      ops_set_viewport (builder, &prev_viewport);
+      ops_set_modelview (builder, &prev_modelview);
+      ops_set_projection (builder, &prev_projection);
+      ops_set_render_target (builder, prev_render_target);
+
+      gsk_gl_driver_cache_shadow (self->gl_driver, &key, blurred_texture_id);
+    }
 
   ops_set_program (builder, &self->outset_shadow_program);
   ops_set_texture (builder, blurred_texture_id);
@@ -1520,6 +1684,14 @@ render_cross_fade_node (GskGLRenderer       *self,
     { { max_x, min_y }, { 1, 1 }, },
   };
 
+  /* At either end of the fade only one of the children is visible */
+  if (progress <= 0 || progress >= 1)
+    {
+      count_offscreen_avoided (self);
+      gsk_gl_renderer_add_render_ops (self, progress <= 0 ? start_node : end_node, builder);
+      return;
+    }
+
   /* TODO: We create 2 textures here as big as the cross-fade node, but both the
    * start and the end node might be a lot smaller than that. */
 
@@ -1993,7 +2165,7 @@ gsk_gl_renderer_realize (GskRenderer  *renderer,
 
   g_assert (self->gl_driver == NULL);
   self->gl_profiler = gsk_gl_profiler_new (self->gl_context);
-  self->gl_driver = gsk_gl_driver_new (self->gl_context);
+  self->gl_driver = gsk_gl_driver_new (self->gl_context, gsk_renderer_get_profiler (renderer));
 
   GSK_RENDERER_NOTE (renderer, OPENGL, g_message ("Creating buffers and programs"));
   if (!gsk_gl_renderer_create_programs (self, error))
@@ -2140,6 +2312,27 @@ gsk_gl_renderer_add_render_ops (GskGLRenderer   *self,
     if (!graphene_rect_intersection (&builder->current_clip.bounds,
                                      &transformed_node_bounds, NULL))
       return;
+
+    /* Offscreens may need content from outside of the damaged area,
+     * so only cull nodes drawn directly to the window */
+    if (self->render_region != NULL &&
+        builder->current_render_target == 0)
+      {
+        graphene_rect_t offset_node_bounds, device_node_bounds;
+
+        /* The damage is in device pixels, and the offset is applied
+         * before the modelview, which includes the scale factor */
+        graphene_rect_offset_r (&node->bounds,
+                                builder->dx, builder->dy,
+                                &offset_node_bounds);
+        graphene_matrix_transform_bounds (&builder->current_modelview,
+                                          &offset_node_bounds,
+                                          &device_node_bounds);
+
+        if (!graphene_rect_intersection (&self->render_region_bounds,
+                                         &device_node_bounds, NULL))
+          return;
+      }
   }
 
   switch (gsk_render_node_get_node_type (node))
@@ -2507,6 +2700,7 @@ gsk_gl_renderer_do_render (GskRenderer           *renderer,
   GskGLRenderer *self = GSK_GL_RENDERER (renderer);
   RenderOpBuilder render_op_builder;
   graphene_matrix_t modelview, projection;
+  guint n_draws_before, n_draws_after;
 #ifdef G_ENABLE_DEBUG
   GskProfiler *profiler;
   gint64 gpu_time, cpu_time;
@@ -2553,6 +2747,17 @@ gsk_gl_renderer_do_render (GskRenderer           *renderer,
   /* We correctly reset the state everywhere */
   g_assert_cmpint (render_op_builder.current_render_target, ==, fbo_id);
 
+  gsk_gl_glyph_cache_upload (&self->glyph_cache);
+
+  ops_batch_draws (&render_op_builder, &n_draws_before, &n_draws_after);
+
+  GSK_RENDERER_NOTE (renderer, OPENGL, g_message ("Batched %u draws into %u", n_draws_before, n_draws_after));
+
+#ifdef G_ENABLE_DEBUG
+  gsk_profiler_counter_add (profiler, self->profile_counters.unbatched_draw_calls, n_draws_before);
+  gsk_profiler_counter_add (profiler, self->profile_counters.draw_calls, n_draws_after);
+#endif
+
   /*g_message ("Ops: %u", self->render_ops->len);*/
 
   /* Now actually draw things... */
@@ -2656,8 +2861,8 @@ gsk_gl_renderer_render (GskRenderer          *renderer,
   surface = gsk_renderer_get_surface (renderer);
   whole_surface = (GdkRectangle) {
                       0, 0,
-                      gdk_surface_get_width (surface) * self->scale_factor,
-                      gdk_surface_get_height (surface) * self->scale_factor
+                      gdk_surface_get_width (surface),
+                      gdk_surface_get_height (surface)
                   };
 
   gdk_draw_context_begin_frame (GDK_DRAW_CONTEXT (self->gl_context),
@@ -2684,6 +2889,20 @@ gsk_gl_renderer_render (GskRenderer          *renderer,
   self->scale_factor = gdk_surface_get_scale_factor (surface);
   gdk_gl_context_make_current (self->gl_context);
 
+  if (self->render_region != NULL)
+    {
+      GdkRectangle extents;
+
+      cairo_region_get_extents (self->render_region, &extents);
+      self->render_region_bounds = GRAPHENE_RECT_INIT (extents.x * self->scale_factor,
+                                                       extents.y * self->scale_factor,
+                                                       extents.width * self->scale_factor,
+                                                       extents.height * self->scale_factor);
+      GSK_RENDERER_NOTE (renderer, OPENGL,
+                         g_message ("Redrawing damaged area %d,%d %dx%d",
+                                    extents.x, extents.y, extents.width, extents.height));
+    }
+
   viewport.origin.x = 0;
   viewport.origin.y = 0;
   viewport.size.width = gdk_surface_get_width (surface) * self->scale_factor;
@@ -2726,6 +2945,10 @@ gsk_gl_renderer_init (GskGLRenderer *self)
 
     self->profile_counters.frames = gsk_profiler_add_counter (profiler, "frames", "Frames", FALSE);
     self->profile_counters.draw_calls = gsk_profiler_add_counter (profiler, "draws", "glDrawArrays", TRUE);
+    self->profile_counters.unbatched_draw_calls = gsk_profiler_add_counter (profiler, "unbatched-draws", "Draws before batching", TRUE);
+    self->profile_counters.shadow_cache_hits = gsk_profiler_add_counter (profiler, "shadow-cache-hits", "Shadow cache hits", TRUE);
+    self->profile_counters.shadow_cache_misses = gsk_profiler_add_counter (profiler, "shadow-cache-misses", "Shadow cache misses", TRUE);
+    self->profile_counters.offscreens_avoided = gsk_profiler_add_counter (profiler, "offscreens-avoided", "Offscreen renderings skipped", TRUE);
 
     self->profile_timers.cpu_time = gsk_profiler_add_timer (profiler, "cpu-time", "CPU time", FALSE, TRUE);
     self->profile_timers.gpu_time = gsk_profiler_add_timer (profiler, "gpu-time", "GPU time", FALSE, TRUE);
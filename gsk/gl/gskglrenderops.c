@@ -1,5 +1,40 @@
 #include "gskglrenderopsprivate.h"
 
+/* How many batches a draw may be moved back over to join a batch
+ * with the same state */
+#define BATCH_LOOKBACK 32
+
+typedef struct
+{
+  GskQuadVertex vertex_data[GL_N_VERTICES];
+  int next;
+} VertexChunk;
+
+typedef struct
+{
+  const Program *program;
+  guint program_version;
+  int texture_id;
+  graphene_rect_t bounds; /* In clip space */
+  int first_chunk;
+  int last_chunk;
+  guint n_chunks;
+} Batch;
+
+/* What we know about the uniforms of a program at a given point in the ops */
+typedef struct
+{
+  guint version;
+  guint known_ops;
+  GskRoundedRect clip;
+  graphene_matrix_t modelview;
+  graphene_matrix_t projection;
+  float opacity;
+  GdkRGBA color;
+  graphene_matrix_t mvp;
+  guint mvp_dirty : 1;
+} ProgramTrack;
+
 static inline void
 rgba_to_float (const GdkRGBA *c,
                float         *f)
@@ -443,3 +478,311 @@ ops_add (RenderOpBuilder *builder,
 {
   g_array_append_val (builder->render_ops, *op);
 }
+
+static gboolean
+program_track_update (ProgramTrack   *track,
+                      const RenderOp *op)
+{
+  gboolean known = (track->known_ops & (1 << op->op)) != 0;
+
+  switch (op->op)
+    {
+    case OP_CHANGE_CLIP:
+      if (known && memcmp (&track->clip, &op->clip, sizeof (GskRoundedRect)) == 0)
+        return FALSE;
+      track->clip = op->clip;
+      break;
+
+    case OP_CHANGE_MODELVIEW:
+      if (known && memcmp (&track->modelview, &op->modelview, sizeof (graphene_matrix_t)) == 0)
+        return FALSE;
+      track->modelview = op->modelview;
+      track->mvp_dirty = TRUE;
+      break;
+
+    case OP_CHANGE_PROJECTION:
+      if (known && memcmp (&track->projection, &op->projection, sizeof (graphene_matrix_t)) == 0)
+        return FALSE;
+      track->projection = op->projection;
+      track->mvp_dirty = TRUE;
+      break;
+
+    case OP_CHANGE_OPACITY:
+      if (known && track->opacity == op->opacity)
+        return FALSE;
+      track->opacity = op->opacity;
+      break;
+
+    case OP_CHANGE_COLOR:
+      if (known && gdk_rgba_equal (&track->color, &op->color))
+        return FALSE;
+      track->color = op->color;
+      break;
+
+    default:
+      break;
+    }
+
+  track->known_ops |= 1 << op->op;
+
+  return TRUE;
+}
+
+static void
+compute_draw_bounds (ProgramTrack          *track,
+                     const VertexChunk     *chunks,
+                     int                    first_chunk,
+                     graphene_rect_t       *bounds)
+{
+  const guint mvp_ops = (1 << OP_CHANGE_MODELVIEW) | (1 << OP_CHANGE_PROJECTION);
+  float min_x = G_MAXFLOAT, min_y = G_MAXFLOAT;
+  float max_x = -G_MAXFLOAT, max_y = -G_MAXFLOAT;
+  graphene_rect_t rect;
+  int c, i;
+
+  if ((track->known_ops & mvp_ops) != mvp_ops)
+    {
+      /* Can't tell where this ends up, so it overlaps everything */
+      graphene_rect_init (bounds, -G_MAXFLOAT / 4, -G_MAXFLOAT / 4, G_MAXFLOAT / 2, G_MAXFLOAT / 2);
+      return;
+    }
+
+  if (track->mvp_dirty)
+    {
+      graphene_matrix_multiply (&track->modelview, &track->projection, &track->mvp);
+      track->mvp_dirty = FALSE;
+    }
+
+  for (c = first_chunk; c != -1; c = chunks[c].next)
+    {
+      for (i = 0; i < GL_N_VERTICES; i ++)
+        {
+          const GskQuadVertex *v = &chunks[c].vertex_data[i];
+
+          min_x = MIN (min_x, v->position[0]);
+          min_y = MIN (min_y, v->position[1]);
+          max_x = MAX (max_x, v->position[0]);
+          max_y = MAX (max_y, v->position[1]);
+        }
+    }
+
+  graphene_rect_init (&rect, min_x, min_y, max_x - min_x, max_y - min_y);
+  graphene_matrix_transform_bounds (&track->mvp, &rect, bounds);
+}
+
+static int
+find_batch (GArray                *batches,
+            guint                  first_batch,
+            const Program         *program,
+            guint                  program_version,
+            int                    texture_id,
+            const graphene_rect_t *bounds)
+{
+  guint i, n;
+
+  for (i = batches->len, n = 0; i > first_batch && n < BATCH_LOOKBACK; i --, n ++)
+    {
+      const Batch *batch = &g_array_index (batches, Batch, i - 1);
+
+      if (batch->program == program &&
+          batch->program_version == program_version &&
+          batch->texture_id == texture_id)
+        return i - 1;
+
+      /* We can't move the draw in front of anything it overlaps */
+      if (graphene_rect_intersection (&batch->bounds, bounds, NULL))
+        return -1;
+    }
+
+  return -1;
+}
+
+/*
+ * ops_batch_draws:
+ *
+ * Rewrites the recorded ops so that draws using the same program, texture
+ * and uniforms are issued as a single draw call. A draw is moved back to an
+ * earlier batch with identical state if it doesn't overlap anything drawn
+ * in between; render target changes, clears and viewport changes are never
+ * crossed. State changes that don't change anything are dropped.
+ *
+ * Returns the number of draws before and after batching.
+ */
+void
+ops_batch_draws (RenderOpBuilder *builder,
+                 guint           *n_draws_before,
+                 guint           *n_draws_after)
+{
+  GArray *ops = builder->render_ops;
+  GArray *out, *batches, *chunks;
+  ProgramTrack tracks[GL_N_PROGRAMS];
+  const Program *program = NULL;
+  int texture_id = 0;
+  guint version_counter = 0;
+  guint first_batch = 0;
+  int pending_first = -1, pending_last = -1;
+  guint n_pending = 0;
+  gsize vao_offset;
+  guint i;
+
+  *n_draws_before = 0;
+  *n_draws_after = 0;
+
+  out = g_array_sized_new (FALSE, FALSE, sizeof (RenderOp), ops->len);
+  batches = g_array_new (FALSE, FALSE, sizeof (Batch));
+  chunks = g_array_new (FALSE, FALSE, sizeof (VertexChunk));
+  memset (tracks, 0, sizeof (tracks));
+
+  for (i = 0; i < ops->len; i ++)
+    {
+      const RenderOp *op = &g_array_index (ops, RenderOp, i);
+
+      switch (op->op)
+        {
+        case OP_NONE:
+          continue;
+
+        case OP_CHANGE_VAO:
+          {
+            VertexChunk chunk;
+
+            memcpy (chunk.vertex_data, op->vertex_data, sizeof (GskQuadVertex) * GL_N_VERTICES);
+            chunk.next = -1;
+            g_array_append_val (chunks, chunk);
+
+            if (pending_last != -1)
+              g_array_index (chunks, VertexChunk, pending_last).next = chunks->len - 1;
+            else
+              pending_first = chunks->len - 1;
+            pending_last = chunks->len - 1;
+            n_pending ++;
+          }
+          continue;
+
+        case OP_DRAW:
+          (*n_draws_before) ++;
+
+          if (program != NULL && n_pending > 0)
+            {
+              ProgramTrack *track = &tracks[program->index];
+              graphene_rect_t bounds;
+              int b;
+
+              compute_draw_bounds (track, (VertexChunk *) chunks->data, pending_first, &bounds);
+
+              b = find_batch (batches, first_batch, program, track->version, texture_id, &bounds);
+              if (b != -1)
+                {
+                  Batch *batch = &g_array_index (batches, Batch, b);
+
+                  g_array_index (chunks, VertexChunk, batch->last_chunk).next = pending_first;
+                  batch->last_chunk = pending_last;
+                  batch->n_chunks += n_pending;
+                  graphene_rect_union (&batch->bounds, &bounds, &batch->bounds);
+                }
+              else
+                {
+                  Batch batch;
+                  RenderOp draw;
+
+                  batch.program = program;
+                  batch.program_version = track->version;
+                  batch.texture_id = texture_id;
+                  batch.bounds = bounds;
+                  batch.first_chunk = pending_first;
+                  batch.last_chunk = pending_last;
+                  batch.n_chunks = n_pending;
+                  g_array_append_val (batches, batch);
+
+                  /* Placeholder, filled in below */
+                  draw.op = OP_DRAW;
+                  draw.draw.vao_offset = batches->len - 1;
+                  draw.draw.vao_size = 0;
+                  g_array_append_val (out, draw);
+                }
+            }
+
+          pending_first = pending_last = -1;
+          n_pending = 0;
+          continue;
+
+        case OP_CHANGE_PROGRAM:
+          if (op->program == program)
+            continue;
+          program = op->program;
+          break;
+
+        case OP_CHANGE_RENDER_TARGET:
+        case OP_CLEAR:
+          first_batch = batches->len;
+          break;
+
+        case OP_CHANGE_VIEWPORT:
+          /* Also changes the GL viewport, which is not per-program state */
+          if (program == NULL)
+            continue;
+          tracks[program->index].version = ++ version_counter;
+          first_batch = batches->len;
+          break;
+
+        case OP_CHANGE_SOURCE_TEXTURE:
+          if (program == NULL || op->texture_id == texture_id)
+            continue;
+          texture_id = op->texture_id;
+          break;
+
+        default:
+          /* Everything else sets uniforms of the current program, and
+           * is ignored by gsk_gl_renderer_render_ops() without one. */
+          if (program == NULL ||
+              !program_track_update (&tracks[program->index], op))
+            continue;
+          tracks[program->index].version = ++ version_counter;
+          break;
+        }
+
+      g_array_append_val (out, *op);
+    }
+
+  /* Now put the vertex data back in front of each draw, in batch order */
+  g_array_set_size (ops, 0);
+  vao_offset = 0;
+
+  for (i = 0; i < out->len; i ++)
+    {
+      const RenderOp *op = &g_array_index (out, RenderOp, i);
+
+      if (op->op == OP_DRAW)
+        {
+          const Batch *batch = &g_array_index (batches, Batch, op->draw.vao_offset);
+          RenderOp vao, draw;
+          int c;
+
+          vao.op = OP_CHANGE_VAO;
+          for (c = batch->first_chunk; c != -1; c = g_array_index (chunks, VertexChunk, c).next)
+            {
+              memcpy (vao.vertex_data, g_array_index (chunks, VertexChunk, c).vertex_data,
+                      sizeof (GskQuadVertex) * GL_N_VERTICES);
+              g_array_append_val (ops, vao);
+            }
+
+          draw.op = OP_DRAW;
+          draw.draw.vao_offset = vao_offset;
+          draw.draw.vao_size = batch->n_chunks * GL_N_VERTICES;
+          g_array_append_val (ops, draw);
+
+          vao_offset += draw.draw.vao_size;
+          (*n_draws_after) ++;
+        }
+      else
+        {
+          g_array_append_val (ops, *op);
+        }
+    }
+
+  builder->buffer_size = vao_offset * sizeof (GskQuadVertex);
+
+  g_array_free (out, TRUE);
+  g_array_free (batches, TRUE);
+  g_array_free (chunks, TRUE);
+}
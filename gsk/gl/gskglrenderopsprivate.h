@@ -284,4 +284,8 @@ void              ops_offset             (RenderOpBuilder        *builder,
 void              ops_add                (RenderOpBuilder        *builder,
                                           const RenderOp         *op);
 
+void              ops_batch_draws        (RenderOpBuilder        *builder,
+                                          guint                  *n_draws_before,
+                                          guint                  *n_draws_after);
+
 #endif
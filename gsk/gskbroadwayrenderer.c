@@ -8,12 +8,24 @@
 #include "gskrendernodeprivate.h"
 #include "gdk/gdktextureprivate.h"
 
+#include <string.h>
+
 struct _GskBroadwayRenderer
 {
   GskRenderer parent_instance;
   GdkBroadwayDrawContext *draw_context;
+
+  /* FallbackKey => GdkTexture, for sending fallbacks as changes
+   * to the fallback of the same node in the previous frame */
+  GHashTable *fallbacks;
+  GHashTable *next_fallbacks;
 };
 
+typedef struct {
+  GskRenderNodeType type;
+  int x, y, width, height;
+} FallbackKey;
+
 struct _GskBroadwayRendererClass
 {
   GskRendererClass parent_class;
@@ -45,6 +57,7 @@ gsk_broadway_renderer_unrealize (GskRenderer *renderer)
 {
   GskBroadwayRenderer *self = GSK_BROADWAY_RENDERER (renderer);
   g_clear_object (&self->draw_context);
+  g_clear_pointer (&self->fallbacks, g_hash_table_unref);
 }
 
 static GdkTexture *
@@ -423,6 +436,28 @@ node_cache_store (GskRenderNode *node,
     }
 }
 
+static guint
+fallback_key_hash (gconstpointer data)
+{
+  const FallbackKey *key = data;
+
+  return key->type ^ (key->x << 4) ^ (key->y << 12) ^ (key->width << 20) ^ (key->height << 26);
+}
+
+static gboolean
+fallback_key_equal (gconstpointer a,
+                    gconstpointer b)
+{
+  return memcmp (a, b, sizeof (FallbackKey)) == 0;
+}
+
+static GHashTable *
+fallbacks_new (void)
+{
+  return g_hash_table_new_full (fallback_key_hash, fallback_key_equal,
+                                g_free, g_object_unref);
+}
+
 static GdkTexture *
 node_texture_fallback (GskRenderNode *node,
                        float *off_x,
@@ -675,9 +710,11 @@ gsk_broadway_renderer_add_node (GskRenderer *renderer,
     }
 
   {
+    GskBroadwayRenderer *self = GSK_BROADWAY_RENDERER (renderer);
     GdkTexture *texture;
     guint32 texture_id;
     float t_off_x = 0, t_off_y = 0;
+    FallbackKey key;
 
     texture = node_cache_lookup (node, &t_off_x, &t_off_y);
 
@@ -691,8 +728,17 @@ gsk_broadway_renderer_add_node (GskRenderer *renderer,
         node_cache_store (node, texture, t_off_x, t_off_y);
       }
 
+    key.type = gsk_render_node_get_node_type (node);
+    key.x = floorf (node->bounds.origin.x);
+    key.y = floorf (node->bounds.origin.y);
+    key.width = gdk_texture_get_width (texture);
+    key.height = gdk_texture_get_height (texture);
+
     g_ptr_array_add (node_textures, texture); /* Transfers ownership to node_textures */
-    texture_id = gdk_broadway_display_ensure_texture (display, texture);
+    texture_id = gdk_broadway_display_ensure_texture_with_base (display, texture,
+                                                                self->fallbacks ? g_hash_table_lookup (self->fallbacks, &key) : NULL);
+    g_hash_table_replace (self->next_fallbacks, g_memdup (&key, sizeof (key)), g_object_ref (texture));
+
     add_uint32 (nodes, BROADWAY_NODE_TEXTURE);
     add_float (nodes, node->bounds.origin.x + t_off_x - offset_x);
     add_float (nodes, node->bounds.origin.y + t_off_y - offset_y);
@@ -709,9 +755,14 @@ gsk_broadway_renderer_render (GskRenderer          *renderer,
 {
   GskBroadwayRenderer *self = GSK_BROADWAY_RENDERER (renderer);
 
+  self->next_fallbacks = fallbacks_new ();
+
   gdk_draw_context_begin_frame (GDK_DRAW_CONTEXT (self->draw_context), update_area);
   gsk_broadway_renderer_add_node (renderer, self->draw_context->nodes, self->draw_context->node_textures, root, 0, 0);
   gdk_draw_context_end_frame (GDK_DRAW_CONTEXT (self->draw_context));
+
+  g_clear_pointer (&self->fallbacks, g_hash_table_unref);
+  self->fallbacks = g_steal_pointer (&self->next_fallbacks);
 }
 
 static void
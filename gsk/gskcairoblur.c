@@ -20,11 +20,17 @@
  *     Owen Taylor <otaylor@redhat.com>
  */
 
+#include "config.h"
+
 #include "gskcairoblurprivate.h"
 
 #include <math.h>
 #include <string.h>
 
+#ifdef HAVE_X86_INTRINSICS
+#include <immintrin.h>
+#endif
+
 /*
  * Gets the size for a single box blur.
  *
@@ -218,6 +224,403 @@ _boxblur (guchar      *buffer,
   g_free (flipped_buffer);
 }
 
+/* The accelerated blur works on strips of STRIP_WIDTH columns that are
+ * copied into a contiguous buffer, so that a vertical pass reads memory
+ * linearly and can process all columns of a strip with vector
+ * instructions. Horizontal passes transpose the buffer first.
+ *
+ * The result is identical to the one of blur_rows().
+ */
+#define STRIP_WIDTH 8
+
+/* Buffers with more pixels than this are split between threads */
+#define PARALLEL_THRESHOLD (512 * 512)
+
+typedef void (* BlurStripFunc) (const guchar *src,
+                                guchar       *dst,
+                                int           height,
+                                int           d,
+                                int           shift);
+
+static gboolean blur_accelerated = TRUE;
+
+/* Does the same as blur_xspan() for each column of a strip */
+static void
+blur_strip_scalar (const guchar *src,
+                   guchar       *dst,
+                   int           height,
+                   int           d,
+                   int           shift)
+{
+  int sum[STRIP_WIDTH] = { 0, };
+  int offset;
+  int i, k;
+
+  if (d % 2 == 1)
+    offset = d / 2;
+  else
+    offset = (d - shift) / 2;
+
+  for (i = -d + offset; i < height + offset; i++)
+    {
+      if (i >= 0 && i < height)
+        {
+          for (k = 0; k < STRIP_WIDTH; k++)
+            sum[k] += src[i * STRIP_WIDTH + k];
+        }
+
+      if (i >= offset)
+        {
+          if (i >= d)
+            {
+              for (k = 0; k < STRIP_WIDTH; k++)
+                sum[k] -= src[(i - d) * STRIP_WIDTH + k];
+            }
+
+          for (k = 0; k < STRIP_WIDTH; k++)
+            dst[(i - offset) * STRIP_WIDTH + k] = (sum[k] + d / 2) / d;
+        }
+    }
+}
+
+#ifdef HAVE_X86_INTRINSICS
+
+/* Computes n / d for 0 <= n < 2^24, where all values are exactly
+ * representable as floats. The product with the reciprocal can be
+ * off by one, so the quotient is fixed up afterwards.
+ */
+static inline __m128i __attribute__ ((target ("sse2")))
+divide_sse2 (__m128i n,
+             __m128  d,
+             __m128  inv_d)
+{
+  __m128 nf = _mm_cvtepi32_ps (n);
+  __m128i q = _mm_cvttps_epi32 (_mm_mul_ps (nf, inv_d));
+  __m128 qf = _mm_cvtepi32_ps (q);
+
+  q = _mm_sub_epi32 (q, _mm_castps_si128 (_mm_cmple_ps (_mm_mul_ps (_mm_add_ps (qf, _mm_set1_ps (1)), d), nf)));
+  q = _mm_add_epi32 (q, _mm_castps_si128 (_mm_cmpgt_ps (_mm_mul_ps (qf, d), nf)));
+
+  return q;
+}
+
+static inline void __attribute__ ((target ("sse2")))
+load_row_sse2 (const guchar *row,
+               __m128i      *lo,
+               __m128i      *hi)
+{
+  __m128i zero = _mm_setzero_si128 ();
+  __m128i v = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *) row), zero);
+
+  *lo = _mm_unpacklo_epi16 (v, zero);
+  *hi = _mm_unpackhi_epi16 (v, zero);
+}
+
+static void __attribute__ ((target ("sse2")))
+blur_strip_sse2 (const guchar *src,
+                 guchar       *dst,
+                 int           height,
+                 int           d,
+                 int           shift)
+{
+  __m128 df = _mm_set1_ps (d);
+  __m128 inv_d = _mm_set1_ps (1.0f / d);
+  __m128i half = _mm_set1_epi32 (d / 2);
+  __m128i sum_lo = _mm_setzero_si128 ();
+  __m128i sum_hi = _mm_setzero_si128 ();
+  __m128i lo, hi;
+  int offset;
+  int i;
+
+  if (d % 2 == 1)
+    offset = d / 2;
+  else
+    offset = (d - shift) / 2;
+
+  for (i = -d + offset; i < height + offset; i++)
+    {
+      if (i >= 0 && i < height)
+        {
+          load_row_sse2 (src + i * STRIP_WIDTH, &lo, &hi);
+          sum_lo = _mm_add_epi32 (sum_lo, lo);
+          sum_hi = _mm_add_epi32 (sum_hi, hi);
+        }
+
+      if (i >= offset)
+        {
+          if (i >= d)
+            {
+              load_row_sse2 (src + (i - d) * STRIP_WIDTH, &lo, &hi);
+              sum_lo = _mm_sub_epi32 (sum_lo, lo);
+              sum_hi = _mm_sub_epi32 (sum_hi, hi);
+            }
+
+          lo = divide_sse2 (_mm_add_epi32 (sum_lo, half), df, inv_d);
+          hi = divide_sse2 (_mm_add_epi32 (sum_hi, half), df, inv_d);
+          lo = _mm_packs_epi32 (lo, hi);
+          _mm_storel_epi64 ((__m128i *) (dst + (i - offset) * STRIP_WIDTH),
+                            _mm_packus_epi16 (lo, lo));
+        }
+    }
+}
+
+static inline __m256i __attribute__ ((target ("avx2")))
+divide_avx2 (__m256i n,
+             __m256  d,
+             __m256  inv_d)
+{
+  __m256 nf = _mm256_cvtepi32_ps (n);
+  __m256i q = _mm256_cvttps_epi32 (_mm256_mul_ps (nf, inv_d));
+  __m256 qf = _mm256_cvtepi32_ps (q);
+
+  q = _mm256_sub_epi32 (q, _mm256_castps_si256 (_mm256_cmp_ps (_mm256_mul_ps (_mm256_add_ps (qf, _mm256_set1_ps (1)), d), nf, _CMP_LE_OQ)));
+  q = _mm256_add_epi32 (q, _mm256_castps_si256 (_mm256_cmp_ps (_mm256_mul_ps (qf, d), nf, _CMP_GT_OQ)));
+
+  return q;
+}
+
+static inline __m256i __attribute__ ((target ("avx2")))
+load_row_avx2 (const guchar *row)
+{
+  return _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i *) row));
+}
+
+static void __attribute__ ((target ("avx2")))
+blur_strip_avx2 (const guchar *src,
+                 guchar       *dst,
+                 int           height,
+                 int           d,
+                 int           shift)
+{
+  __m256 df = _mm256_set1_ps (d);
+  __m256 inv_d = _mm256_set1_ps (1.0f / d);
+  __m256i half = _mm256_set1_epi32 (d / 2);
+  __m256i sum = _mm256_setzero_si256 ();
+  __m256i q;
+  __m128i packed;
+  int offset;
+  int i;
+
+  if (d % 2 == 1)
+    offset = d / 2;
+  else
+    offset = (d - shift) / 2;
+
+  for (i = -d + offset; i < height + offset; i++)
+    {
+      if (i >= 0 && i < height)
+        sum = _mm256_add_epi32 (sum, load_row_avx2 (src + i * STRIP_WIDTH));
+
+      if (i >= offset)
+        {
+          if (i >= d)
+            sum = _mm256_sub_epi32 (sum, load_row_avx2 (src + (i - d) * STRIP_WIDTH));
+
+          q = divide_avx2 (_mm256_add_epi32 (sum, half), df, inv_d);
+          packed = _mm_packs_epi32 (_mm256_castsi256_si128 (q), _mm256_extracti128_si256 (q, 1));
+          _mm_storel_epi64 ((__m128i *) (dst + (i - offset) * STRIP_WIDTH),
+                            _mm_packus_epi16 (packed, packed));
+        }
+    }
+}
+
+#endif /* HAVE_X86_INTRINSICS */
+
+static BlurStripFunc
+get_blur_strip_func (void)
+{
+  static BlurStripFunc strip_func = NULL;
+
+  if (g_once_init_enter (&strip_func))
+    {
+      BlurStripFunc func = blur_strip_scalar;
+
+#ifdef HAVE_X86_INTRINSICS
+      if (__builtin_cpu_supports ("avx2"))
+        func = blur_strip_avx2;
+      else if (__builtin_cpu_supports ("sse2"))
+        func = blur_strip_sse2;
+#endif
+
+      g_once_init_leave (&strip_func, func);
+    }
+
+  return strip_func;
+}
+
+typedef struct {
+  GMutex lock;
+  GCond cond;
+  int n_pending;
+} BlurColumnsGroup;
+
+typedef struct {
+  BlurColumnsGroup *group;
+  guchar *buffer;
+  int width;
+  int height;
+  int d;
+  int first_strip;
+  int last_strip;
+} BlurColumnsJob;
+
+static void
+blur_columns (BlurColumnsJob *job)
+{
+  BlurStripFunc blur_strip = get_blur_strip_func ();
+  guchar *strip, *tmp_strip;
+  int s, x, y, n;
+
+  strip = g_malloc0 (job->height * STRIP_WIDTH);
+  tmp_strip = g_malloc (job->height * STRIP_WIDTH);
+
+  for (s = job->first_strip; s < job->last_strip; s++)
+    {
+      x = s * STRIP_WIDTH;
+      n = MIN (STRIP_WIDTH, job->width - x);
+
+      for (y = 0; y < job->height; y++)
+        memcpy (strip + y * STRIP_WIDTH, job->buffer + y * job->width + x, n);
+
+      /* See blur_rows() for why even sizes use 3 different passes */
+      if (job->d % 2 == 1)
+        {
+          blur_strip (strip, tmp_strip, job->height, job->d, 0);
+          blur_strip (tmp_strip, strip, job->height, job->d, 0);
+          blur_strip (strip, tmp_strip, job->height, job->d, 0);
+        }
+      else
+        {
+          blur_strip (strip, tmp_strip, job->height, job->d, 1);
+          blur_strip (tmp_strip, strip, job->height, job->d, -1);
+          blur_strip (strip, tmp_strip, job->height, job->d + 1, 0);
+        }
+
+      for (y = 0; y < job->height; y++)
+        memcpy (job->buffer + y * job->width + x, tmp_strip + y * STRIP_WIDTH, n);
+    }
+
+  g_free (tmp_strip);
+  g_free (strip);
+}
+
+static void
+blur_columns_worker (gpointer data,
+                     gpointer user_data)
+{
+  BlurColumnsJob *job = data;
+  BlurColumnsGroup *group = job->group;
+
+  blur_columns (job);
+
+  g_mutex_lock (&group->lock);
+  group->n_pending--;
+  if (group->n_pending == 0)
+    g_cond_signal (&group->cond);
+  g_mutex_unlock (&group->lock);
+}
+
+/* The workers are shared by all blurs and kept around, so that large
+ * blurs don't pay for creating threads. The calling thread takes part
+ * in every blur, so the pool has one thread less than there are
+ * processors.
+ */
+static GThreadPool *
+get_blur_pool (void)
+{
+  static GThreadPool *pool = NULL;
+
+  if (g_once_init_enter (&pool))
+    g_once_init_leave (&pool, g_thread_pool_new (blur_columns_worker,
+                                                  NULL,
+                                                  g_get_num_processors () - 1,
+                                                  TRUE,
+                                                  NULL));
+
+  return pool;
+}
+
+/* Blurs all columns of the buffer, splitting them between threads
+ * for large buffers.
+ */
+static void
+blur_columns_parallel (guchar *buffer,
+                       int     width,
+                       int     height,
+                       int     d)
+{
+  BlurColumnsGroup group;
+  BlurColumnsJob *jobs;
+  int n_strips, n_jobs;
+  int i;
+
+  n_strips = (width + STRIP_WIDTH - 1) / STRIP_WIDTH;
+  if (width * height > PARALLEL_THRESHOLD)
+    n_jobs = MIN (g_get_num_processors (), n_strips);
+  else
+    n_jobs = 1;
+
+  jobs = g_newa (BlurColumnsJob, n_jobs);
+
+  for (i = 0; i < n_jobs; i++)
+    {
+      jobs[i].group = &group;
+      jobs[i].buffer = buffer;
+      jobs[i].width = width;
+      jobs[i].height = height;
+      jobs[i].d = d;
+      jobs[i].first_strip = n_strips * i / n_jobs;
+      jobs[i].last_strip = n_strips * (i + 1) / n_jobs;
+    }
+
+  if (n_jobs == 1)
+    {
+      blur_columns (&jobs[0]);
+      return;
+    }
+
+  g_mutex_init (&group.lock);
+  g_cond_init (&group.cond);
+  group.n_pending = n_jobs - 1;
+
+  for (i = 1; i < n_jobs; i++)
+    g_thread_pool_push (get_blur_pool (), &jobs[i], NULL);
+
+  blur_columns (&jobs[0]);
+
+  g_mutex_lock (&group.lock);
+  while (group.n_pending > 0)
+    g_cond_wait (&group.cond, &group.lock);
+  g_mutex_unlock (&group.lock);
+
+  g_cond_clear (&group.cond);
+  g_mutex_clear (&group.lock);
+}
+
+static void
+_boxblur_accelerated (guchar      *buffer,
+                      int          width,
+                      int          height,
+                      int          radius,
+                      GskBlurFlags flags)
+{
+  int d = get_box_filter_size (radius);
+
+  if (flags & GSK_BLUR_Y)
+    blur_columns_parallel (buffer, width, height, d);
+
+  if (flags & GSK_BLUR_X)
+    {
+      guchar *flipped_buffer = g_malloc (width * height);
+
+      flip_buffer (flipped_buffer, buffer, width, height);
+      blur_columns_parallel (flipped_buffer, height, width, d);
+      flip_buffer (buffer, flipped_buffer, height, width);
+
+      g_free (flipped_buffer);
+    }
+}
+
 /*
  * _gsk_cairo_blur_surface:
  * @surface: a cairo image surface.
@@ -247,15 +650,37 @@ gsk_cairo_blur_surface (cairo_surface_t* surface,
   /* Before we mess with the surface, execute any pending drawing. */
   cairo_surface_flush (surface);
 
-  _boxblur (cairo_image_surface_get_data (surface),
-            cairo_image_surface_get_stride (surface),
-            cairo_image_surface_get_height (surface),
-            radius, flags);
+  /* The vector kernels compute sums with floats, which are only exact
+   * for box sizes that keep them below 2^24 */
+  if (blur_accelerated && get_box_filter_size (radius) < 65536)
+    _boxblur_accelerated (cairo_image_surface_get_data (surface),
+                          cairo_image_surface_get_stride (surface),
+                          cairo_image_surface_get_height (surface),
+                          radius, flags);
+  else
+    _boxblur (cairo_image_surface_get_data (surface),
+              cairo_image_surface_get_stride (surface),
+              cairo_image_surface_get_height (surface),
+              radius, flags);
 
   /* Inform cairo we altered the surface contents. */
   cairo_surface_mark_dirty (surface);
 }
 
+/*<private>
+ * gsk_cairo_blur_set_accelerated:
+ * @accelerated: whether to use the accelerated blur
+ *
+ * Selects whether gsk_cairo_blur_surface() uses the vectorized and
+ * multithreaded kernels, or the original scalar ones. The result is
+ * the same either way; this exists for benchmarking.
+ */
+void
+gsk_cairo_blur_set_accelerated (gboolean accelerated)
+{
+  blur_accelerated = accelerated;
+}
+
 /*<private>
  * gsk_cairo_blur_compute_pixels:
  * @radius: the radius to compute the pixels for
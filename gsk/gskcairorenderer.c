@@ -5,23 +5,58 @@
 #include "gskdebugprivate.h"
 #include "gskrendererprivate.h"
 #include "gskrendernodeprivate.h"
+#include "gskcairoblurprivate.h"
 #include "gdk/gdktextureprivate.h"
 
+#include <math.h>
+
+/* Size of the tiles, in application pixels, that the damage region
+ * is split into when rendering with multiple threads.
+ */
+#define TILE_SIZE 128
+
 #ifdef G_ENABLE_DEBUG
 typedef struct {
   GQuark cpu_time;
   GQuark gpu_time;
 } ProfileTimers;
+
+typedef struct {
+  GQuark n_tiles;
+} ProfileCounters;
 #endif
 
+typedef struct {
+  GskRenderNode *root;
+  const cairo_region_t *region;
+  cairo_matrix_t ctm;
+  double x_scale;
+  double y_scale;
+  int padding;
+
+  GMutex lock;
+  GCond cond;
+  guint n_pending;
+} TileFrame;
+
+typedef struct {
+  TileFrame *frame;
+  cairo_rectangle_int_t area;
+  cairo_surface_t *surface;
+} Tile;
+
 struct _GskCairoRenderer
 {
   GskRenderer parent_instance;
 
   GdkCairoContext *cairo_context;
 
+  /* Only set if GSK_CAIRO_THREADS asks for more than one thread */
+  GThreadPool *tile_pool;
+
 #ifdef G_ENABLE_DEBUG
   ProfileTimers profile_timers;
+  ProfileCounters profile_counters;
 #endif
 };
 
@@ -52,13 +87,293 @@ gsk_cairo_renderer_unrealize (GskRenderer *renderer)
   g_clear_object (&self->cairo_context);
 }
 
+/* Computes how far a tile needs to be extended so that nodes reading
+ * back the contents of their surroundings - blurs and shadows - produce
+ * the same pixels inside the tile as they would when rendering the whole
+ * region at once.
+ *
+ * As a side effect this makes sure lazily created state of @node is
+ * initialized, so that drawing it from worker threads does not race.
+ *
+ * Returns: the padding in application pixels, or -1 if @node cannot be
+ *     drawn from a worker thread
+ */
+static int
+gsk_cairo_renderer_prepare_node (GskRenderNode *node)
+{
+  int padding, child_padding;
+  guint i;
+
+  switch (gsk_render_node_get_node_type (node))
+    {
+    case GSK_COLOR_NODE:
+    case GSK_LINEAR_GRADIENT_NODE:
+    case GSK_REPEATING_LINEAR_GRADIENT_NODE:
+    case GSK_BORDER_NODE:
+    case GSK_INSET_SHADOW_NODE:
+    case GSK_OUTSET_SHADOW_NODE:
+      return 0;
+
+    case GSK_TEXTURE_NODE:
+      /* Other textures may need to download from the GPU, which needs
+       * their GL context to be current */
+      if (!GDK_IS_MEMORY_TEXTURE (gsk_texture_node_get_texture (node)))
+        return -1;
+      return 0;
+
+    case GSK_TEXT_NODE:
+      /* Pango creates the scaled font on first use */
+      pango_cairo_font_get_scaled_font (PANGO_CAIRO_FONT ((PangoFont *) gsk_text_node_peek_font (node)));
+      return 0;
+
+    case GSK_CAIRO_NODE:
+      {
+        cairo_surface_t *surface = (cairo_surface_t *) gsk_cairo_node_peek_surface (node);
+
+        /* Recording surfaces build their spatial index on the first
+         * clipped replay, so do that replay here */
+        if (surface != NULL &&
+            cairo_surface_get_type (surface) == CAIRO_SURFACE_TYPE_RECORDING)
+          {
+            cairo_surface_t *scratch;
+            cairo_t *cr;
+
+            scratch = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 1, 1);
+            cr = cairo_create (scratch);
+            cairo_set_source_surface (cr, surface, 0, 0);
+            cairo_paint (cr);
+            cairo_destroy (cr);
+            cairo_surface_destroy (scratch);
+          }
+      }
+      return 0;
+
+    case GSK_CONTAINER_NODE:
+      padding = 0;
+      for (i = 0; i < gsk_container_node_get_n_children (node); i++)
+        {
+          child_padding = gsk_cairo_renderer_prepare_node (gsk_container_node_get_child (node, i));
+          if (child_padding < 0)
+            return -1;
+          padding = MAX (padding, child_padding);
+        }
+      return padding;
+
+    case GSK_TRANSFORM_NODE:
+      {
+        const graphene_matrix_t *transform = gsk_transform_node_peek_transform (node);
+        double xx, yx, xy, yy, dx, dy;
+
+        child_padding = gsk_cairo_renderer_prepare_node (gsk_transform_node_get_child (node));
+        if (child_padding <= 0)
+          return child_padding;
+
+        if (!graphene_matrix_to_2d (transform, &xx, &yx, &xy, &yy, &dx, &dy))
+          return -1;
+
+        return ceil (child_padding * MAX (fabs (xx) + fabs (xy), fabs (yx) + fabs (yy)));
+      }
+
+    case GSK_OFFSET_NODE:
+      return gsk_cairo_renderer_prepare_node (gsk_offset_node_get_child (node));
+
+    case GSK_DEBUG_NODE:
+      return gsk_cairo_renderer_prepare_node (gsk_debug_node_get_child (node));
+
+    case GSK_OPACITY_NODE:
+      return gsk_cairo_renderer_prepare_node (gsk_opacity_node_get_child (node));
+
+    case GSK_COLOR_MATRIX_NODE:
+      return gsk_cairo_renderer_prepare_node (gsk_color_matrix_node_get_child (node));
+
+    case GSK_CLIP_NODE:
+      return gsk_cairo_renderer_prepare_node (gsk_clip_node_get_child (node));
+
+    case GSK_ROUNDED_CLIP_NODE:
+      return gsk_cairo_renderer_prepare_node (gsk_rounded_clip_node_get_child (node));
+
+    case GSK_REPEAT_NODE:
+      /* The child is drawn unclipped into its own surface */
+      if (gsk_cairo_renderer_prepare_node (gsk_repeat_node_get_child (node)) < 0)
+        return -1;
+      return 0;
+
+    case GSK_BLEND_NODE:
+      padding = gsk_cairo_renderer_prepare_node (gsk_blend_node_get_bottom_child (node));
+      child_padding = gsk_cairo_renderer_prepare_node (gsk_blend_node_get_top_child (node));
+      if (padding < 0 || child_padding < 0)
+        return -1;
+      return MAX (padding, child_padding);
+
+    case GSK_CROSS_FADE_NODE:
+      padding = gsk_cairo_renderer_prepare_node (gsk_cross_fade_node_get_start_child (node));
+      child_padding = gsk_cairo_renderer_prepare_node (gsk_cross_fade_node_get_end_child (node));
+      if (padding < 0 || child_padding < 0)
+        return -1;
+      return MAX (padding, child_padding);
+
+    case GSK_SHADOW_NODE:
+      child_padding = gsk_cairo_renderer_prepare_node (gsk_shadow_node_get_child (node));
+      if (child_padding < 0)
+        return -1;
+      padding = 0;
+      for (i = 0; i < gsk_shadow_node_get_n_shadows (node); i++)
+        {
+          const GskShadow *shadow = gsk_shadow_node_peek_shadow (node, i);
+
+          padding = MAX (padding,
+                         ceil (MAX (fabs (shadow->dx), fabs (shadow->dy))) +
+                         gsk_cairo_blur_compute_pixels (shadow->radius));
+        }
+      return padding + child_padding;
+
+    case GSK_BLUR_NODE:
+      child_padding = gsk_cairo_renderer_prepare_node (gsk_blur_node_get_child (node));
+      if (child_padding < 0)
+        return -1;
+      /* The blur node does 3 box blur passes of the given radius */
+      return child_padding + 3 * (int) gsk_blur_node_get_radius (node);
+
+    case GSK_NOT_A_RENDER_NODE:
+    default:
+      return -1;
+    }
+}
+
 static void
-gsk_cairo_renderer_do_render (GskRenderer   *renderer,
-                              cairo_t       *cr,
-                              GskRenderNode *root)
+gsk_cairo_renderer_render_tile (gpointer data,
+                                gpointer user_data)
+{
+  Tile *tile = data;
+  TileFrame *frame = tile->frame;
+  int padding = frame->padding;
+  cairo_t *cr;
+
+  tile->surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                              ceil ((tile->area.width + 2 * padding) * frame->x_scale),
+                                              ceil ((tile->area.height + 2 * padding) * frame->y_scale));
+  cairo_surface_set_device_scale (tile->surface, frame->x_scale, frame->y_scale);
+  cairo_surface_set_device_offset (tile->surface,
+                                   - (tile->area.x - padding) * frame->x_scale,
+                                   - (tile->area.y - padding) * frame->y_scale);
+
+  cr = cairo_create (tile->surface);
+  gdk_cairo_region (cr, frame->region);
+  cairo_clip (cr);
+  cairo_set_matrix (cr, &frame->ctm);
+
+  gsk_render_node_draw (frame->root, cr);
+
+  cairo_destroy (cr);
+
+  g_mutex_lock (&frame->lock);
+  frame->n_pending--;
+  if (frame->n_pending == 0)
+    g_cond_signal (&frame->cond);
+  g_mutex_unlock (&frame->lock);
+}
+
+/* Renders @root by splitting @region - given in device-independent
+ * coordinates of the target of @cr - into tiles that are drawn in
+ * parallel by the tile pool and then copied into @cr.
+ *
+ * The target of @cr must be cleared inside @region.
+ *
+ * Returns: %FALSE if @root cannot be rendered in tiles, in which case
+ *     nothing has been drawn
+ */
+static gboolean
+gsk_cairo_renderer_do_render_tiled (GskCairoRenderer     *self,
+                                    cairo_t              *cr,
+                                    GskRenderNode        *root,
+                                    const cairo_region_t *region)
 {
+  cairo_rectangle_int_t extents;
+  TileFrame frame;
+  GArray *tiles;
+  int x, y;
+  guint i;
+
+  frame.padding = gsk_cairo_renderer_prepare_node (root);
+  if (frame.padding < 0)
+    return FALSE;
+
+  frame.root = root;
+  frame.region = region;
+  cairo_get_matrix (cr, &frame.ctm);
+  frame.x_scale = frame.y_scale = 1;
+  cairo_surface_get_device_scale (cairo_get_target (cr), &frame.x_scale, &frame.y_scale);
+  g_mutex_init (&frame.lock);
+  g_cond_init (&frame.cond);
+
+  tiles = g_array_new (FALSE, FALSE, sizeof (Tile));
+  cairo_region_get_extents (region, &extents);
+  for (y = extents.y; y < extents.y + extents.height; y += TILE_SIZE)
+    for (x = extents.x; x < extents.x + extents.width; x += TILE_SIZE)
+      {
+        Tile tile = { &frame, { x, y,
+                                MIN (TILE_SIZE, extents.x + extents.width - x),
+                                MIN (TILE_SIZE, extents.y + extents.height - y) },
+                      NULL };
+
+        if (cairo_region_contains_rectangle (region, &tile.area) == CAIRO_REGION_OVERLAP_OUT)
+          continue;
+
+        g_array_append_val (tiles, tile);
+      }
+
+  /* The array must not be resized anymore, the workers point into it */
+  frame.n_pending = tiles->len;
+  for (i = 0; i < tiles->len; i++)
+    g_thread_pool_push (self->tile_pool, &g_array_index (tiles, Tile, i), NULL);
+
+  g_mutex_lock (&frame.lock);
+  while (frame.n_pending > 0)
+    g_cond_wait (&frame.cond, &frame.lock);
+  g_mutex_unlock (&frame.lock);
+
+  cairo_save (cr);
+  cairo_identity_matrix (cr);
+  cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+
+  for (i = 0; i < tiles->len; i++)
+    {
+      Tile *tile = &g_array_index (tiles, Tile, i);
+
+      cairo_save (cr);
+      cairo_rectangle (cr, tile->area.x, tile->area.y, tile->area.width, tile->area.height);
+      cairo_clip (cr);
+      cairo_set_source_surface (cr, tile->surface, 0, 0);
+      cairo_pattern_set_filter (cairo_get_source (cr), CAIRO_FILTER_NEAREST);
+      cairo_paint (cr);
+      cairo_restore (cr);
+
+      cairo_surface_destroy (tile->surface);
+    }
+
+  cairo_restore (cr);
+
 #ifdef G_ENABLE_DEBUG
+  gsk_profiler_counter_set (gsk_renderer_get_profiler (GSK_RENDERER (self)),
+                            self->profile_counters.n_tiles,
+                            tiles->len);
+#endif
+
+  g_array_free (tiles, TRUE);
+  g_cond_clear (&frame.cond);
+  g_mutex_clear (&frame.lock);
+
+  return TRUE;
+}
+
+static void
+gsk_cairo_renderer_do_render (GskRenderer          *renderer,
+                              cairo_t              *cr,
+                              GskRenderNode        *root,
+                              const cairo_region_t *region)
+{
   GskCairoRenderer *self = GSK_CAIRO_RENDERER (renderer);
+#ifdef G_ENABLE_DEBUG
   GskProfiler *profiler;
   gint64 cpu_time;
 #endif
@@ -68,7 +383,10 @@ gsk_cairo_renderer_do_render (GskRenderer   *renderer,
   gsk_profiler_timer_begin (profiler, self->profile_timers.cpu_time);
 #endif
 
-  gsk_render_node_draw (root, cr);
+  if (self->tile_pool == NULL ||
+      GSK_RENDERER_DEBUG_CHECK (renderer, GEOMETRY) ||
+      !gsk_cairo_renderer_do_render_tiled (self, cr, root, region))
+    gsk_render_node_draw (root, cr);
 
 #ifdef G_ENABLE_DEBUG
   cpu_time = gsk_profiler_timer_end (profiler, self->profile_timers.cpu_time);
@@ -85,14 +403,21 @@ gsk_cairo_renderer_render_texture (GskRenderer           *renderer,
 {
   GdkTexture *texture;
   cairo_surface_t *surface;
+  cairo_region_t *region;
   cairo_t *cr;
+  int width, height;
 
-  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, ceil (viewport->size.width), ceil (viewport->size.height));
+  width = ceil (viewport->size.width);
+  height = ceil (viewport->size.height);
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
   cr = cairo_create (surface);
 
   cairo_translate (cr, - viewport->origin.x, - viewport->origin.y);
 
-  gsk_cairo_renderer_do_render (renderer, cr, root);
+  region = cairo_region_create_rectangle (&(cairo_rectangle_int_t) { 0, 0, width, height });
+  gsk_cairo_renderer_do_render (renderer, cr, root, region);
+  cairo_region_destroy (region);
 
   cairo_destroy (cr);
 
@@ -132,18 +457,33 @@ gsk_cairo_renderer_render (GskRenderer          *renderer,
     }
 #endif
 
-  gsk_cairo_renderer_do_render (renderer, cr, root);
+  gsk_cairo_renderer_do_render (renderer, cr, root,
+                                gdk_draw_context_get_frame_region (GDK_DRAW_CONTEXT (self->cairo_context)));
 
   cairo_destroy (cr);
 
   gdk_draw_context_end_frame (GDK_DRAW_CONTEXT (self->cairo_context));
 }
 
+static void
+gsk_cairo_renderer_finalize (GObject *gobject)
+{
+  GskCairoRenderer *self = GSK_CAIRO_RENDERER (gobject);
+
+  if (self->tile_pool)
+    g_thread_pool_free (self->tile_pool, TRUE, TRUE);
+
+  G_OBJECT_CLASS (gsk_cairo_renderer_parent_class)->finalize (gobject);
+}
+
 static void
 gsk_cairo_renderer_class_init (GskCairoRendererClass *klass)
 {
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GskRendererClass *renderer_class = GSK_RENDERER_CLASS (klass);
 
+  gobject_class->finalize = gsk_cairo_renderer_finalize;
+
   renderer_class->realize = gsk_cairo_renderer_realize;
   renderer_class->unrealize = gsk_cairo_renderer_unrealize;
   renderer_class->render = gsk_cairo_renderer_render;
@@ -153,9 +493,29 @@ gsk_cairo_renderer_class_init (GskCairoRendererClass *klass)
 static void
 gsk_cairo_renderer_init (GskCairoRenderer *self)
 {
+  const char *env;
 #ifdef G_ENABLE_DEBUG
   GskProfiler *profiler = gsk_renderer_get_profiler (GSK_RENDERER (self));
 
   self->profile_timers.cpu_time = gsk_profiler_add_timer (profiler, "cpu-time", "CPU time", FALSE, TRUE);
+  self->profile_counters.n_tiles = gsk_profiler_add_counter (profiler, "tiles", "Tiles rendered", TRUE);
 #endif
+
+  env = g_getenv ("GSK_CAIRO_THREADS");
+  if (env != NULL)
+    {
+      guint n_threads;
+
+      if (g_ascii_strcasecmp (env, "auto") == 0)
+        n_threads = g_get_num_processors ();
+      else
+        n_threads = g_ascii_strtoull (env, NULL, 10);
+
+      if (n_threads > 1)
+        self->tile_pool = g_thread_pool_new (gsk_cairo_renderer_render_tile,
+                                             NULL,
+                                             n_threads,
+                                             FALSE,
+                                             NULL);
+    }
 }
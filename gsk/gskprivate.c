@@ -1,6 +1,8 @@
 #include "gskresources.h"
 #include "gskprivate.h"
 
+#include <math.h>
+
 static gpointer
 register_resources (gpointer data)
 {
@@ -35,3 +37,29 @@ pango_glyph_string_num_glyphs (PangoGlyphString *glyphs)
   return count;
 }
 
+
+/*
+ * gsk_glyph_snap_x:
+ * @x: the x position of a glyph origin, in user space
+ * @scale: the scale the glyph is drawn at
+ * @out_xshift: (out): return location for the subpixel position
+ *
+ * Rounds @x to the nearest 1/GSK_SUBPIXEL_POSITIONS of a device pixel,
+ * and splits the result into a whole device pixel and a subpixel offset.
+ * Glyphs are rasterized shifted right by @out_xshift / GSK_SUBPIXEL_POSITIONS
+ * pixels, and drawn at the returned position.
+ *
+ * Returns: @x rounded down to a whole device pixel, in user space
+ */
+float
+gsk_glyph_snap_x (float  x,
+                  float  scale,
+                  guint *out_xshift)
+{
+  float quantized = floorf (x * scale * GSK_SUBPIXEL_POSITIONS + 0.5f);
+  float pixel = floorf (quantized / GSK_SUBPIXEL_POSITIONS);
+
+  *out_xshift = (guint) (quantized - pixel * GSK_SUBPIXEL_POSITIONS);
+
+  return pixel / scale;
+}
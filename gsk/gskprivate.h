@@ -10,6 +10,13 @@ void gsk_ensure_resources (void);
 
 int pango_glyph_string_num_glyphs (PangoGlyphString *glyphs);
 
+/* Number of horizontal subpixel positions glyphs are cached for */
+#define GSK_SUBPIXEL_POSITIONS 4
+
+float gsk_glyph_snap_x (float  x,
+                        float  scale,
+                        guint *out_xshift);
+
 typedef struct _GskVulkanRender GskVulkanRender;
 typedef struct _GskVulkanRenderPass GskVulkanRenderPass;
 
@@ -513,3 +513,45 @@ gsk_profiler_append_timers (GskProfiler *profiler,
       g_string_append (buffer, "\n");
     }
 }
+
+void
+gsk_profiler_foreach_counter (GskProfiler     *profiler,
+                              GskProfilerFunc  func,
+                              gpointer         user_data)
+{
+  GHashTableIter iter;
+  gpointer value_p = NULL;
+
+  g_return_if_fail (GSK_IS_PROFILER (profiler));
+  g_return_if_fail (func != NULL);
+
+  g_hash_table_iter_init (&iter, profiler->counters);
+  while (g_hash_table_iter_next (&iter, NULL, &value_p))
+    {
+      NamedCounter *counter = value_p;
+
+      func (g_quark_to_string (counter->id), counter->description, counter->value, user_data);
+    }
+}
+
+/* Reports the last value of every timer, see gsk_profiler_timer_get() */
+void
+gsk_profiler_foreach_timer (GskProfiler     *profiler,
+                            GskProfilerFunc  func,
+                            gpointer         user_data)
+{
+  GHashTableIter iter;
+  gpointer value_p = NULL;
+
+  g_return_if_fail (GSK_IS_PROFILER (profiler));
+  g_return_if_fail (func != NULL);
+
+  g_hash_table_iter_init (&iter, profiler->timers);
+  while (g_hash_table_iter_next (&iter, NULL, &value_p))
+    {
+      NamedTimer *timer = value_p;
+
+      func (g_quark_to_string (timer->id), timer->description,
+            gsk_profiler_timer_get (profiler, timer->id), user_data);
+    }
+}
@@ -1,7 +1,7 @@
 #ifndef __GSK_PROFILER_PRIVATE_H__
 #define __GSK_PROFILER_PRIVATE_H__
 
-#include <glib-object.h>
+#include <gdk/gdk.h>
 
 G_BEGIN_DECLS
 
@@ -49,6 +49,18 @@ void            gsk_profiler_append_counters    (GskProfiler *profiler,
 void            gsk_profiler_append_timers      (GskProfiler *profiler,
                                                  GString     *buffer);
 
+typedef void (* GskProfilerFunc) (const char *name,
+                                  const char *description,
+                                  gint64      value,
+                                  gpointer    user_data);
+
+void            gsk_profiler_foreach_counter    (GskProfiler     *profiler,
+                                                 GskProfilerFunc  func,
+                                                 gpointer         user_data);
+void            gsk_profiler_foreach_timer      (GskProfiler     *profiler,
+                                                 GskProfilerFunc  func,
+                                                 gpointer         user_data);
+
 G_END_DECLS
 
 #endif /* __GSK_PROFILER_PRIVATE_H__ */
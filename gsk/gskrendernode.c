@@ -42,6 +42,7 @@
 
 #include "gskdebugprivate.h"
 #include "gskrendererprivate.h"
+#include "gskrendernodeserializerprivate.h"
 
 #include <graphene-gobject.h>
 
@@ -184,6 +185,20 @@ gsk_render_node_draw (GskRenderNode *node,
   g_return_if_fail (cr != NULL);
   g_return_if_fail (cairo_status (cr) == CAIRO_STATUS_SUCCESS);
 
+  /* Skip nodes that are entirely outside the area being drawn, such
+   * as the parts of the tree not touching a tile or the damage region.
+   */
+  if (!GSK_DEBUG_CHECK (GEOMETRY))
+    {
+      double x1, y1, x2, y2;
+
+      cairo_clip_extents (cr, &x1, &y1, &x2, &y2);
+      if (!graphene_rect_intersection (&node->bounds,
+                                       &GRAPHENE_RECT_INIT (x1, y1, x2 - x1, y2 - y1),
+                                       NULL))
+        return;
+    }
+
   cairo_save (cr);
 
 #ifdef G_ENABLE_DEBUG
@@ -306,6 +321,8 @@ gsk_render_node_diff (GskRenderNode  *node1,
   return node1->node_class->diff (node1, node2, region);
 }
 
+/* The GVariant based format used before the binary one, still
+ * supported for loading */
 #define GSK_RENDER_NODE_SERIALIZATION_VERSION 0
 #define GSK_RENDER_NODE_SERIALIZATION_ID "GskRenderNode"
 
@@ -320,6 +337,8 @@ gsk_render_node_diff (GskRenderNode  *node1,
  * gsk_render_node_deserialize() will correctly reject files it cannot open
  * that were created with previous versions of GTK+.
  *
+ * Textures and fonts used by multiple nodes are only stored once.
+ *
  * The intended use of this functions is testing, benchmarking and debugging.
  * The format is not meant as a permanent storage format.
  *
@@ -328,23 +347,51 @@ gsk_render_node_diff (GskRenderNode  *node1,
 GBytes *
 gsk_render_node_serialize (GskRenderNode *node)
 {
-  GVariant *node_variant, *variant;
+  GOutputStream *stream;
   GBytes *result;
 
-  node_variant = gsk_render_node_serialize_node (node);
+  g_return_val_if_fail (GSK_IS_RENDER_NODE (node), NULL);
 
-  variant = g_variant_new ("(suuv)",
-                           GSK_RENDER_NODE_SERIALIZATION_ID,
-                           (guint32) GSK_RENDER_NODE_SERIALIZATION_VERSION,
-                           (guint32) gsk_render_node_get_node_type (node),
-                           node_variant);
+  stream = g_memory_output_stream_new_resizable ();
 
-  result = g_variant_get_data_as_bytes (variant);
-  g_variant_unref (variant);
+  if (!gsk_render_node_write_binary (node, stream, NULL, NULL))
+    g_assert_not_reached ();
+
+  g_output_stream_close (stream, NULL, NULL);
+  result = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (stream));
+  g_object_unref (stream);
 
   return result;
 }
 
+/**
+ * gsk_render_node_serialize_to_stream:
+ * @node: a #GskRenderNode
+ * @stream: the #GOutputStream to write to
+ * @cancellable: (allow-none): optional #GCancellable object, %NULL to ignore
+ * @error: Return location for a potential error
+ *
+ * Serializes the @node like gsk_render_node_serialize(), but writes
+ * the result to @stream as it is produced instead of collecting it
+ * in memory first.
+ *
+ * The @stream is not closed.
+ *
+ * Returns: %TRUE if writing was successful
+ **/
+gboolean
+gsk_render_node_serialize_to_stream (GskRenderNode  *node,
+                                     GOutputStream  *stream,
+                                     GCancellable   *cancellable,
+                                     GError        **error)
+{
+  g_return_val_if_fail (GSK_IS_RENDER_NODE (node), FALSE);
+  g_return_val_if_fail (G_IS_OUTPUT_STREAM (stream), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  return gsk_render_node_write_binary (node, stream, cancellable, error);
+}
+
 /**
  * gsk_render_node_write_to_file:
  * @node: a #GskRenderNode
@@ -352,8 +399,8 @@ gsk_render_node_serialize (GskRenderNode *node)
  * @error: Return location for a potential error
  *
  * This function is equivalent to calling gsk_render_node_serialize()
- * followed by g_file_set_contents(). See those two functions for details
- * on the arguments.
+ * followed by g_file_set_contents(), except that the data is streamed
+ * to the file. See those two functions for details on the arguments.
  *
  * It is mostly intended for use inside a debugger to quickly dump a render
  * node to a file for later inspection.
@@ -365,37 +412,33 @@ gsk_render_node_write_to_file (GskRenderNode *node,
                                const char    *filename,
                                GError       **error)
 {
-  GBytes *bytes;
+  GFile *file;
+  GFileOutputStream *stream;
   gboolean result;
 
   g_return_val_if_fail (GSK_IS_RENDER_NODE (node), FALSE);
   g_return_val_if_fail (filename != NULL, FALSE);
   g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-  bytes = gsk_render_node_serialize (node);
-  result = g_file_set_contents (filename,
-                                g_bytes_get_data (bytes, NULL),
-                                g_bytes_get_size (bytes),
-                                error);
-  g_bytes_unref (bytes);
+  file = g_file_new_for_path (filename);
+  stream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, error);
+  g_object_unref (file);
+
+  if (stream == NULL)
+    return FALSE;
+
+  result = gsk_render_node_write_binary (node, G_OUTPUT_STREAM (stream), NULL, error);
+  if (result)
+    result = g_output_stream_close (G_OUTPUT_STREAM (stream), NULL, error);
+
+  g_object_unref (stream);
 
   return result;
 }
 
-/**
- * gsk_render_node_deserialize:
- * @bytes: the bytes containing the data
- * @error: (allow-none): location to store error or %NULL
- *
- * Loads data previously created via gsk_render_node_serialize(). For a
- * discussion of the supported format, see that function.
- *
- * Returns: (nullable) (transfer full): a new #GskRenderNode or %NULL on
- *     error.
- **/
-GskRenderNode *
-gsk_render_node_deserialize (GBytes  *bytes,
-                             GError **error)
+static GskRenderNode *
+gsk_render_node_deserialize_variant (GBytes  *bytes,
+                                     GError **error)
 {
   char *id_string;
   guint32 version, node_type;
@@ -430,3 +473,101 @@ out:
   return node;
 }
 
+/**
+ * gsk_render_node_deserialize:
+ * @bytes: the bytes containing the data
+ * @error: (allow-none): location to store error or %NULL
+ *
+ * Loads data previously created via gsk_render_node_serialize(). For a
+ * discussion of the supported format, see that function.
+ *
+ * Returns: (nullable) (transfer full): a new #GskRenderNode or %NULL on
+ *     error.
+ **/
+GskRenderNode *
+gsk_render_node_deserialize (GBytes  *bytes,
+                             GError **error)
+{
+  GInputStream *stream;
+  GskRenderNode *node;
+  gsize size;
+  const guchar *data;
+
+  g_return_val_if_fail (bytes != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  data = g_bytes_get_data (bytes, &size);
+  if (!gsk_render_node_is_binary_data (data, size))
+    return gsk_render_node_deserialize_variant (bytes, error);
+
+  stream = g_memory_input_stream_new_from_bytes (bytes);
+  node = gsk_render_node_read_binary (stream, NULL, error);
+  g_object_unref (stream);
+
+  return node;
+}
+
+/**
+ * gsk_render_node_deserialize_from_stream:
+ * @stream: the #GInputStream to read from
+ * @cancellable: (allow-none): optional #GCancellable object, %NULL to ignore
+ * @error: (allow-none): location to store error or %NULL
+ *
+ * Loads data previously created via gsk_render_node_serialize() or
+ * gsk_render_node_serialize_to_stream() from @stream.
+ *
+ * Unlike gsk_render_node_deserialize(), the data is parsed while it is
+ * read, so large recordings can be loaded without keeping the whole
+ * file in memory.
+ *
+ * Returns: (nullable) (transfer full): a new #GskRenderNode or %NULL on
+ *     error.
+ **/
+GskRenderNode *
+gsk_render_node_deserialize_from_stream (GInputStream  *stream,
+                                         GCancellable  *cancellable,
+                                         GError       **error)
+{
+  GInputStream *buffered;
+  GOutputStream *memory;
+  GskRenderNode *node = NULL;
+  const guchar *data;
+  gsize size;
+  GBytes *bytes;
+
+  g_return_val_if_fail (G_IS_INPUT_STREAM (stream), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  buffered = g_buffered_input_stream_new (stream);
+  g_filter_input_stream_set_close_base_stream (G_FILTER_INPUT_STREAM (buffered), FALSE);
+
+  if (g_buffered_input_stream_fill (G_BUFFERED_INPUT_STREAM (buffered),
+                                    GSK_RENDER_NODE_BINARY_MAGIC_SIZE,
+                                    cancellable, error) < 0)
+    goto out;
+
+  data = g_buffered_input_stream_peek_buffer (G_BUFFERED_INPUT_STREAM (buffered), &size);
+  if (gsk_render_node_is_binary_data (data, size))
+    {
+      node = gsk_render_node_read_binary (buffered, cancellable, error);
+      goto out;
+    }
+
+  /* The old format needs all of the data */
+  memory = g_memory_output_stream_new_resizable ();
+  if (g_output_stream_splice (memory, buffered,
+                              G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+                              cancellable, error) >= 0)
+    {
+      bytes = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (memory));
+      node = gsk_render_node_deserialize_variant (bytes, error);
+      g_bytes_unref (bytes);
+    }
+  g_object_unref (memory);
+
+out:
+  g_object_unref (buffered);
+
+  return node;
+}
+
@@ -77,12 +77,21 @@ void                    gsk_render_node_draw                    (GskRenderNode *
 GDK_AVAILABLE_IN_ALL
 GBytes *                gsk_render_node_serialize               (GskRenderNode *node);
 GDK_AVAILABLE_IN_ALL
+gboolean                gsk_render_node_serialize_to_stream     (GskRenderNode *node,
+                                                                 GOutputStream *stream,
+                                                                 GCancellable  *cancellable,
+                                                                 GError       **error);
+GDK_AVAILABLE_IN_ALL
 gboolean                gsk_render_node_write_to_file           (GskRenderNode *node,
                                                                  const char    *filename,
                                                                  GError       **error);
 GDK_AVAILABLE_IN_ALL
 GskRenderNode *         gsk_render_node_deserialize             (GBytes        *bytes,
                                                                  GError       **error);
+GDK_AVAILABLE_IN_ALL
+GskRenderNode *         gsk_render_node_deserialize_from_stream (GInputStream  *stream,
+                                                                 GCancellable  *cancellable,
+                                                                 GError       **error);
 
 GDK_AVAILABLE_IN_ALL
 GskRenderNode *         gsk_debug_node_new                      (GskRenderNode            *child,
@@ -2422,6 +2422,57 @@ gsk_transform_node_draw (GskRenderNode *node,
     }
 }
 
+static gboolean
+gsk_matrix_equal (const graphene_matrix_t *a,
+                  const graphene_matrix_t *b)
+{
+  float fa[16], fb[16];
+
+  graphene_matrix_to_float (a, fa);
+  graphene_matrix_to_float (b, fb);
+
+  return memcmp (fa, fb, sizeof (fa)) == 0;
+}
+
+static void
+gsk_transform_node_diff (GskRenderNode  *node1,
+                         GskRenderNode  *node2,
+                         cairo_region_t *region)
+{
+  GskTransformNode *self1 = (GskTransformNode *) node1;
+  GskTransformNode *self2 = (GskTransformNode *) node2;
+  cairo_region_t *sub;
+  int i, n;
+
+  if (!gsk_matrix_equal (&self1->transform, &self2->transform))
+    {
+      gsk_render_node_diff_impossible (node1, node2, region);
+      return;
+    }
+
+  if (self1->child == self2->child)
+    return;
+
+  sub = cairo_region_create ();
+  gsk_render_node_diff (self1->child, self2->child, sub);
+
+  n = cairo_region_num_rectangles (sub);
+  for (i = 0; i < n; i++)
+    {
+      cairo_rectangle_int_t rect;
+      graphene_rect_t bounds;
+
+      cairo_region_get_rectangle (sub, i, &rect);
+      graphene_matrix_transform_bounds (&self1->transform,
+                                        &GRAPHENE_RECT_INIT (rect.x, rect.y, rect.width, rect.height),
+                                        &bounds);
+      rectangle_init_from_graphene (&rect, &bounds);
+      cairo_region_union_rectangle (region, &rect);
+    }
+
+  cairo_region_destroy (sub);
+}
+
 #define GSK_TRANSFORM_NODE_VARIANT_TYPE "(dddddddddddddddduv)"
 
 static GVariant *
@@ -2489,7 +2540,7 @@ static const GskRenderNodeClass GSK_TRANSFORM_NODE_CLASS = {
   gsk_transform_node_finalize,
   gsk_transform_node_draw,
   gsk_render_node_can_diff_true,
-  gsk_render_node_diff_impossible,
+  gsk_transform_node_diff,
   gsk_transform_node_serialize,
   gsk_transform_node_deserialize
 };
@@ -3194,6 +3245,21 @@ gsk_color_matrix_node_draw (GskRenderNode *node,
   cairo_pattern_destroy (pattern);
 }
 
+static void
+gsk_color_matrix_node_diff (GskRenderNode  *node1,
+                            GskRenderNode  *node2,
+                            cairo_region_t *region)
+{
+  GskColorMatrixNode *self1 = (GskColorMatrixNode *) node1;
+  GskColorMatrixNode *self2 = (GskColorMatrixNode *) node2;
+
+  if (gsk_matrix_equal (&self1->color_matrix, &self2->color_matrix) &&
+      graphene_vec4_equal (&self1->color_offset, &self2->color_offset))
+    gsk_render_node_diff (self1->child, self2->child, region);
+  else
+    gsk_render_node_diff_impossible (node1, node2, region);
+}
+
 #define GSK_COLOR_MATRIX_NODE_VARIANT_TYPE "(dddddddddddddddddddduv)"
 
 static GVariant *
@@ -3266,7 +3332,7 @@ static const GskRenderNodeClass GSK_COLOR_MATRIX_NODE_CLASS = {
   gsk_color_matrix_node_finalize,
   gsk_color_matrix_node_draw,
   gsk_render_node_can_diff_true,
-  gsk_render_node_diff_impossible,
+  gsk_color_matrix_node_diff,
   gsk_color_matrix_node_serialize,
   gsk_color_matrix_node_deserialize
 };
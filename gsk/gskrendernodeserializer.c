@@ -0,0 +1,1605 @@
+/* GSK - The GTK Scene Kit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The binary render node format.
+ *
+ * A file starts with an 8 byte magic and a 32bit version, followed by
+ * a sequence of chunks. Every chunk starts with a 16 byte header: the
+ * chunk type, flags and the size of the payload as 64bit number. All
+ * numbers are little endian.
+ *
+ * Images and fonts are stored once, in their own chunks, and are
+ * referenced by index from the nodes using them. They always precede
+ * the single NODE chunk, which contains the tree in pre-order. The file
+ * ends with an END chunk.
+ *
+ * Image chunks can be compressed with zlib. Readers skip chunks of
+ * unknown type, so new kinds of resources can be added without
+ * bumping the version.
+ *
+ * The reader never needs more than one image's worth of data at a
+ * time on top of the resulting tree, so multi-hundred megabyte
+ * recordings can be loaded from a stream.
+ */
+
+#include "config.h"
+
+#include "gskrendernodeserializerprivate.h"
+
+#include "gskrendernodeprivate.h"
+
+#include <pango/pangocairo.h>
+#include <string.h>
+
+#define GSK_RENDER_NODE_BINARY_VERSION 1
+
+static const guchar gsk_render_node_binary_magic[GSK_RENDER_NODE_BINARY_MAGIC_SIZE] = {
+  0x89, 'G', 'S', 'K', 'N', 'O', 'D', 'E'
+};
+
+#define CHUNK_TYPE(a,b,c,d) ((guint32) (a) | ((guint32) (b) << 8) | ((guint32) (c) << 16) | ((guint32) (d) << 24))
+
+enum {
+  CHUNK_IMAGE = CHUNK_TYPE ('I', 'M', 'G', ' '),
+  CHUNK_FONT  = CHUNK_TYPE ('F', 'O', 'N', 'T'),
+  CHUNK_NODE  = CHUNK_TYPE ('N', 'O', 'D', 'E'),
+  CHUNK_END   = CHUNK_TYPE ('E', 'N', 'D', ' ')
+};
+
+enum {
+  CHUNK_FLAG_COMPRESSED = 1 << 0
+};
+
+#define CHUNK_HEADER_SIZE 16
+
+/* Size of the id, width and height preceding the pixels of an image */
+#define IMAGE_HEADER_SIZE 12
+
+/* Images smaller than this are not worth compressing */
+#define COMPRESSION_THRESHOLD 1024
+
+/* Nodes are read recursively, so crafted files must not be able to
+ * nest them deep enough to overflow the stack */
+#define MAX_NODE_DEPTH 1024
+
+gboolean
+gsk_render_node_is_binary_data (const guchar *data,
+                                gsize         size)
+{
+  return size >= GSK_RENDER_NODE_BINARY_MAGIC_SIZE &&
+         memcmp (data, gsk_render_node_binary_magic, GSK_RENDER_NODE_BINARY_MAGIC_SIZE) == 0;
+}
+
+/* {{{ Writer */
+
+typedef struct
+{
+  GOutputStream *stream;
+  GCancellable *cancellable;
+  GError *error;
+
+  /* GdkTexture => index + 1 */
+  GHashTable *textures;
+  /* GskSurfaceKey => index + 1 */
+  GHashTable *surfaces;
+  guint n_images;
+  /* font description string => index + 1 */
+  GHashTable *fonts;
+  guint n_fonts;
+
+  GByteArray *nodes;
+} GskNodeWriter;
+
+/* Only the part of a surface inside the node bounds is written,
+ * so the same surface may be needed with different bounds */
+typedef struct
+{
+  cairo_surface_t *surface;
+  cairo_rectangle_int_t area;
+} GskSurfaceKey;
+
+static guint
+gsk_surface_key_hash (gconstpointer data)
+{
+  const GskSurfaceKey *key = data;
+
+  return g_direct_hash (key->surface) ^
+         ((guint) key->area.x << 24) ^ ((guint) key->area.y << 16) ^
+         ((guint) key->area.width << 8) ^ (guint) key->area.height;
+}
+
+static gboolean
+gsk_surface_key_equal (gconstpointer a,
+                       gconstpointer b)
+{
+  const GskSurfaceKey *key_a = a;
+  const GskSurfaceKey *key_b = b;
+
+  return key_a->surface == key_b->surface &&
+         key_a->area.x == key_b->area.x &&
+         key_a->area.y == key_b->area.y &&
+         key_a->area.width == key_b->area.width &&
+         key_a->area.height == key_b->area.height;
+}
+
+static void
+append_u32 (GByteArray *array,
+            guint32     value)
+{
+  value = GUINT32_TO_LE (value);
+  g_byte_array_append (array, (guchar *) &value, sizeof (value));
+}
+
+static void
+append_float (GByteArray *array,
+              float       value)
+{
+  union { float f; guint32 u; } bits = { value };
+
+  append_u32 (array, bits.u);
+}
+
+static void
+append_double (GByteArray *array,
+               double      value)
+{
+  union { double d; guint64 u; } bits = { value };
+
+  bits.u = GUINT64_TO_LE (bits.u);
+  g_byte_array_append (array, (guchar *) &bits.u, sizeof (bits.u));
+}
+
+static void
+append_rect (GByteArray            *array,
+             const graphene_rect_t *rect)
+{
+  append_float (array, rect->origin.x);
+  append_float (array, rect->origin.y);
+  append_float (array, rect->size.width);
+  append_float (array, rect->size.height);
+}
+
+static void
+append_point (GByteArray             *array,
+              const graphene_point_t *point)
+{
+  append_float (array, point->x);
+  append_float (array, point->y);
+}
+
+static void
+append_rounded_rect (GByteArray           *array,
+                     const GskRoundedRect *rect)
+{
+  int i;
+
+  append_rect (array, &rect->bounds);
+  for (i = 0; i < 4; i++)
+    {
+      append_float (array, rect->corner[i].width);
+      append_float (array, rect->corner[i].height);
+    }
+}
+
+static void
+append_rgba (GByteArray    *array,
+             const GdkRGBA *rgba)
+{
+  append_float (array, rgba->red);
+  append_float (array, rgba->green);
+  append_float (array, rgba->blue);
+  append_float (array, rgba->alpha);
+}
+
+static void
+append_matrix (GByteArray              *array,
+               const graphene_matrix_t *matrix)
+{
+  float m[16];
+  int i;
+
+  graphene_matrix_to_float (matrix, m);
+  for (i = 0; i < 16; i++)
+    append_float (array, m[i]);
+}
+
+/* NULL is stored as 0, everything else with its length + 1 */
+static void
+append_string (GByteArray *array,
+               const char *string)
+{
+  gsize len;
+
+  if (string == NULL)
+    {
+      append_u32 (array, 0);
+      return;
+    }
+
+  len = strlen (string);
+  append_u32 (array, len + 1);
+  g_byte_array_append (array, (const guchar *) string, len);
+}
+
+static void
+gsk_node_writer_write (GskNodeWriter *writer,
+                       const guchar  *data,
+                       gsize          size)
+{
+  if (writer->error)
+    return;
+
+  g_output_stream_write_all (writer->stream, data, size, NULL,
+                             writer->cancellable, &writer->error);
+}
+
+static void
+gsk_node_writer_write_chunk (GskNodeWriter *writer,
+                             guint32        type,
+                             guint32        flags,
+                             const guchar  *header,
+                             gsize          header_size,
+                             const guchar  *data,
+                             gsize          size)
+{
+  guint32 chunk[4];
+  guint64 chunk_size = (guint64) header_size + size;
+
+  chunk[0] = GUINT32_TO_LE (type);
+  chunk[1] = GUINT32_TO_LE (flags);
+  chunk[2] = GUINT32_TO_LE ((guint32) (chunk_size & 0xffffffff));
+  chunk[3] = GUINT32_TO_LE ((guint32) (chunk_size >> 32));
+
+  gsk_node_writer_write (writer, (const guchar *) chunk, sizeof (chunk));
+  if (header_size)
+    gsk_node_writer_write (writer, header, header_size);
+  if (size)
+    gsk_node_writer_write (writer, data, size);
+}
+
+static GBytes *
+compress_pixels (const guchar *data,
+                 gsize         size)
+{
+  GConverter *compressor;
+  GOutputStream *memory, *stream;
+  GBytes *result = NULL;
+
+  compressor = G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW, 1));
+  memory = g_memory_output_stream_new_resizable ();
+  stream = g_converter_output_stream_new (memory, compressor);
+
+  if (g_output_stream_write_all (stream, data, size, NULL, NULL, NULL) &&
+      g_output_stream_close (stream, NULL, NULL))
+    result = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (memory));
+
+  g_object_unref (stream);
+  g_object_unref (memory);
+  g_object_unref (compressor);
+
+  return result;
+}
+
+/* Writes the pixels, which must be tightly packed CAIRO_FORMAT_ARGB32 */
+static guint
+gsk_node_writer_add_image (GskNodeWriter *writer,
+                           guint          width,
+                           guint          height,
+                           const guchar  *pixels)
+{
+  GByteArray *header;
+  GBytes *compressed = NULL;
+  gsize size = (gsize) width * height * 4;
+  guint id;
+
+  id = writer->n_images++;
+
+  header = g_byte_array_sized_new (IMAGE_HEADER_SIZE);
+  append_u32 (header, id);
+  append_u32 (header, width);
+  append_u32 (header, height);
+
+  if (size >= COMPRESSION_THRESHOLD)
+    compressed = compress_pixels (pixels, size);
+
+  if (compressed && g_bytes_get_size (compressed) < size)
+    gsk_node_writer_write_chunk (writer, CHUNK_IMAGE, CHUNK_FLAG_COMPRESSED,
+                                 header->data, header->len,
+                                 g_bytes_get_data (compressed, NULL),
+                                 g_bytes_get_size (compressed));
+  else
+    gsk_node_writer_write_chunk (writer, CHUNK_IMAGE, 0,
+                                 header->data, header->len,
+                                 pixels, size);
+
+  g_clear_pointer (&compressed, g_bytes_unref);
+  g_byte_array_unref (header);
+
+  return id;
+}
+
+static guint
+gsk_node_writer_add_texture (GskNodeWriter *writer,
+                             GdkTexture    *texture)
+{
+  guchar *data;
+  int width, height;
+  guint id;
+
+  id = GPOINTER_TO_UINT (g_hash_table_lookup (writer->textures, texture));
+  if (id > 0)
+    return id - 1;
+
+  width = gdk_texture_get_width (texture);
+  height = gdk_texture_get_height (texture);
+  data = g_malloc ((gsize) width * height * 4);
+  gdk_texture_download (texture, data, width * 4);
+
+  id = gsk_node_writer_add_image (writer, width, height, data);
+  g_hash_table_insert (writer->textures, texture, GUINT_TO_POINTER (id + 1));
+
+  g_free (data);
+
+  return id;
+}
+
+static guint
+gsk_node_writer_add_surface (GskNodeWriter         *writer,
+                             cairo_surface_t       *surface,
+                             const graphene_rect_t *bounds)
+{
+  GskSurfaceKey key, *new_key;
+  cairo_surface_t *image;
+  guchar *data;
+  int width, height, stride, y;
+  guint id;
+
+  key.surface = surface;
+  key.area = (cairo_rectangle_int_t) {
+                 bounds->origin.x, bounds->origin.y,
+                 bounds->size.width, bounds->size.height
+             };
+
+  id = GPOINTER_TO_UINT (g_hash_table_lookup (writer->surfaces, &key));
+  if (id > 0)
+    return id - 1;
+
+  image = cairo_surface_map_to_image (surface, &key.area);
+  width = cairo_image_surface_get_width (image);
+  height = cairo_image_surface_get_height (image);
+  stride = cairo_image_surface_get_stride (image);
+
+  if (stride == width * 4)
+    {
+      id = gsk_node_writer_add_image (writer, width, height,
+                                      cairo_image_surface_get_data (image));
+    }
+  else
+    {
+      data = g_malloc ((gsize) width * height * 4);
+      for (y = 0; y < height; y++)
+        memcpy (data + y * width * 4, cairo_image_surface_get_data (image) + y * stride, width * 4);
+
+      id = gsk_node_writer_add_image (writer, width, height, data);
+
+      g_free (data);
+    }
+
+  cairo_surface_unmap_image (surface, image);
+
+  new_key = g_memdup (&key, sizeof (key));
+  g_hash_table_insert (writer->surfaces, new_key, GUINT_TO_POINTER (id + 1));
+
+  return id;
+}
+
+static guint
+gsk_node_writer_add_font (GskNodeWriter *writer,
+                          PangoFont     *font)
+{
+  PangoFontDescription *desc;
+  GByteArray *payload;
+  guint id;
+  char *s;
+
+  desc = pango_font_describe (font);
+  s = pango_font_description_to_string (desc);
+  pango_font_description_free (desc);
+
+  id = GPOINTER_TO_UINT (g_hash_table_lookup (writer->fonts, s));
+  if (id > 0)
+    {
+      g_free (s);
+      return id - 1;
+    }
+
+  id = writer->n_fonts++;
+  g_hash_table_insert (writer->fonts, s, GUINT_TO_POINTER (id + 1));
+
+  payload = g_byte_array_new ();
+  append_u32 (payload, id);
+  append_string (payload, s);
+  gsk_node_writer_write_chunk (writer, CHUNK_FONT, 0, payload->data, payload->len, NULL, 0);
+  g_byte_array_unref (payload);
+
+  return id;
+}
+
+static void
+gsk_node_writer_add_node (GskNodeWriter *writer,
+                          GskRenderNode *node)
+{
+  GByteArray *out = writer->nodes;
+  guint i, n;
+
+  append_u32 (out, gsk_render_node_get_node_type (node));
+
+  switch (gsk_render_node_get_node_type (node))
+    {
+    case GSK_NOT_A_RENDER_NODE:
+    default:
+      g_assert_not_reached ();
+      return;
+
+    case GSK_CONTAINER_NODE:
+      n = gsk_container_node_get_n_children (node);
+      append_u32 (out, n);
+      for (i = 0; i < n; i++)
+        gsk_node_writer_add_node (writer, gsk_container_node_get_child (node, i));
+      break;
+
+    case GSK_CAIRO_NODE:
+      {
+        cairo_surface_t *surface = (cairo_surface_t *) gsk_cairo_node_peek_surface (node);
+
+        append_rect (out, &node->bounds);
+        if (surface == NULL)
+          append_u32 (out, 0);
+        else
+          append_u32 (out, gsk_node_writer_add_surface (writer, surface, &node->bounds) + 1);
+      }
+      break;
+
+    case GSK_COLOR_NODE:
+      append_rect (out, &node->bounds);
+      append_rgba (out, gsk_color_node_peek_color (node));
+      break;
+
+    case GSK_LINEAR_GRADIENT_NODE:
+    case GSK_REPEATING_LINEAR_GRADIENT_NODE:
+      {
+        const GskColorStop *stops = gsk_linear_gradient_node_peek_color_stops (node);
+
+        append_rect (out, &node->bounds);
+        append_point (out, gsk_linear_gradient_node_peek_start (node));
+        append_point (out, gsk_linear_gradient_node_peek_end (node));
+        n = gsk_linear_gradient_node_get_n_color_stops (node);
+        append_u32 (out, n);
+        for (i = 0; i < n; i++)
+          {
+            append_float (out, stops[i].offset);
+            append_rgba (out, &stops[i].color);
+          }
+      }
+      break;
+
+    case GSK_BORDER_NODE:
+      {
+        const float *widths = gsk_border_node_peek_widths (node);
+        const GdkRGBA *colors = gsk_border_node_peek_colors (node);
+
+        append_rounded_rect (out, gsk_border_node_peek_outline (node));
+        for (i = 0; i < 4; i++)
+          append_float (out, widths[i]);
+        for (i = 0; i < 4; i++)
+          append_rgba (out, &colors[i]);
+      }
+      break;
+
+    case GSK_TEXTURE_NODE:
+      append_rect (out, &node->bounds);
+      append_u32 (out, gsk_node_writer_add_texture (writer, gsk_texture_node_get_texture (node)));
+      break;
+
+    case GSK_INSET_SHADOW_NODE:
+      append_rounded_rect (out, gsk_inset_shadow_node_peek_outline (node));
+      append_rgba (out, gsk_inset_shadow_node_peek_color (node));
+      append_float (out, gsk_inset_shadow_node_get_dx (node));
+      append_float (out, gsk_inset_shadow_node_get_dy (node));
+      append_float (out, gsk_inset_shadow_node_get_spread (node));
+      append_float (out, gsk_inset_shadow_node_get_blur_radius (node));
+      break;
+
+    case GSK_OUTSET_SHADOW_NODE:
+      append_rounded_rect (out, gsk_outset_shadow_node_peek_outline (node));
+      append_rgba (out, gsk_outset_shadow_node_peek_color (node));
+      append_float (out, gsk_outset_shadow_node_get_dx (node));
+      append_float (out, gsk_outset_shadow_node_get_dy (node));
+      append_float (out, gsk_outset_shadow_node_get_spread (node));
+      append_float (out, gsk_outset_shadow_node_get_blur_radius (node));
+      break;
+
+    case GSK_TRANSFORM_NODE:
+      append_matrix (out, gsk_transform_node_peek_transform (node));
+      gsk_node_writer_add_node (writer, gsk_transform_node_get_child (node));
+      break;
+
+    case GSK_OPACITY_NODE:
+      append_double (out, gsk_opacity_node_get_opacity (node));
+      gsk_node_writer_add_node (writer, gsk_opacity_node_get_child (node));
+      break;
+
+    case GSK_COLOR_MATRIX_NODE:
+      {
+        float offset[4];
+
+        append_matrix (out, gsk_color_matrix_node_peek_color_matrix (node));
+        graphene_vec4_to_float (gsk_color_matrix_node_peek_color_offset (node), offset);
+        for (i = 0; i < 4; i++)
+          append_float (out, offset[i]);
+        gsk_node_writer_add_node (writer, gsk_color_matrix_node_get_child (node));
+      }
+      break;
+
+    case GSK_REPEAT_NODE:
+      append_rect (out, &node->bounds);
+      append_rect (out, gsk_repeat_node_peek_child_bounds (node));
+      gsk_node_writer_add_node (writer, gsk_repeat_node_get_child (node));
+      break;
+
+    case GSK_CLIP_NODE:
+      append_rect (out, gsk_clip_node_peek_clip (node));
+      gsk_node_writer_add_node (writer, gsk_clip_node_get_child (node));
+      break;
+
+    case GSK_ROUNDED_CLIP_NODE:
+      append_rounded_rect (out, gsk_rounded_clip_node_peek_clip (node));
+      gsk_node_writer_add_node (writer, gsk_rounded_clip_node_get_child (node));
+      break;
+
+    case GSK_SHADOW_NODE:
+      n = gsk_shadow_node_get_n_shadows (node);
+      append_u32 (out, n);
+      for (i = 0; i < n; i++)
+        {
+          const GskShadow *shadow = gsk_shadow_node_peek_shadow (node, i);
+
+          append_rgba (out, &shadow->color);
+          append_float (out, shadow->dx);
+          append_float (out, shadow->dy);
+          append_float (out, shadow->radius);
+        }
+      gsk_node_writer_add_node (writer, gsk_shadow_node_get_child (node));
+      break;
+
+    case GSK_BLEND_NODE:
+      append_u32 (out, gsk_blend_node_get_blend_mode (node));
+      gsk_node_writer_add_node (writer, gsk_blend_node_get_bottom_child (node));
+      gsk_node_writer_add_node (writer, gsk_blend_node_get_top_child (node));
+      break;
+
+    case GSK_CROSS_FADE_NODE:
+      append_double (out, gsk_cross_fade_node_get_progress (node));
+      gsk_node_writer_add_node (writer, gsk_cross_fade_node_get_start_child (node));
+      gsk_node_writer_add_node (writer, gsk_cross_fade_node_get_end_child (node));
+      break;
+
+    case GSK_TEXT_NODE:
+      {
+        const PangoGlyphInfo *glyphs = gsk_text_node_peek_glyphs (node);
+
+        append_u32 (out, gsk_node_writer_add_font (writer, (PangoFont *) gsk_text_node_peek_font (node)));
+        append_rgba (out, gsk_text_node_peek_color (node));
+        append_float (out, gsk_text_node_get_x (node));
+        append_float (out, gsk_text_node_get_y (node));
+        append_rect (out, &node->bounds);
+        n = gsk_text_node_get_num_glyphs (node);
+        append_u32 (out, n);
+        for (i = 0; i < n; i++)
+          {
+            append_u32 (out, glyphs[i].glyph);
+            append_u32 (out, glyphs[i].geometry.width);
+            append_u32 (out, glyphs[i].geometry.x_offset);
+            append_u32 (out, glyphs[i].geometry.y_offset);
+            append_u32 (out, glyphs[i].attr.is_cluster_start);
+          }
+      }
+      break;
+
+    case GSK_BLUR_NODE:
+      append_double (out, gsk_blur_node_get_radius (node));
+      gsk_node_writer_add_node (writer, gsk_blur_node_get_child (node));
+      break;
+
+    case GSK_OFFSET_NODE:
+      append_double (out, gsk_offset_node_get_x_offset (node));
+      append_double (out, gsk_offset_node_get_y_offset (node));
+      gsk_node_writer_add_node (writer, gsk_offset_node_get_child (node));
+      break;
+
+    case GSK_DEBUG_NODE:
+      append_string (out, gsk_debug_node_get_message (node));
+      gsk_node_writer_add_node (writer, gsk_debug_node_get_child (node));
+      break;
+    }
+}
+
+gboolean
+gsk_render_node_write_binary (GskRenderNode  *node,
+                              GOutputStream  *stream,
+                              GCancellable   *cancellable,
+                              GError        **error)
+{
+  GskNodeWriter writer = { 0, };
+  guint32 version;
+
+  writer.stream = stream;
+  writer.cancellable = cancellable;
+  writer.textures = g_hash_table_new (NULL, NULL);
+  writer.surfaces = g_hash_table_new_full (gsk_surface_key_hash, gsk_surface_key_equal, g_free, NULL);
+  writer.fonts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  writer.nodes = g_byte_array_new ();
+
+  version = GUINT32_TO_LE (GSK_RENDER_NODE_BINARY_VERSION);
+  gsk_node_writer_write (&writer, gsk_render_node_binary_magic, GSK_RENDER_NODE_BINARY_MAGIC_SIZE);
+  gsk_node_writer_write (&writer, (const guchar *) &version, sizeof (version));
+
+  /* Resources are written out as they are found, so they precede the nodes */
+  gsk_node_writer_add_node (&writer, node);
+
+  gsk_node_writer_write_chunk (&writer, CHUNK_NODE, 0, NULL, 0, writer.nodes->data, writer.nodes->len);
+  gsk_node_writer_write_chunk (&writer, CHUNK_END, 0, NULL, 0, NULL, 0);
+
+  g_hash_table_unref (writer.textures);
+  g_hash_table_unref (writer.surfaces);
+  g_hash_table_unref (writer.fonts);
+  g_byte_array_unref (writer.nodes);
+
+  if (writer.error)
+    {
+      g_propagate_error (error, writer.error);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* }}} */
+/* {{{ Reader */
+
+typedef struct
+{
+  guint width;
+  guint height;
+  GBytes *pixels;
+  GdkTexture *texture; /* created on first use */
+} GskNodeImage;
+
+typedef struct
+{
+  GInputStream *stream;
+  GCancellable *cancellable;
+  GError *error;
+
+  /* bytes left in the current chunk */
+  guint64 remaining;
+
+  /* nesting of the node being read */
+  guint depth;
+
+  GPtrArray *images;
+  GPtrArray *fonts;
+  PangoFontMap *fontmap;
+  PangoContext *context;
+} GskNodeReader;
+
+static const cairo_user_data_key_t gsk_node_image_pixels_key;
+
+static void
+gsk_node_image_free (gpointer data)
+{
+  GskNodeImage *image = data;
+
+  g_bytes_unref (image->pixels);
+  g_clear_object (&image->texture);
+  g_slice_free (GskNodeImage, image);
+}
+
+static void
+gsk_node_reader_invalid (GskNodeReader *reader,
+                         const char    *format,
+                         ...) G_GNUC_PRINTF (2, 3);
+
+static void
+gsk_node_reader_invalid (GskNodeReader *reader,
+                         const char    *format,
+                         ...)
+{
+  va_list args;
+
+  if (reader->error)
+    return;
+
+  va_start (args, format);
+  reader->error = g_error_new_valist (GSK_SERIALIZATION_ERROR, GSK_SERIALIZATION_INVALID_DATA,
+                                      format, args);
+  va_end (args);
+}
+
+static gboolean
+gsk_node_reader_consume (GskNodeReader *reader,
+                         guint64        size)
+{
+  if (reader->error)
+    return FALSE;
+
+  if (reader->remaining < size)
+    {
+      gsk_node_reader_invalid (reader, "Unexpected end of chunk");
+      return FALSE;
+    }
+
+  reader->remaining -= size;
+  return TRUE;
+}
+
+static void
+gsk_node_reader_read (GskNodeReader *reader,
+                      guchar        *data,
+                      gsize          size)
+{
+  gsize bytes_read;
+
+  if (!gsk_node_reader_consume (reader, size))
+    return;
+
+  if (!g_input_stream_read_all (reader->stream, data, size, &bytes_read,
+                                reader->cancellable, &reader->error))
+    return;
+
+  if (bytes_read != size)
+    gsk_node_reader_invalid (reader, "Unexpected end of data");
+}
+
+static guint32
+read_u32 (GskNodeReader *reader)
+{
+  guint32 value = 0;
+
+  gsk_node_reader_read (reader, (guchar *) &value, sizeof (value));
+
+  return GUINT32_FROM_LE (value);
+}
+
+static guint64
+read_u64 (GskNodeReader *reader)
+{
+  guint64 value = 0;
+
+  gsk_node_reader_read (reader, (guchar *) &value, sizeof (value));
+
+  return GUINT64_FROM_LE (value);
+}
+
+static float
+read_float (GskNodeReader *reader)
+{
+  union { float f; guint32 u; } bits;
+
+  bits.u = read_u32 (reader);
+
+  return bits.f;
+}
+
+static double
+read_double (GskNodeReader *reader)
+{
+  union { double d; guint64 u; } bits;
+
+  bits.u = read_u64 (reader);
+
+  return bits.d;
+}
+
+static void
+read_rect (GskNodeReader   *reader,
+           graphene_rect_t *rect)
+{
+  rect->origin.x = read_float (reader);
+  rect->origin.y = read_float (reader);
+  rect->size.width = read_float (reader);
+  rect->size.height = read_float (reader);
+}
+
+static void
+read_point (GskNodeReader    *reader,
+            graphene_point_t *point)
+{
+  point->x = read_float (reader);
+  point->y = read_float (reader);
+}
+
+static void
+read_rounded_rect (GskNodeReader  *reader,
+                   GskRoundedRect *rect)
+{
+  int i;
+
+  read_rect (reader, &rect->bounds);
+  for (i = 0; i < 4; i++)
+    {
+      rect->corner[i].width = read_float (reader);
+      rect->corner[i].height = read_float (reader);
+    }
+}
+
+static void
+read_rgba (GskNodeReader *reader,
+           GdkRGBA       *rgba)
+{
+  rgba->red = read_float (reader);
+  rgba->green = read_float (reader);
+  rgba->blue = read_float (reader);
+  rgba->alpha = read_float (reader);
+}
+
+static void
+read_matrix (GskNodeReader     *reader,
+             graphene_matrix_t *matrix)
+{
+  float m[16];
+  int i;
+
+  for (i = 0; i < 16; i++)
+    m[i] = read_float (reader);
+
+  graphene_matrix_init_from_float (matrix, m);
+}
+
+/* Reads a count of items of at least item_size bytes each */
+static guint
+read_count (GskNodeReader *reader,
+            gsize          item_size)
+{
+  guint32 count = read_u32 (reader);
+
+  if (reader->error)
+    return 0;
+
+  if ((guint64) count * item_size > reader->remaining)
+    {
+      gsk_node_reader_invalid (reader, "Count of %u items exceeds the chunk size", count);
+      return 0;
+    }
+
+  return count;
+}
+
+static char *
+read_string (GskNodeReader *reader)
+{
+  guint32 len;
+  char *s;
+
+  len = read_count (reader, 1);
+  if (len == 0)
+    return NULL;
+
+  s = g_malloc (len);
+  gsk_node_reader_read (reader, (guchar *) s, len - 1);
+  s[len - 1] = '\0';
+
+  return s;
+}
+
+static GskNodeImage *
+read_image_ref (GskNodeReader *reader)
+{
+  guint32 id = read_u32 (reader);
+
+  if (reader->error)
+    return NULL;
+
+  if (id >= reader->images->len)
+    {
+      gsk_node_reader_invalid (reader, "Reference to unknown image %u", id);
+      return NULL;
+    }
+
+  return g_ptr_array_index (reader->images, id);
+}
+
+static GskRenderNode *gsk_node_reader_read_node (GskNodeReader *reader);
+
+static GskRenderNode *
+gsk_node_reader_read_child (GskNodeReader *reader,
+                            GskRenderNode *parent)
+{
+  if (parent == NULL || reader->error)
+    return NULL;
+
+  return gsk_node_reader_read_node (reader);
+}
+
+static GskRenderNode *
+gsk_node_reader_parse_node (GskNodeReader *reader)
+{
+  GskRenderNodeType type;
+  GskRenderNode *result = NULL;
+  GskRenderNode *child = NULL, *child2 = NULL;
+  GskRoundedRect outline;
+  graphene_rect_t bounds;
+  GdkRGBA color;
+  guint i, n;
+
+  type = read_u32 (reader);
+  if (reader->error)
+    return NULL;
+
+  switch (type)
+    {
+    case GSK_NOT_A_RENDER_NODE:
+    default:
+      gsk_node_reader_invalid (reader, "Invalid node type %u", type);
+      return NULL;
+
+    case GSK_CONTAINER_NODE:
+      {
+        GskRenderNode **children;
+
+        n = read_count (reader, sizeof (guint32));
+        children = g_new (GskRenderNode *, n);
+        for (i = 0; i < n; i++)
+          {
+            children[i] = gsk_node_reader_read_node (reader);
+            if (children[i] == NULL)
+              break;
+          }
+
+        if (i == n)
+          result = gsk_container_node_new (children, n);
+
+        n = i;
+        for (i = 0; i < n; i++)
+          gsk_render_node_unref (children[i]);
+        g_free (children);
+      }
+      return result;
+
+    case GSK_CAIRO_NODE:
+      {
+        GskNodeImage *image;
+        cairo_surface_t *surface;
+        guint32 id;
+
+        read_rect (reader, &bounds);
+        id = read_u32 (reader);
+        if (reader->error)
+          return NULL;
+
+        if (id == 0)
+          return gsk_cairo_node_new (&bounds);
+
+        if (id > reader->images->len)
+          {
+            gsk_node_reader_invalid (reader, "Reference to unknown image %u", id - 1);
+            return NULL;
+          }
+
+        /* cairo only reads from sources, so the data can be shared */
+        image = g_ptr_array_index (reader->images, id - 1);
+        surface = cairo_image_surface_create_for_data ((guchar *) g_bytes_get_data (image->pixels, NULL),
+                                                       CAIRO_FORMAT_ARGB32,
+                                                       image->width, image->height,
+                                                       image->width * 4);
+        cairo_surface_set_user_data (surface,
+                                     &gsk_node_image_pixels_key,
+                                     g_bytes_ref (image->pixels),
+                                     (cairo_destroy_func_t) g_bytes_unref);
+        cairo_surface_set_device_offset (surface, - (int) bounds.origin.x, - (int) bounds.origin.y);
+
+        result = gsk_cairo_node_new_for_surface (&bounds, surface);
+        cairo_surface_destroy (surface);
+      }
+      return result;
+
+    case GSK_COLOR_NODE:
+      read_rect (reader, &bounds);
+      read_rgba (reader, &color);
+      if (reader->error)
+        return NULL;
+      return gsk_color_node_new (&color, &bounds);
+
+    case GSK_LINEAR_GRADIENT_NODE:
+    case GSK_REPEATING_LINEAR_GRADIENT_NODE:
+      {
+        graphene_point_t start, end;
+        GskColorStop *stops;
+
+        read_rect (reader, &bounds);
+        read_point (reader, &start);
+        read_point (reader, &end);
+        n = read_count (reader, 5 * sizeof (float));
+        stops = g_new (GskColorStop, n);
+        for (i = 0; i < n; i++)
+          {
+            stops[i].offset = read_float (reader);
+            read_rgba (reader, &stops[i].color);
+          }
+
+        if (reader->error == NULL)
+          {
+            if (type == GSK_LINEAR_GRADIENT_NODE)
+              result = gsk_linear_gradient_node_new (&bounds, &start, &end, stops, n);
+            else
+              result = gsk_repeating_linear_gradient_node_new (&bounds, &start, &end, stops, n);
+          }
+
+        g_free (stops);
+      }
+      return result;
+
+    case GSK_BORDER_NODE:
+      {
+        float widths[4];
+        GdkRGBA colors[4];
+
+        read_rounded_rect (reader, &outline);
+        for (i = 0; i < 4; i++)
+          widths[i] = read_float (reader);
+        for (i = 0; i < 4; i++)
+          read_rgba (reader, &colors[i]);
+        if (reader->error)
+          return NULL;
+
+        return gsk_border_node_new (&outline, widths, colors);
+      }
+
+    case GSK_TEXTURE_NODE:
+      {
+        GskNodeImage *image;
+
+        read_rect (reader, &bounds);
+        image = read_image_ref (reader);
+        if (image == NULL)
+          return NULL;
+
+        if (image->texture == NULL)
+          image->texture = gdk_memory_texture_new (image->width, image->height,
+                                                   GDK_MEMORY_DEFAULT,
+                                                   image->pixels,
+                                                   image->width * 4);
+
+        return gsk_texture_node_new (image->texture, &bounds);
+      }
+
+    case GSK_INSET_SHADOW_NODE:
+    case GSK_OUTSET_SHADOW_NODE:
+      {
+        float dx, dy, spread, blur_radius;
+
+        read_rounded_rect (reader, &outline);
+        read_rgba (reader, &color);
+        dx = read_float (reader);
+        dy = read_float (reader);
+        spread = read_float (reader);
+        blur_radius = read_float (reader);
+        if (reader->error)
+          return NULL;
+
+        if (type == GSK_INSET_SHADOW_NODE)
+          return gsk_inset_shadow_node_new (&outline, &color, dx, dy, spread, blur_radius);
+        else
+          return gsk_outset_shadow_node_new (&outline, &color, dx, dy, spread, blur_radius);
+      }
+
+    case GSK_TRANSFORM_NODE:
+      {
+        graphene_matrix_t transform;
+
+        read_matrix (reader, &transform);
+        child = gsk_node_reader_read_node (reader);
+        if (child == NULL)
+          return NULL;
+
+        result = gsk_transform_node_new (child, &transform);
+      }
+      break;
+
+    case GSK_OPACITY_NODE:
+      {
+        double opacity = read_double (reader);
+
+        child = gsk_node_reader_read_node (reader);
+        if (child == NULL)
+          return NULL;
+
+        result = gsk_opacity_node_new (child, opacity);
+      }
+      break;
+
+    case GSK_COLOR_MATRIX_NODE:
+      {
+        graphene_matrix_t matrix;
+        graphene_vec4_t offset;
+        float v[4];
+
+        read_matrix (reader, &matrix);
+        for (i = 0; i < 4; i++)
+          v[i] = read_float (reader);
+        graphene_vec4_init_from_float (&offset, v);
+
+        child = gsk_node_reader_read_node (reader);
+        if (child == NULL)
+          return NULL;
+
+        result = gsk_color_matrix_node_new (child, &matrix, &offset);
+      }
+      break;
+
+    case GSK_REPEAT_NODE:
+      {
+        graphene_rect_t child_bounds;
+
+        read_rect (reader, &bounds);
+        read_rect (reader, &child_bounds);
+        child = gsk_node_reader_read_node (reader);
+        if (child == NULL)
+          return NULL;
+
+        result = gsk_repeat_node_new (&bounds, child, &child_bounds);
+      }
+      break;
+
+    case GSK_CLIP_NODE:
+      read_rect (reader, &bounds);
+      child = gsk_node_reader_read_node (reader);
+      if (child == NULL)
+        return NULL;
+
+      result = gsk_clip_node_new (child, &bounds);
+      break;
+
+    case GSK_ROUNDED_CLIP_NODE:
+      read_rounded_rect (reader, &outline);
+      child = gsk_node_reader_read_node (reader);
+      if (child == NULL)
+        return NULL;
+
+      result = gsk_rounded_clip_node_new (child, &outline);
+      break;
+
+    case GSK_SHADOW_NODE:
+      {
+        GskShadow *shadows;
+
+        n = read_count (reader, 7 * sizeof (float));
+        shadows = g_new (GskShadow, n);
+        for (i = 0; i < n; i++)
+          {
+            read_rgba (reader, &shadows[i].color);
+            shadows[i].dx = read_float (reader);
+            shadows[i].dy = read_float (reader);
+            shadows[i].radius = read_float (reader);
+          }
+
+        child = gsk_node_reader_read_node (reader);
+        if (child != NULL)
+          result = gsk_shadow_node_new (child, shadows, n);
+
+        g_free (shadows);
+      }
+      break;
+
+    case GSK_BLEND_NODE:
+      {
+        GskBlendMode mode = read_u32 (reader);
+
+        child = gsk_node_reader_read_node (reader);
+        child2 = gsk_node_reader_read_child (reader, child);
+        if (child2 == NULL)
+          break;
+
+        result = gsk_blend_node_new (child, child2, mode);
+      }
+      break;
+
+    case GSK_CROSS_FADE_NODE:
+      {
+        double progress = read_double (reader);
+
+        child = gsk_node_reader_read_node (reader);
+        child2 = gsk_node_reader_read_child (reader, child);
+        if (child2 == NULL)
+          break;
+
+        result = gsk_cross_fade_node_new (child, child2, progress);
+      }
+      break;
+
+    case GSK_TEXT_NODE:
+      {
+        PangoGlyphString *glyphs;
+        PangoFont *font;
+        guint32 font_id;
+        float x, y;
+
+        font_id = read_u32 (reader);
+        read_rgba (reader, &color);
+        x = read_float (reader);
+        y = read_float (reader);
+        read_rect (reader, &bounds);
+        n = read_count (reader, 5 * sizeof (guint32));
+        if (reader->error)
+          return NULL;
+
+        if (font_id >= reader->fonts->len)
+          {
+            gsk_node_reader_invalid (reader, "Reference to unknown font %u", font_id);
+            return NULL;
+          }
+        font = g_ptr_array_index (reader->fonts, font_id);
+
+        glyphs = pango_glyph_string_new ();
+        pango_glyph_string_set_size (glyphs, n);
+        for (i = 0; i < n; i++)
+          {
+            PangoGlyphInfo *glyph = &glyphs->glyphs[i];
+
+            glyph->glyph = read_u32 (reader);
+            glyph->geometry.width = (gint32) read_u32 (reader);
+            glyph->geometry.x_offset = (gint32) read_u32 (reader);
+            glyph->geometry.y_offset = (gint32) read_u32 (reader);
+            glyph->attr.is_cluster_start = read_u32 (reader);
+          }
+
+        /* Using the stored bounds avoids measuring every glyph again */
+        if (reader->error == NULL)
+          result = gsk_text_node_new_with_bounds (font, glyphs, &color, x, y, &bounds);
+
+        pango_glyph_string_free (glyphs);
+      }
+      return result;
+
+    case GSK_BLUR_NODE:
+      {
+        double radius = read_double (reader);
+
+        child = gsk_node_reader_read_node (reader);
+        if (child == NULL)
+          return NULL;
+
+        result = gsk_blur_node_new (child, radius);
+      }
+      break;
+
+    case GSK_OFFSET_NODE:
+      {
+        double dx, dy;
+
+        dx = read_double (reader);
+        dy = read_double (reader);
+        child = gsk_node_reader_read_node (reader);
+        if (child == NULL)
+          return NULL;
+
+        result = gsk_offset_node_new (child, dx, dy);
+      }
+      break;
+
+    case GSK_DEBUG_NODE:
+      {
+        char *message = read_string (reader);
+
+        child = gsk_node_reader_read_node (reader);
+        if (child == NULL)
+          {
+            g_free (message);
+            return NULL;
+          }
+
+        /* takes ownership of message */
+        result = gsk_debug_node_new (child, message);
+      }
+      break;
+    }
+
+  g_clear_pointer (&child, gsk_render_node_unref);
+  g_clear_pointer (&child2, gsk_render_node_unref);
+
+  return result;
+}
+
+static GskRenderNode *
+gsk_node_reader_read_node (GskNodeReader *reader)
+{
+  GskRenderNode *result;
+
+  if (reader->depth >= MAX_NODE_DEPTH)
+    {
+      gsk_node_reader_invalid (reader, "Nodes nested deeper than %u levels", MAX_NODE_DEPTH);
+      return NULL;
+    }
+
+  reader->depth++;
+  result = gsk_node_reader_parse_node (reader);
+  reader->depth--;
+
+  return result;
+}
+
+static void
+gsk_node_reader_read_image (GskNodeReader *reader,
+                            guint32        flags)
+{
+  GskNodeImage *image;
+  guint32 id, width, height;
+  guint64 size;
+  guchar *data;
+
+  id = read_u32 (reader);
+  width = read_u32 (reader);
+  height = read_u32 (reader);
+  if (reader->error)
+    return;
+
+  if (id != reader->images->len)
+    {
+      gsk_node_reader_invalid (reader, "Expected image %u but got %u", reader->images->len, id);
+      return;
+    }
+
+  size = (guint64) width * height * 4;
+  if (width == 0 || height == 0 || width > G_MAXINT / 4 || size > G_MAXSIZE)
+    {
+      gsk_node_reader_invalid (reader, "Invalid image size %ux%u", width, height);
+      return;
+    }
+
+  if (flags & CHUNK_FLAG_COMPRESSED)
+    {
+      GConverter *decompressor;
+      GInputStream *memory, *stream;
+      guchar *compressed;
+      gsize compressed_size, bytes_read;
+
+      if (reader->remaining > G_MAXSIZE)
+        {
+          gsk_node_reader_invalid (reader, "Image chunk too large");
+          return;
+        }
+
+      compressed_size = reader->remaining;
+      compressed = g_malloc (compressed_size);
+      gsk_node_reader_read (reader, compressed, compressed_size);
+      if (reader->error)
+        {
+          g_free (compressed);
+          return;
+        }
+
+      data = g_try_malloc (size);
+      if (data == NULL)
+        {
+          gsk_node_reader_invalid (reader, "Not enough memory for %ux%u image", width, height);
+          g_free (compressed);
+          return;
+        }
+
+      decompressor = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW));
+      memory = g_memory_input_stream_new_from_data (compressed, compressed_size, g_free);
+      stream = g_converter_input_stream_new (memory, decompressor);
+
+      if (g_input_stream_read_all (stream, data, size, &bytes_read, reader->cancellable, &reader->error) &&
+          bytes_read != size)
+        gsk_node_reader_invalid (reader, "Expected %"G_GUINT64_FORMAT" bytes of pixels but got %"G_GSIZE_FORMAT,
+                                 size, bytes_read);
+
+      g_object_unref (stream);
+      g_object_unref (memory);
+      g_object_unref (decompressor);
+    }
+  else
+    {
+      if (reader->remaining < size)
+        {
+          gsk_node_reader_invalid (reader, "Image chunk too small for %ux%u image", width, height);
+          return;
+        }
+
+      data = g_try_malloc (size);
+      if (data == NULL)
+        {
+          gsk_node_reader_invalid (reader, "Not enough memory for %ux%u image", width, height);
+          return;
+        }
+
+      gsk_node_reader_read (reader, data, size);
+    }
+
+  if (reader->error)
+    {
+      g_free (data);
+      return;
+    }
+
+  image = g_slice_new0 (GskNodeImage);
+  image->width = width;
+  image->height = height;
+  image->pixels = g_bytes_new_take (data, size);
+  g_ptr_array_add (reader->images, image);
+}
+
+static void
+gsk_node_reader_read_font (GskNodeReader *reader)
+{
+  PangoFontDescription *desc;
+  PangoFont *font;
+  guint32 id;
+  char *s;
+
+  id = read_u32 (reader);
+  s = read_string (reader);
+  if (reader->error)
+    {
+      g_free (s);
+      return;
+    }
+
+  if (id != reader->fonts->len || s == NULL)
+    {
+      gsk_node_reader_invalid (reader, "Invalid font %u", id);
+      g_free (s);
+      return;
+    }
+
+  if (reader->fontmap == NULL)
+    {
+      reader->fontmap = pango_cairo_font_map_get_default ();
+      reader->context = pango_font_map_create_context (reader->fontmap);
+    }
+
+  desc = pango_font_description_from_string (s);
+  font = pango_font_map_load_font (reader->fontmap, reader->context, desc);
+  pango_font_description_free (desc);
+
+  if (font == NULL)
+    gsk_node_reader_invalid (reader, "Could not load font \"%s\"", s);
+  else
+    g_ptr_array_add (reader->fonts, font);
+
+  g_free (s);
+}
+
+static void
+gsk_node_reader_skip (GskNodeReader *reader)
+{
+  while (reader->error == NULL && reader->remaining > 0)
+    {
+      gssize skipped;
+
+      skipped = g_input_stream_skip (reader->stream,
+                                     MIN (reader->remaining, G_MAXSSIZE),
+                                     reader->cancellable, &reader->error);
+      if (skipped == 0)
+        gsk_node_reader_invalid (reader, "Unexpected end of data");
+      else if (skipped > 0)
+        reader->remaining -= skipped;
+    }
+}
+
+GskRenderNode *
+gsk_render_node_read_binary (GInputStream  *stream,
+                             GCancellable  *cancellable,
+                             GError       **error)
+{
+  GskNodeReader reader = { 0, };
+  GskRenderNode *node = NULL;
+  guchar magic[GSK_RENDER_NODE_BINARY_MAGIC_SIZE];
+  guint32 version;
+
+  /* Most reads are only a few bytes, so buffer them */
+  reader.stream = g_buffered_input_stream_new (stream);
+  g_filter_input_stream_set_close_base_stream (G_FILTER_INPUT_STREAM (reader.stream), FALSE);
+  reader.cancellable = cancellable;
+  reader.images = g_ptr_array_new_with_free_func (gsk_node_image_free);
+  reader.fonts = g_ptr_array_new_with_free_func (g_object_unref);
+
+  reader.remaining = sizeof (magic) + sizeof (version);
+  gsk_node_reader_read (&reader, magic, sizeof (magic));
+  version = read_u32 (&reader);
+
+  if (reader.error)
+    goto out;
+
+  if (!gsk_render_node_is_binary_data (magic, sizeof (magic)))
+    {
+      g_set_error (&reader.error, GSK_SERIALIZATION_ERROR, GSK_SERIALIZATION_UNSUPPORTED_FORMAT,
+                   "Data not in GskRenderNode serialization format.");
+      goto out;
+    }
+
+  if (version != GSK_RENDER_NODE_BINARY_VERSION)
+    {
+      g_set_error (&reader.error, GSK_SERIALIZATION_ERROR, GSK_SERIALIZATION_UNSUPPORTED_VERSION,
+                   "Format version %u not supported.", version);
+      goto out;
+    }
+
+  while (reader.error == NULL)
+    {
+      guint32 type, flags;
+      guint64 size;
+
+      reader.remaining = CHUNK_HEADER_SIZE;
+      type = read_u32 (&reader);
+      flags = read_u32 (&reader);
+      size = read_u64 (&reader);
+      if (reader.error)
+        break;
+
+      reader.remaining = size;
+
+      if (type == CHUNK_END)
+        {
+          if (node == NULL)
+            gsk_node_reader_invalid (&reader, "No nodes in data");
+          break;
+        }
+
+      switch (type)
+        {
+        case CHUNK_IMAGE:
+          gsk_node_reader_read_image (&reader, flags);
+          break;
+
+        case CHUNK_FONT:
+          gsk_node_reader_read_font (&reader);
+          break;
+
+        case CHUNK_NODE:
+          if (node != NULL)
+            {
+              gsk_node_reader_invalid (&reader, "More than one node chunk");
+              break;
+            }
+          node = gsk_node_reader_read_node (&reader);
+          break;
+
+        default:
+          break;
+        }
+
+      /* Skip unknown chunks and trailing data of known ones */
+      gsk_node_reader_skip (&reader);
+    }
+
+out:
+  if (reader.error)
+    {
+      g_clear_pointer (&node, gsk_render_node_unref);
+      g_propagate_error (error, reader.error);
+    }
+
+  g_ptr_array_unref (reader.images);
+  g_ptr_array_unref (reader.fonts);
+  g_clear_object (&reader.context);
+  g_object_unref (reader.stream);
+
+  return node;
+}
+
+/* }}} */
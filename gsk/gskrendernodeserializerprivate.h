@@ -0,0 +1,24 @@
+#ifndef __GSK_RENDER_NODE_SERIALIZER_PRIVATE_H__
+#define __GSK_RENDER_NODE_SERIALIZER_PRIVATE_H__
+
+#include "gskrendernode.h"
+
+G_BEGIN_DECLS
+
+/* Length of the magic at the start of the binary format */
+#define GSK_RENDER_NODE_BINARY_MAGIC_SIZE 8
+
+gboolean        gsk_render_node_is_binary_data (const guchar   *data,
+                                                gsize           size);
+
+gboolean        gsk_render_node_write_binary   (GskRenderNode  *node,
+                                                GOutputStream  *stream,
+                                                GCancellable   *cancellable,
+                                                GError        **error);
+GskRenderNode * gsk_render_node_read_binary    (GInputStream   *stream,
+                                                GCancellable   *cancellable,
+                                                GError        **error);
+
+G_END_DECLS
+
+#endif /* __GSK_RENDER_NODE_SERIALIZER_PRIVATE_H__ */
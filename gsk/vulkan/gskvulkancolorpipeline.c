@@ -77,11 +77,12 @@ gsk_vulkan_color_pipeline_init (GskVulkanColorPipeline *self)
 
 GskVulkanPipeline *
 gsk_vulkan_color_pipeline_new (GdkVulkanContext         *context,
+                               VkPipelineCache          cache,
                                VkPipelineLayout         layout,
                                const char              *shader_name,
                                VkRenderPass             render_pass)
 {
-  return gsk_vulkan_pipeline_new (GSK_TYPE_VULKAN_COLOR_PIPELINE, context, layout, shader_name, render_pass);
+  return gsk_vulkan_pipeline_new (GSK_TYPE_VULKAN_COLOR_PIPELINE, context, cache, layout, shader_name, render_pass);
 }
 
 gsize
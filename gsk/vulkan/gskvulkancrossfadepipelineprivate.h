@@ -14,6 +14,7 @@ typedef struct _GskVulkanCrossFadePipelineLayout GskVulkanCrossFadePipelineLayou
 G_DECLARE_FINAL_TYPE (GskVulkanCrossFadePipeline, gsk_vulkan_cross_fade_pipeline, GSK, VULKAN_CROSS_FADE_PIPELINE, GskVulkanPipeline)
 
 GskVulkanPipeline * gsk_vulkan_cross_fade_pipeline_new                 (GdkVulkanContext           *context,
+                                                                        VkPipelineCache             cache,
                                                                         VkPipelineLayout            layout,
                                                                         const char                 *shader_name,
                                                                         VkRenderPass                render_pass);
@@ -116,6 +116,7 @@ typedef struct {
   PangoFont *font;
   PangoGlyph glyph;
   guint scale; /* times 1024 */
+  guint xshift; /* in 1/GSK_SUBPIXEL_POSITIONS pixels */
 } GlyphCacheKey;
 
 static gboolean
@@ -126,7 +127,8 @@ glyph_cache_equal (gconstpointer v1, gconstpointer v2)
 
   return key1->font == key2->font &&
          key1->glyph == key2->glyph &&
-         key1->scale == key2->scale;
+         key1->scale == key2->scale &&
+         key1->xshift == key2->xshift;
 }
 
 static guint
@@ -134,7 +136,7 @@ glyph_cache_hash (gconstpointer v)
 {
   const GlyphCacheKey *key = v;
 
-  return GPOINTER_TO_UINT (key->font) ^ key->glyph ^ key->scale;
+  return GPOINTER_TO_UINT (key->font) ^ key->glyph ^ key->scale ^ (key->xshift << 24);
 }
 
 static void
@@ -270,6 +272,8 @@ render_glyph (Atlas          *atlas,
     gi.geometry.x_offset = 0;
   else
     gi.geometry.x_offset = - value->draw_x * 1024;
+  /* The subpixel shift is in device pixels */
+  gi.geometry.x_offset += key->xshift * 1024 * 1024 / (GSK_SUBPIXEL_POSITIONS * key->scale);
   gi.geometry.y_offset = - value->draw_y * 1024;
 
   glyphs.num_glyphs = 1;
@@ -333,6 +337,7 @@ gsk_vulkan_glyph_cache_lookup (GskVulkanGlyphCache *cache,
                                gboolean             create,
                                PangoFont           *font,
                                PangoGlyph           glyph,
+                               guint                xshift,
                                float                scale)
 {
   GlyphCacheKey lookup_key;
@@ -341,6 +346,7 @@ gsk_vulkan_glyph_cache_lookup (GskVulkanGlyphCache *cache,
   lookup_key.font = font;
   lookup_key.glyph = glyph;
   lookup_key.scale = (guint)(scale * 1024);
+  lookup_key.xshift = xshift;
 
   value = g_hash_table_lookup (cache->hash_table, &lookup_key);
 
@@ -372,9 +378,14 @@ gsk_vulkan_glyph_cache_lookup (GskVulkanGlyphCache *cache,
       value->draw_height = ink_rect.height;
       value->timestamp = cache->timestamp;
 
+      /* Shifted glyphs can bleed into the next pixel */
+      if (xshift != 0 && ink_rect.width > 0)
+        value->draw_width += 1;
+
       key->font = g_object_ref (font);
       key->glyph = glyph;
       key->scale = (guint)(scale * 1024);
+      key->xshift = xshift;
 
       if (ink_rect.width > 0 && ink_rect.height > 0)
         add_to_cache (cache, key, value);
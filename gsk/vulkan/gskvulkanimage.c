@@ -6,6 +6,8 @@
 #include "gskvulkanmemoryprivate.h"
 #include "gskvulkanpipelineprivate.h"
 
+#include "gdk/gdkmemorytextureprivate.h"
+
 #include <string.h>
 
 struct _GskVulkanUploader
@@ -241,48 +243,57 @@ gsk_vulkan_image_new (GdkVulkanContext      *context,
   self->memory = gsk_vulkan_memory_new (context,
                                         requirements.memoryTypeBits,
                                         memory,
-                                        requirements.size);
+                                        requirements.size,
+                                        requirements.alignment);
 
   GSK_VK_CHECK (vkBindImageMemory, gdk_vulkan_context_get_device (context),
                                    self->vk_image,
                                    gsk_vulkan_memory_get_device_memory (self->memory),
-                                   0);
+                                   gsk_vulkan_memory_get_offset (self->memory));
   return self;
 }
 
+/* Copies pixels in @format into the B8G8R8A8 premultiplied layout of
+ * our images, converting them on the way if necessary */
+static void
+copy_pixels (guchar          *dest,
+             gsize            dest_stride,
+             const guchar    *src,
+             gsize            src_stride,
+             GdkMemoryFormat  format,
+             gsize            width,
+             gsize            height)
+{
+  if (format == GDK_MEMORY_DEFAULT && src_stride == width * 4 && dest_stride == src_stride)
+    memcpy (dest, src, src_stride * height);
+  else
+    gdk_memory_convert (dest, dest_stride, GDK_MEMORY_DEFAULT,
+                        src, src_stride, format,
+                        width, height);
+}
+
 static void
-gsk_vulkan_image_upload_data (GskVulkanImage *self,
-                              guchar         *data,
-                              gsize           width,
-                              gsize           height,
-                              gsize           data_stride)
+gsk_vulkan_image_upload_data (GskVulkanImage  *self,
+                              const guchar    *data,
+                              GdkMemoryFormat  format,
+                              gsize            width,
+                              gsize            height,
+                              gsize            data_stride)
 {
   VkImageSubresource image_res;
   VkSubresourceLayout image_layout;
-  gsize mem_stride;
   guchar *mem;
 
   image_res.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
   image_res.mipLevel = 0;
   image_res.arrayLayer = 0;
 
-  mem_stride = width * 4;
   vkGetImageSubresourceLayout (gdk_vulkan_context_get_device (self->vulkan),
                                self->vk_image, &image_res, &image_layout);
 
   mem = gsk_vulkan_memory_map (self->memory) + image_layout.offset;
 
-  if (image_layout.rowPitch == width * 4 && data_stride == mem_stride)
-    {
-      memcpy (mem, data, data_stride * height);
-    }
-  else
-    {
-      for (gsize i = 0; i < height; i++)
-        {
-          memcpy (mem + i * image_layout.rowPitch, data + i * data_stride, width * 4);
-        }
-    }
+  copy_pixels (mem, image_layout.rowPitch, data, data_stride, format, width, height);
 
   gsk_vulkan_memory_unmap (self->memory);
 }
@@ -318,7 +329,8 @@ gsk_vulkan_image_ensure_view (GskVulkanImage *self,
 
 static GskVulkanImage *
 gsk_vulkan_image_new_from_data_via_staging_buffer (GskVulkanUploader *uploader,
-                                                   guchar            *data,
+                                                   const guchar      *data,
+                                                   GdkMemoryFormat    format,
                                                    gsize              width,
                                                    gsize              height,
                                                    gsize              stride)
@@ -331,17 +343,7 @@ gsk_vulkan_image_new_from_data_via_staging_buffer (GskVulkanUploader *uploader,
   staging = gsk_vulkan_buffer_new_staging (uploader->vulkan, buffer_size);
   mem = gsk_vulkan_buffer_map (staging);
 
-  if (stride == width * 4)
-    {
-      memcpy (mem, data, stride * height);
-    }
-  else
-    {
-      for (gsize i = 0; i < height; i++)
-        {
-          memcpy (mem + i * width * 4, data + i * stride, width * 4);
-        }
-    }
+  copy_pixels (mem, width * 4, data, stride, format, width, height);
 
   gsk_vulkan_buffer_unmap (staging);
 
@@ -412,7 +414,8 @@ gsk_vulkan_image_new_from_data_via_staging_buffer (GskVulkanUploader *uploader,
 
 static GskVulkanImage *
 gsk_vulkan_image_new_from_data_via_staging_image (GskVulkanUploader *uploader,
-                                                  guchar            *data,
+                                                  const guchar      *data,
+                                                  GdkMemoryFormat    format,
                                                   gsize              width,
                                                   gsize              height,
                                                   gsize              stride)
@@ -429,7 +432,7 @@ gsk_vulkan_image_new_from_data_via_staging_image (GskVulkanUploader *uploader,
                                   VK_ACCESS_TRANSFER_WRITE_BIT,
                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
 
-  gsk_vulkan_image_upload_data (staging, data, width, height, stride);
+  gsk_vulkan_image_upload_data (staging, data, format, width, height, stride);
 
   self = gsk_vulkan_image_new (uploader->vulkan,
                                width,
@@ -496,7 +499,8 @@ gsk_vulkan_image_new_from_data_via_staging_image (GskVulkanUploader *uploader,
 
 static GskVulkanImage *
 gsk_vulkan_image_new_from_data_directly (GskVulkanUploader *uploader,
-                                         guchar            *data,
+                                         const guchar      *data,
+                                         GdkMemoryFormat    format,
                                          gsize              width,
                                          gsize              height,
                                          gsize              stride)
@@ -512,7 +516,7 @@ gsk_vulkan_image_new_from_data_directly (GskVulkanUploader *uploader,
                                VK_ACCESS_HOST_WRITE_BIT,
                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
 
-  gsk_vulkan_image_upload_data (self, data, width, height, stride);
+  gsk_vulkan_image_upload_data (self, data, format, width, height, stride);
 
   gsk_vulkan_uploader_add_image_barrier (uploader,
                                          TRUE,
@@ -525,6 +529,25 @@ gsk_vulkan_image_new_from_data_directly (GskVulkanUploader *uploader,
   return self;
 }
 
+/* Creates an image from pixels in any #GdkMemoryFormat. They are
+ * converted while they are copied to the image memory, so there is no
+ * need to convert them beforehand. */
+GskVulkanImage *
+gsk_vulkan_image_new_from_memory (GskVulkanUploader *uploader,
+                                  const guchar      *data,
+                                  GdkMemoryFormat    format,
+                                  gsize              width,
+                                  gsize              height,
+                                  gsize              stride)
+{
+  if (GSK_DEBUG_CHECK (VULKAN_STAGING_BUFFER))
+    return gsk_vulkan_image_new_from_data_via_staging_buffer (uploader, data, format, width, height, stride);
+  else if (GSK_DEBUG_CHECK (VULKAN_STAGING_IMAGE))
+    return gsk_vulkan_image_new_from_data_via_staging_image (uploader, data, format, width, height, stride);
+  else
+    return gsk_vulkan_image_new_from_data_directly (uploader, data, format, width, height, stride);
+}
+
 GskVulkanImage *
 gsk_vulkan_image_new_from_data (GskVulkanUploader *uploader,
                                 guchar            *data,
@@ -532,12 +555,7 @@ gsk_vulkan_image_new_from_data (GskVulkanUploader *uploader,
                                 gsize              height,
                                 gsize              stride)
 {
-  if (GSK_DEBUG_CHECK (VULKAN_STAGING_BUFFER))
-    return gsk_vulkan_image_new_from_data_via_staging_buffer (uploader, data, width, height, stride);
-  else if (GSK_DEBUG_CHECK (VULKAN_STAGING_IMAGE))
-    return gsk_vulkan_image_new_from_data_via_staging_image (uploader, data, width, height, stride);
-  else
-    return gsk_vulkan_image_new_from_data_directly (uploader, data, width, height, stride);
+  return gsk_vulkan_image_new_from_memory (uploader, data, GDK_MEMORY_DEFAULT, width, height, stride);
 }
 
 GskVulkanImage *
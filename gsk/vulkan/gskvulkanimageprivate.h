@@ -30,6 +30,12 @@ GskVulkanImage *        gsk_vulkan_image_new_from_data                  (GskVulk
                                                                          gsize                   width,
                                                                          gsize                   height,
                                                                          gsize                   stride);
+GskVulkanImage *        gsk_vulkan_image_new_from_memory                (GskVulkanUploader      *uploader,
+                                                                         const guchar           *data,
+                                                                         GdkMemoryFormat         format,
+                                                                         gsize                   width,
+                                                                         gsize                   height,
+                                                                         gsize                   stride);
 
 typedef struct {
   guchar *data;
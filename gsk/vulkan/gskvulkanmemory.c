@@ -3,62 +3,412 @@
 #include "gskvulkanpipelineprivate.h"
 #include "gskvulkanmemoryprivate.h"
 
+/* Memory is sub-allocated from blocks of this size, one list of blocks
+ * per memory type. Larger requests get a block of their own. */
+#define BLOCK_SIZE (16 * 1024 * 1024)
+#define DEDICATED_THRESHOLD (BLOCK_SIZE / 2)
+
+typedef struct _GskVulkanAllocator GskVulkanAllocator;
+typedef struct _GskVulkanMemoryBlock GskVulkanMemoryBlock;
+
+typedef struct
+{
+  VkDeviceSize offset;
+  VkDeviceSize size;
+} FreeRange;
+
+struct _GskVulkanMemoryBlock
+{
+  GskVulkanAllocator *allocator;
+
+  uint32_t type_index;
+  VkDeviceSize size;
+  VkDeviceMemory vk_memory;
+
+  /* Host visible blocks stay mapped for their whole lifetime */
+  guchar *map;
+
+  /* FreeRange, sorted by offset */
+  GArray *free_ranges;
+  guint n_allocations;
+
+  guint dedicated : 1;
+};
+
+struct _GskVulkanAllocator
+{
+  GdkVulkanContext *vulkan;
+
+  VkPhysicalDeviceMemoryProperties properties;
+  VkDeviceSize buffer_image_granularity;
+  VkDeviceSize non_coherent_atom_size;
+
+  /* GskVulkanMemoryBlock, one array per memory type */
+  GPtrArray *blocks[VK_MAX_MEMORY_TYPES];
+
+  GskVulkanMemoryStats stats;
+
+  /* Set by gsk_vulkan_memory_trim() until the next allocation, memory
+   * freed after it must not leave empty blocks behind */
+  guint trimmed : 1;
+};
+
 struct _GskVulkanMemory
 {
   GdkVulkanContext *vulkan;
 
-  gsize size;
+  GskVulkanMemoryBlock *block;
 
-  VkDeviceMemory vk_memory;
+  VkDeviceSize offset;
+  VkDeviceSize size;
 };
 
+static GQuark allocator_quark;
+
+static void
+gsk_vulkan_memory_block_free (GskVulkanMemoryBlock *block)
+{
+  GskVulkanAllocator *allocator = block->allocator;
+  VkDevice device = gdk_vulkan_context_get_device (allocator->vulkan);
+
+  g_assert (block->n_allocations == 0);
+
+  if (block->map)
+    vkUnmapMemory (device, block->vk_memory);
+
+  vkFreeMemory (device, block->vk_memory, NULL);
+
+  allocator->stats.n_blocks--;
+  allocator->stats.allocated -= block->size;
+
+  g_array_unref (block->free_ranges);
+  g_slice_free (GskVulkanMemoryBlock, block);
+}
+
+static void
+gsk_vulkan_allocator_free (gpointer data)
+{
+  GskVulkanAllocator *allocator = data;
+  uint32_t i;
+
+  /* Called when the context is finalized, at which point the device is
+   * gone. gsk_vulkan_memory_trim() must have released all blocks, and
+   * every GskVulkanMemory keeps the context alive. */
+  for (i = 0; i < VK_MAX_MEMORY_TYPES; i++)
+    {
+      if (allocator->blocks[i])
+        {
+          g_warn_if_fail (allocator->blocks[i]->len == 0);
+          g_ptr_array_unref (allocator->blocks[i]);
+        }
+    }
+
+  g_slice_free (GskVulkanAllocator, allocator);
+}
+
+static GskVulkanAllocator *
+gsk_vulkan_allocator_get (GdkVulkanContext *context)
+{
+  GskVulkanAllocator *allocator;
+  VkPhysicalDeviceProperties device_properties;
+
+  if (G_UNLIKELY (allocator_quark == 0))
+    allocator_quark = g_quark_from_static_string ("gsk-vulkan-allocator");
+
+  allocator = g_object_get_qdata (G_OBJECT (context), allocator_quark);
+  if (allocator)
+    return allocator;
+
+  allocator = g_slice_new0 (GskVulkanAllocator);
+  allocator->vulkan = context;
+
+  vkGetPhysicalDeviceMemoryProperties (gdk_vulkan_context_get_physical_device (context),
+                                       &allocator->properties);
+  vkGetPhysicalDeviceProperties (gdk_vulkan_context_get_physical_device (context),
+                                 &device_properties);
+  allocator->buffer_image_granularity = MAX (device_properties.limits.bufferImageGranularity, 1);
+  allocator->non_coherent_atom_size = MAX (device_properties.limits.nonCoherentAtomSize, 1);
+
+  g_object_set_qdata_full (G_OBJECT (context), allocator_quark,
+                           allocator, gsk_vulkan_allocator_free);
+
+  return allocator;
+}
+
+static gboolean
+gsk_vulkan_allocator_is_coherent (GskVulkanAllocator *allocator,
+                                  uint32_t            type_index)
+{
+  return (allocator->properties.memoryTypes[type_index].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+}
+
+static GskVulkanMemoryBlock *
+gsk_vulkan_memory_block_new (GskVulkanAllocator *allocator,
+                             uint32_t            type_index,
+                             VkDeviceSize        size,
+                             gboolean            dedicated)
+{
+  VkDevice device = gdk_vulkan_context_get_device (allocator->vulkan);
+  GskVulkanMemoryBlock *block;
+  FreeRange range = { 0, size };
+
+  block = g_slice_new0 (GskVulkanMemoryBlock);
+  block->allocator = allocator;
+  block->type_index = type_index;
+  block->size = size;
+  block->dedicated = dedicated;
+  block->free_ranges = g_array_new (FALSE, FALSE, sizeof (FreeRange));
+  g_array_append_val (block->free_ranges, range);
+
+  GSK_VK_CHECK (vkAllocateMemory, device,
+                                  &(VkMemoryAllocateInfo) {
+                                      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+                                      .allocationSize = size,
+                                      .memoryTypeIndex = type_index
+                                  },
+                                  NULL,
+                                  &block->vk_memory);
+
+  if (allocator->properties.memoryTypes[type_index].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+      void *data;
+
+      GSK_VK_CHECK (vkMapMemory, device,
+                                 block->vk_memory,
+                                 0,
+                                 VK_WHOLE_SIZE,
+                                 0,
+                                 &data);
+      block->map = data;
+    }
+
+  allocator->stats.n_blocks++;
+  allocator->stats.allocated += size;
+
+  return block;
+}
+
+/* First fit. Leading padding stays in the free list. */
+static gboolean
+gsk_vulkan_memory_block_alloc (GskVulkanMemoryBlock *block,
+                               VkDeviceSize          size,
+                               VkDeviceSize          alignment,
+                               VkDeviceSize         *offset)
+{
+  guint i;
+
+  for (i = 0; i < block->free_ranges->len; i++)
+    {
+      FreeRange *range = &g_array_index (block->free_ranges, FreeRange, i);
+      VkDeviceSize start, end;
+
+      start = (range->offset + alignment - 1) / alignment * alignment;
+      end = range->offset + range->size;
+      if (start + size > end)
+        continue;
+
+      *offset = start;
+
+      if (start + size < end)
+        {
+          FreeRange tail = { start + size, end - start - size };
+
+          if (start > range->offset)
+            {
+              range->size = start - range->offset;
+              g_array_insert_val (block->free_ranges, i + 1, tail);
+            }
+          else
+            *range = tail;
+        }
+      else if (start > range->offset)
+        range->size = start - range->offset;
+      else
+        g_array_remove_index (block->free_ranges, i);
+
+      block->n_allocations++;
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+gsk_vulkan_memory_block_release (GskVulkanMemoryBlock *block,
+                                 VkDeviceSize          offset,
+                                 VkDeviceSize          size)
+{
+  FreeRange range = { offset, size };
+  FreeRange *prev, *next;
+  guint i;
+
+  for (i = 0; i < block->free_ranges->len; i++)
+    {
+      if (g_array_index (block->free_ranges, FreeRange, i).offset > offset)
+        break;
+    }
+
+  g_array_insert_val (block->free_ranges, i, range);
+
+  /* Coalesce with the following and the preceding range */
+  if (i + 1 < block->free_ranges->len)
+    {
+      FreeRange *cur = &g_array_index (block->free_ranges, FreeRange, i);
+
+      next = &g_array_index (block->free_ranges, FreeRange, i + 1);
+      if (cur->offset + cur->size == next->offset)
+        {
+          cur->size += next->size;
+          g_array_remove_index (block->free_ranges, i + 1);
+        }
+    }
+  if (i > 0)
+    {
+      FreeRange *cur = &g_array_index (block->free_ranges, FreeRange, i);
+
+      prev = &g_array_index (block->free_ranges, FreeRange, i - 1);
+      if (prev->offset + prev->size == cur->offset)
+        {
+          prev->size += cur->size;
+          g_array_remove_index (block->free_ranges, i);
+        }
+    }
+
+  block->n_allocations--;
+}
+
+static uint32_t
+gsk_vulkan_allocator_find_type (GskVulkanAllocator    *allocator,
+                                uint32_t               allowed_types,
+                                VkMemoryPropertyFlags  flags)
+{
+  uint32_t i;
+
+  for (i = 0; i < allocator->properties.memoryTypeCount; i++)
+    {
+      if (!(allowed_types & (1 << i)))
+        continue;
+
+      if ((allocator->properties.memoryTypes[i].propertyFlags & flags) == flags)
+        break;
+  }
+
+  g_assert (i < allocator->properties.memoryTypeCount);
+
+  return i;
+}
+
 GskVulkanMemory *
 gsk_vulkan_memory_new (GdkVulkanContext      *context,
                        uint32_t               allowed_types,
                        VkMemoryPropertyFlags  flags,
-                       gsize                  size)
+                       gsize                  size,
+                       gsize                  alignment)
 {
-  VkPhysicalDeviceMemoryProperties properties;
+  GskVulkanAllocator *allocator;
+  GskVulkanMemoryBlock *block;
   GskVulkanMemory *self;
-  uint32_t i;
+  GPtrArray *blocks;
+  uint32_t type_index;
+  guint i;
+
+  allocator = gsk_vulkan_allocator_get (context);
+  type_index = gsk_vulkan_allocator_find_type (allocator, allowed_types, flags);
+
+  /* Linear and optimal resources may share a block, so keep them on
+   * separate pages. Non-coherent memory is flushed in whole atoms. */
+  alignment = MAX (alignment, 1);
+  alignment = MAX (alignment, allocator->buffer_image_granularity);
+  if (!gsk_vulkan_allocator_is_coherent (allocator, type_index))
+    alignment = MAX (alignment, allocator->non_coherent_atom_size);
+
+  allocator->trimmed = FALSE;
 
   self = g_slice_new0 (GskVulkanMemory);
 
   self->vulkan = g_object_ref (context);
   self->size = size;
 
-  vkGetPhysicalDeviceMemoryProperties (gdk_vulkan_context_get_physical_device (context),
-                                       &properties);
+  if (allocator->blocks[type_index] == NULL)
+    allocator->blocks[type_index] = g_ptr_array_new ();
+  blocks = allocator->blocks[type_index];
 
-  for (i = 0; i < properties.memoryTypeCount; i++)
+  block = NULL;
+  if (size > DEDICATED_THRESHOLD)
     {
-      if (!(allowed_types & (1 << i)))
-        continue;
+      block = gsk_vulkan_memory_block_new (allocator, type_index, size, TRUE);
+      gsk_vulkan_memory_block_alloc (block, size, 1, &self->offset);
+      g_ptr_array_add (blocks, block);
+    }
+  else
+    {
+      for (i = 0; i < blocks->len; i++)
+        {
+          GskVulkanMemoryBlock *b = g_ptr_array_index (blocks, i);
 
-      if ((properties.memoryTypes[i].propertyFlags & flags) == flags)
-        break;
-  }
+          if (!b->dedicated &&
+              gsk_vulkan_memory_block_alloc (b, size, alignment, &self->offset))
+            {
+              block = b;
+              break;
+            }
+        }
 
-  g_assert (i < properties.memoryTypeCount);
+      if (block == NULL)
+        {
+          block = gsk_vulkan_memory_block_new (allocator, type_index, BLOCK_SIZE, FALSE);
+          if (!gsk_vulkan_memory_block_alloc (block, size, alignment, &self->offset))
+            g_assert_not_reached ();
+          g_ptr_array_add (blocks, block);
+        }
+    }
 
-  GSK_VK_CHECK (vkAllocateMemory, gdk_vulkan_context_get_device (context),
-                                  &(VkMemoryAllocateInfo) {
-                                      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-                                      .allocationSize = size,
-                                      .memoryTypeIndex = i
-                                  },
-                                  NULL,
-                                  &self->vk_memory);
+  self->block = block;
+
+  allocator->stats.n_allocations++;
+  allocator->stats.used += size;
 
   return self;
 }
 
+static gboolean
+gsk_vulkan_allocator_has_empty_block (GskVulkanAllocator   *allocator,
+                                      GskVulkanMemoryBlock *except)
+{
+  GPtrArray *blocks = allocator->blocks[except->type_index];
+  guint i;
+
+  for (i = 0; i < blocks->len; i++)
+    {
+      GskVulkanMemoryBlock *b = g_ptr_array_index (blocks, i);
+
+      if (b != except && b->n_allocations == 0)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
 void
 gsk_vulkan_memory_free (GskVulkanMemory *self)
 {
-  vkFreeMemory (gdk_vulkan_context_get_device (self->vulkan),
-                self->vk_memory,
-                NULL);
+  GskVulkanMemoryBlock *block = self->block;
+  GskVulkanAllocator *allocator = block->allocator;
+
+  gsk_vulkan_memory_block_release (block, self->offset, self->size);
+
+  allocator->stats.n_allocations--;
+  allocator->stats.used -= self->size;
+
+  /* Keep one empty block per memory type around, so that resources
+   * that are recreated every frame don't allocate device memory. */
+  if (block->n_allocations == 0 &&
+      (block->dedicated || allocator->trimmed ||
+       gsk_vulkan_allocator_has_empty_block (allocator, block)))
+    {
+      g_ptr_array_remove_fast (allocator->blocks[block->type_index], block);
+      gsk_vulkan_memory_block_free (block);
+    }
 
   g_object_unref (self->vulkan);
 
@@ -68,28 +418,111 @@ gsk_vulkan_memory_free (GskVulkanMemory *self)
 VkDeviceMemory
 gsk_vulkan_memory_get_device_memory (GskVulkanMemory *self)
 {
-  return self->vk_memory;
+  return self->block->vk_memory;
+}
+
+VkDeviceSize
+gsk_vulkan_memory_get_offset (GskVulkanMemory *self)
+{
+  return self->offset;
+}
+
+static VkMappedMemoryRange
+gsk_vulkan_memory_get_mapped_range (GskVulkanMemory *self)
+{
+  GskVulkanMemoryBlock *block = self->block;
+  VkDeviceSize atom = block->allocator->non_coherent_atom_size;
+  VkDeviceSize start, end;
+
+  start = self->offset / atom * atom;
+  end = MIN ((self->offset + self->size + atom - 1) / atom * atom, block->size);
+
+  return (VkMappedMemoryRange) {
+      .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+      .memory = block->vk_memory,
+      .offset = start,
+      .size = end - start
+  };
 }
 
 guchar *
 gsk_vulkan_memory_map (GskVulkanMemory *self)
 {
-  void *data;
+  GskVulkanMemoryBlock *block = self->block;
 
-  GSK_VK_CHECK (vkMapMemory, gdk_vulkan_context_get_device (self->vulkan),
-                             self->vk_memory,
-                             0,
-                             self->size,
-                             0,
-                             &data);
+  g_assert (block->map != NULL);
 
-  return data;
+  if (!gsk_vulkan_allocator_is_coherent (block->allocator, block->type_index))
+    {
+      VkMappedMemoryRange range = gsk_vulkan_memory_get_mapped_range (self);
+
+      GSK_VK_CHECK (vkInvalidateMappedMemoryRanges, gdk_vulkan_context_get_device (self->vulkan),
+                                                    1,
+                                                    &range);
+    }
+
+  return block->map + self->offset;
 }
 
 void
 gsk_vulkan_memory_unmap (GskVulkanMemory *self)
 {
-  vkUnmapMemory (gdk_vulkan_context_get_device (self->vulkan),
-                 self->vk_memory);
+  GskVulkanMemoryBlock *block = self->block;
+
+  /* The block stays mapped, we only need to make writes visible */
+  if (!gsk_vulkan_allocator_is_coherent (block->allocator, block->type_index))
+    {
+      VkMappedMemoryRange range = gsk_vulkan_memory_get_mapped_range (self);
+
+      GSK_VK_CHECK (vkFlushMappedMemoryRanges, gdk_vulkan_context_get_device (self->vulkan),
+                                               1,
+                                               &range);
+    }
+}
+
+void
+gsk_vulkan_memory_trim (GdkVulkanContext *context)
+{
+  GskVulkanAllocator *allocator;
+  uint32_t i;
+  guint j;
+
+  if (allocator_quark == 0)
+    return;
+
+  allocator = g_object_get_qdata (G_OBJECT (context), allocator_quark);
+  if (allocator == NULL)
+    return;
+
+  allocator->trimmed = TRUE;
+
+  for (i = 0; i < VK_MAX_MEMORY_TYPES; i++)
+    {
+      GPtrArray *blocks = allocator->blocks[i];
+
+      if (blocks == NULL)
+        continue;
+
+      for (j = blocks->len; j > 0; j--)
+        {
+          GskVulkanMemoryBlock *block = g_ptr_array_index (blocks, j - 1);
+
+          if (block->n_allocations == 0)
+            {
+              g_ptr_array_remove_index_fast (blocks, j - 1);
+              gsk_vulkan_memory_block_free (block);
+            }
+        }
+    }
 }
 
+void
+gsk_vulkan_memory_get_stats (GdkVulkanContext     *context,
+                             GskVulkanMemoryStats *stats)
+{
+  GskVulkanAllocator *allocator;
+
+  allocator = gsk_vulkan_allocator_get (context);
+
+  *stats = allocator->stats;
+}
@@ -6,6 +6,9 @@
 #include "gskvulkanshaderprivate.h"
 
 #include <graphene.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <string.h>
 
 typedef struct _GskVulkanPipelinePrivate GskVulkanPipelinePrivate;
 
@@ -56,11 +59,12 @@ gsk_vulkan_pipeline_init (GskVulkanPipeline *self)
 GskVulkanPipeline *
 gsk_vulkan_pipeline_new (GType                    pipeline_type,
                          GdkVulkanContext        *context,
+                         VkPipelineCache          cache,
                          VkPipelineLayout         layout,
                          const char              *shader_name,
                          VkRenderPass             render_pass)
 {
-  return gsk_vulkan_pipeline_new_full (pipeline_type, context, layout, shader_name, render_pass,
+  return gsk_vulkan_pipeline_new_full (pipeline_type, context, cache, layout, shader_name, render_pass,
                                        VK_BLEND_FACTOR_ONE,
                                        VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA);
 }
@@ -68,6 +72,7 @@ gsk_vulkan_pipeline_new (GType                    pipeline_type,
 GskVulkanPipeline *
 gsk_vulkan_pipeline_new_full (GType                    pipeline_type,
                               GdkVulkanContext        *context,
+                              VkPipelineCache          cache,
                               VkPipelineLayout         layout,
                               const char              *shader_name,
                               VkRenderPass             render_pass,
@@ -96,7 +101,7 @@ gsk_vulkan_pipeline_new_full (GType                    pipeline_type,
   priv->fragment_shader = gsk_vulkan_shader_new_from_resource (context, GSK_VULKAN_SHADER_FRAGMENT, shader_name, NULL);
 
   GSK_VK_CHECK (vkCreateGraphicsPipelines, device,
-                                           VK_NULL_HANDLE,
+                                           cache,
                                            1,
                                            &(VkGraphicsPipelineCreateInfo) {
                                                .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
@@ -187,3 +192,147 @@ gsk_vulkan_pipeline_get_pipeline_layout (GskVulkanPipeline *self)
 
   return priv->layout;
 }
+
+/* The pipeline cache is stored in the user cache directory, one file per
+ * GTK version and driver. The driver validates the contents, but we check
+ * the header ourselves so we can tell when the file is stale. */
+static char *
+gsk_vulkan_pipeline_cache_get_path (const VkPhysicalDeviceProperties *props)
+{
+  GString *basename;
+  char *path;
+  guint i;
+
+  basename = g_string_new ("pipelines-" GTK_VERSION "-");
+  for (i = 0; i < VK_UUID_SIZE; i++)
+    g_string_append_printf (basename, "%02x", props->pipelineCacheUUID[i]);
+  g_string_append (basename, ".cache");
+
+  path = g_build_filename (g_get_user_cache_dir (), "gtk-4.0", "vulkan", basename->str, NULL);
+
+  g_string_free (basename, TRUE);
+
+  return path;
+}
+
+static gboolean
+gsk_vulkan_pipeline_cache_data_is_valid (const guchar                     *data,
+                                         gsize                             size,
+                                         const VkPhysicalDeviceProperties *props)
+{
+  guint32 header[4];
+
+  if (size < sizeof (header) + VK_UUID_SIZE)
+    return FALSE;
+
+  /* All header fields are little endian */
+  memcpy (header, data, sizeof (header));
+
+  return GUINT32_FROM_LE (header[0]) >= sizeof (header) + VK_UUID_SIZE &&
+         GUINT32_FROM_LE (header[1]) == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         GUINT32_FROM_LE (header[2]) == props->vendorID &&
+         GUINT32_FROM_LE (header[3]) == props->deviceID &&
+         memcmp (data + sizeof (header), props->pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+VkPipelineCache
+gsk_vulkan_pipeline_cache_new (GdkVulkanContext *context,
+                               gsize            *loaded_size)
+{
+  VkPhysicalDeviceProperties props;
+  VkPipelineCache cache;
+  VkResult res;
+  char *path, *data;
+  gsize size;
+
+  vkGetPhysicalDeviceProperties (gdk_vulkan_context_get_physical_device (context), &props);
+
+  path = gsk_vulkan_pipeline_cache_get_path (&props);
+  if (!g_file_get_contents (path, &data, &size, NULL))
+    {
+      data = NULL;
+      size = 0;
+    }
+  else if (!gsk_vulkan_pipeline_cache_data_is_valid ((guchar *) data, size, &props))
+    {
+      GSK_NOTE (VULKAN, g_message ("Ignoring stale pipeline cache %s", path));
+      g_clear_pointer (&data, g_free);
+      size = 0;
+    }
+
+  /* Not GSK_VK_CHECK(), pipelines can be created without a cache, so
+   * failing to create one is not worth a critical */
+  res = vkCreatePipelineCache (gdk_vulkan_context_get_device (context),
+                               &(VkPipelineCacheCreateInfo) {
+                                   .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+                                   .initialDataSize = size,
+                                   .pInitialData = data
+                               },
+                               NULL,
+                               &cache);
+  if (res != VK_SUCCESS)
+    {
+      GSK_NOTE (VULKAN, g_message ("Could not create pipeline cache: %s", gdk_vulkan_strerror (res)));
+      cache = VK_NULL_HANDLE;
+      size = 0;
+    }
+  else if (size > 0)
+    GSK_NOTE (VULKAN, g_message ("Loaded %" G_GSIZE_FORMAT " bytes of pipeline cache from %s", size, path));
+
+  *loaded_size = size;
+
+  g_free (data);
+  g_free (path);
+
+  return cache;
+}
+
+/* Writes the cache back to disk if pipelines were added since it was
+ * loaded, then destroys it */
+void
+gsk_vulkan_pipeline_cache_free (GdkVulkanContext *context,
+                                VkPipelineCache   cache,
+                                gsize             loaded_size)
+{
+  VkDevice device = gdk_vulkan_context_get_device (context);
+  VkPhysicalDeviceProperties props;
+  GError *error = NULL;
+  char *path, *dir;
+  guchar *data;
+  size_t size;
+
+  if (cache == VK_NULL_HANDLE)
+    return;
+
+  if (GSK_VK_CHECK (vkGetPipelineCacheData, device, cache, &size, NULL) != VK_SUCCESS ||
+      size <= loaded_size)
+    {
+      vkDestroyPipelineCache (device, cache, NULL);
+      return;
+    }
+
+  data = g_malloc (size);
+  if (GSK_VK_CHECK (vkGetPipelineCacheData, device, cache, &size, data) == VK_SUCCESS)
+    {
+      vkGetPhysicalDeviceProperties (gdk_vulkan_context_get_physical_device (context), &props);
+
+      path = gsk_vulkan_pipeline_cache_get_path (&props);
+      dir = g_path_get_dirname (path);
+
+      if (g_mkdir_with_parents (dir, 0755) != 0 ||
+          !g_file_set_contents (path, (char *) data, size, &error))
+        {
+          GSK_NOTE (VULKAN, g_message ("Failed to write pipeline cache %s: %s",
+                                       path, error ? error->message : g_strerror (errno)));
+          g_clear_error (&error);
+        }
+      else
+        GSK_NOTE (VULKAN, g_message ("Wrote %" G_GSIZE_FORMAT " bytes of pipeline cache to %s", (gsize) size, path));
+
+      g_free (dir);
+      g_free (path);
+    }
+
+  g_free (data);
+  vkDestroyPipelineCache (device, cache, NULL);
+}
@@ -8,13 +8,21 @@
 #include "gskrendernodeprivate.h"
 #include "gskvulkanbufferprivate.h"
 #include "gskvulkanimageprivate.h"
+#include "gskvulkanmemoryprivate.h"
 #include "gskvulkanpipelineprivate.h"
 #include "gskvulkanrenderprivate.h"
 #include "gskvulkanglyphcacheprivate.h"
 
 #include "gdk/gdktextureprivate.h"
+#include "gdk/gdkmemorytextureprivate.h"
 
 #include <graphene.h>
+#include <string.h>
+
+/* Fallback images that haven't been used for this many frames are
+ * dropped, as are the oldest ones when the cache exceeds its budget */
+#define FALLBACK_CACHE_MAX_AGE 60
+#define FALLBACK_CACHE_BUDGET (32 * 1024 * 1024)
 
 typedef struct _GskVulkanTextureData GskVulkanTextureData;
 
@@ -24,12 +32,29 @@ struct _GskVulkanTextureData {
   GskVulkanRenderer *renderer;
 };
 
+typedef struct {
+  /* key */
+  GskRenderNode *node;
+  int scale_factor;
+  gboolean has_clip;
+  GskRoundedRect clip;
+
+  GskVulkanImage *image;
+  gsize size;
+  guint64 last_used;
+} FallbackCacheEntry;
+
 #ifdef G_ENABLE_DEBUG
 typedef struct {
   GQuark frames;
   GQuark render_passes;
   GQuark fallback_pixels;
+  GQuark fallback_cache_hits;
   GQuark texture_pixels;
+  GQuark memory_blocks;
+  GQuark memory_allocations;
+  GQuark memory_allocated;
+  GQuark memory_used;
 } ProfileCounters;
 
 typedef struct {
@@ -44,6 +69,9 @@ struct _GskVulkanRenderer
 
   GdkVulkanContext *vulkan;
 
+  VkPipelineCache pipeline_cache;
+  gsize pipeline_cache_size;
+
   guint n_targets;
   GskVulkanImage **targets;
 
@@ -51,6 +79,10 @@ struct _GskVulkanRenderer
 
   GSList *textures;
 
+  GHashTable *fallback_cache;
+  gsize fallback_cache_size;
+  guint64 frame;
+
   GskVulkanGlyphCache *glyph_cache;
 
 #ifdef G_ENABLE_DEBUG
@@ -80,6 +112,92 @@ gsk_vulkan_renderer_free_targets (GskVulkanRenderer *self)
   self->n_targets = 0;
 }
 
+static guint
+fallback_cache_entry_hash (gconstpointer v)
+{
+  const FallbackCacheEntry *entry = v;
+
+  return g_direct_hash (entry->node) ^ entry->scale_factor;
+}
+
+static gboolean
+fallback_cache_entry_equal (gconstpointer v1,
+                            gconstpointer v2)
+{
+  const FallbackCacheEntry *entry1 = v1;
+  const FallbackCacheEntry *entry2 = v2;
+
+  if (entry1->node != entry2->node ||
+      entry1->scale_factor != entry2->scale_factor ||
+      entry1->has_clip != entry2->has_clip)
+    return FALSE;
+
+  return !entry1->has_clip ||
+         memcmp (&entry1->clip, &entry2->clip, sizeof (GskRoundedRect)) == 0;
+}
+
+static void
+fallback_cache_entry_free (gpointer data)
+{
+  FallbackCacheEntry *entry = data;
+
+  gsk_render_node_unref (entry->node);
+  g_clear_object (&entry->image);
+
+  g_slice_free (FallbackCacheEntry, entry);
+}
+
+static int
+fallback_cache_entry_compare_age (gconstpointer a,
+                                  gconstpointer b)
+{
+  const FallbackCacheEntry *entry1 = *(const FallbackCacheEntry **) a;
+  const FallbackCacheEntry *entry2 = *(const FallbackCacheEntry **) b;
+
+  return entry1->last_used < entry2->last_used ? -1 : (entry1->last_used > entry2->last_used ? 1 : 0);
+}
+
+/* Called once per frame, drops fallback images that weren't used
+ * recently and trims the cache down to its budget */
+static void
+gsk_vulkan_renderer_collect_fallback_images (GskVulkanRenderer *self)
+{
+  GHashTableIter iter;
+  FallbackCacheEntry *entry;
+  GPtrArray *entries;
+  guint i;
+
+  self->frame++;
+
+  g_hash_table_iter_init (&iter, self->fallback_cache);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &entry, NULL))
+    {
+      if (entry->last_used + FALLBACK_CACHE_MAX_AGE < self->frame)
+        {
+          self->fallback_cache_size -= entry->size;
+          g_hash_table_iter_remove (&iter);
+        }
+    }
+
+  if (self->fallback_cache_size <= FALLBACK_CACHE_BUDGET)
+    return;
+
+  entries = g_ptr_array_sized_new (g_hash_table_size (self->fallback_cache));
+  g_hash_table_iter_init (&iter, self->fallback_cache);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &entry, NULL))
+    g_ptr_array_add (entries, entry);
+  g_ptr_array_sort (entries, fallback_cache_entry_compare_age);
+
+  for (i = 0; i < entries->len && self->fallback_cache_size > FALLBACK_CACHE_BUDGET; i++)
+    {
+      entry = g_ptr_array_index (entries, i);
+      self->fallback_cache_size -= entry->size;
+      g_hash_table_remove (self->fallback_cache, entry);
+    }
+
+  g_ptr_array_unref (entries);
+}
+
 static void
 gsk_vulkan_renderer_update_images_cb (GdkVulkanContext  *context,
                                       GskVulkanRenderer *self)
@@ -125,9 +243,15 @@ gsk_vulkan_renderer_realize (GskRenderer  *renderer,
                     self);
   gsk_vulkan_renderer_update_images_cb (self->vulkan, self);
 
+  self->pipeline_cache = gsk_vulkan_pipeline_cache_new (self->vulkan, &self->pipeline_cache_size);
+
   self->render = gsk_vulkan_render_new (renderer, self->vulkan);
 
   self->glyph_cache = gsk_vulkan_glyph_cache_new (renderer, self->vulkan);
+  self->fallback_cache = g_hash_table_new_full (fallback_cache_entry_hash,
+                                                fallback_cache_entry_equal,
+                                                fallback_cache_entry_free,
+                                                NULL);
 
   return TRUE;
 }
@@ -139,6 +263,8 @@ gsk_vulkan_renderer_unrealize (GskRenderer *renderer)
   GSList *l;
 
   g_clear_object (&self->glyph_cache);
+  g_clear_pointer (&self->fallback_cache, g_hash_table_unref);
+  self->fallback_cache_size = 0;
 
   for (l = self->textures; l; l = l->next)
     {
@@ -151,14 +277,35 @@ gsk_vulkan_renderer_unrealize (GskRenderer *renderer)
 
   g_clear_pointer (&self->render, gsk_vulkan_render_free);
 
+  gsk_vulkan_pipeline_cache_free (self->vulkan, self->pipeline_cache, self->pipeline_cache_size);
+  self->pipeline_cache = VK_NULL_HANDLE;
+
   gsk_vulkan_renderer_free_targets (self);
   g_signal_handlers_disconnect_by_func(self->vulkan,
                                        gsk_vulkan_renderer_update_images_cb,
                                        self);
 
+  gsk_vulkan_memory_trim (self->vulkan);
+
   g_clear_object (&self->vulkan);
 }
 
+#ifdef G_ENABLE_DEBUG
+static void
+gsk_vulkan_renderer_update_memory_counters (GskVulkanRenderer *self,
+                                            GskProfiler       *profiler)
+{
+  GskVulkanMemoryStats stats;
+
+  gsk_vulkan_memory_get_stats (self->vulkan, &stats);
+
+  gsk_profiler_counter_set (profiler, self->profile_counters.memory_blocks, stats.n_blocks);
+  gsk_profiler_counter_set (profiler, self->profile_counters.memory_allocations, stats.n_allocations);
+  gsk_profiler_counter_set (profiler, self->profile_counters.memory_allocated, stats.allocated);
+  gsk_profiler_counter_set (profiler, self->profile_counters.memory_used, stats.used);
+}
+#endif
+
 static GdkTexture *
 gsk_vulkan_renderer_render_texture (GskRenderer           *renderer,
                                     GskRenderNode         *root,
@@ -176,11 +323,14 @@ gsk_vulkan_renderer_render_texture (GskRenderer           *renderer,
 #ifdef G_ENABLE_DEBUG
   profiler = gsk_renderer_get_profiler (renderer);
   gsk_profiler_counter_set (profiler, self->profile_counters.fallback_pixels, 0);
+  gsk_profiler_counter_set (profiler, self->profile_counters.fallback_cache_hits, 0);
   gsk_profiler_counter_set (profiler, self->profile_counters.texture_pixels, 0);
   gsk_profiler_counter_set (profiler, self->profile_counters.render_passes, 0);
   gsk_profiler_timer_begin (profiler, self->profile_timers.cpu_time);
 #endif
 
+  gsk_vulkan_renderer_collect_fallback_images (self);
+
   render = gsk_vulkan_render_new (renderer, self->vulkan);
 
   image = gsk_vulkan_image_new_for_framebuffer (self->vulkan,
@@ -197,6 +347,10 @@ gsk_vulkan_renderer_render_texture (GskRenderer           *renderer,
 
   texture = gsk_vulkan_render_download_target (render);
 
+#ifdef G_ENABLE_DEBUG
+  gsk_vulkan_renderer_update_memory_counters (self, profiler);
+#endif
+
   g_object_unref (image);
   gsk_vulkan_render_free (render);
 
@@ -226,6 +380,7 @@ gsk_vulkan_renderer_render (GskRenderer          *renderer,
 #ifdef G_ENABLE_DEBUG
   profiler = gsk_renderer_get_profiler (renderer);
   gsk_profiler_counter_set (profiler, self->profile_counters.fallback_pixels, 0);
+  gsk_profiler_counter_set (profiler, self->profile_counters.fallback_cache_hits, 0);
   gsk_profiler_counter_set (profiler, self->profile_counters.texture_pixels, 0);
   gsk_profiler_counter_set (profiler, self->profile_counters.render_passes, 0);
   gsk_profiler_timer_begin (profiler, self->profile_timers.cpu_time);
@@ -234,6 +389,8 @@ gsk_vulkan_renderer_render (GskRenderer          *renderer,
   gdk_draw_context_begin_frame (GDK_DRAW_CONTEXT (self->vulkan), region);
   render = self->render;
 
+  gsk_vulkan_renderer_collect_fallback_images (self);
+
   clip = gdk_draw_context_get_frame_region (GDK_DRAW_CONTEXT (self->vulkan));
   gsk_vulkan_render_reset (render, self->targets[gdk_vulkan_context_get_draw_index (self->vulkan)], NULL, clip);
 
@@ -245,6 +402,7 @@ gsk_vulkan_renderer_render (GskRenderer          *renderer,
 
 #ifdef G_ENABLE_DEBUG
   gsk_profiler_counter_inc (profiler, self->profile_counters.frames);
+  gsk_vulkan_renderer_update_memory_counters (self, profiler);
 
   cpu_time = gsk_profiler_timer_end (profiler, self->profile_timers.cpu_time);
   gsk_profiler_timer_set (profiler, self->profile_timers.cpu_time, cpu_time);
@@ -279,7 +437,12 @@ gsk_vulkan_renderer_init (GskVulkanRenderer *self)
   self->profile_counters.frames = gsk_profiler_add_counter (profiler, "frames", "Frames", FALSE);
   self->profile_counters.render_passes = gsk_profiler_add_counter (profiler, "render-passes", "Render passes", FALSE);
   self->profile_counters.fallback_pixels = gsk_profiler_add_counter (profiler, "fallback-pixels", "Fallback pixels", TRUE);
+  self->profile_counters.fallback_cache_hits = gsk_profiler_add_counter (profiler, "fallback-cache-hits", "Fallback cache hits", TRUE);
   self->profile_counters.texture_pixels = gsk_profiler_add_counter (profiler, "texture-pixels", "Texture pixels", TRUE);
+  self->profile_counters.memory_blocks = gsk_profiler_add_counter (profiler, "memory-blocks", "Device memory blocks", FALSE);
+  self->profile_counters.memory_allocations = gsk_profiler_add_counter (profiler, "memory-allocations", "Device memory suballocations", FALSE);
+  self->profile_counters.memory_allocated = gsk_profiler_add_counter (profiler, "memory-allocated", "Device memory allocated", FALSE);
+  self->profile_counters.memory_used = gsk_profiler_add_counter (profiler, "memory-used", "Device memory in use", FALSE);
 
   self->profile_timers.cpu_time = gsk_profiler_add_timer (profiler, "cpu-time", "CPU time", FALSE, TRUE);
   if (GSK_RENDERER_DEBUG_CHECK (GSK_RENDERER (self), SYNC))
@@ -300,6 +463,12 @@ gsk_vulkan_renderer_clear_texture (gpointer p)
   g_slice_free (GskVulkanTextureData, data);
 }
 
+VkPipelineCache
+gsk_vulkan_renderer_get_pipeline_cache (GskVulkanRenderer *self)
+{
+  return self->pipeline_cache;
+}
+
 GskVulkanImage *
 gsk_vulkan_renderer_ref_texture_image (GskVulkanRenderer *self,
                                        GdkTexture        *texture,
@@ -313,13 +482,28 @@ gsk_vulkan_renderer_ref_texture_image (GskVulkanRenderer *self,
   if (data)
     return g_object_ref (data->image);
 
-  surface = gdk_texture_download_surface (texture);
-  image = gsk_vulkan_image_new_from_data (uploader,
-                                          cairo_image_surface_get_data (surface),
-                                          cairo_image_surface_get_width (surface),
-                                          cairo_image_surface_get_height (surface),
-                                          cairo_image_surface_get_stride (surface));
-  cairo_surface_destroy (surface);
+  if (GDK_IS_MEMORY_TEXTURE (texture))
+    {
+      GdkMemoryTexture *memory_texture = GDK_MEMORY_TEXTURE (texture);
+
+      /* Upload the bytes as they are, converting them while copying */
+      image = gsk_vulkan_image_new_from_memory (uploader,
+                                                gdk_memory_texture_get_data (memory_texture),
+                                                gdk_memory_texture_get_format (memory_texture),
+                                                gdk_texture_get_width (texture),
+                                                gdk_texture_get_height (texture),
+                                                gdk_memory_texture_get_stride (memory_texture));
+    }
+  else
+    {
+      surface = gdk_texture_download_surface (texture);
+      image = gsk_vulkan_image_new_from_data (uploader,
+                                              cairo_image_surface_get_data (surface),
+                                              cairo_image_surface_get_width (surface),
+                                              cairo_image_surface_get_height (surface),
+                                              cairo_image_surface_get_stride (surface));
+      cairo_surface_destroy (surface);
+    }
 
   data = g_slice_new0 (GskVulkanTextureData);
   data->image = image;
@@ -339,13 +523,73 @@ gsk_vulkan_renderer_ref_texture_image (GskVulkanRenderer *self,
   return image;
 }
 
+GskVulkanImage *
+gsk_vulkan_renderer_ref_fallback_image (GskVulkanRenderer    *self,
+                                        GskRenderNode        *node,
+                                        int                   scale_factor,
+                                        const GskRoundedRect *clip)
+{
+  FallbackCacheEntry lookup, *entry;
+
+  lookup.node = node;
+  lookup.scale_factor = scale_factor;
+  lookup.has_clip = clip != NULL;
+  if (clip)
+    lookup.clip = *clip;
+
+  entry = g_hash_table_lookup (self->fallback_cache, &lookup);
+  if (entry == NULL)
+    return NULL;
+
+  entry->last_used = self->frame;
+
+  return g_object_ref (entry->image);
+}
+
+/* The cache keeps a reference on the node, so its address can't be
+ * reused by a different node while the entry exists */
+void
+gsk_vulkan_renderer_cache_fallback_image (GskVulkanRenderer    *self,
+                                          GskRenderNode        *node,
+                                          int                   scale_factor,
+                                          const GskRoundedRect *clip,
+                                          GskVulkanImage       *image)
+{
+  FallbackCacheEntry *entry;
+  gsize size;
+
+  size = gsk_vulkan_image_get_width (image) * gsk_vulkan_image_get_height (image) * 4;
+  if (size > FALLBACK_CACHE_BUDGET / 2)
+    return;
+
+  entry = g_slice_new0 (FallbackCacheEntry);
+  entry->node = gsk_render_node_ref (node);
+  entry->scale_factor = scale_factor;
+  entry->has_clip = clip != NULL;
+  if (clip)
+    entry->clip = *clip;
+  entry->image = g_object_ref (image);
+  entry->size = size;
+  entry->last_used = self->frame;
+
+  if (g_hash_table_lookup (self->fallback_cache, entry))
+    {
+      fallback_cache_entry_free (entry);
+      return;
+    }
+
+  g_hash_table_add (self->fallback_cache, entry);
+  self->fallback_cache_size += size;
+}
+
 guint
 gsk_vulkan_renderer_cache_glyph (GskVulkanRenderer *self,
                                  PangoFont         *font,
                                  PangoGlyph         glyph,
+                                 guint              xshift,
                                  float              scale)
 {
-  return gsk_vulkan_glyph_cache_lookup (self->glyph_cache, TRUE, font, glyph, scale)->texture_index;
+  return gsk_vulkan_glyph_cache_lookup (self->glyph_cache, TRUE, font, glyph, xshift, scale)->texture_index;
 }
 
 GskVulkanImage *
@@ -360,7 +604,8 @@ GskVulkanCachedGlyph *
 gsk_vulkan_renderer_get_cached_glyph (GskVulkanRenderer *self,
                                       PangoFont         *font,
                                       PangoGlyph         glyph,
+                                      guint              xshift,
                                       float              scale)
 {
-  return gsk_vulkan_glyph_cache_lookup (self->glyph_cache, FALSE, font, glyph, scale);
+  return gsk_vulkan_glyph_cache_lookup (self->glyph_cache, FALSE, font, glyph, xshift, scale);
 }
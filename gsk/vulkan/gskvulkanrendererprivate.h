@@ -25,6 +25,18 @@ GskVulkanImage *        gsk_vulkan_renderer_ref_texture_image           (GskVulk
                                                                          GdkTexture             *texture,
                                                                          GskVulkanUploader      *uploader);
 
+VkPipelineCache         gsk_vulkan_renderer_get_pipeline_cache          (GskVulkanRenderer      *self);
+
+GskVulkanImage *        gsk_vulkan_renderer_ref_fallback_image          (GskVulkanRenderer      *self,
+                                                                         GskRenderNode          *node,
+                                                                         int                     scale_factor,
+                                                                         const GskRoundedRect   *clip);
+void                    gsk_vulkan_renderer_cache_fallback_image        (GskVulkanRenderer      *self,
+                                                                         GskRenderNode          *node,
+                                                                         int                     scale_factor,
+                                                                         const GskRoundedRect   *clip,
+                                                                         GskVulkanImage         *image);
+
 typedef struct
 {
   guint texture_index;
@@ -45,6 +57,7 @@ typedef struct
 guint                  gsk_vulkan_renderer_cache_glyph      (GskVulkanRenderer *renderer,
                                                              PangoFont         *font,
                                                              PangoGlyph         glyph,
+                                                             guint              xshift,
                                                              float              scale);
 
 GskVulkanImage *       gsk_vulkan_renderer_ref_glyph_image  (GskVulkanRenderer *self,
@@ -54,6 +67,7 @@ GskVulkanImage *       gsk_vulkan_renderer_ref_glyph_image  (GskVulkanRenderer *
 GskVulkanCachedGlyph * gsk_vulkan_renderer_get_cached_glyph (GskVulkanRenderer *self,
                                                              PangoFont         *font,
                                                              PangoGlyph         glyph,
+                                                             guint              xshift,
                                                              float              scale);
 
 
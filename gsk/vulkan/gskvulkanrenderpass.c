@@ -119,6 +119,9 @@ struct _GskVulkanRenderPass
   cairo_region_t *clip;
   graphene_matrix_t mv;
   graphene_matrix_t p;
+  /* extents of clip in normalized device coordinates, nodes outside of
+   * it are not drawn */
+  graphene_rect_t cull_rect;
 
   VkRenderPass render_pass;
   VkSemaphore signal_semaphore;
@@ -126,6 +129,7 @@ struct _GskVulkanRenderPass
   GskVulkanBuffer *vertex_data;
 
   GQuark fallback_pixels;
+  GQuark fallback_cache_hits;
   GQuark texture_pixels;
 };
 
@@ -140,6 +144,7 @@ gsk_vulkan_render_pass_new (GdkVulkanContext  *context,
 {
   GskVulkanRenderPass *self;
   VkImageLayout final_layout;
+  cairo_rectangle_int_t extents;
 
   self = g_slice_new0 (GskVulkanRenderPass);
   self->vulkan = g_object_ref (context);
@@ -156,6 +161,13 @@ gsk_vulkan_render_pass_new (GdkVulkanContext  *context,
                               viewport->origin.y, viewport->origin.y + viewport->size.height,
                               ORTHO_NEAR_PLANE,
                               ORTHO_FAR_PLANE);
+  /* clip is relative to the target image, whose origin is the viewport's */
+  cairo_region_get_extents (clip, &extents);
+  graphene_matrix_transform_bounds (&self->p,
+                                    &GRAPHENE_RECT_INIT (viewport->origin.x + extents.x,
+                                                         viewport->origin.y + extents.y,
+                                                         extents.width, extents.height),
+                                    &self->cull_rect);
 
   if (signal_semaphore != VK_NULL_HANDLE) // this is a dependent pass
     final_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
@@ -207,6 +219,7 @@ gsk_vulkan_render_pass_new (GdkVulkanContext  *context,
 
 #ifdef G_ENABLE_DEBUG
   self->fallback_pixels = g_quark_from_static_string ("fallback-pixels");
+  self->fallback_cache_hits = g_quark_from_static_string ("fallback-cache-hits");
   self->texture_pixels = g_quark_from_static_string ("texture-pixels");
 #endif
 
@@ -268,6 +281,12 @@ gsk_vulkan_render_pass_add_node (GskVulkanRenderPass           *self,
     .render.node = node
   };
   GskVulkanPipelineType pipeline_type;
+  graphene_rect_t bounds;
+
+  /* Skip nodes that are entirely outside of the damaged area */
+  graphene_matrix_transform_bounds (&constants->mvp, &node->bounds, &bounds);
+  if (!graphene_rect_intersection (&bounds, &self->cull_rect, NULL))
+    return;
 
   switch (gsk_render_node_get_node_type (node))
     {
@@ -366,7 +385,7 @@ gsk_vulkan_render_pass_add_node (GskVulkanRenderPass           *self,
         const PangoFont *font = gsk_text_node_peek_font (node);
         const PangoGlyphInfo *glyphs = gsk_text_node_peek_glyphs (node);
         guint num_glyphs = gsk_text_node_get_num_glyphs (node);
-        int i;
+        int i, x_position;
         guint count;
         guint texture_index;
         GskVulkanRenderer *renderer = GSK_VULKAN_RENDERER (gsk_vulkan_render_get_renderer (render));
@@ -401,11 +420,17 @@ gsk_vulkan_render_pass_add_node (GskVulkanRenderPass           *self,
         op.text.texture_index = G_MAXUINT;
         op.text.scale = self->scale_factor;
 
-        for (i = 0, count = 0; i < num_glyphs; i++)
+        for (i = 0, count = 0, x_position = 0; i < num_glyphs; i++)
           {
             const PangoGlyphInfo *gi = &glyphs[i];
+            guint xshift;
+
+            /* Must match the position in gsk_vulkan_text_pipeline_collect_vertex_data() */
+            gsk_glyph_snap_x (gsk_text_node_get_x (node) + (double)(x_position + gi->geometry.x_offset) / PANGO_SCALE,
+                              op.text.scale, &xshift);
+            x_position += gi->geometry.width;
 
-            texture_index = gsk_vulkan_renderer_cache_glyph (renderer, (PangoFont *)font, gi->glyph, op.text.scale);
+            texture_index = gsk_vulkan_renderer_cache_glyph (renderer, (PangoFont *)font, gi->glyph, xshift, op.text.scale);
             if (op.text.texture_index == G_MAXUINT)
               op.text.texture_index = texture_index;
             if (texture_index != op.text.texture_index)
@@ -829,12 +854,34 @@ gsk_vulkan_render_pass_upload_fallback (GskVulkanRenderPass  *self,
                                         GskVulkanRender      *render,
                                         GskVulkanUploader    *uploader)
 {
+  GskVulkanRenderer *renderer = GSK_VULKAN_RENDERER (gsk_vulkan_render_get_renderer (render));
+  GskRoundedRect clip;
   GskRenderNode *node;
   cairo_surface_t *surface;
   cairo_t *cr;
 
   node = op->node;
 
+  /* A rectangular clip is the same as a rounded one without corners */
+  if (op->type == GSK_VULKAN_OP_FALLBACK_CLIP)
+    gsk_rounded_rect_init_from_rect (&clip, &op->clip.bounds, 0);
+  else if (op->type == GSK_VULKAN_OP_FALLBACK_ROUNDED_CLIP)
+    clip = op->clip;
+
+  op->source = gsk_vulkan_renderer_ref_fallback_image (renderer,
+                                                       node,
+                                                       self->scale_factor,
+                                                       op->type == GSK_VULKAN_OP_FALLBACK ? NULL : &clip);
+  if (op->source)
+    {
+#ifdef G_ENABLE_DEBUG
+      gsk_profiler_counter_inc (gsk_renderer_get_profiler (GSK_RENDERER (renderer)), self->fallback_cache_hits);
+#endif
+      op->source_rect = GRAPHENE_RECT_INIT(0, 0, 1, 1);
+      gsk_vulkan_render_add_cleanup_image (render, op->source);
+      return;
+    }
+
   GSK_RENDERER_NOTE (gsk_vulkan_render_get_renderer (render), FALLBACK,
             g_message ("Upload op=%s, node %s[%p], bounds %gx%g",
                      op->type == GSK_VULKAN_OP_FALLBACK_CLIP ? "fallback-clip" :
@@ -890,6 +937,12 @@ gsk_vulkan_render_pass_upload_fallback (GskVulkanRenderPass  *self,
 
   cairo_surface_destroy (surface);
 
+  gsk_vulkan_renderer_cache_fallback_image (renderer,
+                                            node,
+                                            self->scale_factor,
+                                            op->type == GSK_VULKAN_OP_FALLBACK ? NULL : &clip,
+                                            op->source);
+
   gsk_vulkan_render_add_cleanup_image (render, op->source);
 }
 
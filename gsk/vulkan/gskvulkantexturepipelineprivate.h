@@ -14,6 +14,7 @@ typedef struct _GskVulkanTexturePipelineLayout GskVulkanTexturePipelineLayout;
 G_DECLARE_FINAL_TYPE (GskVulkanTexturePipeline, gsk_vulkan_texture_pipeline, GSK, VULKAN_TEXTURE_PIPELINE, GskVulkanPipeline)
 
 GskVulkanPipeline *     gsk_vulkan_texture_pipeline_new                 (GdkVulkanContext         *context,
+                                                                         VkPipelineCache           cache,
                                                                          VkPipelineLayout          layout,
                                                                          const char               *shader_name,
                                                                          VkRenderPass              render_pass);
@@ -0,0 +1,115 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 2020 GTK+ Team and others
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GTK_COUNTING_BLOOM_FILTER_PRIVATE_H__
+#define __GTK_COUNTING_BLOOM_FILTER_PRIVATE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * A counting bloom filter keeps track of a set of hashes. Hashes can be
+ * added and removed again, and the filter can tell for sure that a hash
+ * is not in the set, but can only tell that a hash may be in the set.
+ *
+ * Every hash sets two buckets. A bucket that has been added to 255
+ * times stays full, so the filter only gets less exact but never
+ * wrong when that happens.
+ */
+
+typedef struct _GtkCountingBloomFilter GtkCountingBloomFilter;
+
+#define GTK_COUNTING_BLOOM_FILTER_BITS (12)
+#define GTK_COUNTING_BLOOM_FILTER_SIZE (1 << GTK_COUNTING_BLOOM_FILTER_BITS)
+#define GTK_COUNTING_BLOOM_FILTER_MASK (GTK_COUNTING_BLOOM_FILTER_SIZE - 1)
+
+struct _GtkCountingBloomFilter
+{
+  guint8        buckets[GTK_COUNTING_BLOOM_FILTER_SIZE];
+};
+
+#define GTK_COUNTING_BLOOM_FILTER_INIT { { 0, } }
+
+/* Hashes of interned strings and quarks have their bits in the wrong
+ * places, so spread them out first */
+static inline guint
+gtk_counting_bloom_filter_mix (guint hash)
+{
+  return hash * 2654435769u;
+}
+
+static inline gsize
+gtk_counting_bloom_filter_hash1 (guint hash)
+{
+  return gtk_counting_bloom_filter_mix (hash) >> (32 - GTK_COUNTING_BLOOM_FILTER_BITS);
+}
+
+static inline gsize
+gtk_counting_bloom_filter_hash2 (guint hash)
+{
+  return (gtk_counting_bloom_filter_mix (hash) >> (32 - 2 * GTK_COUNTING_BLOOM_FILTER_BITS)) & GTK_COUNTING_BLOOM_FILTER_MASK;
+}
+
+static inline void
+gtk_counting_bloom_filter_add_bucket (GtkCountingBloomFilter *self,
+                                      gsize                   bucket)
+{
+  if (self->buckets[bucket] < G_MAXUINT8)
+    self->buckets[bucket]++;
+}
+
+static inline void
+gtk_counting_bloom_filter_remove_bucket (GtkCountingBloomFilter *self,
+                                         gsize                   bucket)
+{
+  /* A full bucket may have been added to more often than we know */
+  if (self->buckets[bucket] < G_MAXUINT8)
+    {
+      g_assert (self->buckets[bucket] > 0);
+      self->buckets[bucket]--;
+    }
+}
+
+static inline void
+gtk_counting_bloom_filter_add (GtkCountingBloomFilter *self,
+                               guint                   hash)
+{
+  gtk_counting_bloom_filter_add_bucket (self, gtk_counting_bloom_filter_hash1 (hash));
+  gtk_counting_bloom_filter_add_bucket (self, gtk_counting_bloom_filter_hash2 (hash));
+}
+
+static inline void
+gtk_counting_bloom_filter_remove (GtkCountingBloomFilter *self,
+                                  guint                   hash)
+{
+  gtk_counting_bloom_filter_remove_bucket (self, gtk_counting_bloom_filter_hash1 (hash));
+  gtk_counting_bloom_filter_remove_bucket (self, gtk_counting_bloom_filter_hash2 (hash));
+}
+
+/* Returns FALSE if @hash is definitely not in the filter */
+static inline gboolean
+gtk_counting_bloom_filter_may_contain (const GtkCountingBloomFilter *self,
+                                       guint                         hash)
+{
+  return self->buckets[gtk_counting_bloom_filter_hash1 (hash)] != 0 &&
+         self->buckets[gtk_counting_bloom_filter_hash2 (hash)] != 0;
+}
+
+G_END_DECLS
+
+#endif /* __GTK_COUNTING_BLOOM_FILTER_PRIVATE_H__ */
@@ -97,6 +97,18 @@ gtk_css_value_array_equal (const GtkCssValue *value1,
   return TRUE;
 }
 
+static guint
+gtk_css_value_array_hash (const GtkCssValue *value)
+{
+  guint i, hash;
+
+  hash = value->n_values;
+  for (i = 0; i < value->n_values; i++)
+    hash = (hash << 5) - hash + gtk_css_value_hash (value->values[i]);
+
+  return hash;
+}
+
 static guint
 gcd (guint a, guint b)
 {
@@ -372,6 +384,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_ARRAY = {
   gtk_css_value_array_free,
   gtk_css_value_array_compute,
   gtk_css_value_array_equal,
+  gtk_css_value_array_hash,
   gtk_css_value_array_transition,
   gtk_css_value_array_is_dynamic,
   gtk_css_value_array_get_dynamic_value,
@@ -449,3 +462,79 @@ _gtk_css_array_value_get_n_values (const GtkCssValue *value)
   return value->n_values;
 }
 
+/* Saves the values of the array with @save_func, returns %NULL if
+ * @value is not an array or @save_func can't save all of them */
+GVariant *
+gtk_css_array_value_save (const GtkCssValue *value,
+                          GVariant *         (* save_func) (const GtkCssValue *))
+{
+  GVariantBuilder builder;
+  guint i;
+
+  if (value->class != &GTK_CSS_VALUE_ARRAY)
+    return NULL;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("av"));
+
+  for (i = 0; i < value->n_values; i++)
+    {
+      GVariant *saved = save_func (value->values[i]);
+
+      if (saved == NULL)
+        {
+          g_variant_builder_clear (&builder);
+          return NULL;
+        }
+
+      g_variant_builder_add (&builder, "v", saved);
+    }
+
+  return g_variant_builder_end (&builder);
+}
+
+GtkCssValue *
+gtk_css_array_value_load (GVariant     *variant,
+                          GtkCssValue *(* load_func) (GVariant *))
+{
+  GtkCssValue **values;
+  GtkCssValue *result;
+  gsize i, n_values;
+
+  if (!g_variant_is_of_type (variant, G_VARIANT_TYPE ("av")))
+    return NULL;
+
+  n_values = g_variant_n_children (variant);
+  if (n_values == 0)
+    return NULL;
+
+  values = g_new (GtkCssValue *, n_values);
+
+  for (i = 0; i < n_values; i++)
+    {
+      GVariant *child = g_variant_get_child_value (variant, i);
+      GVariant *saved = g_variant_get_variant (child);
+
+      values[i] = load_func (saved);
+
+      g_variant_unref (saved);
+      g_variant_unref (child);
+
+      if (values[i] == NULL)
+        break;
+    }
+
+  if (i == n_values)
+    {
+      result = _gtk_css_array_value_new_from_array (values, n_values);
+    }
+  else
+    {
+      result = NULL;
+      while (i-- > 0)
+        _gtk_css_value_unref (values[i]);
+    }
+
+  g_free (values);
+
+  return result;
+}
@@ -36,6 +36,11 @@ GtkCssValue *       _gtk_css_array_value_get_nth        (const GtkCssValue     *
                                                          guint                  i);
 guint               _gtk_css_array_value_get_n_values   (const GtkCssValue     *value);
 
+GVariant *          gtk_css_array_value_save            (const GtkCssValue     *value,
+                                                         GVariant *             (* save_func) (const GtkCssValue *));
+GtkCssValue *       gtk_css_array_value_load            (GVariant              *variant,
+                                                         GtkCssValue *          (* load_func) (GVariant *));
+
 
 G_END_DECLS
 
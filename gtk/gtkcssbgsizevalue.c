@@ -88,6 +88,14 @@ gtk_css_value_bg_size_equal (const GtkCssValue *value1,
            _gtk_css_value_equal (value1->y, value2->y)));
 }
 
+static guint
+gtk_css_value_bg_size_hash (const GtkCssValue *value)
+{
+  return (value->cover << 1 | value->contain) ^
+         gtk_css_value_hash0 (value->x) ^
+         (gtk_css_value_hash0 (value->y) << 3);
+}
+
 static GtkCssValue *
 gtk_css_value_bg_size_transition (GtkCssValue *start,
                                   GtkCssValue *end,
@@ -156,6 +164,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_BG_SIZE = {
   gtk_css_value_bg_size_free,
   gtk_css_value_bg_size_compute,
   gtk_css_value_bg_size_equal,
+  gtk_css_value_bg_size_hash,
   gtk_css_value_bg_size_transition,
   NULL,
   NULL,
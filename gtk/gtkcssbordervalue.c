@@ -100,6 +100,18 @@ gtk_css_value_border_equal (const GtkCssValue *value1,
   return TRUE;
 }
 
+static guint
+gtk_css_value_border_hash (const GtkCssValue *value)
+{
+  guint i, hash;
+
+  hash = value->fill;
+  for (i = 0; i < 4; i++)
+    hash = (hash << 5) - hash + gtk_css_value_hash0 (value->values[i]);
+
+  return hash;
+}
+
 static GtkCssValue *
 gtk_css_value_border_transition (GtkCssValue *start,
                                  GtkCssValue *end,
@@ -143,6 +155,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_BORDER = {
   gtk_css_value_border_free,
   gtk_css_value_border_compute,
   gtk_css_value_border_equal,
+  gtk_css_value_border_hash,
   gtk_css_value_border_transition,
   NULL,
   NULL,
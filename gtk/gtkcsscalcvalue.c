@@ -150,6 +150,19 @@ gtk_css_value_calc_equal (const GtkCssValue *value1,
   return TRUE;
 }
 
+static guint
+gtk_css_value_calc_hash (const GtkCssValue *value)
+{
+  guint hash;
+  gsize i;
+
+  hash = value->n_terms;
+  for (i = 0; i < value->n_terms; i++)
+    hash = (hash << 5) - hash + gtk_css_value_hash (value->terms[i]);
+
+  return hash;
+}
+
 static void
 gtk_css_value_calc_print (const GtkCssValue *value,
                           GString           *string)
@@ -248,6 +261,7 @@ static const GtkCssNumberValueClass GTK_CSS_VALUE_CALC = {
     gtk_css_value_calc_free,
     gtk_css_value_calc_compute,
     gtk_css_value_calc_equal,
+    gtk_css_value_calc_hash,
     gtk_css_number_value_transition,
     NULL,
     NULL,
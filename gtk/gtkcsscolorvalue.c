@@ -38,6 +38,9 @@ typedef enum {
   COLOR_TYPE_CURRENT_COLOR
 } ColorType;
 
+/* Styles can be resolved from several threads */
+G_LOCK_DEFINE_STATIC (last_value);
+
 struct _GtkCssValue
 {
   GTK_CSS_VALUE_BASE
@@ -272,6 +275,7 @@ _gtk_css_color_value_resolve (GtkCssValue      *color,
       g_assert_not_reached ();
     }
 
+  G_LOCK (last_value);
   if (color->last_value != NULL &&
       _gtk_css_value_equal (color->last_value, value))
     {
@@ -284,6 +288,7 @@ _gtk_css_color_value_resolve (GtkCssValue      *color,
         _gtk_css_value_unref (color->last_value);
       color->last_value = _gtk_css_value_ref (value);
     }
+  G_UNLOCK (last_value);
 
   return value;
 }
@@ -362,6 +367,35 @@ gtk_css_value_color_equal (const GtkCssValue *value1,
     }
 }
 
+static guint
+gtk_css_value_color_hash (const GtkCssValue *value)
+{
+  switch (value->type)
+    {
+    case COLOR_TYPE_LITERAL:
+      return gtk_css_value_hash (value->last_value);
+    case COLOR_TYPE_NAME:
+      return g_str_hash (value->sym_col.name);
+    case COLOR_TYPE_SHADE:
+      return gtk_css_double_hash (value->sym_col.shade.factor) ^
+             gtk_css_value_hash (value->sym_col.shade.color);
+    case COLOR_TYPE_ALPHA:
+      return gtk_css_double_hash (value->sym_col.alpha.factor) ^
+             gtk_css_value_hash (value->sym_col.alpha.color);
+    case COLOR_TYPE_MIX:
+      return gtk_css_double_hash (value->sym_col.mix.factor) ^
+             gtk_css_value_hash (value->sym_col.mix.color1) ^
+             (gtk_css_value_hash (value->sym_col.mix.color2) << 7);
+    case COLOR_TYPE_WIN32:
+      return value->sym_col.win32.id;
+    case COLOR_TYPE_CURRENT_COLOR:
+      return value->type;
+    default:
+      g_assert_not_reached ();
+      return 0;
+    }
+}
+
 static GtkCssValue *
 gtk_css_value_color_transition (GtkCssValue *start,
                                 GtkCssValue *end,
@@ -448,6 +482,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_COLOR = {
   gtk_css_value_color_free,
   gtk_css_value_color_compute,
   gtk_css_value_color_equal,
+  gtk_css_value_color_hash,
   gtk_css_value_color_transition,
   NULL,
   NULL,
@@ -867,3 +902,139 @@ _gtk_css_color_value_parse (GtkCssParser *parser)
   return NULL;
 }
 
+/* Saves colors as their type and the data of that type, returns %NULL
+ * for other values and for colors that can't be saved */
+GVariant *
+gtk_css_color_value_save (const GtkCssValue *color)
+{
+  GVariant *data, *color1, *color2;
+
+  if (color->class != &GTK_CSS_VALUE_COLOR)
+    return NULL;
+
+  switch (color->type)
+    {
+    case COLOR_TYPE_LITERAL:
+      {
+        const GdkRGBA *rgba = _gtk_css_rgba_value_get_rgba (color->last_value);
+
+        data = g_variant_new ("(dddd)", rgba->red, rgba->green, rgba->blue, rgba->alpha);
+      }
+      break;
+
+    case COLOR_TYPE_NAME:
+      data = g_variant_new_string (color->sym_col.name);
+      break;
+
+    case COLOR_TYPE_SHADE:
+    case COLOR_TYPE_ALPHA:
+      /* shade and alpha have the same layout */
+      color1 = gtk_css_color_value_save (color->sym_col.shade.color);
+      if (color1 == NULL)
+        return NULL;
+      data = g_variant_new ("(vd)", color1, color->sym_col.shade.factor);
+      break;
+
+    case COLOR_TYPE_MIX:
+      color1 = gtk_css_color_value_save (color->sym_col.mix.color1);
+      if (color1 == NULL)
+        return NULL;
+      color2 = gtk_css_color_value_save (color->sym_col.mix.color2);
+      if (color2 == NULL)
+        {
+          g_variant_unref (g_variant_ref_sink (color1));
+          return NULL;
+        }
+      data = g_variant_new ("(vvd)", color1, color2, color->sym_col.mix.factor);
+      break;
+
+    case COLOR_TYPE_CURRENT_COLOR:
+      data = g_variant_new_tuple (NULL, 0);
+      break;
+
+    case COLOR_TYPE_WIN32:
+    default:
+      return NULL;
+    }
+
+  return g_variant_new ("(uv)", color->type, data);
+}
+
+GtkCssValue *
+gtk_css_color_value_load (GVariant *variant)
+{
+  GtkCssValue *color1, *color2, *result;
+  GVariant *data, *data1, *data2;
+  guint32 type;
+  double factor;
+
+  if (!g_variant_is_of_type (variant, G_VARIANT_TYPE ("(uv)")))
+    return NULL;
+
+  g_variant_get (variant, "(uv)", &type, &data);
+  result = NULL;
+
+  switch (type)
+    {
+    case COLOR_TYPE_LITERAL:
+      if (g_variant_is_of_type (data, G_VARIANT_TYPE ("(dddd)")))
+        {
+          GdkRGBA rgba;
+
+          g_variant_get (data, "(dddd)", &rgba.red, &rgba.green, &rgba.blue, &rgba.alpha);
+          result = _gtk_css_color_value_new_literal (&rgba);
+        }
+      break;
+
+    case COLOR_TYPE_NAME:
+      if (g_variant_is_of_type (data, G_VARIANT_TYPE_STRING))
+        result = _gtk_css_color_value_new_name (g_variant_get_string (data, NULL));
+      break;
+
+    case COLOR_TYPE_SHADE:
+    case COLOR_TYPE_ALPHA:
+      if (g_variant_is_of_type (data, G_VARIANT_TYPE ("(vd)")))
+        {
+          g_variant_get (data, "(vd)", &data1, &factor);
+          color1 = gtk_css_color_value_load (data1);
+          g_variant_unref (data1);
+          if (color1 == NULL)
+            break;
+
+          if (type == COLOR_TYPE_SHADE)
+            result = _gtk_css_color_value_new_shade (color1, factor);
+          else
+            result = _gtk_css_color_value_new_alpha (color1, factor);
+          _gtk_css_value_unref (color1);
+        }
+      break;
+
+    case COLOR_TYPE_MIX:
+      if (g_variant_is_of_type (data, G_VARIANT_TYPE ("(vvd)")))
+        {
+          g_variant_get (data, "(vvd)", &data1, &data2, &factor);
+          color1 = gtk_css_color_value_load (data1);
+          color2 = gtk_css_color_value_load (data2);
+          g_variant_unref (data1);
+          g_variant_unref (data2);
+
+          if (color1 && color2)
+            result = _gtk_css_color_value_new_mix (color1, color2, factor);
+          g_clear_pointer (&color1, _gtk_css_value_unref);
+          g_clear_pointer (&color2, _gtk_css_value_unref);
+        }
+      break;
+
+    case COLOR_TYPE_CURRENT_COLOR:
+      result = _gtk_css_color_value_new_current_color ();
+      break;
+
+    case COLOR_TYPE_WIN32:
+    default:
+      break;
+    }
+
+  g_variant_unref (data);
+
+  return result;
+}
@@ -43,6 +43,9 @@ GtkCssValue *   _gtk_css_color_value_new_current_color  (void);
 
 GtkCssValue *   _gtk_css_color_value_parse              (GtkCssParser   *parser);
 
+GVariant *      gtk_css_color_value_save                (const GtkCssValue *color);
+GtkCssValue *   gtk_css_color_value_load                (GVariant          *variant);
+
 GtkCssValue *   _gtk_css_color_value_resolve            (GtkCssValue      *color,
                                                          GtkStyleProvider *provider,
                                                          GtkCssValue      *current,
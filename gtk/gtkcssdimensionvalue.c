@@ -167,6 +167,12 @@ gtk_css_value_dimension_equal (const GtkCssValue *number1,
          number1->value == number2->value;
 }
 
+static guint
+gtk_css_value_dimension_hash (const GtkCssValue *number)
+{
+  return number->unit ^ gtk_css_double_hash (number->value);
+}
+
 static void
 gtk_css_value_dimension_print (const GtkCssValue *number,
                             GString           *string)
@@ -275,6 +281,7 @@ static const GtkCssNumberValueClass GTK_CSS_VALUE_DIMENSION = {
     gtk_css_value_dimension_free,
     gtk_css_value_dimension_compute,
     gtk_css_value_dimension_equal,
+    gtk_css_value_dimension_hash,
     gtk_css_number_value_transition,
     NULL,
     NULL,
@@ -325,3 +332,29 @@ gtk_css_dimension_value_new (double     value,
   return result;
 }
 
+/* Returns %NULL if @value is not a dimension */
+GVariant *
+gtk_css_dimension_value_save (const GtkCssValue *value)
+{
+  if (value->class != &GTK_CSS_VALUE_DIMENSION.value_class)
+    return NULL;
+
+  return g_variant_new ("(ud)", value->unit, value->value);
+}
+
+GtkCssValue *
+gtk_css_dimension_value_load (GVariant *variant)
+{
+  guint32 unit;
+  double value;
+
+  if (!g_variant_is_of_type (variant, G_VARIANT_TYPE ("(ud)")))
+    return NULL;
+
+  g_variant_get (variant, "(ud)", &unit, &value);
+  if (unit > GTK_CSS_MS)
+    return NULL;
+
+  return gtk_css_dimension_value_new (value, unit);
+}
+
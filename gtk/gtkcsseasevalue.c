@@ -82,6 +82,24 @@ gtk_css_value_ease_equal (const GtkCssValue *ease1,
     }
 }
 
+static guint
+gtk_css_value_ease_hash (const GtkCssValue *ease)
+{
+  switch (ease->type)
+    {
+    case GTK_CSS_EASE_CUBIC_BEZIER:
+      return gtk_css_double_hash (ease->u.cubic.x1) ^
+             gtk_css_double_hash (ease->u.cubic.y1) << 1 ^
+             gtk_css_double_hash (ease->u.cubic.x2) << 2 ^
+             gtk_css_double_hash (ease->u.cubic.y2) << 3;
+    case GTK_CSS_EASE_STEPS:
+      return ease->u.steps.steps << 1 | ease->u.steps.start;
+    default:
+      g_assert_not_reached ();
+      return 0;
+    }
+}
+
 static GtkCssValue *
 gtk_css_value_ease_transition (GtkCssValue *start,
                                GtkCssValue *end,
@@ -138,6 +156,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_EASE = {
   gtk_css_value_ease_free,
   gtk_css_value_ease_compute,
   gtk_css_value_ease_equal,
+  gtk_css_value_ease_hash,
   gtk_css_value_ease_transition,
   NULL,
   NULL,
@@ -59,6 +59,13 @@ gtk_css_value_enum_equal (const GtkCssValue *enum1,
   return enum1 == enum2;
 }
 
+static guint
+gtk_css_value_enum_hash (const GtkCssValue *value)
+{
+  /* Enum values are singletons, see gtk_css_value_enum_equal() */
+  return g_direct_hash (value);
+}
+
 static GtkCssValue *
 gtk_css_value_enum_transition (GtkCssValue *start,
                                GtkCssValue *end,
@@ -81,6 +88,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_BORDER_STYLE = {
   gtk_css_value_enum_free,
   gtk_css_value_enum_compute,
   gtk_css_value_enum_equal,
+  gtk_css_value_enum_hash,
   gtk_css_value_enum_transition,
   NULL,
   NULL,
@@ -138,6 +146,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_BLEND_MODE = {
   gtk_css_value_enum_free,
   gtk_css_value_enum_compute,
   gtk_css_value_enum_equal,
+  gtk_css_value_enum_hash,
   gtk_css_value_enum_transition,
   NULL,
   NULL,
@@ -288,6 +297,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_FONT_SIZE = {
   gtk_css_value_enum_free,
   gtk_css_value_font_size_compute,
   gtk_css_value_enum_equal,
+  gtk_css_value_enum_hash,
   gtk_css_value_enum_transition,
   NULL,
   NULL,
@@ -344,6 +354,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_FONT_STYLE = {
   gtk_css_value_enum_free,
   gtk_css_value_enum_compute,
   gtk_css_value_enum_equal,
+  gtk_css_value_enum_hash,
   gtk_css_value_enum_transition,
   NULL,
   NULL,
@@ -458,6 +469,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_FONT_WEIGHT = {
   gtk_css_value_enum_free,
   gtk_css_value_font_weight_compute,
   gtk_css_value_enum_equal,
+  gtk_css_value_enum_hash,
   gtk_css_value_font_weight_transition,
   NULL,
   NULL,
@@ -533,6 +545,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_FONT_STRETCH = {
   gtk_css_value_enum_free,
   gtk_css_value_enum_compute,
   gtk_css_value_enum_equal,
+  gtk_css_value_enum_hash,
   gtk_css_value_enum_transition,
   NULL,
   NULL,
@@ -589,6 +602,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_TEXT_DECORATION_LINE = {
   gtk_css_value_enum_free,
   gtk_css_value_enum_compute,
   gtk_css_value_enum_equal,
+  gtk_css_value_enum_hash,
   gtk_css_value_enum_transition,
   NULL,
   NULL,
@@ -639,6 +653,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_TEXT_DECORATION_STYLE = {
   gtk_css_value_enum_free,
   gtk_css_value_enum_compute,
   gtk_css_value_enum_equal,
+  gtk_css_value_enum_hash,
   gtk_css_value_enum_transition,
   NULL,
   NULL,
@@ -689,6 +704,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_AREA = {
   gtk_css_value_enum_free,
   gtk_css_value_enum_compute,
   gtk_css_value_enum_equal,
+  gtk_css_value_enum_hash,
   gtk_css_value_enum_transition,
   NULL,
   NULL,
@@ -745,6 +761,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_DIRECTION = {
   gtk_css_value_enum_free,
   gtk_css_value_enum_compute,
   gtk_css_value_enum_equal,
+  gtk_css_value_enum_hash,
   gtk_css_value_enum_transition,
   NULL,
   NULL,
@@ -805,6 +822,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_PLAY_STATE = {
   gtk_css_value_enum_free,
   gtk_css_value_enum_compute,
   gtk_css_value_enum_equal,
+  gtk_css_value_enum_hash,
   gtk_css_value_enum_transition,
   NULL,
   NULL,
@@ -860,6 +878,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_FILL_MODE = {
   gtk_css_value_enum_free,
   gtk_css_value_enum_compute,
   gtk_css_value_enum_equal,
+  gtk_css_value_enum_hash,
   gtk_css_value_enum_transition,
   NULL,
   NULL,
@@ -917,6 +936,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_ICON_STYLE = {
   gtk_css_value_enum_free,
   gtk_css_value_enum_compute,
   gtk_css_value_enum_equal,
+  gtk_css_value_enum_hash,
   gtk_css_value_enum_transition,
   NULL,
   NULL,
@@ -973,6 +993,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_FONT_KERNING = {
   gtk_css_value_enum_free,
   gtk_css_value_enum_compute,
   gtk_css_value_enum_equal,
+  gtk_css_value_enum_hash,
   gtk_css_value_enum_transition,
   NULL,
   NULL,
@@ -1029,6 +1050,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_FONT_VARIANT_POSITION = {
   gtk_css_value_enum_free,
   gtk_css_value_enum_compute,
   gtk_css_value_enum_equal,
+  gtk_css_value_enum_hash,
   gtk_css_value_enum_transition,
   NULL,
   NULL,
@@ -1085,6 +1107,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_FONT_VARIANT_CAPS = {
   gtk_css_value_enum_free,
   gtk_css_value_enum_compute,
   gtk_css_value_enum_equal,
+  gtk_css_value_enum_hash,
   gtk_css_value_enum_transition,
   NULL,
   NULL,
@@ -1145,6 +1168,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_FONT_VARIANT_ALTERNATE = {
   gtk_css_value_enum_free,
   gtk_css_value_enum_compute,
   gtk_css_value_enum_equal,
+  gtk_css_value_enum_hash,
   gtk_css_value_enum_transition,
   NULL,
   NULL,
@@ -1210,6 +1234,12 @@ gtk_css_value_flags_equal (const GtkCssValue *enum1,
   return enum1->value == enum2->value;
 }
 
+static guint
+gtk_css_value_flags_hash (const GtkCssValue *value)
+{
+  return value->value;
+}
+
 static void
 gtk_css_value_flags_print (const FlagsValue  *values,
                            guint              n_values,
@@ -1258,6 +1288,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_FONT_VARIANT_LIGATURE = {
   gtk_css_value_enum_free,
   gtk_css_value_enum_compute,
   gtk_css_value_flags_equal,
+  gtk_css_value_flags_hash,
   gtk_css_value_enum_transition,
   NULL,
   NULL,
@@ -1364,6 +1395,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_FONT_VARIANT_NUMERIC = {
   gtk_css_value_enum_free,
   gtk_css_value_enum_compute,
   gtk_css_value_flags_equal,
+  gtk_css_value_flags_hash,
   gtk_css_value_enum_transition,
   NULL,
   NULL,
@@ -1467,6 +1499,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_FONT_VARIANT_EAST_ASIAN = {
   gtk_css_value_enum_free,
   gtk_css_value_enum_compute,
   gtk_css_value_flags_equal,
+  gtk_css_value_flags_hash,
   gtk_css_value_enum_transition,
   NULL,
   NULL,
@@ -1580,3 +1613,91 @@ _gtk_css_font_variant_east_asian_value_get (const GtkCssValue *value)
 
   return value->value;
 }
+
+/* Saving and loading */
+
+/* The enums, whose values are all static */
+static const struct {
+  GtkCssValue *values;
+  guint n_values;
+} enum_values[] = {
+  { border_style_values, G_N_ELEMENTS (border_style_values) },
+  { blend_mode_values, G_N_ELEMENTS (blend_mode_values) },
+  { font_size_values, G_N_ELEMENTS (font_size_values) },
+  { font_style_values, G_N_ELEMENTS (font_style_values) },
+  { font_weight_values, G_N_ELEMENTS (font_weight_values) },
+  { font_stretch_values, G_N_ELEMENTS (font_stretch_values) },
+  { text_decoration_line_values, G_N_ELEMENTS (text_decoration_line_values) },
+  { text_decoration_style_values, G_N_ELEMENTS (text_decoration_style_values) },
+  { area_values, G_N_ELEMENTS (area_values) },
+  { direction_values, G_N_ELEMENTS (direction_values) },
+  { play_state_values, G_N_ELEMENTS (play_state_values) },
+  { fill_mode_values, G_N_ELEMENTS (fill_mode_values) },
+  { icon_style_values, G_N_ELEMENTS (icon_style_values) },
+  { font_kerning_values, G_N_ELEMENTS (font_kerning_values) },
+  { font_variant_position_values, G_N_ELEMENTS (font_variant_position_values) },
+  { font_variant_caps_values, G_N_ELEMENTS (font_variant_caps_values) },
+  { font_variant_alternate_values, G_N_ELEMENTS (font_variant_alternate_values) },
+};
+
+/* The flags, after the enums */
+enum {
+  FLAGS_LIGATURE = G_N_ELEMENTS (enum_values),
+  FLAGS_NUMERIC,
+  FLAGS_EAST_ASIAN
+};
+
+/* Saves enums and flags as their type and their index or flags, returns
+ * %NULL for other values. The indexes only stay the same within one
+ * version of GTK. */
+GVariant *
+gtk_css_enum_value_save (const GtkCssValue *value)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (enum_values); i++)
+    {
+      if (value->class == enum_values[i].values[0].class)
+        return g_variant_new ("(uu)", i, (guint) (value - enum_values[i].values));
+    }
+
+  if (value->class == &GTK_CSS_VALUE_FONT_VARIANT_LIGATURE)
+    return g_variant_new ("(uu)", FLAGS_LIGATURE, value->value);
+  else if (value->class == &GTK_CSS_VALUE_FONT_VARIANT_NUMERIC)
+    return g_variant_new ("(uu)", FLAGS_NUMERIC, value->value);
+  else if (value->class == &GTK_CSS_VALUE_FONT_VARIANT_EAST_ASIAN)
+    return g_variant_new ("(uu)", FLAGS_EAST_ASIAN, value->value);
+
+  return NULL;
+}
+
+GtkCssValue *
+gtk_css_enum_value_load (GVariant *variant)
+{
+  guint32 type, value;
+
+  if (!g_variant_is_of_type (variant, G_VARIANT_TYPE ("(uu)")))
+    return NULL;
+
+  g_variant_get (variant, "(uu)", &type, &value);
+
+  if (type < G_N_ELEMENTS (enum_values))
+    {
+      if (value >= enum_values[type].n_values)
+        return NULL;
+
+      return _gtk_css_value_ref (&enum_values[type].values[value]);
+    }
+
+  switch (type)
+    {
+    case FLAGS_LIGATURE:
+      return _gtk_css_font_variant_ligature_value_new (value);
+    case FLAGS_NUMERIC:
+      return _gtk_css_font_variant_numeric_value_new (value);
+    case FLAGS_EAST_ASIAN:
+      return _gtk_css_font_variant_east_asian_value_new (value);
+    default:
+      return NULL;
+    }
+}
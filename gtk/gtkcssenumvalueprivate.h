@@ -113,6 +113,9 @@ GtkCssFontVariantEastAsian _gtk_css_font_variant_east_asian_try_parse_one (GtkCs
                                                                       GtkCssFontVariantEastAsian base);
 GtkCssFontVariantEastAsian _gtk_css_font_variant_east_asian_value_get     (const GtkCssValue          *value);
 
+GVariant *           gtk_css_enum_value_save      (const GtkCssValue *value);
+GtkCssValue *        gtk_css_enum_value_load      (GVariant          *variant);
+
 G_END_DECLS
 
 #endif /* __GTK_CSS_ENUM_VALUE_PRIVATE_H__ */
@@ -696,6 +696,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_FILTER = {
   gtk_css_value_filter_free,
   gtk_css_value_filter_compute,
   gtk_css_value_filter_equal,
+  NULL,
   gtk_css_value_filter_transition,
   NULL,
   NULL,
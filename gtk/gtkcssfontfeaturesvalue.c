@@ -180,6 +180,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_FONT_FEATURES = {
   gtk_css_value_font_features_free,
   gtk_css_value_font_features_compute,
   gtk_css_value_font_features_equal,
+  NULL,
   gtk_css_value_font_features_transition,
   NULL,
   NULL,
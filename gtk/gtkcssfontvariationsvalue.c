@@ -179,6 +179,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_FONT_VARIATIONS = {
   gtk_css_value_font_variations_free,
   gtk_css_value_font_variations_compute,
   gtk_css_value_font_variations_equal,
+  NULL,
   gtk_css_value_font_variations_transition,
   NULL,
   NULL,
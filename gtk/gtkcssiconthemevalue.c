@@ -40,13 +40,19 @@ struct _GtkCssValue {
   guint changed_id;
 };
 
+/* Values are created when computing styles, which can happen on
+ * several threads */
+G_LOCK_DEFINE_STATIC (icon_theme_value);
+
 static void
 gtk_css_value_icon_theme_disconnect_handler (GtkCssValue *value)
 {
   if (value->changed_id == 0)
     return;
 
+  G_LOCK (icon_theme_value);
   g_object_set_data (G_OBJECT (value->icontheme), "-gtk-css-value", NULL);
+  G_UNLOCK (icon_theme_value);
 
   g_signal_handler_disconnect (value->icontheme, value->changed_id);
   value->changed_id = 0;
@@ -94,6 +100,13 @@ gtk_css_value_icon_theme_equal (const GtkCssValue *value1,
   return FALSE;
 }
 
+static guint
+gtk_css_value_icon_theme_hash (const GtkCssValue *value)
+{
+  /* Only identical values are equal */
+  return g_direct_hash (value);
+}
+
 static GtkCssValue *
 gtk_css_value_icon_theme_transition (GtkCssValue *start,
                                      GtkCssValue *end,
@@ -114,6 +127,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_ICON_THEME = {
   gtk_css_value_icon_theme_free,
   gtk_css_value_icon_theme_compute,
   gtk_css_value_icon_theme_equal,
+  gtk_css_value_icon_theme_hash,
   gtk_css_value_icon_theme_transition,
   NULL,
   NULL,
@@ -130,15 +144,23 @@ gtk_css_icon_theme_value_new (GtkIconTheme *icontheme)
   if (icontheme == NULL)
     return _gtk_css_value_ref (&default_icon_theme_value);
 
+  G_LOCK (icon_theme_value);
+
   result = g_object_get_data (G_OBJECT (icontheme), "-gtk-css-value");
   if (result)
-    return _gtk_css_value_ref (result);
+    {
+      _gtk_css_value_ref (result);
+    }
+  else
+    {
+      result = _gtk_css_value_new (GtkCssValue, &GTK_CSS_VALUE_ICON_THEME);
+      result->icontheme = g_object_ref (icontheme);
 
-  result = _gtk_css_value_new (GtkCssValue, &GTK_CSS_VALUE_ICON_THEME);
-  result->icontheme = g_object_ref (icontheme);
+      g_object_set_data (G_OBJECT (icontheme), I_("-gtk-css-value"), result);
+      result->changed_id = g_signal_connect (icontheme, "changed", G_CALLBACK (gtk_css_value_icon_theme_changed_cb), result);
+    }
 
-  g_object_set_data (G_OBJECT (icontheme), I_("-gtk-css-value"), result);
-  result->changed_id = g_signal_connect (icontheme, "changed", G_CALLBACK (gtk_css_value_icon_theme_changed_cb), result);
+  G_UNLOCK (icon_theme_value);
 
   return result;
 }
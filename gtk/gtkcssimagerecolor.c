@@ -95,9 +95,13 @@ lookup_symbolic_colors (GtkCssStyle *style,
     *error_out = *color_out;
 }
 
+/* Textures are loaded when computing styles, which can happen on
+ * several threads */
+G_LOCK_DEFINE_STATIC (texture);
+
 static void
-gtk_css_image_recolor_load_texture (GtkCssImageRecolor  *recolor,
-                                    GError             **error)
+gtk_css_image_recolor_load_texture_locked (GtkCssImageRecolor  *recolor,
+                                           GError             **error)
 {
   char *uri;
 
@@ -128,6 +132,15 @@ gtk_css_image_recolor_load_texture (GtkCssImageRecolor  *recolor,
   g_free (uri);
 }
 
+static void
+gtk_css_image_recolor_load_texture (GtkCssImageRecolor  *recolor,
+                                    GError             **error)
+{
+  G_LOCK (texture);
+  gtk_css_image_recolor_load_texture_locked (recolor, error);
+  G_UNLOCK (texture);
+}
+
 static GtkCssImage *
 gtk_css_image_recolor_load (GtkCssImageRecolor  *recolor,
                             GtkCssStyle         *style,
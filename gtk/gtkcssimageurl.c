@@ -29,9 +29,13 @@
 
 G_DEFINE_TYPE (GtkCssImageUrl, _gtk_css_image_url, GTK_TYPE_CSS_IMAGE)
 
+/* Images are loaded when computing styles, which can happen on
+ * several threads */
+G_LOCK_DEFINE_STATIC (loaded_image);
+
 static GtkCssImage *
-gtk_css_image_url_load_image (GtkCssImageUrl  *url,
-                              GError         **error)
+gtk_css_image_url_load_image_locked (GtkCssImageUrl  *url,
+                                     GError         **error)
 {
   GdkTexture *texture;
   GError *local_error = NULL;
@@ -84,6 +88,19 @@ gtk_css_image_url_load_image (GtkCssImageUrl  *url,
   return url->loaded_image;
 }
 
+static GtkCssImage *
+gtk_css_image_url_load_image (GtkCssImageUrl  *url,
+                              GError         **error)
+{
+  GtkCssImage *image;
+
+  G_LOCK (loaded_image);
+  image = gtk_css_image_url_load_image_locked (url, error);
+  G_UNLOCK (loaded_image);
+
+  return image;
+}
+
 static int
 gtk_css_image_url_get_width (GtkCssImage *image)
 {
@@ -177,8 +194,14 @@ gtk_css_image_url_print (GtkCssImage *image,
                          GString     *string)
 {
   GtkCssImageUrl *url = GTK_CSS_IMAGE_URL (image);
-
-  _gtk_css_image_print (gtk_css_image_url_load_image (url, NULL), string);
+  char *uri;
+
+  /* Print the url and not the image, so the output can be parsed again */
+  uri = g_file_get_uri (url->file);
+  g_string_append (string, "url(");
+  _gtk_css_print_string (string, uri);
+  g_string_append (string, ")");
+  g_free (uri);
 }
 
 static void
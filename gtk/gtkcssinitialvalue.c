@@ -105,6 +105,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_INITIAL = {
   gtk_css_value_initial_free,
   gtk_css_value_initial_compute,
   gtk_css_value_initial_equal,
+  NULL,
   gtk_css_value_initial_transition,
   NULL,
   NULL,
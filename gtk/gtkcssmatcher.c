@@ -188,6 +188,8 @@ _gtk_css_matcher_init (GtkCssMatcher               *matcher,
 
 /* GTK_CSS_MATCHER_NODE */
 
+static const GtkCssMatcherClass GTK_CSS_MATCHER_NODE;
+
 static gboolean
 gtk_css_matcher_node_get_parent (GtkCssMatcher       *matcher,
                                  const GtkCssMatcher *child)
@@ -198,7 +200,14 @@ gtk_css_matcher_node_get_parent (GtkCssMatcher       *matcher,
   if (node == NULL)
     return FALSE;
 
-  return gtk_css_node_init_matcher (node, matcher);
+  if (!gtk_css_node_init_matcher (node, matcher))
+    return FALSE;
+
+  /* The ancestors of the parent are ancestors of the child, too */
+  if (matcher->klass == &GTK_CSS_MATCHER_NODE)
+    matcher->node.filter = child->node.filter;
+
+  return TRUE;
 }
 
 static GtkCssNode *
@@ -231,7 +240,13 @@ gtk_css_matcher_node_get_previous (GtkCssMatcher       *matcher,
   if (node == NULL)
     return FALSE;
 
-  return gtk_css_node_init_matcher (node, matcher);
+  if (!gtk_css_node_init_matcher (node, matcher))
+    return FALSE;
+
+  if (matcher->klass == &GTK_CSS_MATCHER_NODE)
+    matcher->node.filter = next->node.filter;
+
+  return TRUE;
 }
 
 static GtkStateFlags
@@ -325,6 +340,34 @@ _gtk_css_matcher_node_init (GtkCssMatcher *matcher,
 {
   matcher->node.klass = &GTK_CSS_MATCHER_NODE;
   matcher->node.node = node;
+  matcher->node.filter = NULL;
+}
+
+gboolean
+_gtk_css_matcher_is_node (const GtkCssMatcher *matcher)
+{
+  return matcher->klass == &GTK_CSS_MATCHER_NODE;
+}
+
+/* @filter must contain the names, ids and classes of all ancestors
+ * of the node, it is used to quickly reject selectors that need an
+ * ancestor the node doesn't have */
+void
+_gtk_css_matcher_node_set_filter (GtkCssMatcher                *matcher,
+                                  const GtkCountingBloomFilter *filter)
+{
+  g_return_if_fail (matcher->klass == &GTK_CSS_MATCHER_NODE);
+
+  matcher->node.filter = filter;
+}
+
+const GtkCountingBloomFilter *
+_gtk_css_matcher_get_filter (const GtkCssMatcher *matcher)
+{
+  if (matcher->klass != &GTK_CSS_MATCHER_NODE)
+    return NULL;
+
+  return matcher->node.filter;
 }
 
 /* GTK_CSS_MATCHER_WIDGET_ANY */
@@ -21,6 +21,7 @@
 #include <gtk/gtkenums.h>
 #include <gtk/gtktypes.h>
 #include "gtk/gtkcsstypesprivate.h"
+#include "gtk/gtkcountingbloomfilterprivate.h"
 
 G_BEGIN_DECLS
 
@@ -60,6 +61,7 @@ struct _GtkCssMatcherWidgetPath {
 struct _GtkCssMatcherNode {
   const GtkCssMatcherClass *klass;
   GtkCssNode               *node;
+  const GtkCountingBloomFilter *filter;      /* names, ids and classes of all ancestors or NULL */
 };
 
 struct _GtkCssMatcherSuperset {
@@ -80,6 +82,11 @@ gboolean          _gtk_css_matcher_init           (GtkCssMatcher          *match
                                                    const GtkCssNodeDeclaration *decl) G_GNUC_WARN_UNUSED_RESULT;
 void              _gtk_css_matcher_node_init      (GtkCssMatcher          *matcher,
                                                    GtkCssNode             *node);
+gboolean          _gtk_css_matcher_is_node        (const GtkCssMatcher    *matcher);
+void              _gtk_css_matcher_node_set_filter (GtkCssMatcher         *matcher,
+                                                   const GtkCountingBloomFilter *filter);
+const GtkCountingBloomFilter *
+                  _gtk_css_matcher_get_filter     (const GtkCssMatcher    *matcher);
 void              _gtk_css_matcher_any_init       (GtkCssMatcher          *matcher);
 void              _gtk_css_matcher_superset_init  (GtkCssMatcher          *matcher,
                                                    const GtkCssMatcher    *subset,
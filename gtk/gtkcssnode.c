@@ -22,11 +22,16 @@
 #include "gtkcssanimatedstyleprivate.h"
 #include "gtkcsssectionprivate.h"
 #include "gtkcssstylepropertyprivate.h"
+#include "gtkdebug.h"
+#include "gtkicontheme.h"
 #include "gtkintl.h"
 #include "gtkmarshalers.h"
 #include "gtksettingsprivate.h"
+#include "gtkstyleproviderprivate.h"
 #include "gtktypebuiltins.h"
 
+#include <string.h>
+
 /*
  * CSS nodes are the backbone of the GtkStyleContext implementation and
  * replace the role that GtkWidgetPath played in the past. A CSS node has
@@ -112,9 +117,53 @@ struct _GtkCssNodeStyleChange {
   GtkCssStyle *new_style;
 };
 
+typedef struct _GtkCssStyleTasks GtkCssStyleTasks;
+
+/* A static style computed on the style thread pool before validating,
+ * see gtk_css_node_validate() */
+struct _GtkCssStyleTask
+{
+  GtkCssStyleTasks *tasks;
+  GtkCssNode       *node;
+  GtkCssStyleTask  *parent;             /* task computing the parent style or NULL */
+  GtkCssStyleTask  *first_child;
+  GtkCssStyleTask  *next_sibling;
+  GtkStyleProvider *provider;
+  GtkCssStyle      *parent_style;       /* parent style the style is computed for */
+  GtkCssStyle      *style;              /* the style until the node takes it */
+  GPtrArray        *errors;             /* errors emitted while computing the style */
+  guint             use_matcher : 1;
+};
+
+struct _GtkCssStyleTasks
+{
+  GPtrArray        *tasks;
+  GPtrArray        *settings;           /* settings of the tasks' providers */
+  guint             generation;         /* style_generation when the styles were computed */
+  guint             n_pending;
+  GMutex            lock;
+  GCond             cond;
+};
+
 static guint cssnode_signals[LAST_SIGNAL] = { 0 };
 static GParamSpec *cssnode_properties[NUM_PROPERTIES];
 
+/* Changes whenever something changes that styles computed by style
+ * tasks depend on */
+static guint style_generation;
+/* The tasks of the running gtk_css_node_validate() */
+static GtkCssStyleTasks *current_style_tasks;
+
+#ifdef G_ENABLE_DEBUG
+/* Counted for GTK_DEBUG=styles since they were last printed */
+static struct {
+  guint changes;                /* class and state changes */
+  guint unused_changes;         /* changes that no selector depends on */
+  guint updated;                /* nodes whose style was updated */
+  guint restyled;               /* nodes that got a new static style */
+} style_stats;
+#endif
+
 static GtkStyleProvider *
 gtk_css_node_get_style_provider_or_null (GtkCssNode *cssnode)
 {
@@ -352,14 +401,44 @@ store_in_global_parent_cache (GtkCssNode                  *node,
                                                  style);
 }
 
+/* Returns the style computed by the style task of @cssnode if it is
+ * the style that would be computed now */
 static GtkCssStyle *
-gtk_css_node_create_style (GtkCssNode *cssnode)
+gtk_css_node_take_task_style (GtkCssNode  *cssnode,
+                              GtkCssStyle *parent)
+{
+  GtkCssStyleTask *task = cssnode->style_task;
+  GtkCssMatcher matcher;
+  GtkCssStyle *style;
+
+  if (task == NULL ||
+      task->style == NULL ||
+      task->tasks->generation != style_generation ||
+      task->parent_style != parent ||
+      task->provider != gtk_css_node_get_style_provider (cssnode) ||
+      task->use_matcher != gtk_css_node_init_matcher (cssnode, &matcher))
+    return NULL;
+
+  gtk_style_provider_emit_deferred_errors (task->errors);
+  g_clear_pointer (&task->errors, g_ptr_array_unref);
+
+  style = task->style;
+  task->style = NULL;
+
+  return style;
+}
+
+static GtkCssStyle *
+gtk_css_node_create_style (GtkCssNode                   *cssnode,
+                           const GtkCountingBloomFilter *filter)
 {
   const GtkCssNodeDeclaration *decl;
   GtkCssMatcher matcher;
   GtkCssStyle *parent;
   GtkCssStyle *style;
 
+  GTK_NOTE (STYLES, style_stats.restyled++);
+
   decl = gtk_css_node_get_declaration (cssnode);
 
   style = lookup_in_global_parent_cache (cssnode, decl);
@@ -368,14 +447,23 @@ gtk_css_node_create_style (GtkCssNode *cssnode)
 
   parent = cssnode->parent ? cssnode->parent->style : NULL;
 
-  if (gtk_css_node_init_matcher (cssnode, &matcher))
-    style = gtk_css_static_style_new_compute (gtk_css_node_get_style_provider (cssnode),
-                                              &matcher,
-                                              parent);
-  else
-    style = gtk_css_static_style_new_compute (gtk_css_node_get_style_provider (cssnode),
-                                              NULL,
-                                              parent);
+  style = gtk_css_node_take_task_style (cssnode, parent);
+  if (style == NULL)
+    {
+      if (gtk_css_node_init_matcher (cssnode, &matcher))
+        {
+          if (filter && _gtk_css_matcher_is_node (&matcher))
+            _gtk_css_matcher_node_set_filter (&matcher, filter);
+
+          style = gtk_css_static_style_new_compute (gtk_css_node_get_style_provider (cssnode),
+                                                    &matcher,
+                                                    parent);
+        }
+      else
+        style = gtk_css_static_style_new_compute (gtk_css_node_get_style_provider (cssnode),
+                                                  NULL,
+                                                  parent);
+    }
 
   store_in_global_parent_cache (cssnode, decl, style);
 
@@ -406,10 +494,11 @@ gtk_css_style_needs_recreation (GtkCssStyle  *style,
 }
 
 static GtkCssStyle *
-gtk_css_node_real_update_style (GtkCssNode   *cssnode,
-                                GtkCssChange  change,
-                                gint64        timestamp,
-                                GtkCssStyle  *style)
+gtk_css_node_real_update_style (GtkCssNode                   *cssnode,
+                                const GtkCountingBloomFilter *filter,
+                                GtkCssChange                  change,
+                                gint64                        timestamp,
+                                GtkCssStyle                  *style)
 {
   GtkCssStyle *static_style, *new_static_style, *new_style;
 
@@ -423,7 +512,7 @@ gtk_css_node_real_update_style (GtkCssNode   *cssnode,
     }
 
   if (gtk_css_style_needs_recreation (static_style, change))
-    new_static_style = gtk_css_node_create_style (cssnode);
+    new_static_style = gtk_css_node_create_style (cssnode, filter);
   else
     new_static_style = g_object_ref (static_style);
 
@@ -951,6 +1040,9 @@ gtk_css_node_set_style (GtkCssNode  *cssnode,
   return style_changed;
 }
 
+static void gtk_css_node_invalidate_internal (GtkCssNode   *cssnode,
+                                              GtkCssChange  change);
+
 static void
 gtk_css_node_propagate_pending_changes (GtkCssNode *cssnode,
                                         gboolean    style_changed)
@@ -970,7 +1062,7 @@ gtk_css_node_propagate_pending_changes (GtkCssNode *cssnode,
        child = gtk_css_node_get_next_sibling (child))
     {
       child_change = child->pending_changes;
-      gtk_css_node_invalidate (child, change);
+      gtk_css_node_invalidate_internal (child, change);
       if (child->visible)
         change |= _gtk_css_change_for_sibling (child_change);
     }
@@ -984,9 +1076,11 @@ gtk_css_node_needs_new_style (GtkCssNode *cssnode)
   return cssnode->style_is_invalid || cssnode->needs_propagation;
 }
 
+/* @filter must be NULL or contain the ancestors of @cssnode */
 static void
-gtk_css_node_ensure_style (GtkCssNode *cssnode,
-                           gint64      current_time)
+gtk_css_node_ensure_style (GtkCssNode                   *cssnode,
+                           const GtkCountingBloomFilter *filter,
+                           gint64                        current_time)
 {
   gboolean style_changed;
 
@@ -994,19 +1088,23 @@ gtk_css_node_ensure_style (GtkCssNode *cssnode,
     return;
 
   if (cssnode->parent)
-    gtk_css_node_ensure_style (cssnode->parent, current_time);
+    gtk_css_node_ensure_style (cssnode->parent, NULL, current_time);
 
   if (cssnode->style_is_invalid)
     {
       GtkCssStyle *new_style;
 
       if (cssnode->previous_sibling)
-        gtk_css_node_ensure_style (cssnode->previous_sibling, current_time);
+        gtk_css_node_ensure_style (cssnode->previous_sibling, filter, current_time);
 
       g_clear_pointer (&cssnode->cache, gtk_css_node_style_cache_unref);
 
+      GTK_NOTE (STYLES, style_stats.updated++);
+
       new_style = GTK_CSS_NODE_GET_CLASS (cssnode)->update_style (cssnode,
-                                                                  cssnode->pending_changes,
+                                                                  filter,
+                                                                  cssnode->pending_changes |
+                                                                  cssnode->pending_self_changes,
                                                                   current_time,
                                                                   cssnode->style);
 
@@ -1021,6 +1119,7 @@ gtk_css_node_ensure_style (GtkCssNode *cssnode,
   gtk_css_node_propagate_pending_changes (cssnode, style_changed);
 
   cssnode->pending_changes = 0;
+  cssnode->pending_self_changes = 0;
   cssnode->style_is_invalid = FALSE;
 }
 
@@ -1031,7 +1130,7 @@ gtk_css_node_get_style (GtkCssNode *cssnode)
     {
       gint64 timestamp = gtk_css_node_get_timestamp (cssnode);
 
-      gtk_css_node_ensure_style (cssnode, timestamp);
+      gtk_css_node_ensure_style (cssnode, NULL, timestamp);
     }
 
   return cssnode->style;
@@ -1049,6 +1148,8 @@ gtk_css_node_set_visible (GtkCssNode *cssnode,
   cssnode->visible = visible;
   g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_VISIBLE]);
 
+  style_generation++;
+
   if (cssnode->invalid)
     {
       if (cssnode->visible)
@@ -1155,13 +1256,167 @@ gtk_css_node_get_id (GtkCssNode *cssnode)
   return gtk_css_node_declaration_get_id (cssnode->decl);
 }
 
+/* Adds the style providers of @cssnode and its descendants that are
+ * not in @providers yet. Widgets with providers of their own get a
+ * separate cascade, which doesn't apply to their children.
+ */
+static void
+gtk_css_node_collect_providers (GtkCssNode       *cssnode,
+                                GtkStyleProvider *parent_provider,
+                                GPtrArray        *providers)
+{
+  GtkStyleProvider *provider;
+  GtkCssNode *child;
+
+  provider = gtk_css_node_get_style_provider_or_null (cssnode);
+  if (provider == NULL)
+    provider = parent_provider;
+  else if (provider != parent_provider && !g_ptr_array_find (providers, provider, NULL))
+    g_ptr_array_add (providers, provider);
+
+  for (child = cssnode->first_child; child; child = child->next_sibling)
+    gtk_css_node_collect_providers (child, provider, providers);
+}
+
+/* Returns the style providers of the nodes whose style may depend on
+ * the classes and state of @cssnode: the node itself, its descendants,
+ * its later siblings and their descendants.
+ */
+static GPtrArray *
+gtk_css_node_get_affected_providers (GtkCssNode *cssnode)
+{
+  GtkStyleProvider *provider, *parent_provider;
+  GPtrArray *providers;
+  GtkCssNode *node;
+
+  providers = g_ptr_array_new ();
+
+  provider = gtk_css_node_get_style_provider (cssnode);
+  g_ptr_array_add (providers, provider);
+
+  for (node = cssnode->first_child; node; node = node->next_sibling)
+    gtk_css_node_collect_providers (node, provider, providers);
+
+  if (cssnode->parent)
+    parent_provider = gtk_css_node_get_style_provider (cssnode->parent);
+  else
+    parent_provider = provider;
+
+  for (node = cssnode->next_sibling; node; node = node->next_sibling)
+    gtk_css_node_collect_providers (node, parent_provider, providers);
+
+  return providers;
+}
+
+static GtkCssChange
+gtk_css_node_get_class_change (GtkCssNode   *cssnode,
+                               const GQuark *classes,
+                               guint         n_classes)
+{
+  GPtrArray *providers;
+  GtkCssChange change;
+  guint i, j;
+
+  if (n_classes == 0)
+    return 0;
+
+  providers = gtk_css_node_get_affected_providers (cssnode);
+  change = 0;
+  for (i = 0; i < providers->len; i++)
+    {
+      for (j = 0; j < n_classes; j++)
+        change |= gtk_style_provider_get_class_change (g_ptr_array_index (providers, i), classes[j]);
+    }
+  g_ptr_array_unref (providers);
+
+  return change;
+}
+
+static GtkCssChange
+gtk_css_node_get_state_change (GtkCssNode    *cssnode,
+                               GtkStateFlags  state)
+{
+  GPtrArray *providers;
+  GtkCssChange change;
+  guint i;
+
+  providers = gtk_css_node_get_affected_providers (cssnode);
+  change = 0;
+  for (i = 0; i < providers->len; i++)
+    change |= gtk_style_provider_get_state_change (g_ptr_array_index (providers, i), state);
+  g_ptr_array_unref (providers);
+
+  return change;
+}
+
+/* Invalidates the nodes that may change their style when classes or
+ * state flags of @cssnode changed. @change is what the style providers
+ * of the affected nodes return for them: GTK_CSS_CHANGE_CLASS and GTK_CSS_CHANGE_STATE for
+ * the node itself, GTK_CSS_CHANGE_PARENT_CLASS and ..._PARENT_STATE for
+ * its descendants and the sibling changes for its later siblings and
+ * their descendants.
+ */
+static void
+gtk_css_node_invalidate_selectors (GtkCssNode   *cssnode,
+                                   GtkCssChange  change)
+{
+  GtkCssChange self, descendants, siblings;
+  GtkCssNode *node;
+
+  GTK_NOTE (STYLES, style_stats.changes++);
+
+  style_generation++;
+
+  if (change == 0)
+    {
+      GTK_NOTE (STYLES, style_stats.unused_changes++);
+      return;
+    }
+
+  /* Unlike pending_changes, these are not propagated to other nodes */
+  self = change & (GTK_CSS_CHANGE_CLASS | GTK_CSS_CHANGE_STATE);
+  if (self)
+    {
+      cssnode->pending_self_changes |= self;
+      GTK_CSS_NODE_GET_CLASS (cssnode)->invalidate (cssnode);
+      gtk_css_node_invalidate_style (cssnode);
+    }
+
+  /* The children propagate these further down */
+  descendants = change & (GTK_CSS_CHANGE_PARENT_CLASS | GTK_CSS_CHANGE_PARENT_STATE);
+  if (descendants)
+    {
+      for (node = cssnode->first_child; node; node = node->next_sibling)
+        gtk_css_node_invalidate_internal (node, descendants);
+    }
+
+  /* And the next sibling to the siblings after it and their children */
+  siblings = 0;
+  if (change & (GTK_CSS_CHANGE_SIBLING_CLASS | GTK_CSS_CHANGE_PARENT_SIBLING_CLASS))
+    siblings |= GTK_CSS_CHANGE_SIBLING_CLASS;
+  if (change & (GTK_CSS_CHANGE_SIBLING_STATE | GTK_CSS_CHANGE_PARENT_SIBLING_STATE))
+    siblings |= GTK_CSS_CHANGE_SIBLING_STATE;
+  if (siblings)
+    {
+      for (node = cssnode->next_sibling; node && !node->visible; node = node->next_sibling)
+        ;
+      if (node)
+        gtk_css_node_invalidate_internal (node, siblings);
+    }
+}
+
 void
 gtk_css_node_set_state (GtkCssNode    *cssnode,
                         GtkStateFlags  state_flags)
 {
+  GtkStateFlags old_state;
+
+  old_state = gtk_css_node_declaration_get_state (cssnode->decl);
+
   if (gtk_css_node_declaration_set_state (&cssnode->decl, state_flags))
     {
-      gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_STATE);
+      gtk_css_node_invalidate_selectors (cssnode,
+                                         gtk_css_node_get_state_change (cssnode, old_state ^ state_flags));
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_STATE]);
     }
 }
@@ -1175,9 +1430,16 @@ gtk_css_node_get_state (GtkCssNode *cssnode)
 static void
 gtk_css_node_clear_classes (GtkCssNode *cssnode)
 {
+  const GQuark *classes;
+  GtkCssChange change;
+  guint n_classes;
+
+  classes = gtk_css_node_declaration_get_classes (cssnode->decl, &n_classes);
+  change = gtk_css_node_get_class_change (cssnode, classes, n_classes);
+
   if (gtk_css_node_declaration_clear_classes (&cssnode->decl))
     {
-      gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_CLASS);
+      gtk_css_node_invalidate_selectors (cssnode, change);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_CLASSES]);
     }
 }
@@ -1228,7 +1490,8 @@ gtk_css_node_add_class (GtkCssNode *cssnode,
 {
   if (gtk_css_node_declaration_add_class (&cssnode->decl, style_class))
     {
-      gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_CLASS);
+      gtk_css_node_invalidate_selectors (cssnode,
+                                         gtk_css_node_get_class_change (cssnode, &style_class, 1));
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_CLASSES]);
     }
 }
@@ -1239,7 +1502,8 @@ gtk_css_node_remove_class (GtkCssNode *cssnode,
 {
   if (gtk_css_node_declaration_remove_class (&cssnode->decl, style_class))
     {
-      gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_CLASS);
+      gtk_css_node_invalidate_selectors (cssnode,
+                                         gtk_css_node_get_class_change (cssnode, &style_class, 1));
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_CLASSES]);
     }
 }
@@ -1311,9 +1575,9 @@ gtk_css_node_invalidate_frame_clock (GtkCssNode *cssnode,
     gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_ANIMATIONS);
 }
 
-void
-gtk_css_node_invalidate (GtkCssNode   *cssnode,
-                         GtkCssChange  change)
+static void
+gtk_css_node_invalidate_internal (GtkCssNode   *cssnode,
+                                  GtkCssChange  change)
 {
   if (!cssnode->invalid)
     change &= ~GTK_CSS_CHANGE_TIMESTAMP;
@@ -1330,16 +1594,42 @@ gtk_css_node_invalidate (GtkCssNode   *cssnode,
   gtk_css_node_invalidate_style (cssnode);
 }
 
+void
+gtk_css_node_invalidate (GtkCssNode   *cssnode,
+                         GtkCssChange  change)
+{
+  /* Unlike propagating changes while validating, this is called when
+   * something in the tree changed */
+  style_generation++;
+
+  gtk_css_node_invalidate_internal (cssnode, change);
+}
+
+/* Nodes that match a widget path have ancestors that aren't css nodes,
+ * so their descendants can't use an ancestor filter */
+static gboolean
+gtk_css_node_supports_filter (GtkCssNode *cssnode)
+{
+  GtkCssMatcher matcher;
+
+  if (!gtk_css_node_init_matcher (cssnode, &matcher))
+    return TRUE;
+
+  return _gtk_css_matcher_is_node (&matcher);
+}
+
 static void
-gtk_css_node_validate_internal (GtkCssNode *cssnode,
-                                gint64      timestamp)
+gtk_css_node_validate_internal (GtkCssNode             *cssnode,
+                                GtkCountingBloomFilter *filter,
+                                gint64                  timestamp)
 {
+  GtkCssNodeDeclaration *decl;
   GtkCssNode *child;
 
   if (!cssnode->invalid)
     return;
 
-  gtk_css_node_ensure_style (cssnode, timestamp);
+  gtk_css_node_ensure_style (cssnode, filter, timestamp);
 
   /* need to set to FALSE then to TRUE here to make it chain up */
   gtk_css_node_set_invalid (cssnode, FALSE);
@@ -1348,23 +1638,367 @@ gtk_css_node_validate_internal (GtkCssNode *cssnode,
 
   GTK_CSS_NODE_GET_CLASS (cssnode)->validate (cssnode);
 
+  /* Keep the declaration around, the node's may change while
+   * validating the children */
+  if (filter && gtk_css_node_supports_filter (cssnode))
+    {
+      decl = gtk_css_node_declaration_ref (cssnode->decl);
+      gtk_css_node_declaration_add_bloom_hashes (decl, filter);
+    }
+  else
+    {
+      decl = NULL;
+      filter = NULL;
+    }
+
   for (child = gtk_css_node_get_first_child (cssnode);
        child;
        child = gtk_css_node_get_next_sibling (child))
     {
       if (child->visible)
-        gtk_css_node_validate_internal (child, timestamp);
+        gtk_css_node_validate_internal (child, filter, timestamp);
+    }
+
+  if (decl)
+    {
+      gtk_css_node_declaration_remove_bloom_hashes (decl, filter);
+      gtk_css_node_declaration_unref (decl);
     }
 }
 
+/* COMPUTING STYLES IN PARALLEL
+ *
+ * With GTK_CSS_THREADS set, gtk_css_node_validate() first computes the
+ * static styles that validating the tree is likely going to need on a
+ * thread pool. The descendants of the validated node that need a new
+ * static style, assuming that new styles of their ancestors are always
+ * different from the old ones, get a task each, and a task is run once
+ * the task of the parent node is done.
+ *
+ * The main thread waits for the tasks and then validates the tree as
+ * usual. gtk_css_node_create_style() takes the style of a task instead
+ * of computing one when it has been computed for the same parent style
+ * and provider and nothing in the tree changed since, so setting the
+ * styles and emitting ::style-changed still happens in tree order on
+ * the main thread.
+ *
+ * Only nodes that match with node matchers are computed on the pool,
+ * the ancestor filter is not used there.
+ */
+
+static GThreadPool *style_pool;
+
+static void
+gtk_css_style_task_run (gpointer data,
+                        gpointer user_data)
+{
+  GtkCssStyleTask *task = data;
+  GtkCssStyleTasks *tasks = task->tasks;
+  GtkCssStyleTask *child, *next;
+  GtkCssMatcher matcher;
+
+  while (task)
+    {
+      if (task->parent)
+        task->parent_style = g_object_ref (task->parent->style);
+
+      gtk_style_provider_defer_errors (&task->errors);
+      if (task->use_matcher)
+        {
+          gtk_css_node_init_matcher (task->node, &matcher);
+          task->style = gtk_css_static_style_new_compute (task->provider,
+                                                          &matcher,
+                                                          task->parent_style);
+        }
+      else
+        task->style = gtk_css_static_style_new_compute (task->provider,
+                                                        NULL,
+                                                        task->parent_style);
+      gtk_style_provider_defer_errors (NULL);
+
+      /* Continue with the first child here and leave the others to
+       * other threads */
+      next = task->first_child;
+      if (next)
+        {
+          for (child = next->next_sibling; child; child = child->next_sibling)
+            g_thread_pool_push (style_pool, child, NULL);
+        }
+
+      g_mutex_lock (&tasks->lock);
+      tasks->n_pending--;
+      if (tasks->n_pending == 0)
+        g_cond_signal (&tasks->cond);
+      g_mutex_unlock (&tasks->lock);
+
+      task = next;
+    }
+}
+
+static GThreadPool *
+gtk_css_node_get_style_pool (void)
+{
+  static gboolean initialized = FALSE;
+  const char *env;
+  guint n_threads;
+
+  if (initialized)
+    return style_pool;
+
+  initialized = TRUE;
+
+  env = g_getenv ("GTK_CSS_THREADS");
+  if (env == NULL)
+    return NULL;
+
+  if (g_ascii_strcasecmp (env, "auto") == 0)
+    n_threads = g_get_num_processors ();
+  else
+    n_threads = g_ascii_strtoull (env, NULL, 10);
+
+  if (n_threads > 1)
+    style_pool = g_thread_pool_new (gtk_css_style_task_run,
+                                    NULL,
+                                    n_threads,
+                                    FALSE,
+                                    NULL);
+
+  return style_pool;
+}
+
+static GtkCssStyleTasks *
+gtk_css_style_tasks_new (void)
+{
+  GtkCssStyleTasks *tasks;
+
+  tasks = g_slice_new0 (GtkCssStyleTasks);
+  tasks->tasks = g_ptr_array_new ();
+  tasks->settings = g_ptr_array_new ();
+  g_mutex_init (&tasks->lock);
+  g_cond_init (&tasks->cond);
+
+  return tasks;
+}
+
+static void
+gtk_css_style_tasks_free (GtkCssStyleTasks *tasks)
+{
+  guint i;
+
+  for (i = 0; i < tasks->tasks->len; i++)
+    {
+      GtkCssStyleTask *task = g_ptr_array_index (tasks->tasks, i);
+
+      if (task->node->style_task == task)
+        task->node->style_task = NULL;
+      g_object_unref (task->node);
+      g_object_unref (task->provider);
+      g_clear_object (&task->parent_style);
+      g_clear_object (&task->style);
+      g_clear_pointer (&task->errors, g_ptr_array_unref);
+
+      g_slice_free (GtkCssStyleTask, task);
+    }
+
+  if (current_style_tasks == tasks)
+    current_style_tasks = NULL;
+
+  g_ptr_array_unref (tasks->tasks);
+  g_ptr_array_unref (tasks->settings);
+  g_mutex_clear (&tasks->lock);
+  g_cond_clear (&tasks->cond);
+
+  g_slice_free (GtkCssStyleTasks, tasks);
+}
+
+static GtkCssStyleTask *
+gtk_css_style_tasks_add (GtkCssStyleTasks *tasks,
+                         GtkCssNode       *node,
+                         GtkCssStyleTask  *parent)
+{
+  GtkCssStyleTask *task;
+  GtkCssMatcher matcher;
+  GtkSettings *settings;
+
+  task = g_slice_new0 (GtkCssStyleTask);
+  task->tasks = tasks;
+  task->node = g_object_ref (node);
+  task->provider = g_object_ref (gtk_css_node_get_style_provider (node));
+  task->use_matcher = gtk_css_node_init_matcher (node, &matcher);
+
+  if (parent)
+    {
+      task->parent = parent;
+      task->next_sibling = parent->first_child;
+      parent->first_child = task;
+    }
+  else
+    {
+      task->parent_style = g_object_ref (node->parent->style);
+    }
+
+  node->style_task = task;
+  g_ptr_array_add (tasks->tasks, task);
+
+  settings = gtk_style_provider_get_settings (task->provider);
+  if (settings && !g_ptr_array_find (tasks->settings, settings, NULL))
+    g_ptr_array_add (tasks->settings, settings);
+
+  return task;
+}
+
+/* Adds tasks for the descendants of @cssnode that are likely to need
+ * a new static style when validating. @pending_changes are the changes
+ * @cssnode will have when it is validated and @parent its task, if it
+ * has one. */
+static void
+gtk_css_node_add_style_tasks (GtkCssNode       *cssnode,
+                              GtkCssChange      pending_changes,
+                              GtkCssStyleTask  *parent,
+                              GtkCssStyleTasks *tasks)
+{
+  GtkCssChange change, child_change;
+  GtkCssStyleTask *task;
+  GtkCssNode *child;
+
+  /* Like gtk_css_node_propagate_pending_changes() */
+  change = _gtk_css_change_for_child (pending_changes);
+  if (parent)
+    change |= GTK_CSS_CHANGE_PARENT_STYLE;
+
+  for (child = gtk_css_node_get_first_child (cssnode);
+       child;
+       child = gtk_css_node_get_next_sibling (child))
+    {
+      if (!child->visible)
+        continue;
+
+      child_change = child->pending_changes;
+
+      if (gtk_css_node_supports_filter (child))
+        {
+          if (gtk_css_style_needs_recreation (child->style,
+                                              change | child_change | child->pending_self_changes))
+            task = gtk_css_style_tasks_add (tasks, child, parent);
+          else
+            task = NULL;
+
+          gtk_css_node_add_style_tasks (child, change | child_change, task, tasks);
+        }
+
+      change |= _gtk_css_change_for_sibling (child_change);
+    }
+}
+
+/* @filter must contain the ancestors of @cssnode */
+static GtkCssStyleTasks *
+gtk_css_node_compute_styles_in_parallel (GtkCssNode                   *cssnode,
+                                         const GtkCountingBloomFilter *filter,
+                                         gint64                        timestamp)
+{
+  GtkCssStyleTasks *tasks;
+  GThreadPool *pool;
+  guint i;
+
+  pool = gtk_css_node_get_style_pool ();
+  if (pool == NULL ||
+      current_style_tasks != NULL ||
+      !cssnode->invalid ||
+      !gtk_css_node_supports_filter (cssnode))
+    return NULL;
+
+  /* The tasks need the new style of @cssnode and its changes to be
+   * propagated to the children */
+  gtk_css_node_ensure_style (cssnode, filter, timestamp);
+
+  tasks = gtk_css_style_tasks_new ();
+  gtk_css_node_add_style_tasks (cssnode, cssnode->pending_changes, NULL, tasks);
+  if (tasks->tasks->len < 2)
+    {
+      gtk_css_style_tasks_free (tasks);
+      return NULL;
+    }
+
+  for (i = 0; i < tasks->settings->len; i++)
+    {
+      GtkSettings *settings = g_ptr_array_index (tasks->settings, i);
+
+      gtk_settings_freeze_display_settings (settings);
+      /* Computing styles creates it on demand otherwise */
+      gtk_icon_theme_get_for_display (_gtk_settings_get_display (settings));
+    }
+
+  tasks->generation = style_generation;
+  tasks->n_pending = tasks->tasks->len;
+
+  for (i = 0; i < tasks->tasks->len; i++)
+    {
+      GtkCssStyleTask *task = g_ptr_array_index (tasks->tasks, i);
+
+      if (task->parent == NULL)
+        g_thread_pool_push (pool, task, NULL);
+    }
+
+  g_mutex_lock (&tasks->lock);
+  while (tasks->n_pending > 0)
+    g_cond_wait (&tasks->cond, &tasks->lock);
+  g_mutex_unlock (&tasks->lock);
+
+  for (i = 0; i < tasks->settings->len; i++)
+    gtk_settings_thaw_display_settings (g_ptr_array_index (tasks->settings, i));
+
+  current_style_tasks = tasks;
+
+  return tasks;
+}
+
 void
 gtk_css_node_validate (GtkCssNode *cssnode)
 {
+  GtkCountingBloomFilter filter = GTK_COUNTING_BLOOM_FILTER_INIT;
+  GtkCssStyleTasks *tasks = NULL;
+  gboolean use_filter = TRUE;
+  GtkCssNode *ancestor;
   gint64 timestamp;
 
   timestamp = gtk_css_node_get_timestamp (cssnode);
 
-  gtk_css_node_validate_internal (cssnode, timestamp);
+  for (ancestor = cssnode->parent; ancestor; ancestor = ancestor->parent)
+    {
+      if (!gtk_css_node_supports_filter (ancestor))
+        {
+          use_filter = FALSE;
+          break;
+        }
+
+      gtk_css_node_declaration_add_bloom_hashes (ancestor->decl, &filter);
+    }
+
+  /* Styles of nodes below path nodes can't be computed on other threads */
+  if (use_filter)
+    tasks = gtk_css_node_compute_styles_in_parallel (cssnode, &filter, timestamp);
+
+  gtk_css_node_validate_internal (cssnode, use_filter ? &filter : NULL, timestamp);
+
+  if (tasks)
+    gtk_css_style_tasks_free (tasks);
+
+#ifdef G_ENABLE_DEBUG
+  if (GTK_DEBUG_CHECK (STYLES) && style_stats.updated > 0)
+    {
+      if (style_stats.changes > 0)
+        g_message ("Validated styles: %u class and state changes (%u affecting no selector), "
+                   "%u styles updated, %u restyled, %.1f restyled per change",
+                   style_stats.changes, style_stats.unused_changes,
+                   style_stats.updated, style_stats.restyled,
+                   (double) style_stats.restyled / style_stats.changes);
+      else
+        g_message ("Validated styles: %u styles updated, %u restyled",
+                   style_stats.updated, style_stats.restyled);
+
+      memset (&style_stats, 0, sizeof (style_stats));
+    }
+#endif
 }
 
 gboolean
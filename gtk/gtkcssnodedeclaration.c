@@ -18,6 +18,7 @@
 #include "config.h"
 
 #include "gtkcssnodedeclarationprivate.h"
+#include "gtkcssselectorprivate.h"
 #include "gtkwidgetpathprivate.h"
 
 #include <string.h>
@@ -342,6 +343,40 @@ gtk_css_node_declaration_get_classes (const GtkCssNodeDeclaration *decl,
   return get_classes (decl);
 }
 
+void
+gtk_css_node_declaration_add_bloom_hashes (const GtkCssNodeDeclaration *decl,
+                                           GtkCountingBloomFilter      *filter)
+{
+  GQuark *classes;
+  guint i;
+
+  if (decl->name)
+    gtk_counting_bloom_filter_add (filter, gtk_css_hash_name (decl->name));
+  if (decl->id)
+    gtk_counting_bloom_filter_add (filter, gtk_css_hash_id (decl->id));
+
+  classes = get_classes (decl);
+  for (i = 0; i < decl->n_classes; i++)
+    gtk_counting_bloom_filter_add (filter, gtk_css_hash_class (classes[i]));
+}
+
+void
+gtk_css_node_declaration_remove_bloom_hashes (const GtkCssNodeDeclaration *decl,
+                                              GtkCountingBloomFilter      *filter)
+{
+  GQuark *classes;
+  guint i;
+
+  if (decl->name)
+    gtk_counting_bloom_filter_remove (filter, gtk_css_hash_name (decl->name));
+  if (decl->id)
+    gtk_counting_bloom_filter_remove (filter, gtk_css_hash_id (decl->id));
+
+  classes = get_classes (decl);
+  for (i = 0; i < decl->n_classes; i++)
+    gtk_counting_bloom_filter_remove (filter, gtk_css_hash_class (classes[i]));
+}
+
 guint
 gtk_css_node_declaration_hash (gconstpointer elem)
 {
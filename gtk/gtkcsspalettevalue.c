@@ -104,6 +104,22 @@ gtk_css_value_palette_equal (const GtkCssValue *value1,
   return TRUE;
 }
 
+static guint
+gtk_css_value_palette_hash (const GtkCssValue *value)
+{
+  gpointer name, color;
+  GHashTableIter iter;
+  guint hash;
+
+  /* Summed up, so the order of the hash table does not matter */
+  hash = 0;
+  g_hash_table_iter_init (&iter, value->colors);
+  while (g_hash_table_iter_next (&iter, &name, &color))
+    hash += g_str_hash (name) ^ gtk_css_value_hash (color);
+
+  return hash;
+}
+
 static GtkCssValue *
 gtk_css_value_palette_transition (GtkCssValue *start,
                                   GtkCssValue *end,
@@ -177,6 +193,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_PALETTE = {
   gtk_css_value_palette_free,
   gtk_css_value_palette_compute,
   gtk_css_value_palette_equal,
+  gtk_css_value_palette_hash,
   gtk_css_value_palette_transition,
   NULL,
   NULL,
@@ -65,6 +65,12 @@ gtk_css_value_position_equal (const GtkCssValue *position1,
       && _gtk_css_value_equal (position1->y, position2->y);
 }
 
+static guint
+gtk_css_value_position_hash (const GtkCssValue *position)
+{
+  return gtk_css_value_hash (position->x) ^ (gtk_css_value_hash (position->y) << 3);
+}
+
 static GtkCssValue *
 gtk_css_value_position_transition (GtkCssValue *start,
                                    GtkCssValue *end,
@@ -153,6 +159,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_POSITION = {
   gtk_css_value_position_free,
   gtk_css_value_position_compute,
   gtk_css_value_position_equal,
+  gtk_css_value_position_hash,
   gtk_css_value_position_transition,
   NULL,
   NULL,
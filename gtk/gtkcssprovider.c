@@ -28,11 +28,18 @@
 #include "gtkbitmaskprivate.h"
 #include "gtkcssarrayvalueprivate.h"
 #include "gtkcsscolorvalueprivate.h"
+#include "gtkcssdimensionvalueprivate.h"
+#include "gtkcssenumvalueprivate.h"
+#include "gtkcssinheritvalueprivate.h"
+#include "gtkcssinitialvalueprivate.h"
 #include "gtkcsskeyframesprivate.h"
 #include "gtkcssparserprivate.h"
 #include "gtkcsssectionprivate.h"
 #include "gtkcssselectorprivate.h"
 #include "gtkcssshorthandpropertyprivate.h"
+#include "gtkcssstringvalueprivate.h"
+#include "gtkcssunsetvalueprivate.h"
+#include "gtkdebug.h"
 #include "gtksettingsprivate.h"
 #include "gtkstyleprovider.h"
 #include "gtkstylecontextprivate.h"
@@ -74,6 +81,10 @@
  *
  * In the same way, GTK+ tries to load a gtk-keys.css file for the current
  * key theme, as defined by #GtkSettings:gtk-key-theme-name.
+ *
+ * Parsed themes are cached in `$XDG_CACHE_HOME/gtk-4.0/css`, which makes
+ * loading them faster the next time. The cache is not used after any of
+ * the theme's files have changed.
  */
 
 
@@ -117,8 +128,13 @@ struct _GtkCssProviderPrivate
 
   GArray *rulesets;
   GtkCssSelectorTree *tree;
+  GtkCssInvalidations *invalidations;   /* created from the tree on demand */
   GResource *resource;
   gchar *path;
+
+  /* Only used while loading a theme that gets written to the cache */
+  GVariantBuilder *cache_sources;
+  guint cache_invalid : 1;
 };
 
 enum {
@@ -336,6 +352,11 @@ gtk_css_provider_emit_error (GtkCssProvider *provider,
                              GtkCssScanner  *scanner,
                              const GError   *error)
 {
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (provider);
+
+  /* The cache would lose the error */
+  priv->cache_invalid = TRUE;
+
   gtk_css_style_provider_emit_error (GTK_STYLE_PROVIDER (provider),
                                      scanner ? scanner->section : NULL,
                                      error);
@@ -614,6 +635,37 @@ gtk_css_style_provider_lookup (GtkStyleProvider    *provider,
     }
 }
 
+static GtkCssInvalidations *
+gtk_css_provider_get_invalidations (GtkCssProvider *css_provider)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
+
+  if (priv->invalidations == NULL)
+    priv->invalidations = _gtk_css_selector_tree_get_invalidations (priv->tree);
+
+  return priv->invalidations;
+}
+
+static GtkCssChange
+gtk_css_style_provider_get_class_change (GtkStyleProvider *provider,
+                                         GQuark            style_class)
+{
+  GtkCssProvider *css_provider = GTK_CSS_PROVIDER (provider);
+
+  return gtk_css_invalidations_get_class_change (gtk_css_provider_get_invalidations (css_provider),
+                                                 style_class);
+}
+
+static GtkCssChange
+gtk_css_style_provider_get_state_change (GtkStyleProvider *provider,
+                                         GtkStateFlags     state)
+{
+  GtkCssProvider *css_provider = GTK_CSS_PROVIDER (provider);
+
+  return gtk_css_invalidations_get_state_change (gtk_css_provider_get_invalidations (css_provider),
+                                                 state);
+}
+
 static void
 gtk_css_style_provider_iface_init (GtkStyleProviderInterface *iface)
 {
@@ -621,6 +673,8 @@ gtk_css_style_provider_iface_init (GtkStyleProviderInterface *iface)
   iface->get_keyframes = gtk_css_style_provider_get_keyframes;
   iface->lookup = gtk_css_style_provider_lookup;
   iface->emit_error = gtk_css_style_provider_emit_error;
+  iface->get_class_change = gtk_css_style_provider_get_class_change;
+  iface->get_state_change = gtk_css_style_provider_get_state_change;
 }
 
 static void
@@ -635,6 +689,7 @@ gtk_css_provider_finalize (GObject *object)
 
   g_array_free (priv->rulesets, TRUE);
   _gtk_css_selector_tree_free (priv->tree);
+  g_clear_pointer (&priv->invalidations, gtk_css_invalidations_free);
 
   g_hash_table_destroy (priv->symbolic_colors);
   g_hash_table_destroy (priv->keyframes);
@@ -772,6 +827,7 @@ gtk_css_provider_reset (GtkCssProvider *css_provider)
   g_array_set_size (priv->rulesets, 0);
   _gtk_css_selector_tree_free (priv->tree);
   priv->tree = NULL;
+  g_clear_pointer (&priv->invalidations, gtk_css_invalidations_free);
 
 }
 
@@ -901,6 +957,7 @@ parse_color_definition (GtkCssScanner *scanner)
 static gboolean
 parse_binding_set (GtkCssScanner *scanner)
 {
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (scanner->provider);
   GtkBindingSet *binding_set;
   char *name;
 
@@ -912,6 +969,9 @@ parse_binding_set (GtkCssScanner *scanner)
       return FALSE;
     }
 
+  /* Binding sets are global, so they are not part of the cache */
+  priv->cache_invalid = TRUE;
+
   name = _gtk_css_parser_try_ident (scanner->parser, TRUE);
   if (name == NULL)
     {
@@ -1372,6 +1432,59 @@ gtk_css_provider_postprocess (GtkCssProvider *css_provider)
 #endif
 }
 
+/* Files are identified by their modification time in microseconds and
+ * their size, which is a lot cheaper than reading them again. Files
+ * without a modification time, like resources, only have their size
+ * checked. They are part of GTK, which the cache is specific to. */
+static gboolean
+gtk_css_provider_get_source_stamp (GFile   *file,
+                                   guint64 *mtime,
+                                   guint64 *size)
+{
+  GFileInfo *info;
+
+  info = g_file_query_info (file,
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC ","
+                            G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                            G_FILE_QUERY_INFO_NONE,
+                            NULL, NULL);
+  if (info == NULL)
+    return FALSE;
+
+  *mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+           g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+  *size = g_file_info_get_size (info);
+
+  g_object_unref (info);
+
+  return TRUE;
+}
+
+/* Called before loading @file, so changes while loading it make the
+ * cache out of date instead of going unnoticed */
+static void
+gtk_css_provider_add_cache_source (GtkCssProvider *css_provider,
+                                   GFile          *file)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
+  guint64 mtime, size;
+  char *uri;
+
+  if (priv->cache_sources == NULL)
+    return;
+
+  if (!gtk_css_provider_get_source_stamp (file, &mtime, &size))
+    {
+      priv->cache_invalid = TRUE;
+      return;
+    }
+
+  uri = g_file_get_uri (file);
+  g_variant_builder_add (priv->cache_sources, "(stt)", uri, mtime, size);
+  g_free (uri);
+}
+
 static void
 gtk_css_provider_load_internal (GtkCssProvider *css_provider,
                                 GtkCssScanner  *parent,
@@ -1385,6 +1498,7 @@ gtk_css_provider_load_internal (GtkCssProvider *css_provider,
     {
       GError *load_error = NULL;
 
+      gtk_css_provider_add_cache_source (css_provider, file);
       bytes = g_file_load_bytes (file, NULL, NULL, &load_error);
 
       if (bytes)
@@ -1533,6 +1647,23 @@ gtk_css_provider_load_from_path (GtkCssProvider  *css_provider,
   g_object_unref (file);
 }
 
+static GFile *
+gtk_css_provider_get_resource_file (const gchar *resource_path)
+{
+  GFile *file;
+  gchar *uri, *escaped;
+
+  escaped = g_uri_escape_string (resource_path,
+				 G_URI_RESERVED_CHARS_ALLOWED_IN_PATH, FALSE);
+  uri = g_strconcat ("resource://", escaped, NULL);
+  g_free (escaped);
+
+  file = g_file_new_for_uri (uri);
+  g_free (uri);
+
+  return file;
+}
+
 /**
  * gtk_css_provider_load_from_resource:
  * @css_provider: a #GtkCssProvider
@@ -1549,18 +1680,11 @@ gtk_css_provider_load_from_resource (GtkCssProvider *css_provider,
 			             const gchar    *resource_path)
 {
   GFile *file;
-  gchar *uri, *escaped;
 
   g_return_if_fail (GTK_IS_CSS_PROVIDER (css_provider));
   g_return_if_fail (resource_path != NULL);
 
-  escaped = g_uri_escape_string (resource_path,
-				 G_URI_RESERVED_CHARS_ALLOWED_IN_PATH, FALSE);
-  uri = g_strconcat ("resource://", escaped, NULL);
-  g_free (escaped);
-
-  file = g_file_new_for_uri (uri);
-  g_free (uri);
+  file = gtk_css_provider_get_resource_file (resource_path);
 
   gtk_css_provider_load_from_file (css_provider, file);
 
@@ -1707,6 +1831,777 @@ _gtk_css_find_theme (const gchar *name,
   return path;
 }
 
+/* THEME CACHE
+ *
+ * Themes get written to the user's cache directory after parsing them,
+ * so the next process loading them can skip the parser and the building
+ * of the selector tree. The cache is a GVariant that gets mapped from
+ * disk and it is only used if it was written by the same build of GTK
+ * and all the files that went into the theme still have the same
+ * modification time and size.
+ *
+ * The selector tree is saved as is. Numbers, colors, enums, strings,
+ * arrays of those and the CSS-wide keywords are saved in a binary form.
+ * Other values, such as images, shadows or transforms, and keyframes
+ * are saved as the text they print to and go through the parser again
+ * when loading, but only once for every distinct value. Themes with
+ * such values that don't print to text that parses back into the same
+ * value, with errors or with binding sets are not cached.
+ */
+
+#define GTK_CSS_CACHE_MAGIC "GtkCssProviderCache"
+#define GTK_CSS_CACHE_VERSION 2
+
+/* magic, format version, GTK version, pointer size and byte order,
+ * the sources as (uri, mtime, size), the colors as (name, value),
+ * the keyframes as (name, text), the strings of the selector tree, the
+ * selector tree, the values as (property, value), the indexes of the
+ * values in every set of styles and for every ruleset the index of its
+ * styles or G_MAXUINT32 if it has none. Values are (type, data) with a
+ * GtkCssCacheValueType. */
+#define GTK_CSS_CACHE_FORMAT "(suuuuuua(stt)a(s(uv))a(ss)asaya(s(uv))aauau)"
+
+typedef enum {
+  GTK_CSS_CACHE_VALUE_TEXT,
+  GTK_CSS_CACHE_VALUE_DIMENSION,
+  GTK_CSS_CACHE_VALUE_COLOR,
+  GTK_CSS_CACHE_VALUE_ENUM,
+  GTK_CSS_CACHE_VALUE_STRING,
+  GTK_CSS_CACHE_VALUE_ARRAY,
+  GTK_CSS_CACHE_VALUE_INITIAL,
+  GTK_CSS_CACHE_VALUE_INHERIT,
+  GTK_CSS_CACHE_VALUE_UNSET
+} GtkCssCacheValueType;
+
+static gboolean
+gtk_css_provider_use_cache (void)
+{
+#ifdef VERIFY_TREE
+  /* Verifying the tree needs the selectors, which the cache doesn't have */
+  return FALSE;
+#else
+  return !gtk_keep_css_sections && !GTK_DEBUG_CHECK (NO_CSS_CACHE);
+#endif
+}
+
+static char *
+gtk_css_provider_get_cache_path (GFile *file)
+{
+  char *uri, *checksum, *name, *path;
+
+  uri = g_file_get_uri (file);
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA256, uri, -1);
+  name = g_strdup_printf ("%s-%d.%d.%d", checksum, GTK_MAJOR_VERSION, GTK_MINOR_VERSION, GTK_MICRO_VERSION);
+  path = g_build_filename (g_get_user_cache_dir (), "gtk-4.0", "css", name, NULL);
+
+  g_free (name);
+  g_free (checksum);
+  g_free (uri);
+
+  return path;
+}
+
+static void
+gtk_css_provider_cache_parser_error (GtkCssParser *parser,
+                                     const GError *error,
+                                     gpointer      user_data)
+{
+  gboolean *failed = user_data;
+
+  *failed = TRUE;
+}
+
+/* Parses a value of @property or a color if @property is %NULL. Returns
+ * %NULL unless all of @text parses without errors. */
+static GtkCssValue *
+gtk_css_provider_cache_parse_value (GtkCssStyleProperty *property,
+                                    const char          *text)
+{
+  GtkCssParser *parser;
+  GtkCssValue *value;
+  gboolean failed = FALSE;
+
+  parser = _gtk_css_parser_new (text, NULL, gtk_css_provider_cache_parser_error, &failed);
+
+  if (property)
+    value = _gtk_style_property_parse_value (GTK_STYLE_PROPERTY (property), parser);
+  else
+    value = _gtk_css_color_value_parse (parser);
+
+  if (value && (failed || !_gtk_css_parser_is_eof (parser)))
+    g_clear_pointer (&value, _gtk_css_value_unref);
+
+  _gtk_css_parser_free (parser);
+
+  return value;
+}
+
+static GtkCssKeyframes *
+gtk_css_provider_cache_parse_keyframes (const char *text)
+{
+  GtkCssParser *parser;
+  GtkCssKeyframes *keyframes;
+  gboolean failed = FALSE;
+  char *block;
+
+  /* The parser stops at the end of the block */
+  block = g_strconcat (text, "}", NULL);
+  parser = _gtk_css_parser_new (block, NULL, gtk_css_provider_cache_parser_error, &failed);
+
+  keyframes = _gtk_css_keyframes_parse (parser);
+
+  if (keyframes &&
+      (failed ||
+       !_gtk_css_parser_try (parser, "}", TRUE) ||
+       !_gtk_css_parser_is_eof (parser)))
+    g_clear_pointer (&keyframes, _gtk_css_keyframes_unref);
+
+  _gtk_css_parser_free (parser);
+  g_free (block);
+
+  return keyframes;
+}
+
+/* Checks that loading @text from the cache gives a value that prints
+ * the same as the one it was printed from */
+static gboolean
+gtk_css_provider_cache_check_value (GtkCssStyleProperty *property,
+                                    const char          *text)
+{
+  GtkCssValue *value;
+  GString *str;
+  gboolean result;
+
+  value = gtk_css_provider_cache_parse_value (property, text);
+  if (value == NULL)
+    return FALSE;
+
+  str = g_string_new (NULL);
+  _gtk_css_value_print (value, str);
+  result = g_str_equal (str->str, text);
+
+  g_string_free (str, TRUE);
+  _gtk_css_value_unref (value);
+
+  return result;
+}
+
+static gboolean
+gtk_css_provider_cache_check_keyframes (const char *text)
+{
+  GtkCssKeyframes *keyframes;
+  GString *str;
+  gboolean result;
+
+  keyframes = gtk_css_provider_cache_parse_keyframes (text);
+  if (keyframes == NULL)
+    return FALSE;
+
+  str = g_string_new (NULL);
+  _gtk_css_keyframes_print (keyframes, str);
+  result = g_str_equal (str->str, text);
+
+  g_string_free (str, TRUE);
+  _gtk_css_keyframes_unref (keyframes);
+
+  return result;
+}
+
+/* Returns %NULL if @value has no binary form */
+static GVariant *
+gtk_css_provider_cache_save_binary_value (const GtkCssValue *value)
+{
+  GtkCssCacheValueType type;
+  GtkCssValue *unset;
+  GVariant *data;
+
+  unset = _gtk_css_unset_value_new ();
+
+  if ((data = gtk_css_dimension_value_save (value)))
+    type = GTK_CSS_CACHE_VALUE_DIMENSION;
+  else if ((data = gtk_css_color_value_save (value)))
+    type = GTK_CSS_CACHE_VALUE_COLOR;
+  else if ((data = gtk_css_enum_value_save (value)))
+    type = GTK_CSS_CACHE_VALUE_ENUM;
+  else if ((data = gtk_css_string_value_save (value)))
+    type = GTK_CSS_CACHE_VALUE_STRING;
+  else if ((data = gtk_css_array_value_save (value, gtk_css_provider_cache_save_binary_value)))
+    type = GTK_CSS_CACHE_VALUE_ARRAY;
+  else if (value == _gtk_css_initial_value_get ())
+    type = GTK_CSS_CACHE_VALUE_INITIAL;
+  else if (value == _gtk_css_inherit_value_get ())
+    type = GTK_CSS_CACHE_VALUE_INHERIT;
+  else if (value == unset)
+    type = GTK_CSS_CACHE_VALUE_UNSET;
+  else
+    type = GTK_CSS_CACHE_VALUE_TEXT;
+
+  _gtk_css_value_unref (unset);
+
+  if (type == GTK_CSS_CACHE_VALUE_TEXT)
+    return NULL;
+
+  if (data == NULL)
+    data = g_variant_new_tuple (NULL, 0);
+
+  return g_variant_new ("(uv)", type, data);
+}
+
+/* Saves @value of @property, or a color if @property is %NULL, in its
+ * binary form if it has one. Otherwise as text, if that parses back to
+ * the same value. */
+static GVariant *
+gtk_css_provider_cache_save_value (GtkCssStyleProperty *property,
+                                   const GtkCssValue   *value,
+                                   const char          *text)
+{
+  GVariant *result;
+
+  result = gtk_css_provider_cache_save_binary_value (value);
+  if (result)
+    return result;
+
+  if (!gtk_css_provider_cache_check_value (property, text))
+    return NULL;
+
+  return g_variant_new ("(uv)", GTK_CSS_CACHE_VALUE_TEXT, g_variant_new_string (text));
+}
+
+static GtkCssValue *
+gtk_css_provider_cache_load_binary_value (GVariant *variant)
+{
+  GtkCssValue *result;
+  GVariant *data;
+  guint32 type;
+
+  if (!g_variant_is_of_type (variant, G_VARIANT_TYPE ("(uv)")))
+    return NULL;
+
+  g_variant_get (variant, "(uv)", &type, &data);
+
+  switch (type)
+    {
+    case GTK_CSS_CACHE_VALUE_DIMENSION:
+      result = gtk_css_dimension_value_load (data);
+      break;
+    case GTK_CSS_CACHE_VALUE_COLOR:
+      result = gtk_css_color_value_load (data);
+      break;
+    case GTK_CSS_CACHE_VALUE_ENUM:
+      result = gtk_css_enum_value_load (data);
+      break;
+    case GTK_CSS_CACHE_VALUE_STRING:
+      result = gtk_css_string_value_load (data);
+      break;
+    case GTK_CSS_CACHE_VALUE_ARRAY:
+      result = gtk_css_array_value_load (data, gtk_css_provider_cache_load_binary_value);
+      break;
+    case GTK_CSS_CACHE_VALUE_INITIAL:
+      result = _gtk_css_initial_value_new ();
+      break;
+    case GTK_CSS_CACHE_VALUE_INHERIT:
+      result = _gtk_css_inherit_value_new ();
+      break;
+    case GTK_CSS_CACHE_VALUE_UNSET:
+      result = _gtk_css_unset_value_new ();
+      break;
+    case GTK_CSS_CACHE_VALUE_TEXT:
+    default:
+      result = NULL;
+      break;
+    }
+
+  g_variant_unref (data);
+
+  return result;
+}
+
+static GtkCssValue *
+gtk_css_provider_cache_load_value (GtkCssStyleProperty *property,
+                                   GVariant            *variant)
+{
+  GtkCssValue *result;
+  GVariant *data;
+  guint32 type;
+
+  g_variant_get (variant, "(uv)", &type, &data);
+
+  if (type != GTK_CSS_CACHE_VALUE_TEXT)
+    result = gtk_css_provider_cache_load_binary_value (variant);
+  else if (g_variant_is_of_type (data, G_VARIANT_TYPE_STRING))
+    result = gtk_css_provider_cache_parse_value (property, g_variant_get_string (data, NULL));
+  else
+    result = NULL;
+
+  g_variant_unref (data);
+
+  return result;
+}
+
+static gboolean
+gtk_css_provider_cache_check_sources (GVariant *sources,
+                                      GFile    *file)
+{
+  char *file_uri;
+  gsize i, n_sources;
+
+  file_uri = g_file_get_uri (file);
+  n_sources = g_variant_n_children (sources);
+
+  for (i = 0; i < n_sources; i++)
+    {
+      const char *uri;
+      guint64 mtime, size, current_mtime, current_size;
+      GFile *source;
+      gboolean found;
+
+      g_variant_get_child (sources, i, "(&stt)", &uri, &mtime, &size);
+
+      /* The first source is the file itself, the others were imported */
+      if (i == 0 && !g_str_equal (uri, file_uri))
+        break;
+
+      source = g_file_new_for_uri (uri);
+      found = gtk_css_provider_get_source_stamp (source, &current_mtime, &current_size);
+      g_object_unref (source);
+
+      if (!found || current_mtime != mtime || current_size != size)
+        break;
+    }
+
+  g_free (file_uri);
+
+  return n_sources > 0 && i == n_sources;
+}
+
+static guint
+gtk_css_provider_save_match (gpointer match,
+                             gpointer data)
+{
+  GArray *rulesets = data;
+
+  return (GtkCssRuleset *) match - (GtkCssRuleset *) rulesets->data;
+}
+
+static gpointer
+gtk_css_provider_load_match (gsize                     index,
+                             const GtkCssSelectorTree *tree,
+                             gpointer                  data)
+{
+  GArray *rulesets = data;
+  GtkCssRuleset *ruleset;
+
+  if (index >= rulesets->len)
+    return NULL;
+
+  ruleset = &g_array_index (rulesets, GtkCssRuleset, index);
+  ruleset->selector_match = (GtkCssSelectorTree *) tree;
+
+  return ruleset;
+}
+
+/* Returns %NULL if the provider can't be cached */
+static GVariant *
+gtk_css_provider_save_cache (GtkCssProvider *css_provider,
+                             GVariant       *sources)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
+  GVariantBuilder colors, keyframes, values, blocks, rulesets;
+  GHashTable *value_indexes, *block_indexes;
+  GHashTableIter iter;
+  gpointer key, value;
+  GPtrArray *strings;
+  GBytes *tree;
+  GVariant *result;
+  GString *str;
+  guint i, j;
+
+  g_variant_builder_init (&colors, G_VARIANT_TYPE ("a(s(uv))"));
+  g_variant_builder_init (&keyframes, G_VARIANT_TYPE ("a(ss)"));
+  g_variant_builder_init (&values, G_VARIANT_TYPE ("a(s(uv))"));
+  g_variant_builder_init (&blocks, G_VARIANT_TYPE ("aau"));
+  g_variant_builder_init (&rulesets, G_VARIANT_TYPE ("au"));
+  value_indexes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  block_indexes = g_hash_table_new (NULL, NULL);
+  str = g_string_new (NULL);
+
+  g_hash_table_iter_init (&iter, priv->symbolic_colors);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      GVariant *saved;
+
+      g_string_set_size (str, 0);
+      _gtk_css_value_print (value, str);
+      saved = gtk_css_provider_cache_save_value (NULL, value, str->str);
+      if (saved == NULL)
+        goto fail;
+
+      g_variant_builder_add (&colors, "(s@(uv))", key, saved);
+    }
+
+  g_hash_table_iter_init (&iter, priv->keyframes);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      g_string_set_size (str, 0);
+      _gtk_css_keyframes_print (value, str);
+      if (!gtk_css_provider_cache_check_keyframes (str->str))
+        goto fail;
+
+      g_variant_builder_add (&keyframes, "(ss)", key, str->str);
+    }
+
+  for (i = 0; i < priv->rulesets->len; i++)
+    {
+      GtkCssRuleset *ruleset = &g_array_index (priv->rulesets, GtkCssRuleset, i);
+      gpointer block_index;
+
+      if (ruleset->styles == NULL)
+        {
+          g_variant_builder_add (&rulesets, "u", G_MAXUINT32);
+          continue;
+        }
+
+      /* Rulesets with multiple selectors share their styles */
+      if (!g_hash_table_lookup_extended (block_indexes, ruleset->styles, NULL, &block_index))
+        {
+          GVariantBuilder block;
+
+          g_variant_builder_init (&block, G_VARIANT_TYPE ("au"));
+
+          for (j = 0; j < ruleset->n_styles; j++)
+            {
+              GtkCssStyleProperty *property = ruleset->styles[j].property;
+              const char *name = _gtk_style_property_get_name (GTK_STYLE_PROPERTY (property));
+              gpointer value_index;
+              char *value_key;
+
+              g_string_set_size (str, 0);
+              _gtk_css_value_print (ruleset->styles[j].value, str);
+
+              value_key = g_strconcat (name, ": ", str->str, NULL);
+              if (g_hash_table_lookup_extended (value_indexes, value_key, NULL, &value_index))
+                {
+                  g_free (value_key);
+                }
+              else
+                {
+                  GVariant *saved;
+
+                  saved = gtk_css_provider_cache_save_value (property, ruleset->styles[j].value, str->str);
+                  if (saved == NULL)
+                    {
+                      g_free (value_key);
+                      g_variant_builder_clear (&block);
+                      goto fail;
+                    }
+
+                  value_index = GUINT_TO_POINTER (g_hash_table_size (value_indexes));
+                  g_hash_table_insert (value_indexes, value_key, value_index);
+                  g_variant_builder_add (&values, "(s@(uv))", name, saved);
+                }
+
+              g_variant_builder_add (&block, "u", GPOINTER_TO_UINT (value_index));
+            }
+
+          block_index = GUINT_TO_POINTER (g_hash_table_size (block_indexes));
+          g_hash_table_insert (block_indexes, ruleset->styles, block_index);
+          g_variant_builder_add_value (&blocks, g_variant_builder_end (&block));
+        }
+
+      g_variant_builder_add (&rulesets, "u", GPOINTER_TO_UINT (block_index));
+    }
+
+  strings = g_ptr_array_new ();
+  tree = _gtk_css_selector_tree_save (priv->tree, strings, gtk_css_provider_save_match, priv->rulesets);
+
+  result = g_variant_new ("(suuuuuu@a(stt)@a(s(uv))@a(ss)@as@ay@a(s(uv))@aau@au)",
+                          GTK_CSS_CACHE_MAGIC,
+                          (guint32) GTK_CSS_CACHE_VERSION,
+                          (guint32) GTK_MAJOR_VERSION,
+                          (guint32) GTK_MINOR_VERSION,
+                          (guint32) GTK_MICRO_VERSION,
+                          (guint32) sizeof (gpointer),
+                          (guint32) G_BYTE_ORDER,
+                          sources,
+                          g_variant_builder_end (&colors),
+                          g_variant_builder_end (&keyframes),
+                          g_variant_new_strv ((const char * const *) strings->pdata, strings->len),
+                          g_variant_new_from_bytes (G_VARIANT_TYPE_BYTESTRING, tree, TRUE),
+                          g_variant_builder_end (&values),
+                          g_variant_builder_end (&blocks),
+                          g_variant_builder_end (&rulesets));
+  g_variant_ref_sink (result);
+
+  g_bytes_unref (tree);
+  g_ptr_array_unref (strings);
+  g_hash_table_unref (value_indexes);
+  g_hash_table_unref (block_indexes);
+  g_string_free (str, TRUE);
+
+  return result;
+
+fail:
+  g_variant_builder_clear (&colors);
+  g_variant_builder_clear (&keyframes);
+  g_variant_builder_clear (&values);
+  g_variant_builder_clear (&blocks);
+  g_variant_builder_clear (&rulesets);
+  g_hash_table_unref (value_indexes);
+  g_hash_table_unref (block_indexes);
+  g_string_free (str, TRUE);
+
+  return NULL;
+}
+
+static void
+gtk_css_provider_write_cache (GtkCssProvider *css_provider,
+                              GVariant       *sources,
+                              const char     *path)
+{
+  GVariant *cache;
+  char *dir;
+
+  cache = gtk_css_provider_save_cache (css_provider, sources);
+  if (cache == NULL)
+    return;
+
+  /* Not being able to write the cache only makes the next start slower */
+  dir = g_path_get_dirname (path);
+  if (g_mkdir_with_parents (dir, 0700) == 0)
+    g_file_set_contents (path, g_variant_get_data (cache), g_variant_get_size (cache), NULL);
+
+  g_free (dir);
+  g_variant_unref (cache);
+}
+
+static gboolean
+gtk_css_provider_load_cache (GtkCssProvider *css_provider,
+                             GFile          *file,
+                             const char     *path)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
+  GVariant *cache, *sources, *colors, *keyframes, *tree, *values, *blocks, *rulesets, *saved;
+  guint32 version, major, minor, micro, pointer_size, byte_order;
+  GtkCssStyleProperty **properties = NULL;
+  GtkCssValue **parsed_values = NULL;
+  PropertyValue **block_styles = NULL;
+  const char **strings;
+  const char *magic, *name, *text;
+  GMappedFile *mapped;
+  GBytes *bytes;
+  GVariantIter iter;
+  gsize i, j, n_values = 0, n_blocks;
+  gboolean result = FALSE;
+
+  mapped = g_mapped_file_new (path, FALSE, NULL);
+  if (mapped == NULL)
+    return FALSE;
+
+  bytes = g_mapped_file_get_bytes (mapped);
+  g_mapped_file_unref (mapped);
+  cache = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (GTK_CSS_CACHE_FORMAT), bytes, FALSE));
+  g_bytes_unref (bytes);
+
+  g_variant_get (cache, "(&suuuuuu@a(stt)@a(s(uv))@a(ss)^a&s@ay@a(s(uv))@aau@au)",
+                 &magic, &version, &major, &minor, &micro, &pointer_size, &byte_order,
+                 &sources, &colors, &keyframes, &strings, &tree, &values, &blocks, &rulesets);
+
+  if (!g_str_equal (magic, GTK_CSS_CACHE_MAGIC) ||
+      version != GTK_CSS_CACHE_VERSION ||
+      major != GTK_MAJOR_VERSION ||
+      minor != GTK_MINOR_VERSION ||
+      micro != GTK_MICRO_VERSION ||
+      pointer_size != sizeof (gpointer) ||
+      byte_order != G_BYTE_ORDER ||
+      !gtk_css_provider_cache_check_sources (sources, file))
+    goto out;
+
+  g_variant_iter_init (&iter, colors);
+  while (g_variant_iter_next (&iter, "(&s@(uv))", &name, &saved))
+    {
+      GtkCssValue *color;
+
+      color = gtk_css_provider_cache_load_value (NULL, saved);
+      g_variant_unref (saved);
+      if (color == NULL)
+        goto out;
+
+      g_hash_table_insert (priv->symbolic_colors, g_strdup (name), color);
+    }
+
+  g_variant_iter_init (&iter, keyframes);
+  while (g_variant_iter_next (&iter, "(&s&s)", &name, &text))
+    {
+      GtkCssKeyframes *parsed;
+
+      parsed = gtk_css_provider_cache_parse_keyframes (text);
+      if (parsed == NULL)
+        goto out;
+
+      g_hash_table_insert (priv->keyframes, g_strdup (name), parsed);
+    }
+
+  n_values = g_variant_n_children (values);
+  properties = g_new0 (GtkCssStyleProperty *, n_values);
+  parsed_values = g_new0 (GtkCssValue *, n_values);
+  for (i = 0; i < n_values; i++)
+    {
+      GtkStyleProperty *property;
+
+      g_variant_get_child (values, i, "(&s@(uv))", &name, &saved);
+
+      property = _gtk_style_property_lookup (name);
+      if (!GTK_IS_CSS_STYLE_PROPERTY (property))
+        {
+          g_variant_unref (saved);
+          goto out;
+        }
+
+      properties[i] = GTK_CSS_STYLE_PROPERTY (property);
+      parsed_values[i] = gtk_css_provider_cache_load_value (properties[i], saved);
+      g_variant_unref (saved);
+      if (parsed_values[i] == NULL)
+        goto out;
+    }
+
+  n_blocks = g_variant_n_children (blocks);
+  block_styles = g_new0 (PropertyValue *, n_blocks);
+  for (i = 0; i < g_variant_n_children (rulesets); i++)
+    {
+      GtkCssRuleset ruleset = { 0, };
+      GVariant *block;
+      guint32 block_index, value_index;
+
+      g_variant_get_child (rulesets, i, "u", &block_index);
+      if (block_index == G_MAXUINT32)
+        {
+          g_array_append_val (priv->rulesets, ruleset);
+          continue;
+        }
+
+      if (block_index >= n_blocks)
+        goto out;
+
+      block = g_variant_get_child_value (blocks, block_index);
+      ruleset.n_styles = g_variant_n_children (block);
+
+      for (j = 0; j < ruleset.n_styles; j++)
+        {
+          g_variant_get_child (block, j, "u", &value_index);
+          if (value_index >= n_values)
+            {
+              g_variant_unref (block);
+              goto out;
+            }
+        }
+
+      /* The first ruleset using the styles owns them, like after parsing */
+      if (block_styles[block_index] == NULL)
+        {
+          ruleset.styles = g_new0 (PropertyValue, ruleset.n_styles);
+          ruleset.owns_styles = TRUE;
+
+          for (j = 0; j < ruleset.n_styles; j++)
+            {
+              g_variant_get_child (block, j, "u", &value_index);
+              ruleset.styles[j].property = properties[value_index];
+              ruleset.styles[j].value = _gtk_css_value_ref (parsed_values[value_index]);
+            }
+
+          block_styles[block_index] = ruleset.styles;
+        }
+      else
+        ruleset.styles = block_styles[block_index];
+
+      ruleset.set_styles = _gtk_bitmask_new ();
+      for (j = 0; j < ruleset.n_styles; j++)
+        ruleset.set_styles = _gtk_bitmask_set (ruleset.set_styles,
+                                               _gtk_css_style_property_get_id (ruleset.styles[j].property),
+                                               TRUE);
+
+      g_variant_unref (block);
+      g_array_append_val (priv->rulesets, ruleset);
+    }
+
+  bytes = g_variant_get_data_as_bytes (tree);
+  result = _gtk_css_selector_tree_load (bytes,
+                                        strings,
+                                        g_strv_length ((char **) strings),
+                                        gtk_css_provider_load_match,
+                                        priv->rulesets,
+                                        &priv->tree);
+  g_bytes_unref (bytes);
+
+  /* Every ruleset needs to be in the tree */
+  for (i = 0; result && i < priv->rulesets->len; i++)
+    {
+      if (g_array_index (priv->rulesets, GtkCssRuleset, i).selector_match == NULL)
+        result = FALSE;
+    }
+
+out:
+  for (i = 0; parsed_values && i < n_values; i++)
+    {
+      if (parsed_values[i])
+        _gtk_css_value_unref (parsed_values[i]);
+    }
+  g_free (parsed_values);
+  g_free (properties);
+  g_free (block_styles);
+  g_free (strings);
+  g_variant_unref (sources);
+  g_variant_unref (colors);
+  g_variant_unref (keyframes);
+  g_variant_unref (tree);
+  g_variant_unref (values);
+  g_variant_unref (blocks);
+  g_variant_unref (rulesets);
+  g_variant_unref (cache);
+
+  return result;
+}
+
+static void
+gtk_css_provider_load_theme_file (GtkCssProvider *css_provider,
+                                  GFile          *file)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
+  GVariant *sources;
+  char *cache_path;
+
+  if (!gtk_css_provider_use_cache ())
+    {
+      gtk_css_provider_load_from_file (css_provider, file);
+      return;
+    }
+
+  gtk_css_provider_reset (css_provider);
+
+  cache_path = gtk_css_provider_get_cache_path (file);
+
+  if (!gtk_css_provider_load_cache (css_provider, file, cache_path))
+    {
+      gtk_css_provider_reset (css_provider);
+
+      priv->cache_sources = g_variant_builder_new (G_VARIANT_TYPE ("a(stt)"));
+      priv->cache_invalid = FALSE;
+
+      gtk_css_provider_load_internal (css_provider, NULL, file, NULL);
+
+      sources = g_variant_ref_sink (g_variant_builder_end (priv->cache_sources));
+      g_clear_pointer (&priv->cache_sources, g_variant_builder_unref);
+
+      if (!priv->cache_invalid)
+        gtk_css_provider_write_cache (css_provider, sources, cache_path);
+
+      g_variant_unref (sources);
+    }
+
+  g_free (cache_path);
+
+  gtk_style_provider_changed (GTK_STYLE_PROVIDER (css_provider));
+}
+
 /**
  * _gtk_css_provider_load_named:
  * @provider: a #GtkCssProvider
@@ -1726,6 +2621,7 @@ _gtk_css_provider_load_named (GtkCssProvider *provider,
 {
   gchar *path;
   gchar *resource_path;
+  GFile *file;
 
   g_return_if_fail (GTK_IS_CSS_PROVIDER (provider));
   g_return_if_fail (name != NULL);
@@ -1742,7 +2638,9 @@ _gtk_css_provider_load_named (GtkCssProvider *provider,
 
   if (g_resources_get_info (resource_path, 0, NULL, NULL, NULL))
     {
-      gtk_css_provider_load_from_resource (provider, resource_path);
+      file = gtk_css_provider_get_resource_file (resource_path);
+      gtk_css_provider_load_theme_file (provider, file);
+      g_object_unref (file);
       g_free (resource_path);
       return;
     }
@@ -1764,9 +2662,11 @@ _gtk_css_provider_load_named (GtkCssProvider *provider,
       if (resource != NULL)
         g_resources_register (resource);
 
-      gtk_css_provider_load_from_path (provider, path);
+      file = g_file_new_for_path (path);
+      gtk_css_provider_load_theme_file (provider, file);
+      g_object_unref (file);
 
-      /* Only set this after load, as load_from_path will clear it */
+      /* Only set this after load, as loading will clear it */
       priv->resource = resource;
       priv->path = dir;
 
@@ -51,6 +51,12 @@ gtk_css_value_repeat_equal (const GtkCssValue *repeat1,
       && repeat1->y == repeat2->y;
 }
 
+static guint
+gtk_css_value_repeat_hash (const GtkCssValue *repeat)
+{
+  return repeat->x << 8 | repeat->y;
+}
+
 static GtkCssValue *
 gtk_css_value_repeat_transition (GtkCssValue *start,
                                  GtkCssValue *end,
@@ -116,6 +122,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_BACKGROUND_REPEAT = {
   gtk_css_value_repeat_free,
   gtk_css_value_repeat_compute,
   gtk_css_value_repeat_equal,
+  gtk_css_value_repeat_hash,
   gtk_css_value_repeat_transition,
   NULL,
   NULL,
@@ -126,6 +133,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_BORDER_REPEAT = {
   gtk_css_value_repeat_free,
   gtk_css_value_repeat_compute,
   gtk_css_value_repeat_equal,
+  gtk_css_value_repeat_hash,
   gtk_css_value_repeat_transition,
   NULL,
   NULL,
@@ -1476,6 +1476,45 @@ gtk_css_selectors_skip_initial_selector (GtkCssSelector *selector, const GtkCssS
   return (GtkCssSelector *)gtk_css_selector_previous (selector);
 }
 
+/* Checks if the selector can match an ancestor according to the filter */
+static gboolean
+gtk_css_selector_may_match_ancestor (const GtkCssSelector         *selector,
+                                     const GtkCountingBloomFilter *filter)
+{
+  if (selector->class == &GTK_CSS_SELECTOR_NAME)
+    return gtk_counting_bloom_filter_may_contain (filter, gtk_css_hash_name (selector->name.name));
+  else if (selector->class == &GTK_CSS_SELECTOR_CLASS)
+    return gtk_counting_bloom_filter_may_contain (filter, gtk_css_hash_class (selector->style_class.style_class));
+  else if (selector->class == &GTK_CSS_SELECTOR_ID)
+    return gtk_counting_bloom_filter_may_contain (filter, gtk_css_hash_id (selector->id.name));
+  else
+    return TRUE;
+}
+
+/* Descendant and child combinators make us walk up the ancestors. That's
+ * not needed if the selectors for the ancestor can't match any of them. */
+static gboolean
+gtk_css_selector_tree_reject_ancestors (const GtkCssSelectorTree     *tree,
+                                        const GtkCountingBloomFilter *filter)
+{
+  const GtkCssSelectorTree *prev;
+
+  if (filter == NULL ||
+      (tree->selector.class != &GTK_CSS_SELECTOR_DESCENDANT &&
+       tree->selector.class != &GTK_CSS_SELECTOR_CHILD))
+    return FALSE;
+
+  for (prev = gtk_css_selector_tree_get_previous (tree);
+       prev != NULL;
+       prev = gtk_css_selector_tree_get_sibling (prev))
+    {
+      if (gtk_css_selector_may_match_ancestor (&prev->selector, filter))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
 static gboolean
 gtk_css_selector_tree_match_foreach (const GtkCssSelector *selector,
                                      const GtkCssMatcher  *matcher,
@@ -1483,16 +1522,24 @@ gtk_css_selector_tree_match_foreach (const GtkCssSelector *selector,
 {
   const GtkCssSelectorTree *tree = (const GtkCssSelectorTree *) selector;
   const GtkCssSelectorTree *prev;
+  const GtkCountingBloomFilter *filter;
 
   if (!gtk_css_selector_match (selector, matcher))
     return FALSE;
 
   gtk_css_selector_tree_found_match (tree, res);
 
+  filter = _gtk_css_matcher_get_filter (matcher);
+
   for (prev = gtk_css_selector_tree_get_previous (tree);
        prev != NULL;
        prev = gtk_css_selector_tree_get_sibling (prev))
-    gtk_css_selector_foreach (&prev->selector, matcher, gtk_css_selector_tree_match_foreach, res);
+    {
+      if (gtk_css_selector_tree_reject_ancestors (prev, filter))
+        continue;
+
+      gtk_css_selector_foreach (&prev->selector, matcher, gtk_css_selector_tree_match_foreach, res);
+    }
 
   return FALSE;
 }
@@ -1501,11 +1548,19 @@ GPtrArray *
 _gtk_css_selector_tree_match_all (const GtkCssSelectorTree *tree,
 				  const GtkCssMatcher *matcher)
 {
+  const GtkCountingBloomFilter *filter;
   GPtrArray *array = NULL;
 
+  filter = _gtk_css_matcher_get_filter (matcher);
+
   for (; tree != NULL;
        tree = gtk_css_selector_tree_get_sibling (tree))
-    gtk_css_selector_foreach (&tree->selector, matcher, gtk_css_selector_tree_match_foreach, &array);
+    {
+      if (gtk_css_selector_tree_reject_ancestors (tree, filter))
+        continue;
+
+      gtk_css_selector_foreach (&tree->selector, matcher, gtk_css_selector_tree_match_foreach, &array);
+    }
 
   return array;
 }
@@ -1578,6 +1633,139 @@ _gtk_css_selector_tree_get_change_all (const GtkCssSelectorTree *tree,
   return change & ~GTK_CSS_CHANGE_RESERVED_BIT;
 }
 
+/* INVALIDATIONS
+ *
+ * When a class or state flag of a node changes, only nodes matched by
+ * selectors that contain the class or state can change their style.
+ * Where in the selector it is determines which nodes those are: The
+ * change is transformed by the combinators between it and the subject
+ * of the selector the same way _gtk_css_selector_get_change() does, so
+ * .foo gives GTK_CSS_CHANGE_CLASS (the node itself), .foo label gives
+ * GTK_CSS_CHANGE_PARENT_CLASS (its descendants), .foo + label gives
+ * GTK_CSS_CHANGE_SIBLING_CLASS (its later siblings) and .foo + box label
+ * gives GTK_CSS_CHANGE_PARENT_SIBLING_CLASS.
+ */
+
+struct _GtkCssInvalidations
+{
+  GHashTable   *classes;        /* GQuark => change of the class, as guint */
+  GtkCssChange  states[32];     /* change of each bit of GtkStateFlags */
+};
+
+/* The combinators between a selector in the tree and the subject */
+typedef struct _GtkCssCombinators GtkCssCombinators;
+struct _GtkCssCombinators
+{
+  const GtkCssSelector    *combinator;
+  const GtkCssCombinators *next;        /* the one closer to the subject */
+};
+
+static GtkCssChange
+gtk_css_combinators_get_change (const GtkCssCombinators *combinators,
+                                GtkCssChange             change)
+{
+  for (; combinators; combinators = combinators->next)
+    change = combinators->combinator->class->get_change (combinators->combinator, change);
+
+  return change;
+}
+
+static void
+gtk_css_selector_tree_add_invalidations (const GtkCssSelectorTree *tree,
+                                         const GtkCssCombinators  *combinators,
+                                         GtkCssInvalidations      *invalidations)
+{
+  const GtkCssCombinators *previous_combinators;
+  GtkCssCombinators combinator;
+  GtkCssChange change;
+  gpointer key;
+  guint i;
+
+  for (; tree != NULL; tree = gtk_css_selector_tree_get_sibling (tree))
+    {
+      const GtkCssSelector *selector = &tree->selector;
+
+      previous_combinators = combinators;
+
+      if (selector->class == &GTK_CSS_SELECTOR_CLASS ||
+          selector->class == &GTK_CSS_SELECTOR_NOT_CLASS)
+        {
+          key = GUINT_TO_POINTER (selector->style_class.style_class);
+          change = gtk_css_combinators_get_change (combinators, GTK_CSS_CHANGE_CLASS);
+          change |= GPOINTER_TO_UINT (g_hash_table_lookup (invalidations->classes, key));
+          g_hash_table_insert (invalidations->classes, key, GUINT_TO_POINTER ((guint) change));
+        }
+      else if (selector->class == &GTK_CSS_SELECTOR_PSEUDOCLASS_STATE ||
+               selector->class == &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_STATE)
+        {
+          change = gtk_css_combinators_get_change (combinators, GTK_CSS_CHANGE_STATE);
+          for (i = 0; i < G_N_ELEMENTS (invalidations->states); i++)
+            {
+              if (selector->state.state & (1u << i))
+                invalidations->states[i] |= change;
+            }
+        }
+      else if (!selector->class->is_simple)
+        {
+          combinator.combinator = selector;
+          combinator.next = combinators;
+          previous_combinators = &combinator;
+        }
+
+      gtk_css_selector_tree_add_invalidations (gtk_css_selector_tree_get_previous (tree),
+                                               previous_combinators,
+                                               invalidations);
+    }
+}
+
+GtkCssInvalidations *
+_gtk_css_selector_tree_get_invalidations (const GtkCssSelectorTree *tree)
+{
+  GtkCssInvalidations *invalidations;
+
+  invalidations = g_slice_new0 (GtkCssInvalidations);
+  invalidations->classes = g_hash_table_new (NULL, NULL);
+
+  gtk_css_selector_tree_add_invalidations (tree, NULL, invalidations);
+
+  return invalidations;
+}
+
+void
+gtk_css_invalidations_free (GtkCssInvalidations *invalidations)
+{
+  g_hash_table_unref (invalidations->classes);
+  g_slice_free (GtkCssInvalidations, invalidations);
+}
+
+/* Returns a combination of GTK_CSS_CHANGE_CLASS, GTK_CSS_CHANGE_SIBLING_CLASS,
+ * GTK_CSS_CHANGE_PARENT_CLASS and GTK_CSS_CHANGE_PARENT_SIBLING_CLASS for
+ * the nodes that may change their style when @style_class changes */
+GtkCssChange
+gtk_css_invalidations_get_class_change (const GtkCssInvalidations *invalidations,
+                                        GQuark                     style_class)
+{
+  return GPOINTER_TO_UINT (g_hash_table_lookup (invalidations->classes, GUINT_TO_POINTER (style_class)));
+}
+
+/* Like gtk_css_invalidations_get_class_change() for changes of the flags
+ * in @state */
+GtkCssChange
+gtk_css_invalidations_get_state_change (const GtkCssInvalidations *invalidations,
+                                        GtkStateFlags              state)
+{
+  GtkCssChange change = 0;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (invalidations->states); i++)
+    {
+      if (state & (1u << i))
+        change |= invalidations->states[i];
+    }
+
+  return change;
+}
+
 #ifdef PRINT_TREE
 static void
 _gtk_css_selector_tree_print (const GtkCssSelectorTree *tree, GString *str, char *prefix)
@@ -1903,3 +2091,328 @@ _gtk_css_selector_tree_builder_build (GtkCssSelectorTreeBuilder *builder)
 
   return tree;
 }
+
+/* SAVING AND LOADING */
+
+/* A saved tree is a copy of the tree's memory with all pointers replaced
+ * by indexes: selector classes index selector_classes, names, ids and
+ * style classes index a string table and matches are whatever the save
+ * function returns for them, plus one so they stay non-NULL. Offsets are
+ * relative already, so they don't need changes.
+ */
+static const GtkCssSelectorClass *selector_classes[] = {
+  &GTK_CSS_SELECTOR_DESCENDANT,
+  &GTK_CSS_SELECTOR_CHILD,
+  &GTK_CSS_SELECTOR_SIBLING,
+  &GTK_CSS_SELECTOR_ADJACENT,
+  &GTK_CSS_SELECTOR_ANY,
+  &GTK_CSS_SELECTOR_NOT_ANY,
+  &GTK_CSS_SELECTOR_NAME,
+  &GTK_CSS_SELECTOR_NOT_NAME,
+  &GTK_CSS_SELECTOR_CLASS,
+  &GTK_CSS_SELECTOR_NOT_CLASS,
+  &GTK_CSS_SELECTOR_ID,
+  &GTK_CSS_SELECTOR_NOT_ID,
+  &GTK_CSS_SELECTOR_PSEUDOCLASS_STATE,
+  &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_STATE,
+  &GTK_CSS_SELECTOR_PSEUDOCLASS_POSITION,
+  &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_POSITION
+};
+
+typedef struct {
+  GHashTable *string_indexes;
+  GPtrArray *strings;
+  GtkCssSelectorTreeSaveFunc save_match;
+  gpointer data;
+} GtkCssSelectorTreeSaveData;
+
+typedef struct {
+  guint8 *start;
+  gsize size;
+  const char * const *strings;
+  gsize n_strings;
+  GtkCssSelectorTreeLoadFunc load_match;
+  gpointer data;
+} GtkCssSelectorTreeLoadData;
+
+static void
+gtk_css_selector_tree_get_end (const GtkCssSelectorTree *tree,
+                               const guint8             *start,
+                               gsize                    *end)
+{
+  for (; tree != NULL; tree = gtk_css_selector_tree_get_sibling (tree))
+    {
+      gpointer *matches;
+      guint i;
+
+      *end = MAX (*end, (gsize) ((const guint8 *) (tree + 1) - start));
+
+      matches = gtk_css_selector_tree_get_matches (tree);
+      if (matches)
+        {
+          for (i = 0; matches[i] != NULL; i++)
+            ;
+          *end = MAX (*end, (gsize) ((const guint8 *) (matches + i + 1) - start));
+        }
+
+      gtk_css_selector_tree_get_end (gtk_css_selector_tree_get_previous (tree), start, end);
+    }
+}
+
+static gpointer
+gtk_css_selector_tree_save_string (GtkCssSelectorTreeSaveData *save,
+                                   const char                 *string)
+{
+  gpointer index;
+
+  if (!g_hash_table_lookup_extended (save->string_indexes, string, NULL, &index))
+    {
+      index = GUINT_TO_POINTER (save->strings->len);
+      g_hash_table_insert (save->string_indexes, (gpointer) string, index);
+      g_ptr_array_add (save->strings, (gpointer) string);
+    }
+
+  return index;
+}
+
+static void
+gtk_css_selector_tree_save_nodes (GtkCssSelectorTree         *tree,
+                                  GtkCssSelectorTreeSaveData *save)
+{
+  for (; tree != NULL; tree = (GtkCssSelectorTree *) gtk_css_selector_tree_get_sibling (tree))
+    {
+      GtkCssSelector *selector = &tree->selector;
+      gpointer *matches;
+      guint i;
+
+      if (selector->class == &GTK_CSS_SELECTOR_NAME ||
+          selector->class == &GTK_CSS_SELECTOR_NOT_NAME)
+        selector->name.name = gtk_css_selector_tree_save_string (save, selector->name.name);
+      else if (selector->class == &GTK_CSS_SELECTOR_ID ||
+               selector->class == &GTK_CSS_SELECTOR_NOT_ID)
+        selector->id.name = gtk_css_selector_tree_save_string (save, selector->id.name);
+      else if (selector->class == &GTK_CSS_SELECTOR_CLASS ||
+               selector->class == &GTK_CSS_SELECTOR_NOT_CLASS)
+        selector->style_class.style_class = GPOINTER_TO_UINT (gtk_css_selector_tree_save_string (save, g_quark_to_string (selector->style_class.style_class)));
+
+      for (i = 0; i < G_N_ELEMENTS (selector_classes); i++)
+        {
+          if (selector_classes[i] == selector->class)
+            break;
+        }
+      g_assert (i < G_N_ELEMENTS (selector_classes));
+      selector->class = GUINT_TO_POINTER (i);
+
+      matches = gtk_css_selector_tree_get_matches (tree);
+      if (matches)
+        {
+          for (i = 0; matches[i] != NULL; i++)
+            matches[i] = GUINT_TO_POINTER (save->save_match (matches[i], save->data) + 1);
+        }
+
+      gtk_css_selector_tree_save_nodes ((GtkCssSelectorTree *) gtk_css_selector_tree_get_previous (tree), save);
+    }
+}
+
+/**
+ * _gtk_css_selector_tree_save:
+ * @tree: (allow-none): the tree to save
+ * @strings: array that the strings used by @tree get appended to
+ * @save_match: function returning an index for every match of @tree
+ * @data: data to pass to @save_match
+ *
+ * Saves @tree into a form that can be written to disk and turned back
+ * into a tree with _gtk_css_selector_tree_load(), as long as it is the
+ * same build of GTK that does the loading. The indexes returned by
+ * @save_match are passed to the load function.
+ *
+ * Returns: the saved tree
+ **/
+GBytes *
+_gtk_css_selector_tree_save (const GtkCssSelectorTree   *tree,
+                             GPtrArray                  *strings,
+                             GtkCssSelectorTreeSaveFunc  save_match,
+                             gpointer                    data)
+{
+  GtkCssSelectorTreeSaveData save;
+  GtkCssSelectorTree *copy;
+  gsize size = 0;
+
+  if (tree == NULL)
+    return g_bytes_new (NULL, 0);
+
+  gtk_css_selector_tree_get_end (tree, (const guint8 *) tree, &size);
+  copy = g_memdup (tree, size);
+
+  save.string_indexes = g_hash_table_new (g_str_hash, g_str_equal);
+  save.strings = strings;
+  save.save_match = save_match;
+  save.data = data;
+
+  gtk_css_selector_tree_save_nodes (copy, &save);
+
+  g_hash_table_unref (save.string_indexes);
+
+  return g_bytes_new_take (copy, size);
+}
+
+static gboolean
+gtk_css_selector_tree_load_string (GtkCssSelectorTreeLoadData  *load,
+                                   gconstpointer                index,
+                                   const char                 **string)
+{
+  if (GPOINTER_TO_SIZE (index) >= load->n_strings)
+    return FALSE;
+
+  *string = load->strings[GPOINTER_TO_SIZE (index)];
+  return TRUE;
+}
+
+static gboolean
+gtk_css_selector_tree_is_valid_offset (GtkCssSelectorTreeLoadData *load,
+                                       const GtkCssSelectorTree   *tree,
+                                       gint32                      offset,
+                                       gsize                       size)
+{
+  gsize start;
+
+  if (offset <= 0)
+    return FALSE;
+
+  start = ((const guint8 *) tree - load->start) + offset;
+
+  return start % sizeof (gpointer) == 0 && start + size <= load->size;
+}
+
+/* Offsets to the previous and sibling nodes and to the matches always
+ * point forward, which makes sure that we're not going in circles on
+ * broken data */
+static gboolean
+gtk_css_selector_tree_load_nodes (GtkCssSelectorTree         *tree,
+                                  const GtkCssSelectorTree   *parent,
+                                  GtkCssSelectorTreeLoadData *load)
+{
+  for (; tree != NULL; tree = (GtkCssSelectorTree *) gtk_css_selector_tree_get_sibling (tree))
+    {
+      GtkCssSelector *selector = &tree->selector;
+      const char *string;
+      gsize index;
+
+      if (gtk_css_selector_tree_get_parent (tree) != parent)
+        return FALSE;
+
+      index = GPOINTER_TO_SIZE (selector->class);
+      if (index >= G_N_ELEMENTS (selector_classes))
+        return FALSE;
+      selector->class = selector_classes[index];
+
+      if (selector->class == &GTK_CSS_SELECTOR_NAME ||
+          selector->class == &GTK_CSS_SELECTOR_NOT_NAME)
+        {
+          if (!gtk_css_selector_tree_load_string (load, selector->name.name, &string))
+            return FALSE;
+          selector->name.name = g_intern_string (string);
+        }
+      else if (selector->class == &GTK_CSS_SELECTOR_ID ||
+               selector->class == &GTK_CSS_SELECTOR_NOT_ID)
+        {
+          if (!gtk_css_selector_tree_load_string (load, selector->id.name, &string))
+            return FALSE;
+          selector->id.name = g_intern_string (string);
+        }
+      else if (selector->class == &GTK_CSS_SELECTOR_CLASS ||
+               selector->class == &GTK_CSS_SELECTOR_NOT_CLASS)
+        {
+          if (!gtk_css_selector_tree_load_string (load, GUINT_TO_POINTER (selector->style_class.style_class), &string))
+            return FALSE;
+          selector->style_class.style_class = g_quark_from_string (string);
+        }
+
+      if (tree->matches_offset != GTK_CSS_SELECTOR_TREE_EMPTY_OFFSET)
+        {
+          gpointer *matches;
+          guint i;
+
+          if (!gtk_css_selector_tree_is_valid_offset (load, tree, tree->matches_offset, sizeof (gpointer)))
+            return FALSE;
+
+          matches = gtk_css_selector_tree_get_matches (tree);
+          for (i = 0; matches[i] != NULL; i++)
+            {
+              matches[i] = load->load_match (GPOINTER_TO_SIZE (matches[i]) - 1, tree, load->data);
+              if (matches[i] == NULL ||
+                  !gtk_css_selector_tree_is_valid_offset (load, tree, tree->matches_offset + (i + 1) * sizeof (gpointer), sizeof (gpointer)))
+                return FALSE;
+            }
+        }
+
+      if (tree->previous_offset != GTK_CSS_SELECTOR_TREE_EMPTY_OFFSET)
+        {
+          if (!gtk_css_selector_tree_is_valid_offset (load, tree, tree->previous_offset, sizeof (GtkCssSelectorTree)) ||
+              !gtk_css_selector_tree_load_nodes ((GtkCssSelectorTree *) gtk_css_selector_tree_get_previous (tree), tree, load))
+            return FALSE;
+        }
+
+      if (tree->sibling_offset != GTK_CSS_SELECTOR_TREE_EMPTY_OFFSET &&
+          !gtk_css_selector_tree_is_valid_offset (load, tree, tree->sibling_offset, sizeof (GtkCssSelectorTree)))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/**
+ * _gtk_css_selector_tree_load:
+ * @bytes: a tree saved with _gtk_css_selector_tree_save()
+ * @strings: the strings that were appended when saving
+ * @n_strings: the number of @strings
+ * @load_match: function returning the match for every saved index
+ * @data: data to pass to @load_match
+ * @out_tree: (out): return location for the loaded tree
+ *
+ * Loads a tree saved with _gtk_css_selector_tree_save(). @load_match
+ * gets called with the node that an index is a match for and may
+ * return %NULL if the index is not valid.
+ *
+ * Returns: %FALSE if @bytes is not a valid tree
+ **/
+gboolean
+_gtk_css_selector_tree_load (GBytes                      *bytes,
+                             const char * const          *strings,
+                             gsize                        n_strings,
+                             GtkCssSelectorTreeLoadFunc   load_match,
+                             gpointer                     data,
+                             GtkCssSelectorTree         **out_tree)
+{
+  GtkCssSelectorTreeLoadData load;
+  GtkCssSelectorTree *tree;
+  gsize size;
+
+  size = g_bytes_get_size (bytes);
+  if (size == 0)
+    {
+      *out_tree = NULL;
+      return TRUE;
+    }
+
+  if (size < sizeof (GtkCssSelectorTree))
+    return FALSE;
+
+  tree = g_memdup (g_bytes_get_data (bytes, NULL), size);
+
+  load.start = (guint8 *) tree;
+  load.size = size;
+  load.strings = strings;
+  load.n_strings = n_strings;
+  load.load_match = load_match;
+  load.data = data;
+
+  if (!gtk_css_selector_tree_load_nodes (tree, NULL, &load))
+    {
+      g_free (tree);
+      return FALSE;
+    }
+
+  *out_tree = tree;
+  return TRUE;
+}
@@ -26,6 +26,13 @@ G_BEGIN_DECLS
 typedef union _GtkCssSelector GtkCssSelector;
 typedef struct _GtkCssSelectorTree GtkCssSelectorTree;
 typedef struct _GtkCssSelectorTreeBuilder GtkCssSelectorTreeBuilder;
+typedef struct _GtkCssInvalidations GtkCssInvalidations;
+
+typedef guint    (* GtkCssSelectorTreeSaveFunc) (gpointer                  match,
+                                                 gpointer                  data);
+typedef gpointer (* GtkCssSelectorTreeLoadFunc) (gsize                     index,
+                                                 const GtkCssSelectorTree *tree,
+                                                 gpointer                  data);
 
 GtkCssSelector *  _gtk_css_selector_parse           (GtkCssParser           *parser);
 void              _gtk_css_selector_free            (GtkCssSelector         *selector);
@@ -45,8 +52,20 @@ GPtrArray *  _gtk_css_selector_tree_match_all        (const GtkCssSelectorTree *
 						      const GtkCssMatcher      *matcher);
 GtkCssChange _gtk_css_selector_tree_get_change_all   (const GtkCssSelectorTree *tree,
 						      const GtkCssMatcher *matcher);
+GtkCssInvalidations *
+             _gtk_css_selector_tree_get_invalidations (const GtkCssSelectorTree *tree);
 void         _gtk_css_selector_tree_match_print      (const GtkCssSelectorTree *tree,
 						      GString                  *str);
+GBytes *     _gtk_css_selector_tree_save             (const GtkCssSelectorTree   *tree,
+                                                      GPtrArray                  *strings,
+                                                      GtkCssSelectorTreeSaveFunc  save_match,
+                                                      gpointer                    data);
+gboolean     _gtk_css_selector_tree_load             (GBytes                      *bytes,
+                                                      const char * const          *strings,
+                                                      gsize                        n_strings,
+                                                      GtkCssSelectorTreeLoadFunc   load_match,
+                                                      gpointer                     data,
+                                                      GtkCssSelectorTree         **out_tree);
 
 
 GtkCssSelectorTreeBuilder *_gtk_css_selector_tree_builder_new   (void);
@@ -57,8 +76,33 @@ void                       _gtk_css_selector_tree_builder_add   (GtkCssSelectorT
 GtkCssSelectorTree *       _gtk_css_selector_tree_builder_build (GtkCssSelectorTreeBuilder *builder);
 void                       _gtk_css_selector_tree_builder_free  (GtkCssSelectorTreeBuilder *builder);
 
+void         gtk_css_invalidations_free              (GtkCssInvalidations       *invalidations);
+GtkCssChange gtk_css_invalidations_get_class_change  (const GtkCssInvalidations *invalidations,
+                                                      GQuark                     style_class);
+GtkCssChange gtk_css_invalidations_get_state_change  (const GtkCssInvalidations *invalidations,
+                                                      GtkStateFlags              state);
+
 const char *gtk_css_pseudoclass_name (GtkStateFlags flags);
 
+/* Hashes of the names, ids and classes in ancestor filters */
+static inline guint
+gtk_css_hash_name (/*interned*/ const char *name)
+{
+  return GPOINTER_TO_UINT (name) * 7;
+}
+
+static inline guint
+gtk_css_hash_id (/*interned*/ const char *id)
+{
+  return GPOINTER_TO_UINT (id) * 11;
+}
+
+static inline guint
+gtk_css_hash_class (GQuark style_class)
+{
+  return style_class * 5;
+}
+
 G_END_DECLS
 
 #endif /* __GTK_CSS_SELECTOR_PRIVATE_H__ */
@@ -113,6 +113,18 @@ gtk_css_value_shadows_equal (const GtkCssValue *value1,
   return TRUE;
 }
 
+static guint
+gtk_css_value_shadows_hash (const GtkCssValue *value)
+{
+  guint i, hash;
+
+  hash = value->len;
+  for (i = 0; i < value->len; i++)
+    hash = (hash << 5) - hash + gtk_css_value_hash (value->values[i]);
+
+  return hash;
+}
+
 static GtkCssValue *
 gtk_css_value_shadows_transition (GtkCssValue *start,
                                   GtkCssValue *end,
@@ -203,6 +215,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_SHADOWS = {
   gtk_css_value_shadows_free,
   gtk_css_value_shadows_compute,
   gtk_css_value_shadows_equal,
+  gtk_css_value_shadows_hash,
   gtk_css_value_shadows_transition,
   NULL,
   NULL,
@@ -109,6 +109,21 @@ gtk_css_value_shadow_equal (const GtkCssValue *shadow1,
       && _gtk_css_value_equal (shadow1->color, shadow2->color);
 }
 
+static guint
+gtk_css_value_shadow_hash (const GtkCssValue *shadow)
+{
+  guint hash;
+
+  hash = shadow->inset;
+  hash = (hash << 5) - hash + gtk_css_value_hash (shadow->hoffset);
+  hash = (hash << 5) - hash + gtk_css_value_hash (shadow->voffset);
+  hash = (hash << 5) - hash + gtk_css_value_hash (shadow->radius);
+  hash = (hash << 5) - hash + gtk_css_value_hash (shadow->spread);
+  hash = (hash << 5) - hash + gtk_css_value_hash (shadow->color);
+
+  return hash;
+}
+
 static GtkCssValue *
 gtk_css_value_shadow_transition (GtkCssValue *start,
                                  GtkCssValue *end,
@@ -158,6 +173,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_SHADOW = {
   gtk_css_value_shadow_free,
   gtk_css_value_shadow_compute,
   gtk_css_value_shadow_equal,
+  gtk_css_value_shadow_hash,
   gtk_css_value_shadow_transition,
   NULL,
   NULL,
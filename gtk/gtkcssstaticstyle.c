@@ -41,6 +41,237 @@
 
 G_DEFINE_TYPE (GtkCssStaticStyle, gtk_css_static_style, GTK_TYPE_CSS_STYLE)
 
+static const guint8 property_groups[GTK_CSS_PROPERTY_N_PROPERTIES] = {
+  [GTK_CSS_PROPERTY_COLOR] = GTK_CSS_VALUES_CORE,
+  [GTK_CSS_PROPERTY_DPI] = GTK_CSS_VALUES_CORE,
+  [GTK_CSS_PROPERTY_FONT_SIZE] = GTK_CSS_VALUES_CORE,
+  [GTK_CSS_PROPERTY_ICON_THEME] = GTK_CSS_VALUES_CORE,
+  [GTK_CSS_PROPERTY_ICON_PALETTE] = GTK_CSS_VALUES_CORE,
+  [GTK_CSS_PROPERTY_BACKGROUND_COLOR] = GTK_CSS_VALUES_BACKGROUND,
+  [GTK_CSS_PROPERTY_FONT_FAMILY] = GTK_CSS_VALUES_FONT,
+  [GTK_CSS_PROPERTY_FONT_STYLE] = GTK_CSS_VALUES_FONT,
+  [GTK_CSS_PROPERTY_FONT_WEIGHT] = GTK_CSS_VALUES_FONT,
+  [GTK_CSS_PROPERTY_FONT_STRETCH] = GTK_CSS_VALUES_FONT,
+  [GTK_CSS_PROPERTY_LETTER_SPACING] = GTK_CSS_VALUES_FONT,
+  [GTK_CSS_PROPERTY_TEXT_DECORATION_LINE] = GTK_CSS_VALUES_TEXT_DECORATION,
+  [GTK_CSS_PROPERTY_TEXT_DECORATION_COLOR] = GTK_CSS_VALUES_TEXT_DECORATION,
+  [GTK_CSS_PROPERTY_TEXT_DECORATION_STYLE] = GTK_CSS_VALUES_TEXT_DECORATION,
+  [GTK_CSS_PROPERTY_FONT_KERNING] = GTK_CSS_VALUES_TEXT_DECORATION,
+  [GTK_CSS_PROPERTY_FONT_VARIANT_LIGATURES] = GTK_CSS_VALUES_TEXT_DECORATION,
+  [GTK_CSS_PROPERTY_FONT_VARIANT_POSITION] = GTK_CSS_VALUES_TEXT_DECORATION,
+  [GTK_CSS_PROPERTY_FONT_VARIANT_CAPS] = GTK_CSS_VALUES_TEXT_DECORATION,
+  [GTK_CSS_PROPERTY_FONT_VARIANT_NUMERIC] = GTK_CSS_VALUES_TEXT_DECORATION,
+  [GTK_CSS_PROPERTY_FONT_VARIANT_ALTERNATES] = GTK_CSS_VALUES_TEXT_DECORATION,
+  [GTK_CSS_PROPERTY_FONT_VARIANT_EAST_ASIAN] = GTK_CSS_VALUES_TEXT_DECORATION,
+  [GTK_CSS_PROPERTY_TEXT_SHADOW] = GTK_CSS_VALUES_FONT,
+  [GTK_CSS_PROPERTY_BOX_SHADOW] = GTK_CSS_VALUES_BACKGROUND,
+  [GTK_CSS_PROPERTY_MARGIN_TOP] = GTK_CSS_VALUES_SIZE,
+  [GTK_CSS_PROPERTY_MARGIN_LEFT] = GTK_CSS_VALUES_SIZE,
+  [GTK_CSS_PROPERTY_MARGIN_BOTTOM] = GTK_CSS_VALUES_SIZE,
+  [GTK_CSS_PROPERTY_MARGIN_RIGHT] = GTK_CSS_VALUES_SIZE,
+  [GTK_CSS_PROPERTY_PADDING_TOP] = GTK_CSS_VALUES_SIZE,
+  [GTK_CSS_PROPERTY_PADDING_LEFT] = GTK_CSS_VALUES_SIZE,
+  [GTK_CSS_PROPERTY_PADDING_BOTTOM] = GTK_CSS_VALUES_SIZE,
+  [GTK_CSS_PROPERTY_PADDING_RIGHT] = GTK_CSS_VALUES_SIZE,
+  [GTK_CSS_PROPERTY_BORDER_TOP_STYLE] = GTK_CSS_VALUES_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_TOP_WIDTH] = GTK_CSS_VALUES_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_LEFT_STYLE] = GTK_CSS_VALUES_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_LEFT_WIDTH] = GTK_CSS_VALUES_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_BOTTOM_STYLE] = GTK_CSS_VALUES_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_BOTTOM_WIDTH] = GTK_CSS_VALUES_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_RIGHT_STYLE] = GTK_CSS_VALUES_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_RIGHT_WIDTH] = GTK_CSS_VALUES_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_TOP_LEFT_RADIUS] = GTK_CSS_VALUES_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_TOP_RIGHT_RADIUS] = GTK_CSS_VALUES_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_BOTTOM_RIGHT_RADIUS] = GTK_CSS_VALUES_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_BOTTOM_LEFT_RADIUS] = GTK_CSS_VALUES_BORDER,
+  [GTK_CSS_PROPERTY_OUTLINE_STYLE] = GTK_CSS_VALUES_OUTLINE,
+  [GTK_CSS_PROPERTY_OUTLINE_WIDTH] = GTK_CSS_VALUES_OUTLINE,
+  [GTK_CSS_PROPERTY_OUTLINE_OFFSET] = GTK_CSS_VALUES_OUTLINE,
+  [GTK_CSS_PROPERTY_OUTLINE_TOP_LEFT_RADIUS] = GTK_CSS_VALUES_OUTLINE,
+  [GTK_CSS_PROPERTY_OUTLINE_TOP_RIGHT_RADIUS] = GTK_CSS_VALUES_OUTLINE,
+  [GTK_CSS_PROPERTY_OUTLINE_BOTTOM_RIGHT_RADIUS] = GTK_CSS_VALUES_OUTLINE,
+  [GTK_CSS_PROPERTY_OUTLINE_BOTTOM_LEFT_RADIUS] = GTK_CSS_VALUES_OUTLINE,
+  [GTK_CSS_PROPERTY_BACKGROUND_CLIP] = GTK_CSS_VALUES_BACKGROUND,
+  [GTK_CSS_PROPERTY_BACKGROUND_ORIGIN] = GTK_CSS_VALUES_BACKGROUND,
+  [GTK_CSS_PROPERTY_BACKGROUND_SIZE] = GTK_CSS_VALUES_BACKGROUND,
+  [GTK_CSS_PROPERTY_BACKGROUND_POSITION] = GTK_CSS_VALUES_BACKGROUND,
+  [GTK_CSS_PROPERTY_BORDER_TOP_COLOR] = GTK_CSS_VALUES_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_RIGHT_COLOR] = GTK_CSS_VALUES_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_BOTTOM_COLOR] = GTK_CSS_VALUES_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_LEFT_COLOR] = GTK_CSS_VALUES_BORDER,
+  [GTK_CSS_PROPERTY_OUTLINE_COLOR] = GTK_CSS_VALUES_OUTLINE,
+  [GTK_CSS_PROPERTY_BACKGROUND_REPEAT] = GTK_CSS_VALUES_BACKGROUND,
+  [GTK_CSS_PROPERTY_BACKGROUND_IMAGE] = GTK_CSS_VALUES_BACKGROUND,
+  [GTK_CSS_PROPERTY_BACKGROUND_BLEND_MODE] = GTK_CSS_VALUES_BACKGROUND,
+  [GTK_CSS_PROPERTY_BORDER_IMAGE_SOURCE] = GTK_CSS_VALUES_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_IMAGE_REPEAT] = GTK_CSS_VALUES_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_IMAGE_SLICE] = GTK_CSS_VALUES_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_IMAGE_WIDTH] = GTK_CSS_VALUES_BORDER,
+  [GTK_CSS_PROPERTY_ICON_SOURCE] = GTK_CSS_VALUES_OTHER,
+  [GTK_CSS_PROPERTY_ICON_SIZE] = GTK_CSS_VALUES_ICON,
+  [GTK_CSS_PROPERTY_ICON_SHADOW] = GTK_CSS_VALUES_ICON,
+  [GTK_CSS_PROPERTY_ICON_STYLE] = GTK_CSS_VALUES_ICON,
+  [GTK_CSS_PROPERTY_ICON_TRANSFORM] = GTK_CSS_VALUES_OTHER,
+  [GTK_CSS_PROPERTY_ICON_FILTER] = GTK_CSS_VALUES_OTHER,
+  [GTK_CSS_PROPERTY_BORDER_SPACING] = GTK_CSS_VALUES_SIZE,
+  [GTK_CSS_PROPERTY_MIN_WIDTH] = GTK_CSS_VALUES_SIZE,
+  [GTK_CSS_PROPERTY_MIN_HEIGHT] = GTK_CSS_VALUES_SIZE,
+  [GTK_CSS_PROPERTY_TRANSITION_PROPERTY] = GTK_CSS_VALUES_ANIMATION,
+  [GTK_CSS_PROPERTY_TRANSITION_DURATION] = GTK_CSS_VALUES_ANIMATION,
+  [GTK_CSS_PROPERTY_TRANSITION_TIMING_FUNCTION] = GTK_CSS_VALUES_ANIMATION,
+  [GTK_CSS_PROPERTY_TRANSITION_DELAY] = GTK_CSS_VALUES_ANIMATION,
+  [GTK_CSS_PROPERTY_ANIMATION_NAME] = GTK_CSS_VALUES_ANIMATION,
+  [GTK_CSS_PROPERTY_ANIMATION_DURATION] = GTK_CSS_VALUES_ANIMATION,
+  [GTK_CSS_PROPERTY_ANIMATION_TIMING_FUNCTION] = GTK_CSS_VALUES_ANIMATION,
+  [GTK_CSS_PROPERTY_ANIMATION_ITERATION_COUNT] = GTK_CSS_VALUES_ANIMATION,
+  [GTK_CSS_PROPERTY_ANIMATION_DIRECTION] = GTK_CSS_VALUES_ANIMATION,
+  [GTK_CSS_PROPERTY_ANIMATION_PLAY_STATE] = GTK_CSS_VALUES_ANIMATION,
+  [GTK_CSS_PROPERTY_ANIMATION_DELAY] = GTK_CSS_VALUES_ANIMATION,
+  [GTK_CSS_PROPERTY_ANIMATION_FILL_MODE] = GTK_CSS_VALUES_ANIMATION,
+  [GTK_CSS_PROPERTY_OPACITY] = GTK_CSS_VALUES_OTHER,
+  [GTK_CSS_PROPERTY_FILTER] = GTK_CSS_VALUES_OTHER,
+  [GTK_CSS_PROPERTY_GTK_KEY_BINDINGS] = GTK_CSS_VALUES_OTHER,
+  [GTK_CSS_PROPERTY_CARET_COLOR] = GTK_CSS_VALUES_FONT,
+  [GTK_CSS_PROPERTY_SECONDARY_CARET_COLOR] = GTK_CSS_VALUES_FONT,
+  [GTK_CSS_PROPERTY_FONT_FEATURE_SETTINGS] = GTK_CSS_VALUES_FONT,
+  [GTK_CSS_PROPERTY_FONT_VARIATION_SETTINGS] = GTK_CSS_VALUES_FONT,
+};
+
+/* Groups whose initial values don't depend on other properties, like
+ * currentColor or em sizes do, so they can be computed once */
+static const gboolean group_initial_is_constant[GTK_CSS_VALUES_N_GROUPS] = {
+  [GTK_CSS_VALUES_BACKGROUND] = TRUE,
+  [GTK_CSS_VALUES_SIZE] = TRUE,
+  [GTK_CSS_VALUES_ANIMATION] = TRUE,
+  [GTK_CSS_VALUES_OTHER] = TRUE,
+};
+
+/* Filled in class_init () */
+static guint8 property_indexes[GTK_CSS_PROPERTY_N_PROPERTIES];
+static guint8 group_sizes[GTK_CSS_VALUES_N_GROUPS];
+static guint8 *group_properties[GTK_CSS_VALUES_N_GROUPS];
+static gboolean group_is_inherited[GTK_CSS_VALUES_N_GROUPS];
+
+/* All values that are in use, to share equal ones. Styles can be
+ * computed from several threads, so this is protected by a lock. */
+static GHashTable *interned_values;
+G_LOCK_DEFINE_STATIC (interned_values);
+/* Computed initial values of groups with group_initial_is_constant,
+ * set once and accessed atomically */
+static GtkCssValues *initial_values[GTK_CSS_VALUES_N_GROUPS];
+
+static guint
+gtk_css_values_hash (gconstpointer data)
+{
+  const GtkCssValues *values = data;
+  guint i, hash;
+
+  hash = values->group;
+  for (i = 0; i < group_sizes[values->group]; i++)
+    hash = (hash << 5) - hash + gtk_css_value_hash (values->values[i]);
+
+  return hash;
+}
+
+static gboolean
+gtk_css_values_equal (gconstpointer data1,
+                      gconstpointer data2)
+{
+  const GtkCssValues *values1 = data1;
+  const GtkCssValues *values2 = data2;
+  guint i;
+
+  if (values1->group != values2->group)
+    return FALSE;
+
+  for (i = 0; i < group_sizes[values1->group]; i++)
+    {
+      if (!_gtk_css_value_equal (values1->values[i], values2->values[i]))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static GtkCssValues *
+gtk_css_values_new (GtkCssValuesGroup group)
+{
+  GtkCssValues *values;
+
+  values = g_malloc0 (sizeof (GtkCssValues) + (group_sizes[group] - 1) * sizeof (GtkCssValue *));
+  values->ref_count = 1;
+  values->group = group;
+
+  return values;
+}
+
+static GtkCssValues *
+gtk_css_values_ref (GtkCssValues *values)
+{
+  g_atomic_int_inc (&values->ref_count);
+
+  return values;
+}
+
+static void
+gtk_css_values_unref (GtkCssValues *values)
+{
+  guint i;
+
+  if (values->interned)
+    {
+      /* Values found in the table are referenced with the lock held,
+       * so nobody can pick them up while we free them */
+      G_LOCK (interned_values);
+      if (!g_atomic_int_dec_and_test (&values->ref_count))
+        {
+          G_UNLOCK (interned_values);
+          return;
+        }
+      g_hash_table_remove (interned_values, values);
+      G_UNLOCK (interned_values);
+    }
+  else if (!g_atomic_int_dec_and_test (&values->ref_count))
+    return;
+
+  for (i = 0; i < group_sizes[values->group]; i++)
+    {
+      if (values->values[i])
+        _gtk_css_value_unref (values->values[i]);
+    }
+
+  g_free (values);
+}
+
+/* Takes ownership of @values and returns the shared equal values */
+static GtkCssValues *
+gtk_css_values_intern (GtkCssValues *values)
+{
+  GtkCssValues *interned;
+
+  G_LOCK (interned_values);
+  interned = g_hash_table_lookup (interned_values, values);
+  if (interned)
+    {
+      gtk_css_values_ref (interned);
+    }
+  else
+    {
+      values->interned = TRUE;
+      g_hash_table_add (interned_values, values);
+    }
+  G_UNLOCK (interned_values);
+
+  if (interned)
+    {
+      gtk_css_values_unref (values);
+      return interned;
+    }
+
+  return values;
+}
+
 static GtkCssValue *
 gtk_css_static_style_get_value (GtkCssStyle *style,
                                 guint        id)
@@ -48,7 +279,7 @@ gtk_css_static_style_get_value (GtkCssStyle *style,
   /* This is called a lot, so we avoid a dynamic type check here */
   GtkCssStaticStyle *sstyle = (GtkCssStaticStyle *) style;
 
-  return sstyle->values[id];
+  return sstyle->groups[property_groups[id]]->values[property_indexes[id]];
 }
 
 static GtkCssSection *
@@ -70,10 +301,13 @@ gtk_css_static_style_dispose (GObject *object)
   GtkCssStaticStyle *style = GTK_CSS_STATIC_STYLE (object);
   guint i;
 
-  for (i = 0; i < GTK_CSS_PROPERTY_N_PROPERTIES; i++)
+  for (i = 0; i < GTK_CSS_VALUES_N_GROUPS; i++)
     {
-      if (style->values[i])
-        _gtk_css_value_unref (style->values[i]);
+      if (style->groups[i])
+        {
+          gtk_css_values_unref (style->groups[i]);
+          style->groups[i] = NULL;
+        }
     }
   if (style->sections)
     {
@@ -89,6 +323,29 @@ gtk_css_static_style_class_init (GtkCssStaticStyleClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
   GtkCssStyleClass *style_class = GTK_CSS_STYLE_CLASS (klass);
+  guint i, group;
+
+  for (group = 0; group < GTK_CSS_VALUES_N_GROUPS; group++)
+    group_is_inherited[group] = TRUE;
+
+  for (i = 0; i < GTK_CSS_PROPERTY_N_PROPERTIES; i++)
+    {
+      group = property_groups[i];
+      property_indexes[i] = group_sizes[group]++;
+      if (!_gtk_css_style_property_is_inherit (_gtk_css_style_property_lookup_by_id (i)))
+        group_is_inherited[group] = FALSE;
+    }
+
+  for (group = 0; group < GTK_CSS_VALUES_N_GROUPS; group++)
+    {
+      g_assert (group_sizes[group] > 0);
+      group_properties[group] = g_new (guint8, group_sizes[group]);
+    }
+
+  for (i = 0; i < GTK_CSS_PROPERTY_N_PROPERTIES; i++)
+    group_properties[property_groups[i]][property_indexes[i]] = i;
+
+  interned_values = g_hash_table_new (gtk_css_values_hash, gtk_css_values_equal);
 
   object_class->dispose = gtk_css_static_style_dispose;
 
@@ -114,9 +371,12 @@ gtk_css_static_style_set_value (GtkCssStaticStyle *style,
                                 GtkCssValue       *value,
                                 GtkCssSection     *section)
 {
-  if (style->values[id])
-    _gtk_css_value_unref (style->values[id]);
-  style->values[id] = _gtk_css_value_ref (value);
+  GtkCssValues *values = style->groups[property_groups[id]];
+  guint index = property_indexes[id];
+
+  if (values->values[index])
+    _gtk_css_value_unref (values->values[index]);
+  values->values[index] = _gtk_css_value_ref (value);
 
   if (style->sections && style->sections->len > id && g_ptr_array_index (style->sections, id))
     {
@@ -166,6 +426,84 @@ gtk_css_static_style_get_default (void)
   return default_style;
 }
 
+static gboolean
+gtk_css_static_style_group_is_unset (const GtkCssLookup *lookup,
+                                     GtkCssValuesGroup   group)
+{
+  guint i;
+
+  for (i = 0; i < group_sizes[group]; i++)
+    {
+      if (lookup->values[group_properties[group][i]].value)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Shares the groups no declaration applies to with the parent or with
+ * the cached initial values, and creates empty values for the others.
+ * Returns the groups whose initial values should be cached. */
+static guint
+gtk_css_static_style_init_groups (GtkCssStaticStyle  *style,
+                                  const GtkCssLookup *lookup,
+                                  GtkCssStyle        *parent)
+{
+  GtkCssValues *initial;
+  guint group, new_initial = 0;
+
+  for (group = 0; group < GTK_CSS_VALUES_N_GROUPS; group++)
+    {
+      if (gtk_css_static_style_group_is_unset (lookup, group))
+        {
+          if (group_is_inherited[group] && parent && GTK_IS_CSS_STATIC_STYLE (parent))
+            {
+              style->groups[group] = gtk_css_values_ref (GTK_CSS_STATIC_STYLE (parent)->groups[group]);
+              continue;
+            }
+
+          if (!group_is_inherited[group] && group_initial_is_constant[group])
+            {
+              initial = g_atomic_pointer_get (&initial_values[group]);
+              if (initial)
+                {
+                  style->groups[group] = gtk_css_values_ref (initial);
+                  continue;
+                }
+
+              new_initial |= 1 << group;
+            }
+        }
+
+      style->groups[group] = gtk_css_values_new (group);
+      style->computing |= 1 << group;
+    }
+
+  return new_initial;
+}
+
+static void
+gtk_css_static_style_finish_groups (GtkCssStaticStyle *style,
+                                    guint              new_initial)
+{
+  guint group;
+
+  for (group = 0; group < GTK_CSS_VALUES_N_GROUPS; group++)
+    {
+      if ((style->computing & (1 << group)) == 0)
+        continue;
+
+      style->groups[group] = gtk_css_values_intern (style->groups[group]);
+
+      /* Another thread may have set them in the meantime */
+      if ((new_initial & (1 << group)) &&
+          g_atomic_pointer_compare_and_exchange (&initial_values[group], NULL, style->groups[group]))
+        gtk_css_values_ref (style->groups[group]);
+    }
+
+  style->computing = 0;
+}
+
 GtkCssStyle *
 gtk_css_static_style_new_compute (GtkStyleProvider    *provider,
                                   const GtkCssMatcher *matcher,
@@ -174,6 +512,7 @@ gtk_css_static_style_new_compute (GtkStyleProvider    *provider,
   GtkCssStaticStyle *result;
   GtkCssLookup lookup;
   GtkCssChange change = GTK_CSS_CHANGE_ANY_SELF | GTK_CSS_CHANGE_ANY_SIBLING | GTK_CSS_CHANGE_ANY_PARENT;
+  guint new_initial;
 
   _gtk_css_lookup_init (&lookup, NULL);
 
@@ -187,11 +526,15 @@ gtk_css_static_style_new_compute (GtkStyleProvider    *provider,
 
   result->change = change;
 
+  new_initial = gtk_css_static_style_init_groups (result, &lookup, parent);
+
   _gtk_css_lookup_resolve (&lookup,
                            provider,
                            result,
                            parent);
 
+  gtk_css_static_style_finish_groups (result, new_initial);
+
   _gtk_css_lookup_destroy (&lookup);
 
   return GTK_CSS_STYLE (result);
@@ -212,6 +555,10 @@ gtk_css_static_style_compute_value (GtkCssStaticStyle *style,
   gtk_internal_return_if_fail (parent_style == NULL || GTK_IS_CSS_STYLE (parent_style));
   gtk_internal_return_if_fail (id < GTK_CSS_PROPERTY_N_PROPERTIES);
 
+  /* The group is shared and has the value already */
+  if ((style->computing & (1 << property_groups[id])) == 0)
+    return;
+
   /* http://www.w3.org/TR/css3-cascade/#cascade
    * Then, for every element, the value for each property can be found
    * by following this pseudo-algorithm:
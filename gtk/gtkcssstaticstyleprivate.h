@@ -34,15 +34,44 @@ G_BEGIN_DECLS
 
 typedef struct _GtkCssStaticStyle           GtkCssStaticStyle;
 typedef struct _GtkCssStaticStyleClass      GtkCssStaticStyleClass;
+typedef struct _GtkCssValues                GtkCssValues;
+
+/* Properties are grouped so that styles can share the values of a
+ * group when they are equal. Groups with only inherited properties
+ * come first. */
+typedef enum {
+  GTK_CSS_VALUES_CORE,
+  GTK_CSS_VALUES_FONT,
+  GTK_CSS_VALUES_ICON,
+  GTK_CSS_VALUES_TEXT_DECORATION,
+  GTK_CSS_VALUES_BACKGROUND,
+  GTK_CSS_VALUES_BORDER,
+  GTK_CSS_VALUES_OUTLINE,
+  GTK_CSS_VALUES_SIZE,
+  GTK_CSS_VALUES_ANIMATION,
+  GTK_CSS_VALUES_OTHER,
+  GTK_CSS_VALUES_N_GROUPS
+} GtkCssValuesGroup;
+
+/* Immutable once computed, and shared between all styles with equal
+ * values for the group */
+struct _GtkCssValues
+{
+  gint                   ref_count;
+  GtkCssValuesGroup      group;
+  guint                  interned : 1;
+  GtkCssValue           *values[1];            /* one per property of the group */
+};
 
 struct _GtkCssStaticStyle
 {
   GtkCssStyle parent;
 
-  GtkCssValue           *values[GTK_CSS_PROPERTY_N_PROPERTIES]; /* the values */
+  GtkCssValues          *groups[GTK_CSS_VALUES_N_GROUPS]; /* the values */
   GPtrArray             *sections;             /* sections the values are defined in */
 
   GtkCssChange           change;               /* change as returned by value lookup */
+  guint                  computing;            /* mask of groups that are being computed */
 };
 
 struct _GtkCssStaticStyleClass
@@ -50,6 +50,12 @@ gtk_css_value_string_equal (const GtkCssValue *value1,
   return g_strcmp0 (value1->string, value2->string) == 0;
 }
 
+static guint
+gtk_css_value_string_hash (const GtkCssValue *value)
+{
+  return value->string ? g_str_hash (value->string) : 0;
+}
+
 static GtkCssValue *
 gtk_css_value_string_transition (GtkCssValue *start,
                                  GtkCssValue *end,
@@ -120,6 +126,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_STRING = {
   gtk_css_value_string_free,
   gtk_css_value_string_compute,
   gtk_css_value_string_equal,
+  gtk_css_value_string_hash,
   gtk_css_value_string_transition,
   NULL,
   NULL,
@@ -130,6 +137,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_IDENT = {
   gtk_css_value_string_free,
   gtk_css_value_string_compute,
   gtk_css_value_string_equal,
+  gtk_css_value_string_hash,
   gtk_css_value_string_transition,
   NULL,
   NULL,
@@ -216,3 +224,30 @@ _gtk_css_ident_value_get (const GtkCssValue *value)
   return value->string;
 }
 
+/* Saves strings and idents, returns %NULL for other values */
+GVariant *
+gtk_css_string_value_save (const GtkCssValue *value)
+{
+  if (value->class != &GTK_CSS_VALUE_STRING &&
+      value->class != &GTK_CSS_VALUE_IDENT)
+    return NULL;
+
+  return g_variant_new ("(bms)", value->class == &GTK_CSS_VALUE_IDENT, value->string);
+}
+
+GtkCssValue *
+gtk_css_string_value_load (GVariant *variant)
+{
+  gboolean ident;
+  char *string;
+
+  if (!g_variant_is_of_type (variant, G_VARIANT_TYPE ("(bms)")))
+    return NULL;
+
+  g_variant_get (variant, "(bms)", &ident, &string);
+
+  if (ident)
+    return _gtk_css_ident_value_new_take (string);
+  else
+    return _gtk_css_string_value_new_take (string);
+}
@@ -38,6 +38,9 @@ GtkCssValue *   _gtk_css_string_value_parse         (GtkCssParser           *par
 
 const char *    _gtk_css_string_value_get           (const GtkCssValue      *string);
 
+GVariant *      gtk_css_string_value_save           (const GtkCssValue      *value);
+GtkCssValue *   gtk_css_string_value_load           (GVariant               *variant);
+
 
 G_END_DECLS
 
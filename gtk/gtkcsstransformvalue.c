@@ -706,6 +706,7 @@ static const GtkCssValueClass GTK_CSS_VALUE_TRANSFORM = {
   gtk_css_value_transform_free,
   gtk_css_value_transform_compute,
   gtk_css_value_transform_equal,
+  NULL,
   gtk_css_value_transform_transition,
   NULL,
   NULL,
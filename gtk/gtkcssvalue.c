@@ -48,7 +48,7 @@ gtk_css_value_ref (GtkCssValue *value)
 {
   gtk_internal_return_val_if_fail (value != NULL, NULL);
 
-  value->ref_count += 1;
+  g_atomic_int_inc (&value->ref_count);
 
   return value;
 }
@@ -59,8 +59,7 @@ gtk_css_value_unref (GtkCssValue *value)
   if (value == NULL)
     return;
 
-  value->ref_count -= 1;
-  if (value->ref_count > 0)
+  if (!g_atomic_int_dec_and_test (&value->ref_count))
     return;
 
   value->class->free (value);
@@ -107,6 +106,39 @@ _gtk_css_value_equal (const GtkCssValue *value1,
   return value1->class->equal (value1, value2);
 }
 
+/* Equal values hash the same. Classes without a hash function only
+ * hash their type, so all their values end up in the same bucket. */
+guint
+gtk_css_value_hash (const GtkCssValue *value)
+{
+  gtk_internal_return_val_if_fail (value != NULL, 0);
+
+  if (value->class->hash == NULL)
+    return g_direct_hash (value->class);
+
+  return value->class->hash (value);
+}
+
+guint
+gtk_css_value_hash0 (const GtkCssValue *value)
+{
+  if (value == NULL)
+    return 0;
+
+  return gtk_css_value_hash (value);
+}
+
+/* Hashes doubles so that values comparing equal with == hash the
+ * same, which is not the case for g_double_hash() and -0.0 */
+guint
+gtk_css_double_hash (double d)
+{
+  if (d == 0.0)
+    return 0;
+
+  return g_double_hash (&d);
+}
+
 gboolean
 _gtk_css_value_equal0 (const GtkCssValue *value1,
                        const GtkCssValue *value2)
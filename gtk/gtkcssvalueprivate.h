@@ -27,7 +27,8 @@ G_BEGIN_DECLS
 
 #define GTK_TYPE_CSS_VALUE           (_gtk_css_value_get_type ())
 
-/* A GtkCssValue is a refcounted immutable value type */
+/* A GtkCssValue is a refcounted immutable value type, so it can be
+ * shared between threads */
 
 typedef struct _GtkCssValue           GtkCssValue;
 typedef struct _GtkCssValueClass      GtkCssValueClass;
@@ -47,6 +48,7 @@ struct _GtkCssValueClass {
                                                        GtkCssStyle                *parent_style);
   gboolean      (* equal)                             (const GtkCssValue          *value1,
                                                        const GtkCssValue          *value2);
+  guint         (* hash)                              (const GtkCssValue          *value);
   GtkCssValue * (* transition)                        (GtkCssValue                *start,
                                                        GtkCssValue                *end,
                                                        guint                       property_id,
@@ -78,6 +80,9 @@ gboolean     _gtk_css_value_equal                     (const GtkCssValue
                                                        const GtkCssValue          *value2);
 gboolean     _gtk_css_value_equal0                    (const GtkCssValue          *value1,
                                                        const GtkCssValue          *value2);
+guint           gtk_css_value_hash                    (const GtkCssValue          *value);
+guint           gtk_css_value_hash0                   (const GtkCssValue          *value);
+guint           gtk_css_double_hash                   (double                      d);
 GtkCssValue *_gtk_css_value_transition                (GtkCssValue                *start,
                                                        GtkCssValue                *end,
                                                        guint                       property_id,
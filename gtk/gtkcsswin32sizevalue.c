@@ -155,6 +155,23 @@ gtk_css_value_win32_size_equal (const GtkCssValue *value1,
     }
 }
 
+static guint
+gtk_css_value_win32_size_hash (const GtkCssValue *value)
+{
+  switch (value->type)
+    {
+    case GTK_WIN32_SIZE:
+      return value->type ^ value->val.size.id << 4;
+
+    case GTK_WIN32_PART_WIDTH:
+    case GTK_WIN32_PART_HEIGHT:
+      return value->type ^ value->val.part.part << 4 ^ value->val.part.state << 16;
+
+    default:
+      return value->type;
+    }
+}
+
 static void
 gtk_css_value_win32_size_print (const GtkCssValue *value,
                                 GString           *string)
@@ -252,6 +269,7 @@ static const GtkCssNumberValueClass GTK_CSS_VALUE_WIN32_SIZE = {
     gtk_css_value_win32_size_free,
     gtk_css_value_win32_size_compute,
     gtk_css_value_win32_size_equal,
+    gtk_css_value_win32_size_hash,
     gtk_css_number_value_transition,
     NULL,
     NULL,
@@ -87,6 +87,8 @@ struct _GtkImagePrivate
   gchar                *filename;       /* Only used with GTK_IMAGE_SURFACE */
   gchar                *resource_path;  /* Only used with GTK_IMAGE_SURFACE */
 
+  GCancellable         *load_cancellable;
+
   guint keep_aspect_ratio : 1;
   guint can_shrink : 1;
 };
@@ -741,6 +743,121 @@ gtk_image_set_from_file   (GtkImage    *image,
   g_object_thaw_notify (G_OBJECT (image));
 }
 
+typedef struct
+{
+  GtkImage *image;
+  int scale_factor;
+} FileLoadData;
+
+static void
+gtk_image_file_loaded (GObject      *source,
+                       GAsyncResult *result,
+                       gpointer      user_data)
+{
+  FileLoadData *data = user_data;
+  GtkImage *image = data->image;
+  GtkImagePrivate *priv = gtk_image_get_instance_private (image);
+  GdkTexture *texture;
+  GError *error = NULL;
+  char *filename;
+
+  texture = gdk_texture_new_from_file_finish (result, &error);
+
+  /* Cancelled by gtk_image_clear(), the image shows something else now */
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      g_error_free (error);
+      goto out;
+    }
+
+  g_object_freeze_notify (G_OBJECT (image));
+
+  /* Setting the image clears the filename, but it's still the same file */
+  g_clear_object (&priv->load_cancellable);
+  filename = g_steal_pointer (&priv->filename);
+
+  if (texture)
+    {
+      GdkPaintable *scaler;
+
+      scaler = gtk_scaler_new (GDK_PAINTABLE (texture), data->scale_factor);
+      gtk_image_set_from_paintable (image, scaler);
+      g_object_unref (scaler);
+      g_object_unref (texture);
+    }
+  else
+    {
+      g_error_free (error);
+      gtk_image_set_from_icon_name (image, "image-missing");
+    }
+
+  priv->filename = filename;
+  g_object_notify_by_pspec (G_OBJECT (image), image_props[PROP_FILE]);
+
+  g_object_thaw_notify (G_OBJECT (image));
+
+out:
+  g_object_unref (image);
+  g_slice_free (FileLoadData, data);
+}
+
+/**
+ * gtk_image_set_from_file_async:
+ * @image: a #GtkImage
+ * @filename: (type filename): a filename
+ *
+ * Like gtk_image_set_from_file(), but decodes the image in a worker
+ * thread. The image shows the “image-loading” icon until the file is
+ * loaded, and the “image-missing” icon if it could not be loaded.
+ *
+ * If a pixel size is set with gtk_image_set_pixel_size(), the image
+ * is decoded directly at that size, which makes this a good fit for
+ * thumbnails.
+ *
+ * Setting a different image before the file is loaded cancels the
+ * loading.
+ **/
+void
+gtk_image_set_from_file_async (GtkImage    *image,
+                               const gchar *filename)
+{
+  GtkImagePrivate *priv = gtk_image_get_instance_private (image);
+  FileLoadData *data;
+  int pixel_size;
+  GFile *file;
+
+  g_return_if_fail (GTK_IS_IMAGE (image));
+  g_return_if_fail (filename != NULL);
+
+  g_object_freeze_notify (G_OBJECT (image));
+
+  gtk_image_set_from_icon_name (image, "image-loading");
+
+  data = g_slice_new (FileLoadData);
+  data->image = g_object_ref (image);
+  data->scale_factor = gtk_widget_get_scale_factor (GTK_WIDGET (image));
+
+  pixel_size = gtk_image_get_pixel_size (image);
+  if (pixel_size > 0)
+    pixel_size *= data->scale_factor;
+  else
+    data->scale_factor = 1;
+
+  priv->load_cancellable = g_cancellable_new ();
+  file = g_file_new_for_path (filename);
+  gdk_texture_new_from_file_async (file,
+                                   pixel_size, pixel_size,
+                                   priv->load_cancellable,
+                                   gtk_image_file_loaded,
+                                   data);
+  g_object_unref (file);
+
+  priv->filename = g_strdup (filename);
+  g_object_notify_by_pspec (G_OBJECT (image), image_props[PROP_FILE]);
+
+  g_object_thaw_notify (G_OBJECT (image));
+}
+
 #ifndef GDK_PIXBUF_MAGIC_NUMBER
 #define GDK_PIXBUF_MAGIC_NUMBER (0x47646b50)    /* 'GdkP' */
 #endif
@@ -1268,6 +1385,12 @@ gtk_image_clear (GtkImage *image)
       g_object_notify_by_pspec (G_OBJECT (image), image_props[PROP_RESOURCE]);
     }
 
+  if (priv->load_cancellable)
+    {
+      g_cancellable_cancel (priv->load_cancellable);
+      g_clear_object (&priv->load_cancellable);
+    }
+
   if (storage_type == GTK_IMAGE_PAINTABLE)
     {
       GdkPaintable *paintable = _gtk_icon_helper_peek_paintable (priv->icon_helper);
@@ -125,6 +125,7 @@ struct _GtkSettingsPrivate
   gboolean font_size_absolute;
   gchar *font_family;
   cairo_font_options_t *font_options;
+  guint display_settings_frozen;
 };
 
 struct _GtkSettingsValuePrivate
@@ -2459,6 +2460,9 @@ settings_update_xsetting (GtkSettings *settings,
   if (priv->property_values[pspec->param_id - 1].source == GTK_SETTINGS_SOURCE_XSETTING && !force)
     return FALSE;
 
+  if (priv->display_settings_frozen)
+    return FALSE;
+
   value_type = G_PARAM_SPEC_VALUE_TYPE (pspec);
   fundamental_type = G_TYPE_FUNDAMENTAL (value_type);
 
@@ -2668,3 +2672,38 @@ gtk_settings_get_font_size_is_absolute (GtkSettings *settings)
 
   return settings->priv->font_size_absolute;
 }
+
+/*
+ * gtk_settings_freeze_display_settings:
+ * @settings: a #GtkSettings
+ *
+ * Updates the settings that CSS styles depend on from the display and
+ * then stops looking at the display until
+ * gtk_settings_thaw_display_settings() is called, so that the settings
+ * can be read while styles are computed on other threads.
+ */
+void
+gtk_settings_freeze_display_settings (GtkSettings *settings)
+{
+  GtkSettingsPrivate *priv = settings->priv;
+
+  if (priv->display_settings_frozen == 0)
+    {
+      settings_update_font_name (settings);
+      settings_update_xsetting (settings,
+                                g_object_class_find_property (G_OBJECT_GET_CLASS (settings), "gtk-xft-dpi"),
+                                FALSE);
+    }
+
+  priv->display_settings_frozen++;
+}
+
+void
+gtk_settings_thaw_display_settings (GtkSettings *settings)
+{
+  GtkSettingsPrivate *priv = settings->priv;
+
+  g_return_if_fail (priv->display_settings_frozen > 0);
+
+  priv->display_settings_frozen--;
+}
@@ -223,6 +223,46 @@ gtk_style_cascade_lookup (GtkStyleProvider    *provider,
   gtk_style_cascade_iter_clear (&iter);
 }
 
+static GtkCssChange
+gtk_style_cascade_get_class_change (GtkStyleProvider *provider,
+                                    GQuark            style_class)
+{
+  GtkStyleCascade *cascade = GTK_STYLE_CASCADE (provider);
+  GtkStyleCascadeIter iter;
+  GtkStyleProvider *item;
+  GtkCssChange change = 0;
+
+  for (item = gtk_style_cascade_iter_init (cascade, &iter);
+       item;
+       item = gtk_style_cascade_iter_next (cascade, &iter))
+    {
+      change |= gtk_style_provider_get_class_change (item, style_class);
+    }
+  gtk_style_cascade_iter_clear (&iter);
+
+  return change;
+}
+
+static GtkCssChange
+gtk_style_cascade_get_state_change (GtkStyleProvider *provider,
+                                    GtkStateFlags     state)
+{
+  GtkStyleCascade *cascade = GTK_STYLE_CASCADE (provider);
+  GtkStyleCascadeIter iter;
+  GtkStyleProvider *item;
+  GtkCssChange change = 0;
+
+  for (item = gtk_style_cascade_iter_init (cascade, &iter);
+       item;
+       item = gtk_style_cascade_iter_next (cascade, &iter))
+    {
+      change |= gtk_style_provider_get_state_change (item, state);
+    }
+  gtk_style_cascade_iter_clear (&iter);
+
+  return change;
+}
+
 static void
 gtk_style_cascade_provider_iface_init (GtkStyleProviderInterface *iface)
 {
@@ -231,6 +271,8 @@ gtk_style_cascade_provider_iface_init (GtkStyleProviderInterface *iface)
   iface->get_scale = gtk_style_cascade_get_scale;
   iface->get_keyframes = gtk_style_cascade_get_keyframes;
   iface->lookup = gtk_style_cascade_lookup;
+  iface->get_class_change = gtk_style_cascade_get_class_change;
+  iface->get_state_change = gtk_style_cascade_get_state_change;
 }
 
 G_DEFINE_TYPE_EXTENDED (GtkStyleCascade, _gtk_style_cascade, G_TYPE_OBJECT, 0,
@@ -19,6 +19,7 @@
 
 #include "gtkstyleproviderprivate.h"
 
+#include "gtkcsssection.h"
 #include "gtkintl.h"
 #include "gtkprivate.h"
 #include "gtkwidgetpath.h"
@@ -42,6 +43,15 @@ G_DEFINE_INTERFACE (GtkStyleProvider, gtk_style_provider, G_TYPE_OBJECT)
 
 static guint signals[LAST_SIGNAL];
 
+typedef struct {
+  GtkStyleProvider *provider;
+  GtkCssSection *section;
+  GError *error;
+} DeferredError;
+
+/* Where errors emitted from the current thread are collected */
+static GPrivate deferred_errors;
+
 static void
 gtk_style_provider_default_init (GtkStyleProviderInterface *iface)
 {
@@ -115,6 +125,47 @@ gtk_style_provider_lookup (GtkStyleProvider    *provider,
   iface->lookup (provider, matcher, lookup, out_change);
 }
 
+/* Returns which nodes relative to a node may change their style when
+ * @style_class is added to or removed from it, see
+ * gtk_css_invalidations_get_class_change() */
+GtkCssChange
+gtk_style_provider_get_class_change (GtkStyleProvider *provider,
+                                     GQuark            style_class)
+{
+  GtkStyleProviderInterface *iface;
+
+  gtk_internal_return_val_if_fail (GTK_IS_STYLE_PROVIDER (provider), 0);
+
+  iface = GTK_STYLE_PROVIDER_GET_INTERFACE (provider);
+
+  /* Providers that can't tell may match anything */
+  if (!iface->get_class_change)
+    return iface->lookup ? GTK_CSS_CHANGE_CLASS | GTK_CSS_CHANGE_SIBLING_CLASS |
+                           GTK_CSS_CHANGE_PARENT_CLASS | GTK_CSS_CHANGE_PARENT_SIBLING_CLASS
+                         : 0;
+
+  return iface->get_class_change (provider, style_class);
+}
+
+/* Like gtk_style_provider_get_class_change() for the flags in @state */
+GtkCssChange
+gtk_style_provider_get_state_change (GtkStyleProvider *provider,
+                                     GtkStateFlags     state)
+{
+  GtkStyleProviderInterface *iface;
+
+  gtk_internal_return_val_if_fail (GTK_IS_STYLE_PROVIDER (provider), 0);
+
+  iface = GTK_STYLE_PROVIDER_GET_INTERFACE (provider);
+
+  if (!iface->get_state_change)
+    return iface->lookup ? GTK_CSS_CHANGE_STATE | GTK_CSS_CHANGE_SIBLING_STATE |
+                           GTK_CSS_CHANGE_PARENT_STATE | GTK_CSS_CHANGE_PARENT_SIBLING_STATE
+                         : 0;
+
+  return iface->get_state_change (provider, state);
+}
+
 void
 gtk_style_provider_changed (GtkStyleProvider *provider)
 {
@@ -153,12 +204,79 @@ gtk_style_provider_get_scale (GtkStyleProvider *provider)
   return iface->get_scale (provider);
 }
 
+static void
+deferred_error_free (gpointer data)
+{
+  DeferredError *deferred = data;
+
+  g_object_unref (deferred->provider);
+  if (deferred->section)
+    gtk_css_section_unref (deferred->section);
+  g_error_free (deferred->error);
+
+  g_slice_free (DeferredError, deferred);
+}
+
+/*
+ * gtk_style_provider_defer_errors:
+ * @errors: (nullable): location of a #GPtrArray or %NULL
+ *
+ * Makes gtk_style_provider_emit_error() collect the errors of the
+ * current thread in the array at @errors instead of emitting them,
+ * creating the array as needed. This is used when computing styles
+ * from other threads, as the error handlers have to run on the main
+ * thread. Pass %NULL to emit errors again.
+ */
+void
+gtk_style_provider_defer_errors (GPtrArray **errors)
+{
+  g_private_set (&deferred_errors, errors);
+}
+
+/*
+ * gtk_style_provider_emit_deferred_errors:
+ * @errors: (nullable): errors collected by gtk_style_provider_defer_errors()
+ *
+ * Emits the errors in @errors in the order they happened.
+ */
+void
+gtk_style_provider_emit_deferred_errors (GPtrArray *errors)
+{
+  guint i;
+
+  if (errors == NULL)
+    return;
+
+  for (i = 0; i < errors->len; i++)
+    {
+      DeferredError *deferred = g_ptr_array_index (errors, i);
+
+      gtk_style_provider_emit_error (deferred->provider, deferred->section, deferred->error);
+    }
+}
+
 void
 gtk_style_provider_emit_error (GtkStyleProvider *provider,
                                GtkCssSection    *section,
                                GError           *error)
 {
   GtkStyleProviderInterface *iface;
+  GPtrArray **errors;
+
+  errors = g_private_get (&deferred_errors);
+  if (errors)
+    {
+      DeferredError *deferred = g_slice_new (DeferredError);
+
+      deferred->provider = g_object_ref (provider);
+      deferred->section = section ? gtk_css_section_ref (section) : NULL;
+      deferred->error = g_error_copy (error);
+
+      if (*errors == NULL)
+        *errors = g_ptr_array_new_with_free_func (deferred_error_free);
+      g_ptr_array_add (*errors, deferred);
+      return;
+    }
 
   iface = GTK_STYLE_PROVIDER_GET_INTERFACE (provider);
 
@@ -48,6 +48,10 @@ struct _GtkStyleProviderInterface
   void                  (* emit_error)          (GtkStyleProvider *provider,
                                                  GtkCssSection           *section,
                                                  const GError            *error);
+  GtkCssChange          (* get_class_change)    (GtkStyleProvider *provider,
+                                                 GQuark                   style_class);
+  GtkCssChange          (* get_state_change)    (GtkStyleProvider *provider,
+                                                 GtkStateFlags            state);
   /* signal */
   void                  (* changed)             (GtkStyleProvider *provider);
 };
@@ -62,12 +66,18 @@ void                    gtk_style_provider_lookup                (GtkStyleProvid
                                                                   const GtkCssMatcher     *matcher,
                                                                   GtkCssLookup            *lookup,
                                                                   GtkCssChange            *out_change);
+GtkCssChange            gtk_style_provider_get_class_change      (GtkStyleProvider *provider,
+                                                                  GQuark                   style_class);
+GtkCssChange            gtk_style_provider_get_state_change      (GtkStyleProvider *provider,
+                                                                  GtkStateFlags            state);
 
 void                    gtk_style_provider_changed               (GtkStyleProvider *provider);
 
 void                    gtk_style_provider_emit_error            (GtkStyleProvider *provider,
                                                                   GtkCssSection           *section,
                                                                   GError                  *error);
+void                    gtk_style_provider_defer_errors          (GPtrArray              **errors);
+void                    gtk_style_provider_emit_deferred_errors  (GPtrArray               *errors);
 
 G_END_DECLS
 
@@ -763,18 +763,22 @@ render_node_save_response (GtkWidget     *dialog,
 
   if (response == GTK_RESPONSE_ACCEPT)
     {
-      GBytes *bytes = gsk_render_node_serialize (node);
+      GFile *file = gtk_file_chooser_get_file (GTK_FILE_CHOOSER (dialog));
+      GFileOutputStream *stream;
       GError *error = NULL;
 
-      if (!g_file_replace_contents (gtk_file_chooser_get_file (GTK_FILE_CHOOSER (dialog)),
-                                    g_bytes_get_data (bytes, NULL),
-                                    g_bytes_get_size (bytes),
-                                    NULL,
-                                    FALSE,
-                                    0,
-                                    NULL,
-                                    NULL,
-                                    &error))
+      /* Recordings can be large, so stream them instead of
+       * serializing them to memory first */
+      stream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, &error);
+      if (stream != NULL)
+        {
+          if (gsk_render_node_serialize_to_stream (node, G_OUTPUT_STREAM (stream), NULL, &error))
+            g_output_stream_close (G_OUTPUT_STREAM (stream), NULL, &error);
+          g_object_unref (stream);
+        }
+      g_object_unref (file);
+
+      if (error != NULL)
         {
           GtkWidget *message_dialog;
 
@@ -789,8 +793,6 @@ render_node_save_response (GtkWidget     *dialog,
           gtk_widget_show (message_dialog);
           g_error_free (error);
         }
-
-      g_bytes_unref (bytes);
     }
 
   gtk_widget_destroy (dialog);
@@ -16,6 +16,43 @@ init_surface (cairo_t *cr)
   cairo_fill (cr);
 }
 
+static double
+time_blur (cairo_t  *cr,
+           GTimer   *timer,
+           int       radius,
+           gboolean  accelerated)
+{
+  init_surface (cr);
+  gsk_cairo_blur_set_accelerated (accelerated);
+  g_timer_start (timer);
+  gsk_cairo_blur_surface (cairo_get_target (cr), radius, GSK_BLUR_X | GSK_BLUR_Y);
+
+  return g_timer_elapsed (timer, NULL) * 1000;
+}
+
+/* Compares the original scalar kernels with the accelerated ones */
+static void
+compare_kernels (cairo_t *cr,
+                 GTimer  *timer,
+                 int      size)
+{
+  double megapixels = size * size / 1000000.0;
+  double old_msec, new_msec;
+  int i, j;
+
+  for (j = 0; j < 2; j++)
+    {
+      for (i = 1; i < 16; i++)
+        {
+          old_msec = time_blur (cr, timer, i, FALSE);
+          new_msec = time_blur (cr, timer, i, TRUE);
+          if (j == 1)
+            g_print ("Radius %2d: old %.2f msec/Mpixel, new %.2f msec/Mpixel, %.2fx\n",
+                     i, old_msec / megapixels, new_msec / megapixels, old_msec / new_msec);
+        }
+    }
+}
+
 int
 main (int argc, char **argv)
 {
@@ -34,6 +71,13 @@ main (int argc, char **argv)
 
   cr = cairo_create (surface);
 
+  if (argc > 1 && g_str_equal (argv[1], "--compare"))
+    {
+      compare_kernels (cr, timer, size);
+      g_timer_destroy (timer);
+      return 0;
+    }
+
   /* We do everything three times, first two as warmup */
   for (j = 0; j < 2; j++)
     {
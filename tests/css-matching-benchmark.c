@@ -0,0 +1,199 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil; -*- */
+
+/* Builds a deep tree of widgets, restyles all of it every frame and
+ * prints how long the layout phase takes, which is where the styles
+ * are matched and computed. The theme is Adwaita unless another one
+ * is given, so the selectors are what applications run with.
+ */
+
+#include <gtk/gtk.h>
+
+static int frames = 200;
+static int depth = 40;
+static int width = 4;
+static char *theme = NULL;
+
+static GOptionEntry options[] = {
+  { "frames", 'f', 0, G_OPTION_ARG_INT, &frames, "Number of frames to restyle", "N" },
+  { "depth", 'd', 0, G_OPTION_ARG_INT, &depth, "Nesting depth of the widget tree", "N" },
+  { "width", 'w', 0, G_OPTION_ARG_INT, &width, "Number of leaf widgets per level", "N" },
+  { "theme", 't', 0, G_OPTION_ARG_STRING, &theme, "Theme to use", "THEME" },
+  { NULL }
+};
+
+static GtkCssProvider *provider;
+static GArray *layout_times;
+static gint64 layout_start;
+static int frame;
+
+static GtkWidget *
+create_leaf (int level,
+             int n)
+{
+  GtkWidget *widget;
+  char *text;
+
+  text = g_strdup_printf ("Level %d, widget %d", level, n);
+
+  switch (n % 4)
+    {
+    case 0:
+      widget = gtk_label_new (text);
+      break;
+    case 1:
+      widget = gtk_button_new_with_label (text);
+      break;
+    case 2:
+      widget = gtk_entry_new ();
+      gtk_entry_set_text (GTK_ENTRY (widget), text);
+      break;
+    default:
+      widget = gtk_check_button_new_with_label (text);
+      break;
+    }
+
+  if (n % 3 == 0)
+    gtk_style_context_add_class (gtk_widget_get_style_context (widget), "dim-label");
+
+  g_free (text);
+
+  return widget;
+}
+
+static GtkWidget *
+create_tree (void)
+{
+  GtkWidget *root, *box, *child;
+  int level, n;
+
+  root = box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+
+  for (level = 0; level < depth; level++)
+    {
+      for (n = 0; n < width; n++)
+        gtk_container_add (GTK_CONTAINER (box), create_leaf (level, n));
+
+      child = gtk_box_new (level % 2 ? GTK_ORIENTATION_VERTICAL : GTK_ORIENTATION_HORIZONTAL, 0);
+      if (level % 5 == 0)
+        gtk_style_context_add_class (gtk_widget_get_style_context (child), "linked");
+      if (level % 7 == 0)
+        gtk_style_context_add_class (gtk_widget_get_style_context (child), "view");
+      gtk_container_add (GTK_CONTAINER (box), child);
+      box = child;
+    }
+
+  return root;
+}
+
+/* Changing a style provider makes all styles get recomputed */
+static gboolean
+restyle (GtkWidget     *widget,
+         GdkFrameClock *frame_clock,
+         gpointer       user_data)
+{
+  gtk_css_provider_load_from_data (provider,
+                                   frame % 2 ? "label.benchmark { }" : "",
+                                   -1);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+update_done (GdkFrameClock *frame_clock)
+{
+  layout_start = g_get_monotonic_time ();
+}
+
+static void
+layout_done (GdkFrameClock *frame_clock)
+{
+  gint64 elapsed;
+
+  elapsed = g_get_monotonic_time () - layout_start;
+
+  /* The first frame creates all the styles */
+  if (frame > 0 && frame <= frames)
+    g_array_append_val (layout_times, elapsed);
+
+  frame++;
+  if (frame == frames + 1)
+    gtk_main_quit ();
+}
+
+static int
+compare_int64 (gconstpointer a,
+               gconstpointer b)
+{
+  gint64 va = *(const gint64 *) a;
+  gint64 vb = *(const gint64 *) b;
+
+  return va < vb ? -1 : (va > vb ? 1 : 0);
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *context;
+  GError *error = NULL;
+  GtkWidget *window, *scrolled_window;
+  GdkFrameClock *frame_clock;
+  gint64 sum = 0;
+  guint i;
+
+  context = g_option_context_new ("");
+  g_option_context_add_main_entries (context, options, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("Option parsing failed: %s\n", error->message);
+      return 1;
+    }
+
+  if (frames < 1 || depth < 1 || width < 0)
+    {
+      g_printerr ("Need at least 1 frame and a depth of at least 1.\n");
+      return 1;
+    }
+
+  gtk_init ();
+
+  if (theme)
+    g_object_set (gtk_settings_get_default (), "gtk-theme-name", theme, NULL);
+
+  provider = gtk_css_provider_new ();
+  gtk_style_context_add_provider_for_display (gdk_display_get_default (),
+                                              GTK_STYLE_PROVIDER (provider),
+                                              GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+
+  layout_times = g_array_new (FALSE, FALSE, sizeof (gint64));
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  gtk_window_set_default_size (GTK_WINDOW (window), 800, 600);
+  scrolled_window = gtk_scrolled_window_new (NULL, NULL);
+  gtk_container_add (GTK_CONTAINER (window), scrolled_window);
+  gtk_container_add (GTK_CONTAINER (scrolled_window), create_tree ());
+
+  gtk_widget_realize (window);
+  frame_clock = gtk_widget_get_frame_clock (window);
+  g_signal_connect_after (frame_clock, "update", G_CALLBACK (update_done), NULL);
+  g_signal_connect_after (frame_clock, "layout", G_CALLBACK (layout_done), NULL);
+  gtk_widget_add_tick_callback (window, restyle, NULL, NULL);
+
+  gtk_widget_show (window);
+  gtk_main ();
+
+  g_array_sort (layout_times, compare_int64);
+  for (i = 0; i < layout_times->len; i++)
+    sum += g_array_index (layout_times, gint64, i);
+
+  g_print ("Widgets: %d levels with %d leaves each\n", depth, width);
+  g_print ("Restyled frames: %u\n", layout_times->len);
+  g_print ("Layout phase: %.2f ms median, %.2f ms on average\n",
+           g_array_index (layout_times, gint64, layout_times->len / 2) / 1000.0,
+           sum / 1000.0 / layout_times->len);
+
+  gtk_widget_destroy (window);
+  g_array_unref (layout_times);
+  g_object_unref (provider);
+
+  return 0;
+}
@@ -0,0 +1,234 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil; -*- */
+
+/* Lays out a large paragraph and renders it repeatedly with the GL
+ * renderer while scrolling it by fractional pixel amounts, reporting the
+ * hit rate of the renderer's glyph cache and the frame times.
+ *
+ * The hit rate is read from the profiler counters of the renderer, so
+ * it is only available when GTK was built with debugging.
+ */
+
+#include <gsk/gsk.h>
+#include <gsk/gskrendererprivate.h>
+#include <pango/pangocairo.h>
+
+static const char *lorem =
+  "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod "
+  "tempor incididunt ut labore et dolore magna aliqua. Ut enim ad minim veniam, "
+  "quis nostrud exercitation ullamco laboris nisi ut aliquip ex ea commodo "
+  "consequat. Duis aute irure dolor in reprehenderit in voluptate velit esse "
+  "cillum dolore eu fugiat nulla pariatur. Excepteur sint occaecat cupidatat "
+  "non proident, sunt in culpa qui officia deserunt mollit anim id est laborum. ";
+
+static int frames = 100;
+static int paragraphs = 40;
+static int width = 800;
+static double scroll_step = 0.3;
+static char *font = NULL;
+static double min_hit_rate = 0;
+
+static GOptionEntry options[] = {
+  { "frames", 'f', 0, G_OPTION_ARG_INT, &frames, "Number of frames to render", "N" },
+  { "paragraphs", 'p', 0, G_OPTION_ARG_INT, &paragraphs, "Number of paragraphs of text", "N" },
+  { "width", 'w', 0, G_OPTION_ARG_INT, &width, "Width of the text", "PIXELS" },
+  { "scroll-step", 's', 0, G_OPTION_ARG_DOUBLE, &scroll_step, "Horizontal scroll per frame", "PIXELS" },
+  { "font", 0, 0, G_OPTION_ARG_STRING, &font, "Font to use", "FONT" },
+  { "min-hit-rate", 0, 0, G_OPTION_ARG_DOUBLE, &min_hit_rate, "Fail if the hit rate is lower", "PERCENT" },
+  { NULL }
+};
+
+typedef struct {
+  PangoFont *font;
+  PangoGlyphString *glyphs;
+  double x, y;
+} Run;
+
+static GArray *
+layout_runs (PangoLayout *layout)
+{
+  GArray *runs = g_array_new (FALSE, FALSE, sizeof (Run));
+  PangoLayoutIter *iter;
+
+  iter = pango_layout_get_iter (layout);
+  do
+    {
+      PangoLayoutRun *run = pango_layout_iter_get_run_readonly (iter);
+      PangoRectangle logical;
+      Run r;
+
+      if (run == NULL)
+        continue;
+
+      pango_layout_iter_get_run_extents (iter, NULL, &logical);
+
+      r.font = run->item->analysis.font;
+      r.glyphs = run->glyphs;
+      r.x = (double) logical.x / PANGO_SCALE;
+      r.y = (double) pango_layout_iter_get_baseline (iter) / PANGO_SCALE;
+      g_array_append_val (runs, r);
+    }
+  while (pango_layout_iter_next_run (iter));
+  pango_layout_iter_free (iter);
+
+  return runs;
+}
+
+static GskRenderNode *
+create_node (GArray *runs,
+             double  offset)
+{
+  GdkRGBA black = { 0, 0, 0, 1 };
+  GskRenderNode **children;
+  GskRenderNode *container, *node;
+  guint i, n;
+
+  children = g_new (GskRenderNode *, runs->len);
+  for (i = 0, n = 0; i < runs->len; i++)
+    {
+      const Run *r = &g_array_index (runs, Run, i);
+
+      children[n] = gsk_text_node_new (r->font, r->glyphs, &black, r->x, r->y);
+      if (children[n] != NULL)
+        n++;
+    }
+
+  container = gsk_container_node_new (children, n);
+  for (i = 0; i < n; i++)
+    gsk_render_node_unref (children[i]);
+  g_free (children);
+
+  node = gsk_offset_node_new (container, offset, 0);
+  gsk_render_node_unref (container);
+
+  return node;
+}
+
+static gint64
+get_counter (GskRenderer *renderer,
+             const char  *name)
+{
+  GQuark id = g_quark_try_string (name);
+
+  if (id == 0)
+    return 0;
+
+  return gsk_profiler_counter_get (gsk_renderer_get_profiler (renderer), id);
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *context;
+  GError *error = NULL;
+  PangoContext *pango_context;
+  PangoLayout *layout;
+  PangoFontDescription *desc;
+  GString *text;
+  GArray *runs;
+  GdkSurface *surface;
+  GskRenderer *renderer;
+  gint64 hits, misses;
+  double hit_rate = 0;
+  gint64 start, first_frame = 0, rest = 0;
+  int i;
+
+  context = g_option_context_new ("");
+  g_option_context_add_main_entries (context, options, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("Option parsing failed: %s\n", error->message);
+      return 1;
+    }
+
+  if (gdk_display_open (NULL) == NULL)
+    {
+      g_printerr ("Could not open display.\n");
+      return 1;
+    }
+
+  text = g_string_new (NULL);
+  for (i = 0; i < paragraphs; i++)
+    {
+      g_string_append (text, lorem);
+      if (i % 4 == 3)
+        g_string_append_c (text, '\n');
+    }
+
+  pango_context = pango_font_map_create_context (pango_cairo_font_map_get_default ());
+  layout = pango_layout_new (pango_context);
+  desc = pango_font_description_from_string (font ? font : "Cantarell 11");
+  pango_layout_set_font_description (layout, desc);
+  pango_layout_set_width (layout, width * PANGO_SCALE);
+  pango_layout_set_text (layout, text->str, text->len);
+  runs = layout_runs (layout);
+
+  g_setenv ("GSK_RENDERER", "opengl", TRUE);
+  surface = gdk_surface_new_toplevel (gdk_display_get_default (), 10, 10);
+  renderer = gsk_renderer_new_for_surface (surface);
+
+  /* GskRenderer falls back to other renderers if GL can't be used */
+  if (renderer == NULL || g_strcmp0 (G_OBJECT_TYPE_NAME (renderer), "GskGLRenderer") != 0)
+    {
+      g_printerr ("The GL renderer is not available.\n");
+      return 1;
+    }
+
+  for (i = 0; i < frames; i++)
+    {
+      double offset = i * scroll_step;
+      GskRenderNode *node;
+      GdkTexture *texture;
+      gint64 elapsed;
+
+      node = create_node (runs, offset);
+      start = g_get_monotonic_time ();
+      texture = gsk_renderer_render_texture (renderer, node, NULL);
+      elapsed = g_get_monotonic_time () - start;
+
+      if (i == 0)
+        first_frame = elapsed;
+      else
+        rest += elapsed;
+
+      g_object_unref (texture);
+      gsk_render_node_unref (node);
+    }
+
+  /* The counters add up over all frames */
+  hits = get_counter (renderer, "glyph-cache-hits");
+  misses = get_counter (renderer, "glyph-cache-misses");
+
+  if (hits + misses > 0)
+    {
+      hit_rate = 100.0 * hits / (hits + misses);
+      g_print ("Glyphs per frame: %" G_GINT64_FORMAT "\n", (hits + misses) / MAX (frames, 1));
+      g_print ("Cache entries: %" G_GINT64_FORMAT "\n", misses);
+      g_print ("Hit rate: %.2f%%\n", hit_rate);
+    }
+  else
+    {
+      g_print ("No glyph cache counters, GTK was built without debugging\n");
+    }
+
+  g_print ("First frame: %.2f ms\n", first_frame / 1000.0);
+  if (frames > 1)
+    g_print ("Other frames: %.2f ms on average\n", rest / 1000.0 / (frames - 1));
+
+  g_array_unref (runs);
+  g_object_unref (layout);
+  g_object_unref (pango_context);
+  pango_font_description_free (desc);
+  g_string_free (text, TRUE);
+
+  gsk_renderer_unrealize (renderer);
+  g_object_unref (renderer);
+  g_object_unref (surface);
+
+  if (hits + misses > 0 && hit_rate < min_hit_rate)
+    {
+      g_printerr ("Hit rate is below %.2f%%\n", min_hit_rate);
+      return 1;
+    }
+
+  return 0;
+}
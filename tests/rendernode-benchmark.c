@@ -0,0 +1,376 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil; -*- */
+
+/* Renders a serialized render node offscreen with each of the given
+ * renderers and prints frame time statistics and the renderers'
+ * profiler counters as JSON, for tracking performance regressions.
+ *
+ * Counters are only available when GTK was built with debugging.
+ */
+
+#include <gsk/gsk.h>
+#include <gsk/gskrendererprivate.h>
+#include <math.h>
+
+static int runs = 100;
+static int warmup = 5;
+static char **renderers = NULL;
+static char *output = NULL;
+
+static GOptionEntry options[] = {
+  { "runs", 'r', 0, G_OPTION_ARG_INT, &runs, "Render the node N times per renderer", "N" },
+  { "warmup", 'w', 0, G_OPTION_ARG_INT, &warmup, "Render the node N times before measuring", "N" },
+  { "renderer", 0, 0, G_OPTION_ARG_STRING_ARRAY, &renderers, "Renderer to use, can be repeated (default: cairo, opengl, vulkan)", "RENDERER" },
+  { "output", 'o', 0, G_OPTION_ARG_FILENAME, &output, "Write the JSON to FILE instead of stdout", "FILE" },
+  { NULL }
+};
+
+static const struct {
+  const char *name;
+  const char *type_name;
+} known_renderers[] = {
+  { "cairo", "GskCairoRenderer" },
+  { "opengl", "GskGLRenderer" },
+  { "vulkan", "GskVulkanRenderer" },
+};
+
+/* name => GArray of gint64, one value per run */
+typedef GHashTable Samples;
+
+static Samples *
+samples_new (void)
+{
+  return g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_array_unref);
+}
+
+static void
+samples_add (const char *name,
+             const char *description,
+             gint64      value,
+             gpointer    user_data)
+{
+  Samples *samples = user_data;
+  GArray *values;
+
+  values = g_hash_table_lookup (samples, name);
+  if (values == NULL)
+    {
+      values = g_array_new (FALSE, FALSE, sizeof (gint64));
+      g_hash_table_insert (samples, g_strdup (name), values);
+    }
+
+  g_array_append_val (values, value);
+}
+
+/* Counters add up over frames, turn their values after every frame
+ * into the amount they changed by in that frame */
+static void
+samples_to_deltas (Samples *samples)
+{
+  GHashTableIter iter;
+  gpointer value_p = NULL;
+  guint i;
+
+  g_hash_table_iter_init (&iter, samples);
+  while (g_hash_table_iter_next (&iter, NULL, &value_p))
+    {
+      GArray *values = value_p;
+
+      for (i = values->len; i-- > 1; )
+        g_array_index (values, gint64, i) -= g_array_index (values, gint64, i - 1);
+
+      if (values->len > 0)
+        g_array_remove_index (values, 0);
+    }
+}
+
+static int
+compare_int64 (gconstpointer a,
+               gconstpointer b)
+{
+  gint64 va = *(const gint64 *) a;
+  gint64 vb = *(const gint64 *) b;
+
+  return va < vb ? -1 : (va > vb ? 1 : 0);
+}
+
+/* Nearest rank percentile of sorted values */
+static gint64
+percentile (GArray *sorted,
+            double  p)
+{
+  guint rank;
+
+  rank = (guint) ceil (p * sorted->len);
+  rank = CLAMP (rank, 1, sorted->len);
+
+  return g_array_index (sorted, gint64, rank - 1);
+}
+
+static void
+append_statistics (GString *json,
+                   GArray  *values)
+{
+  GArray *sorted;
+  double sum = 0;
+  guint i;
+
+  if (values->len == 0)
+    {
+      g_string_append (json, "null");
+      return;
+    }
+
+  sorted = g_array_sized_new (FALSE, FALSE, sizeof (gint64), values->len);
+  g_array_append_vals (sorted, values->data, values->len);
+  g_array_sort (sorted, compare_int64);
+
+  for (i = 0; i < sorted->len; i++)
+    sum += g_array_index (sorted, gint64, i);
+
+  g_string_append_printf (json,
+                          "{ \"min\": %" G_GINT64_FORMAT
+                          ", \"median\": %" G_GINT64_FORMAT
+                          ", \"p99\": %" G_GINT64_FORMAT
+                          ", \"max\": %" G_GINT64_FORMAT
+                          ", \"mean\": %.1f }",
+                          g_array_index (sorted, gint64, 0),
+                          percentile (sorted, 0.5),
+                          percentile (sorted, 0.99),
+                          g_array_index (sorted, gint64, sorted->len - 1),
+                          sum / sorted->len);
+
+  g_array_unref (sorted);
+}
+
+static void
+append_string (GString    *json,
+               const char *s)
+{
+  g_string_append_c (json, '"');
+  for (; *s; s++)
+    {
+      if (*s == '"' || *s == '\\')
+        g_string_append_printf (json, "\\%c", *s);
+      else if ((guchar) *s < 0x20)
+        g_string_append_printf (json, "\\u%04x", (guint) *s);
+      else
+        g_string_append_c (json, *s);
+    }
+  g_string_append_c (json, '"');
+}
+
+static void
+append_samples (GString *json,
+                Samples *samples)
+{
+  GList *names, *l;
+  gboolean empty;
+
+  g_string_append (json, "{");
+
+  names = g_list_sort (g_hash_table_get_keys (samples), (GCompareFunc) strcmp);
+  empty = names == NULL;
+  for (l = names; l; l = l->next)
+    {
+      g_string_append (json, l == names ? "\n      " : ",\n      ");
+      append_string (json, l->data);
+      g_string_append (json, ": ");
+      append_statistics (json, g_hash_table_lookup (samples, l->data));
+    }
+  g_list_free (names);
+
+  g_string_append (json, empty ? "}" : "\n    }");
+}
+
+static void
+benchmark_renderer (GString       *json,
+                    const char    *name,
+                    GskRenderNode *node)
+{
+  const char *type_name = NULL;
+  GdkSurface *surface;
+  GskRenderer *renderer;
+  GArray *frame_times;
+  Samples *counters, *timers;
+  guint i;
+  int run;
+
+  for (i = 0; i < G_N_ELEMENTS (known_renderers); i++)
+    {
+      if (g_ascii_strcasecmp (name, known_renderers[i].name) == 0)
+        type_name = known_renderers[i].type_name;
+    }
+
+  g_string_append (json, "    {\n      \"name\": ");
+  append_string (json, name);
+
+  if (type_name == NULL)
+    {
+      g_string_append (json, ",\n      \"error\": \"unknown renderer\"\n    }");
+      return;
+    }
+
+  /* GskRenderer falls back to other renderers if the requested one
+   * can't be used, so check what we got */
+  g_setenv ("GSK_RENDERER", name, TRUE);
+  surface = gdk_surface_new_toplevel (gdk_display_get_default (), 10, 10);
+  renderer = gsk_renderer_new_for_surface (surface);
+
+  if (renderer == NULL || g_strcmp0 (G_OBJECT_TYPE_NAME (renderer), type_name) != 0)
+    {
+      g_string_append (json, ",\n      \"error\": \"not available\"\n    }");
+      if (renderer)
+        {
+          gsk_renderer_unrealize (renderer);
+          g_object_unref (renderer);
+        }
+      g_object_unref (surface);
+      return;
+    }
+
+  frame_times = g_array_new (FALSE, FALSE, sizeof (gint64));
+  counters = samples_new ();
+  timers = samples_new ();
+
+  for (run = -warmup; run < runs; run++)
+    {
+      GdkTexture *texture;
+      gint64 start, elapsed;
+
+      /* The values before the first measured frame */
+      if (run == 0)
+        gsk_profiler_foreach_counter (gsk_renderer_get_profiler (renderer), samples_add, counters);
+
+      start = g_get_monotonic_time ();
+      texture = gsk_renderer_render_texture (renderer, node, NULL);
+      elapsed = g_get_monotonic_time () - start;
+      g_object_unref (texture);
+
+      if (run < 0)
+        continue;
+
+      g_array_append_val (frame_times, elapsed);
+      gsk_profiler_foreach_counter (gsk_renderer_get_profiler (renderer), samples_add, counters);
+      gsk_profiler_foreach_timer (gsk_renderer_get_profiler (renderer), samples_add, timers);
+    }
+
+  samples_to_deltas (counters);
+
+  g_string_append (json, ",\n      \"type\": ");
+  append_string (json, type_name);
+  g_string_append (json, ",\n      \"frame_time_usec\": ");
+  append_statistics (json, frame_times);
+  g_string_append (json, ",\n      \"counters\": ");
+  append_samples (json, counters);
+  g_string_append (json, ",\n      \"timers\": ");
+  append_samples (json, timers);
+  g_string_append (json, "\n    }");
+
+  g_array_unref (frame_times);
+  g_hash_table_unref (counters);
+  g_hash_table_unref (timers);
+
+  gsk_renderer_unrealize (renderer);
+  g_object_unref (renderer);
+  g_object_unref (surface);
+}
+
+int
+main (int argc, char **argv)
+{
+  const char *default_renderers[] = { "cairo", "opengl", "vulkan", NULL };
+  const char * const *names;
+  GOptionContext *context;
+  GError *error = NULL;
+  GFileInputStream *stream;
+  GskRenderNode *node;
+  graphene_rect_t bounds;
+  GString *json;
+  GFile *file;
+  gint64 start, load_time;
+  int i;
+
+  context = g_option_context_new ("NODE-FILE");
+  g_option_context_add_main_entries (context, options, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("Option parsing failed: %s\n", error->message);
+      return 1;
+    }
+
+  if (argc != 2)
+    {
+      g_printerr ("Usage: %s [OPTIONS] NODE-FILE\n", argv[0]);
+      return 1;
+    }
+
+  if (runs < 1 || warmup < 0)
+    {
+      g_printerr ("Need at least 1 run and no negative number of warmup runs.\n");
+      return 1;
+    }
+
+  if (gdk_display_open (NULL) == NULL)
+    {
+      g_printerr ("Could not open display.\n");
+      return 1;
+    }
+
+  file = g_file_new_for_commandline_arg (argv[1]);
+  stream = g_file_read (file, NULL, &error);
+  g_object_unref (file);
+  if (stream == NULL)
+    {
+      g_printerr ("Could not open node file: %s\n", error->message);
+      return 1;
+    }
+
+  start = g_get_monotonic_time ();
+  node = gsk_render_node_deserialize_from_stream (G_INPUT_STREAM (stream), NULL, &error);
+  load_time = g_get_monotonic_time () - start;
+  g_object_unref (stream);
+
+  if (node == NULL)
+    {
+      g_printerr ("Invalid node file: %s\n", error->message);
+      return 1;
+    }
+
+  gsk_render_node_get_bounds (node, &bounds);
+
+  json = g_string_new ("{\n  \"file\": ");
+  append_string (json, argv[1]);
+  g_string_append_printf (json,
+                          ",\n  \"width\": %g,\n  \"height\": %g"
+                          ",\n  \"load_time_usec\": %" G_GINT64_FORMAT
+                          ",\n  \"runs\": %d,\n  \"warmup\": %d"
+                          ",\n  \"renderers\": [\n",
+                          bounds.size.width, bounds.size.height,
+                          load_time, runs, warmup);
+
+  names = renderers ? (const char * const *) renderers : default_renderers;
+  for (i = 0; names[i]; i++)
+    {
+      if (i > 0)
+        g_string_append (json, ",\n");
+      benchmark_renderer (json, names[i], node);
+    }
+
+  g_string_append (json, "\n  ]\n}\n");
+
+  if (output)
+    {
+      if (!g_file_set_contents (output, json->str, json->len, &error))
+        {
+          g_printerr ("Could not write %s: %s\n", output, error->message);
+          return 1;
+        }
+    }
+  else
+    g_print ("%s", json->str);
+
+  g_string_free (json, TRUE);
+  gsk_render_node_unref (node);
+
+  return 0;
+}
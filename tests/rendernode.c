@@ -54,7 +54,12 @@ main(int argc, char **argv)
     }
 
   bytes = g_bytes_new_take (contents, len);
-  if (dump_variant)
+  if (dump_variant && !g_str_has_prefix (contents, "GskRenderNode"))
+    {
+      /* Only files in the old format contain a GVariant */
+      g_printerr ("%s is not in the GVariant format\n", argv[1]);
+    }
+  else if (dump_variant)
     {
       GVariant *variant = g_variant_new_from_bytes (G_VARIANT_TYPE ("(suuv)"), bytes, FALSE);
       char *s;
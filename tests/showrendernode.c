@@ -113,9 +113,8 @@ main (int argc, char **argv)
 {
   GtkWidget *window;
   GtkWidget *nodeview;
-  char *contents;
-  gsize len;
-  GBytes *bytes;
+  GFile *file;
+  GFileInputStream *stream;
   graphene_rect_t node_bounds;
   GOptionContext *option_context;
   GError *error = NULL;
@@ -144,16 +143,17 @@ main (int argc, char **argv)
 
   gtk_window_set_decorated (GTK_WINDOW (window), FALSE);
 
-  g_file_get_contents (argv[1], &contents, &len, &error);
+  file = g_file_new_for_commandline_arg (argv[1]);
+  stream = g_file_read (file, NULL, &error);
+  g_object_unref (file);
   if (error)
     {
       g_warning ("%s", error->message);
       return -1;
     }
 
-  bytes = g_bytes_new_take (contents, len);
-  GTK_NODE_VIEW (nodeview)->node = gsk_render_node_deserialize (bytes, &error);
-  g_bytes_unref (bytes);
+  GTK_NODE_VIEW (nodeview)->node = gsk_render_node_deserialize_from_stream (G_INPUT_STREAM (stream), NULL, &error);
+  g_object_unref (stream);
 
   if (GTK_NODE_VIEW (nodeview)->node == NULL)
     {
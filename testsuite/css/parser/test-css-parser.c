@@ -161,6 +161,31 @@ parsing_error_cb (GtkCssProvider *provider,
   g_string_append_c (errors, '\n');
 }
 
+/* Images print their url, make those independent of where the tests are */
+static char *
+remove_directory_uri (char  *css,
+                      GFile *file)
+{
+  GFile *dir;
+  char *uri, *prefix, *result;
+  char **parts;
+
+  dir = g_file_get_parent (file);
+  uri = g_file_get_uri (dir);
+  prefix = g_strconcat (uri, "/", NULL);
+
+  parts = g_strsplit (css, prefix, -1);
+  result = g_strjoinv ("", parts);
+
+  g_strfreev (parts);
+  g_free (prefix);
+  g_free (uri);
+  g_object_unref (dir);
+  g_free (css);
+
+  return result;
+}
+
 static void
 parse_css_file (GFile *file, gboolean generate)
 {
@@ -181,6 +206,7 @@ parse_css_file (GFile *file, gboolean generate)
   gtk_css_provider_load_from_path (provider, css_file);
 
   css = gtk_css_provider_to_string (provider);
+  css = remove_directory_uri (css, file);
 
   if (generate)
     {
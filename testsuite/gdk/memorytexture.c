@@ -1,8 +1,12 @@
+/* Downloading parts of a texture is private API, so this links the
+ * internal gdk library. */
+
 #include <locale.h>
 #include <gdk/gdk.h>
+#include <gdk/gdktextureprivate.h>
 
 /* maximum bytes per pixel */
-#define MAX_BPP 4
+#define MAX_BPP 16
 
 typedef enum {
   BLUE,
@@ -43,8 +47,110 @@ static MemoryData tests[GDK_MEMORY_N_FORMATS] = {
   { 4, FALSE, { RGBA(FF,FF,00,00), RGBA(FF,00,FF,00), RGBA(FF,00,00,FF), RGBA(00,00,00,00), RGBA(AA,99,33,66) } },
   { 3, TRUE,  { RGBA(00,00,FF,00), RGBA(00,FF,00,00), RGBA(FF,00,00,00), RGBA(00,00,00,00), RGBA(44,22,66,00) } },
   { 3, TRUE,  { RGBA(FF,00,00,00), RGBA(00,FF,00,00), RGBA(00,00,FF,00), RGBA(00,00,00,00), RGBA(66,22,44,00) } },
+  /* The high bit depth formats are filled in by init_wide_formats() */
 };
 
+/* Only handles the values in [0, 1] we need */
+static guint16
+float_to_half (float f)
+{
+  union { float f; guint32 i; } u = { f };
+  int exponent;
+  guint32 mantissa;
+
+  if (f == 0.0f)
+    return 0;
+
+  exponent = (int) ((u.i >> 23) & 0xFF) - 127 + 15;
+  mantissa = u.i & 0x7FFFFF;
+
+  if (exponent <= 0)
+    return (mantissa | 0x800000) >> (14 - exponent);
+
+  /* A carry out of the mantissa correctly bumps the exponent */
+  return (exponent << 10) + ((mantissa + 0x1000) >> 13);
+}
+
+static void
+encode_pixel (GdkMemoryFormat  format,
+              const guchar    *bgra,
+              guchar          *dest)
+{
+  float c[4];
+  int i, n_channels;
+
+  c[0] = bgra[2] / 255.f;
+  c[1] = bgra[1] / 255.f;
+  c[2] = bgra[0] / 255.f;
+  c[3] = bgra[3] / 255.f;
+
+  switch (format)
+    {
+    case GDK_MEMORY_R16G16B16:
+    case GDK_MEMORY_R16G16B16A16_PREMULTIPLIED:
+    case GDK_MEMORY_R16G16B16A16:
+      n_channels = format == GDK_MEMORY_R16G16B16 ? 3 : 4;
+      for (i = 0; i < n_channels; i++)
+        ((guint16 *) dest)[i] = bgra[i < 3 ? 2 - i : 3] * 257;
+      break;
+
+    case GDK_MEMORY_R16G16B16_FLOAT:
+    case GDK_MEMORY_R16G16B16A16_FLOAT_PREMULTIPLIED:
+    case GDK_MEMORY_R16G16B16A16_FLOAT:
+      n_channels = format == GDK_MEMORY_R16G16B16_FLOAT ? 3 : 4;
+      for (i = 0; i < n_channels; i++)
+        ((guint16 *) dest)[i] = float_to_half (c[i]);
+      break;
+
+    case GDK_MEMORY_R32G32B32_FLOAT:
+    case GDK_MEMORY_R32G32B32A32_FLOAT_PREMULTIPLIED:
+    case GDK_MEMORY_R32G32B32A32_FLOAT:
+      n_channels = format == GDK_MEMORY_R32G32B32_FLOAT ? 3 : 4;
+      memcpy (dest, c, n_channels * sizeof (float));
+      break;
+
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+/* Encodes the premultiplied colors for premultiplied and opaque formats
+ * and the straight ones for the others */
+static void
+init_wide_formats (void)
+{
+  static const struct {
+    GdkMemoryFormat format;
+    gsize bytes_per_pixel;
+    gboolean opaque;
+    gboolean premultiplied;
+  } formats[] = {
+    { GDK_MEMORY_R16G16B16, 6, TRUE, TRUE },
+    { GDK_MEMORY_R16G16B16A16_PREMULTIPLIED, 8, FALSE, TRUE },
+    { GDK_MEMORY_R16G16B16A16, 8, FALSE, FALSE },
+    { GDK_MEMORY_R16G16B16_FLOAT, 6, TRUE, TRUE },
+    { GDK_MEMORY_R16G16B16A16_FLOAT_PREMULTIPLIED, 8, FALSE, TRUE },
+    { GDK_MEMORY_R16G16B16A16_FLOAT, 8, FALSE, FALSE },
+    { GDK_MEMORY_R32G32B32_FLOAT, 12, TRUE, TRUE },
+    { GDK_MEMORY_R32G32B32A32_FLOAT_PREMULTIPLIED, 16, FALSE, TRUE },
+    { GDK_MEMORY_R32G32B32A32_FLOAT, 16, FALSE, FALSE },
+  };
+  Color color;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (formats); i++)
+    {
+      MemoryData *data = &tests[formats[i].format];
+      const MemoryData *source = &tests[formats[i].premultiplied ? GDK_MEMORY_B8G8R8A8_PREMULTIPLIED
+                                                                  : GDK_MEMORY_B8G8R8A8];
+
+      data->bytes_per_pixel = formats[i].bytes_per_pixel;
+      data->opaque = formats[i].opaque;
+      for (color = 0; color < N_COLORS; color++)
+        encode_pixel (formats[i].format, source->data[color], data->data[color]);
+    }
+}
+
 static void
 compare_textures (GdkTexture *expected,
                   GdkTexture *test,
@@ -172,6 +278,206 @@ test_download_4x4_with_stride (gconstpointer data)
   g_object_unref (test);
 }
 
+static GdkTexture *
+create_yuv_texture (GdkMemoryFormat  format,
+                    int              width,
+                    int              height,
+                    guchar           y,
+                    guchar           u,
+                    guchar           v)
+{
+  GdkTexture *texture;
+  GBytes *bytes;
+  gsize stride, chroma_height, size;
+  guchar *data;
+
+  /* An odd stride to check that plane offsets follow from it */
+  stride = width + 1;
+  chroma_height = (height + 1) / 2;
+
+  if (format == GDK_MEMORY_NV12)
+    {
+      gsize i;
+
+      size = stride * (height + chroma_height);
+      data = g_malloc (size);
+      memset (data, y, stride * height);
+      for (i = stride * height; i + 1 < size; i += 2)
+        {
+          data[i] = u;
+          data[i + 1] = v;
+        }
+    }
+  else
+    {
+      gsize chroma_size = (stride + 1) / 2 * chroma_height;
+
+      size = stride * height + 2 * chroma_size;
+      data = g_malloc (size);
+      memset (data, y, stride * height);
+      memset (data + stride * height, u, chroma_size);
+      memset (data + stride * height + chroma_size, v, chroma_size);
+    }
+
+  bytes = g_bytes_new_take (data, size);
+  texture = gdk_memory_texture_new (width, height, format, bytes, stride);
+  g_bytes_unref (bytes);
+
+  return texture;
+}
+
+static void
+assert_yuv_color (GdkMemoryFormat format,
+                  int             width,
+                  int             height,
+                  guchar          y,
+                  guchar          u,
+                  guchar          v,
+                  guint32         expected)
+{
+  GdkTexture *texture;
+  guint32 *pixels;
+  int i, shift;
+
+  texture = create_yuv_texture (format, width, height, y, u, v);
+  pixels = g_new (guint32, width * height);
+  gdk_texture_download (texture, (guchar *) pixels, width * 4);
+
+  for (i = 0; i < width * height; i++)
+    {
+      for (shift = 0; shift < 32; shift += 8)
+        {
+          int value = (pixels[i] >> shift) & 0xFF;
+          int expected_value = (expected >> shift) & 0xFF;
+
+          g_assert_cmpint (ABS (value - expected_value), <=, 2);
+        }
+    }
+
+  g_free (pixels);
+  g_object_unref (texture);
+}
+
+static void
+test_download_yuv (gconstpointer data)
+{
+  GdkMemoryFormat format = GPOINTER_TO_INT (data);
+  /* Include sizes that need the scalar head and tail around the SIMD code */
+  const int sizes[][2] = { { 1, 1 }, { 4, 4 }, { 3, 5 }, { 19, 3 } };
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++)
+    {
+      assert_yuv_color (format, sizes[i][0], sizes[i][1], 16, 128, 128, 0xFF000000);
+      assert_yuv_color (format, sizes[i][0], sizes[i][1], 235, 128, 128, 0xFFFFFFFF);
+      assert_yuv_color (format, sizes[i][0], sizes[i][1], 81, 90, 240, 0xFFFF0000);
+    }
+}
+
+/* The BT.601 conversion in the fixed point math of the scalar code,
+ * as 0xAARRGGBB */
+static guint32
+yuv_reference (int y,
+               int u,
+               int v)
+{
+  int c = 298 * (y - 16) + 128;
+  int d = u - 128;
+  int e = v - 128;
+  int r, g, b;
+
+  r = CLAMP ((c + 409 * e) >> 8, 0, 255);
+  g = CLAMP ((c - 100 * d - 208 * e) >> 8, 0, 255);
+  b = CLAMP ((c + 516 * d) >> 8, 0, 255);
+
+  return 0xFF000000 | (r << 16) | (g << 8) | b;
+}
+
+/* Every pixel gets a different luma and every 2x2 block a different
+ * chroma, so misplaced samples show up */
+static void
+test_download_yuv_area (gconstpointer data)
+{
+  GdkMemoryFormat format = GPOINTER_TO_INT (data);
+  /* Odd sizes and offsets, wide enough for the SIMD code to kick in
+   * after the scalar head */
+  const int width = 37, height = 7;
+  const GdkRectangle areas[] = {
+    { 0, 0, width, height },
+    { 1, 0, width - 1, height },
+    { 3, 1, 17, 5 },
+    { 5, 2, 9, 1 },
+    { 2, 3, 33, 4 },
+    { width - 1, height - 1, 1, 1 },
+  };
+  gsize stride, chroma_height, chroma_stride, size, i;
+  const guchar *u_plane, *v_plane;
+  GdkTexture *texture;
+  GBytes *bytes;
+  guchar *planes;
+  guint a;
+
+  stride = width + 2;
+  chroma_height = (height + 1) / 2;
+  if (format == GDK_MEMORY_NV12)
+    {
+      chroma_stride = stride;
+      size = stride * (height + chroma_height);
+    }
+  else
+    {
+      chroma_stride = (stride + 1) / 2;
+      size = stride * height + 2 * chroma_stride * chroma_height;
+    }
+
+  planes = g_malloc (size);
+  for (i = 0; i < size; i++)
+    planes[i] = g_test_rand_int_range (0, 256);
+
+  if (format == GDK_MEMORY_NV12)
+    {
+      u_plane = planes + stride * height;
+      v_plane = u_plane + 1;
+    }
+  else
+    {
+      u_plane = planes + stride * height;
+      v_plane = u_plane + chroma_stride * chroma_height;
+    }
+
+  bytes = g_bytes_new (planes, size);
+  texture = gdk_memory_texture_new (width, height, format, bytes, stride);
+  g_bytes_unref (bytes);
+
+  for (a = 0; a < G_N_ELEMENTS (areas); a++)
+    {
+      const GdkRectangle *area = &areas[a];
+      guint32 *pixels;
+      int x, y;
+
+      pixels = g_new (guint32, area->width * area->height);
+      gdk_texture_download_area (texture, area, (guchar *) pixels, area->width * 4);
+
+      for (y = 0; y < area->height; y++)
+        {
+          for (x = 0; x < area->width; x++)
+            {
+              int tx = area->x + x;
+              int ty = area->y + y;
+              gsize uv = ty / 2 * chroma_stride + (format == GDK_MEMORY_NV12 ? tx / 2 * 2 : tx / 2);
+
+              g_assert_cmphex (pixels[y * area->width + x], ==,
+                               yuv_reference (planes[ty * stride + tx], u_plane[uv], v_plane[uv]));
+            }
+        }
+
+      g_free (pixels);
+    }
+
+  g_object_unref (texture);
+  g_free (planes);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -185,8 +491,14 @@ main (int argc, char *argv[])
 
   enum_class = g_type_class_ref (GDK_TYPE_MEMORY_FORMAT);
 
+  init_wide_formats ();
+
   for (format = 0; format < GDK_MEMORY_N_FORMATS; format++)
     {
+      /* YUV has no alpha and different color values, see below */
+      if (format == GDK_MEMORY_NV12 || format == GDK_MEMORY_I420)
+        continue;
+
       for (color = 0; color < N_COLORS; color++)
         {
           TestData *test_data = g_new (TestData, 1);
@@ -227,5 +539,10 @@ main (int argc, char *argv[])
         }
     }
 
+  g_test_add_data_func ("/memorytexture/download_yuv/nv12", GINT_TO_POINTER (GDK_MEMORY_NV12), test_download_yuv);
+  g_test_add_data_func ("/memorytexture/download_yuv/i420", GINT_TO_POINTER (GDK_MEMORY_I420), test_download_yuv);
+  g_test_add_data_func ("/memorytexture/download_yuv_area/nv12", GINT_TO_POINTER (GDK_MEMORY_NV12), test_download_yuv_area);
+  g_test_add_data_func ("/memorytexture/download_yuv_area/i420", GINT_TO_POINTER (GDK_MEMORY_I420), test_download_yuv_area);
+
   return g_test_run ();
 }
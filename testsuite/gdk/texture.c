@@ -0,0 +1,139 @@
+#include <locale.h>
+#include <glib/gstdio.h>
+#include <gdk/gdk.h>
+
+static GdkTexture *
+create_texture (int width,
+                int height)
+{
+  GdkTexture *texture;
+  GBytes *bytes;
+  guchar *data;
+
+  data = g_malloc0 (width * height * 4);
+  bytes = g_bytes_new_take (data, width * height * 4);
+  texture = gdk_memory_texture_new (width, height, GDK_MEMORY_DEFAULT, bytes, width * 4);
+  g_bytes_unref (bytes);
+
+  return texture;
+}
+
+static char *
+save_texture (int width,
+              int height)
+{
+  GdkTexture *texture;
+  char *path;
+  int fd;
+
+  fd = g_file_open_tmp ("texture-XXXXXX.png", &path, NULL);
+  g_assert_cmpint (fd, >=, 0);
+  g_close (fd, NULL);
+
+  texture = create_texture (width, height);
+  g_assert_true (gdk_texture_save_to_png (texture, path));
+  g_object_unref (texture);
+
+  return path;
+}
+
+static void
+loaded_cb (GObject      *source,
+           GAsyncResult *result,
+           gpointer      data)
+{
+  GAsyncResult **res = data;
+
+  *res = g_object_ref (result);
+  g_main_context_wakeup (NULL);
+}
+
+static GdkTexture *
+load_texture (GFile   *file,
+              int      width,
+              int      height,
+              GError **error)
+{
+  GAsyncResult *result = NULL;
+  GdkTexture *texture;
+
+  gdk_texture_new_from_file_async (file, width, height, NULL, loaded_cb, &result);
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  texture = gdk_texture_new_from_file_finish (result, error);
+  g_object_unref (result);
+
+  return texture;
+}
+
+static void
+test_load_async (void)
+{
+  GdkTexture *texture;
+  GError *error = NULL;
+  GFile *file;
+  char *path;
+
+  path = save_texture (64, 32);
+  file = g_file_new_for_path (path);
+
+  texture = load_texture (file, -1, -1, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (gdk_texture_get_width (texture), ==, 64);
+  g_assert_cmpint (gdk_texture_get_height (texture), ==, 32);
+  g_object_unref (texture);
+
+  /* Scaled down to fit, keeping the aspect ratio */
+  texture = load_texture (file, 16, 16, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (gdk_texture_get_width (texture), ==, 16);
+  g_assert_cmpint (gdk_texture_get_height (texture), ==, 8);
+  g_object_unref (texture);
+
+  texture = load_texture (file, -1, 8, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (gdk_texture_get_width (texture), ==, 16);
+  g_assert_cmpint (gdk_texture_get_height (texture), ==, 8);
+  g_object_unref (texture);
+
+  /* Never scaled up */
+  texture = load_texture (file, 128, 128, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (gdk_texture_get_width (texture), ==, 64);
+  g_assert_cmpint (gdk_texture_get_height (texture), ==, 32);
+  g_object_unref (texture);
+
+  g_unlink (path);
+  g_object_unref (file);
+  g_free (path);
+}
+
+static void
+test_load_async_error (void)
+{
+  GdkTexture *texture;
+  GError *error = NULL;
+  GFile *file;
+
+  file = g_file_new_for_path ("/does/not/exist.png");
+
+  texture = load_texture (file, -1, -1, &error);
+  g_assert_null (texture);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+  g_error_free (error);
+
+  g_object_unref (file);
+}
+
+int
+main (int argc, char *argv[])
+{
+  setlocale (LC_ALL, "");
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/texture/load-async", test_load_async);
+  g_test_add_func ("/texture/load-async-error", test_load_async_error);
+
+  return g_test_run ();
+}
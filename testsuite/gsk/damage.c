@@ -0,0 +1,129 @@
+/* Checks which nodes the GL renderer skips when redrawing only part of
+ * a surface. The draw counters of the profiler are private, so this
+ * links the internal gdk and gsk libraries. */
+
+#include <gsk/gsk.h>
+#include <gsk/gskrendererprivate.h>
+
+static GskRenderer *
+create_gl_renderer (GdkSurface *surface)
+{
+  GskRenderer *renderer;
+
+  renderer = gsk_renderer_new_for_surface (surface);
+  if (renderer == NULL)
+    return NULL;
+
+  /* We may have fallen back to another renderer */
+  if (g_strcmp0 (G_OBJECT_TYPE_NAME (renderer), "GskGLRenderer") != 0)
+    {
+      gsk_renderer_unrealize (renderer);
+      g_object_unref (renderer);
+      return NULL;
+    }
+
+  return renderer;
+}
+
+static GskRenderNode *
+color_node_new (const char *color,
+                float       x,
+                float       y,
+                float       width,
+                float       height)
+{
+  GdkRGBA rgba;
+
+  gdk_rgba_parse (&rgba, color);
+
+  return gsk_color_node_new (&rgba, &GRAPHENE_RECT_INIT (x, y, width, height));
+}
+
+static void
+test_offset_scaled (void)
+{
+  GdkSurface *surface;
+  GskRenderer *renderer;
+  GskRenderNode *nodes[2], *child, *root;
+  cairo_region_t *region;
+  GskProfiler *profiler;
+  GQuark draws;
+  gint64 n_draws;
+
+  surface = gdk_surface_new_toplevel (gdk_display_get_default (), 100, 100);
+  if (gdk_surface_get_scale_factor (surface) != 2)
+    {
+      g_test_skip ("Surface is not scaled, set GDK_SCALE=2");
+      g_object_unref (surface);
+      return;
+    }
+
+  renderer = create_gl_renderer (surface);
+  if (renderer == NULL)
+    {
+      g_test_skip ("GL renderer not available");
+      g_object_unref (surface);
+      return;
+    }
+
+  /* Registered by the renderer in debug builds */
+  draws = g_quark_try_string ("unbatched-draws");
+  if (draws == 0)
+    {
+      g_test_skip ("Profiler counters need a debug build");
+      gsk_renderer_unrealize (renderer);
+      g_object_unref (renderer);
+      g_object_unref (surface);
+      return;
+    }
+
+  profiler = gsk_renderer_get_profiler (renderer);
+  gdk_surface_show (surface);
+
+  /* Drawn at 50,0 by the offset node, i.e. at 100,0 in device pixels,
+   * the second child is far away from it */
+  child = color_node_new ("red", 0, 0, 20, 20);
+  nodes[0] = gsk_offset_node_new (child, 50, 0);
+  gsk_render_node_unref (child);
+  nodes[1] = color_node_new ("blue", 0, 60, 20, 20);
+  root = gsk_container_node_new (nodes, G_N_ELEMENTS (nodes));
+  gsk_render_node_unref (nodes[0]);
+  gsk_render_node_unref (nodes[1]);
+
+  /* The counters add up over frames */
+  n_draws = gsk_profiler_counter_get (profiler, draws);
+  gsk_renderer_render (renderer, root, NULL);
+  g_assert_cmpint (gsk_profiler_counter_get (profiler, draws) - n_draws, ==, 2);
+
+  /* Damage only the offset child */
+  n_draws = gsk_profiler_counter_get (profiler, draws);
+  region = cairo_region_create_rectangle (&(cairo_rectangle_int_t) { 50, 0, 20, 20 });
+  gsk_renderer_render (renderer, root, region);
+  cairo_region_destroy (region);
+
+  /* Only the damaged child must be drawn. Without buffer age support,
+   * the whole surface is redrawn and nothing can be skipped. */
+  n_draws = gsk_profiler_counter_get (profiler, draws) - n_draws;
+  if (n_draws == 2)
+    g_test_skip ("Surface was redrawn completely");
+  else
+    g_assert_cmpint (n_draws, ==, 1);
+
+  gsk_render_node_unref (root);
+  gsk_renderer_unrealize (renderer);
+  g_object_unref (renderer);
+  g_object_unref (surface);
+}
+
+int
+main (int argc, char **argv)
+{
+  g_test_init (&argc, &argv, NULL);
+
+  if (gdk_display_open (NULL) == NULL)
+    return 77;
+
+  g_test_add_func ("/damage/offset-scaled", test_offset_scaled);
+
+  return g_test_run ();
+}
@@ -0,0 +1,157 @@
+/* Renderers may apply the opacity of an opacity node to each draw of
+ * its child instead of rendering the child offscreen, if these draws
+ * don't overlap. Check that nodes that draw their child directly are
+ * only treated that way if the child qualifies. */
+
+#include <gtk/gtk.h>
+#include "reftest-compare.h"
+
+static cairo_surface_t *
+render_node (GskRenderNode *node)
+{
+  GdkSurface *window;
+  GskRenderer *renderer;
+  GdkTexture *texture;
+  cairo_surface_t *surface;
+
+  window = gdk_surface_new_toplevel (gdk_display_get_default (), 10, 10);
+  renderer = gsk_renderer_new_for_surface (window);
+  texture = gsk_renderer_render_texture (renderer, node, NULL);
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                        gdk_texture_get_width (texture),
+                                        gdk_texture_get_height (texture));
+  gdk_texture_download (texture,
+                        cairo_image_surface_get_data (surface),
+                        cairo_image_surface_get_stride (surface));
+  cairo_surface_mark_dirty (surface);
+
+  g_object_unref (texture);
+  gsk_renderer_unrealize (renderer);
+  g_object_unref (renderer);
+  gdk_surface_destroy (window);
+  g_object_unref (window);
+
+  return surface;
+}
+
+static GskRenderNode *
+color_node_new (const char *color,
+                float       x,
+                float       y)
+{
+  GdkRGBA rgba;
+
+  gdk_rgba_parse (&rgba, color);
+
+  return gsk_color_node_new (&rgba, &GRAPHENE_RECT_INIT (x, y, 60, 60));
+}
+
+/* Two squares that overlap in the middle */
+static GskRenderNode *
+overlapping_node_new (void)
+{
+  GskRenderNode *nodes[2], *container;
+
+  nodes[0] = color_node_new ("red", 0, 0);
+  nodes[1] = color_node_new ("blue", 30, 30);
+  container = gsk_container_node_new (nodes, G_N_ELEMENTS (nodes));
+  gsk_render_node_unref (nodes[0]);
+  gsk_render_node_unref (nodes[1]);
+
+  return container;
+}
+
+/* Takes ownership of both nodes */
+static void
+assert_renders_like (GskRenderNode *node,
+                     GskRenderNode *reference)
+{
+  GskRenderNode *opacity;
+  cairo_surface_t *surface, *ref_surface, *diff_surface;
+
+  opacity = gsk_opacity_node_new (node, 0.5);
+  surface = render_node (opacity);
+  gsk_render_node_unref (opacity);
+  gsk_render_node_unref (node);
+
+  opacity = gsk_opacity_node_new (reference, 0.5);
+  ref_surface = render_node (opacity);
+  gsk_render_node_unref (opacity);
+  gsk_render_node_unref (reference);
+
+  diff_surface = reftest_compare_surfaces (surface, ref_surface);
+  if (diff_surface)
+    {
+      g_test_fail ();
+      cairo_surface_destroy (diff_surface);
+    }
+
+  cairo_surface_destroy (surface);
+  cairo_surface_destroy (ref_surface);
+}
+
+static void
+test_blur_no_radius (void)
+{
+  GskRenderNode *child, *blur;
+
+  child = overlapping_node_new ();
+  blur = gsk_blur_node_new (child, 0);
+  gsk_render_node_unref (child);
+
+  assert_renders_like (blur, overlapping_node_new ());
+}
+
+static void
+test_blur_no_radius_single (void)
+{
+  GskRenderNode *child, *blur;
+
+  child = color_node_new ("red", 0, 0);
+  blur = gsk_blur_node_new (child, 0);
+  gsk_render_node_unref (child);
+
+  assert_renders_like (blur, color_node_new ("red", 0, 0));
+}
+
+static void
+test_cross_fade_start (void)
+{
+  GskRenderNode *start, *end, *cross_fade;
+
+  start = overlapping_node_new ();
+  end = color_node_new ("green", 0, 0);
+  cross_fade = gsk_cross_fade_node_new (start, end, 0);
+  gsk_render_node_unref (start);
+  gsk_render_node_unref (end);
+
+  assert_renders_like (cross_fade, overlapping_node_new ());
+}
+
+static void
+test_cross_fade_end (void)
+{
+  GskRenderNode *start, *end, *cross_fade;
+
+  start = color_node_new ("green", 0, 0);
+  end = overlapping_node_new ();
+  cross_fade = gsk_cross_fade_node_new (start, end, 1);
+  gsk_render_node_unref (start);
+  gsk_render_node_unref (end);
+
+  assert_renders_like (cross_fade, overlapping_node_new ());
+}
+
+int
+main (int argc, char **argv)
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/opacity-offscreen/blur/no-radius", test_blur_no_radius);
+  g_test_add_func ("/opacity-offscreen/blur/no-radius-single", test_blur_no_radius_single);
+  g_test_add_func ("/opacity-offscreen/cross-fade/start", test_cross_fade_start);
+  g_test_add_func ("/opacity-offscreen/cross-fade/end", test_cross_fade_end);
+
+  return g_test_run ();
+}
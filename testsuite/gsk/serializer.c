@@ -0,0 +1,187 @@
+/* Tests for the binary render node format. Cairo nodes for existing
+ * surfaces are private API, so this links the internal gdk and gsk
+ * libraries. */
+
+#include <gsk/gsk.h>
+#include <gsk/gskrendernodeprivate.h>
+#include <string.h>
+
+static const guchar magic[] = { 0x89, 'G', 'S', 'K', 'N', 'O', 'D', 'E' };
+
+static void
+append_u32 (GByteArray *array,
+            guint32     value)
+{
+  value = GUINT32_TO_LE (value);
+  g_byte_array_append (array, (guchar *) &value, sizeof (value));
+}
+
+static void
+append_float (GByteArray *array,
+              float       value)
+{
+  union { float f; guint32 u; } bits = { value };
+
+  append_u32 (array, bits.u);
+}
+
+static void
+append_double (GByteArray *array,
+               double      value)
+{
+  union { double d; guint64 u; } bits = { value };
+
+  bits.u = GUINT64_TO_LE (bits.u);
+  g_byte_array_append (array, (guchar *) &bits.u, sizeof (bits.u));
+}
+
+static void
+append_chunk (GByteArray   *array,
+              const char   *type,
+              const guchar *data,
+              guint32       size)
+{
+  g_byte_array_append (array, (const guchar *) type, 4);
+  append_u32 (array, 0);
+  append_u32 (array, size);
+  append_u32 (array, 0);
+  g_byte_array_append (array, data, size);
+}
+
+/* A color node inside @depth opacity nodes */
+static GBytes *
+nested_opacity_data_new (guint depth)
+{
+  GByteArray *nodes, *data;
+  guint i;
+
+  nodes = g_byte_array_new ();
+  for (i = 0; i < depth; i++)
+    {
+      append_u32 (nodes, GSK_OPACITY_NODE);
+      append_double (nodes, 1.0);
+    }
+  append_u32 (nodes, GSK_COLOR_NODE);
+  for (i = 0; i < 4; i++)
+    append_float (nodes, 1.0);
+  for (i = 0; i < 4; i++)
+    append_float (nodes, 1.0);
+
+  data = g_byte_array_new ();
+  g_byte_array_append (data, magic, sizeof (magic));
+  append_u32 (data, 1);
+  append_chunk (data, "NODE", nodes->data, nodes->len);
+  append_chunk (data, "END ", NULL, 0);
+
+  g_byte_array_unref (nodes);
+
+  return g_byte_array_free_to_bytes (data);
+}
+
+static void
+test_nested (void)
+{
+  GskRenderNode *node;
+  GError *error = NULL;
+  GBytes *bytes;
+
+  bytes = nested_opacity_data_new (100);
+  node = gsk_render_node_deserialize (bytes, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (node);
+  g_assert_cmpint (gsk_render_node_get_node_type (node), ==, GSK_OPACITY_NODE);
+
+  gsk_render_node_unref (node);
+  g_bytes_unref (bytes);
+}
+
+static void
+test_nested_too_deep (void)
+{
+  GskRenderNode *node;
+  GError *error = NULL;
+  GBytes *bytes;
+
+  /* Deep enough to overflow the stack if the reader didn't stop */
+  bytes = nested_opacity_data_new (1000000);
+  node = gsk_render_node_deserialize (bytes, &error);
+  g_assert_error (error, GSK_SERIALIZATION_ERROR, GSK_SERIALIZATION_INVALID_DATA);
+  g_assert_null (node);
+
+  g_error_free (error);
+  g_bytes_unref (bytes);
+}
+
+static cairo_surface_t *
+draw_node (GskRenderNode *node)
+{
+  cairo_surface_t *surface;
+  cairo_t *cr;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 20, 10);
+  cr = cairo_create (surface);
+  gsk_render_node_draw (node, cr);
+  cairo_destroy (cr);
+  cairo_surface_flush (surface);
+
+  return surface;
+}
+
+static void
+test_shared_surface (void)
+{
+  cairo_surface_t *surface, *expected, *result;
+  GskRenderNode *nodes[2], *container, *node;
+  GError *error = NULL;
+  GBytes *bytes;
+  cairo_t *cr;
+  int y;
+
+  /* Red on the left, blue on the right */
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 20, 10);
+  cr = cairo_create (surface);
+  cairo_set_source_rgb (cr, 1, 0, 0);
+  cairo_rectangle (cr, 0, 0, 10, 10);
+  cairo_fill (cr);
+  cairo_set_source_rgb (cr, 0, 0, 1);
+  cairo_rectangle (cr, 10, 0, 10, 10);
+  cairo_fill (cr);
+  cairo_destroy (cr);
+
+  /* Each node shows a different part of the same surface */
+  nodes[0] = gsk_cairo_node_new_for_surface (&GRAPHENE_RECT_INIT (0, 0, 10, 10), surface);
+  nodes[1] = gsk_cairo_node_new_for_surface (&GRAPHENE_RECT_INIT (10, 0, 10, 10), surface);
+  container = gsk_container_node_new (nodes, G_N_ELEMENTS (nodes));
+  gsk_render_node_unref (nodes[0]);
+  gsk_render_node_unref (nodes[1]);
+  cairo_surface_destroy (surface);
+
+  bytes = gsk_render_node_serialize (container);
+  node = gsk_render_node_deserialize (bytes, &error);
+  g_assert_no_error (error);
+
+  expected = draw_node (container);
+  result = draw_node (node);
+
+  for (y = 0; y < 10; y++)
+    g_assert_cmpmem (cairo_image_surface_get_data (result) + y * cairo_image_surface_get_stride (result), 20 * 4,
+                     cairo_image_surface_get_data (expected) + y * cairo_image_surface_get_stride (expected), 20 * 4);
+
+  cairo_surface_destroy (expected);
+  cairo_surface_destroy (result);
+  gsk_render_node_unref (node);
+  gsk_render_node_unref (container);
+  g_bytes_unref (bytes);
+}
+
+int
+main (int argc, char **argv)
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/serializer/nested", test_nested);
+  g_test_add_func ("/serializer/nested-too-deep", test_nested_too_deep);
+  g_test_add_func ("/serializer/shared-surface", test_shared_surface);
+
+  return g_test_run ();
+}
@@ -699,6 +699,21 @@ load_node_file (GFile *file, gboolean generate)
       return;
     }
 
+  /* Render the node after a round trip through serialization,
+   * so the reference images check the serializer, too */
+  bytes = gsk_render_node_serialize (node);
+  gsk_render_node_unref (node);
+  node = gsk_render_node_deserialize (bytes, &error);
+  g_bytes_unref (bytes);
+
+  if (node == NULL)
+    {
+      g_test_message ("Could not deserialize node: %s\n", error->message);
+      g_clear_error (&error);
+      g_test_fail ();
+      return;
+    }
+
   window = gdk_surface_new_toplevel (gdk_display_get_default(), 10 , 10);
   renderer = gsk_renderer_new_for_surface (window);
   texture = gsk_renderer_render_texture (renderer, node, NULL);
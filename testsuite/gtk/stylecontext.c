@@ -1,4 +1,5 @@
 #include <gtk/gtk.h>
+#include <glib/gstdio.h>
 
 typedef struct {
   GtkStyleContext *context;
@@ -504,9 +505,326 @@ test_style_priorities_three_context_higher (PrioritiesFixture *f,
   g_assert_true (gdk_rgba_equal (&ref_color, &color));
 }
 
+static void
+check_colors (GtkWidget  *widget,
+              const char *expected)
+{
+  GtkStyleContext *context;
+  GdkRGBA *color, *border_color, *bg_color;
+  GdkRGBA rgba;
+
+  context = gtk_widget_get_style_context (widget);
+  gtk_style_context_get (context,
+                         "color", &color,
+                         "border-top-color", &border_color,
+                         "background-color", &bg_color,
+                         NULL);
+
+  gdk_rgba_parse (&rgba, expected);
+  g_assert (gdk_rgba_equal (color, &rgba));
+  g_assert (gdk_rgba_equal (border_color, &rgba));
+  gdk_rgba_parse (&rgba, "transparent");
+  g_assert (gdk_rgba_equal (bg_color, &rgba));
+
+  gdk_rgba_free (color);
+  gdk_rgba_free (border_color);
+  gdk_rgba_free (bg_color);
+}
+
+/* Styles share the values of property groups, make sure values that
+ * depend on other groups still get computed per style */
+static void
+test_shared_values (void)
+{
+  GtkCssProvider *provider;
+  GtkWidget *box, *label1, *label2;
+
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_data (provider,
+                                   "box { color: red; }\n"
+                                   "label.blue { color: blue; }",
+                                   -1);
+  gtk_style_context_add_provider_for_display (gdk_display_get_default (),
+                                              GTK_STYLE_PROVIDER (provider),
+                                              GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+
+  box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 0);
+  g_object_ref_sink (box);
+  label1 = gtk_label_new ("red");
+  label2 = gtk_label_new ("blue");
+  gtk_style_context_add_class (gtk_widget_get_style_context (label2), "blue");
+  gtk_container_add (GTK_CONTAINER (box), label1);
+  gtk_container_add (GTK_CONTAINER (box), label2);
+
+  check_colors (box, "red");
+  check_colors (label1, "red");
+  check_colors (label2, "blue");
+
+  gtk_style_context_remove_provider_for_display (gdk_display_get_default (),
+                                                 GTK_STYLE_PROVIDER (provider));
+  g_object_unref (box);
+  g_object_unref (provider);
+}
+
+/* Class and state changes only restyle the nodes that selectors with
+ * the class or state can match, make sure those do get restyled */
+static void
+test_invalidation (void)
+{
+  GtkCssProvider *provider;
+  GtkWidget *box, *label1, *label2;
+
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_data (provider,
+                                   "label { color: red; }\n"
+                                   ".blue label { color: blue; }\n"
+                                   ".green + label { color: lime; }\n"
+                                   "box:selected > label { color: yellow; }",
+                                   -1);
+  gtk_style_context_add_provider_for_display (gdk_display_get_default (),
+                                              GTK_STYLE_PROVIDER (provider),
+                                              GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+
+  box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 0);
+  g_object_ref_sink (box);
+  label1 = gtk_label_new ("1");
+  label2 = gtk_label_new ("2");
+  gtk_container_add (GTK_CONTAINER (box), label1);
+  gtk_container_add (GTK_CONTAINER (box), label2);
+
+  check_colors (label1, "red");
+  check_colors (label2, "red");
+
+  /* No selector uses this class */
+  gtk_style_context_add_class (gtk_widget_get_style_context (box), "unused");
+  check_colors (label1, "red");
+  check_colors (label2, "red");
+
+  gtk_style_context_add_class (gtk_widget_get_style_context (box), "blue");
+  check_colors (label1, "blue");
+  check_colors (label2, "blue");
+
+  gtk_style_context_remove_class (gtk_widget_get_style_context (box), "blue");
+  check_colors (label1, "red");
+  check_colors (label2, "red");
+
+  gtk_style_context_add_class (gtk_widget_get_style_context (label1), "green");
+  check_colors (label1, "red");
+  check_colors (label2, "lime");
+
+  gtk_style_context_remove_class (gtk_widget_get_style_context (label1), "green");
+  check_colors (label2, "red");
+
+  gtk_widget_set_state_flags (box, GTK_STATE_FLAG_SELECTED, FALSE);
+  check_colors (label1, "yellow");
+  check_colors (label2, "yellow");
+
+  gtk_widget_unset_state_flags (box, GTK_STATE_FLAG_SELECTED);
+  check_colors (label1, "red");
+  check_colors (label2, "red");
+
+  gtk_style_context_remove_provider_for_display (gdk_display_get_default (),
+                                                 GTK_STYLE_PROVIDER (provider));
+  g_object_unref (box);
+  g_object_unref (provider);
+}
+
+/* Providers of single widgets don't apply to the nodes whose classes
+ * change, but their selectors can still depend on them */
+static void
+test_invalidation_widget_provider (void)
+{
+  GtkCssProvider *provider;
+  GtkWidget *box, *label1, *label2;
+
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_data (provider,
+                                   "label { color: red; }\n"
+                                   ".blue label { color: blue; }\n"
+                                   ".green + label { color: lime; }",
+                                   -1);
+
+  box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 0);
+  g_object_ref_sink (box);
+  label1 = gtk_label_new ("1");
+  label2 = gtk_label_new ("2");
+  gtk_container_add (GTK_CONTAINER (box), label1);
+  gtk_container_add (GTK_CONTAINER (box), label2);
+
+  gtk_style_context_add_provider (gtk_widget_get_style_context (label1),
+                                  GTK_STYLE_PROVIDER (provider),
+                                  GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+  gtk_style_context_add_provider (gtk_widget_get_style_context (label2),
+                                  GTK_STYLE_PROVIDER (provider),
+                                  GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+
+  check_colors (label1, "red");
+  check_colors (label2, "red");
+
+  /* A descendant with its own provider */
+  gtk_style_context_add_class (gtk_widget_get_style_context (box), "blue");
+  check_colors (label1, "blue");
+  check_colors (label2, "blue");
+
+  gtk_style_context_remove_class (gtk_widget_get_style_context (box), "blue");
+  check_colors (label1, "red");
+  check_colors (label2, "red");
+
+  /* A sibling with its own provider */
+  gtk_style_context_add_class (gtk_widget_get_style_context (label1), "green");
+  check_colors (label2, "lime");
+
+  gtk_style_context_remove_class (gtk_widget_get_style_context (label1), "green");
+  check_colors (label2, "red");
+
+  g_object_unref (box);
+  g_object_unref (provider);
+}
+
+static char *
+get_theme_file (void)
+{
+  return g_build_filename (g_get_user_data_dir (), "themes", "Cached", "gtk-4.0", "gtk.css", NULL);
+}
+
+static void
+set_theme_contents (const char *contents)
+{
+  char *file, *dir;
+
+  file = get_theme_file ();
+  dir = g_path_get_dirname (file);
+
+  g_assert_cmpint (g_mkdir_with_parents (dir, 0700), ==, 0);
+  g_assert_true (g_file_set_contents (file, contents, -1, NULL));
+
+  g_free (dir);
+  g_free (file);
+}
+
+static void
+check_theme_color (const char *expected)
+{
+  GtkSettings *settings = gtk_settings_get_default ();
+  GtkWidget *label;
+  GdkRGBA color, rgba;
+
+  /* Changing the theme name loads the theme again */
+  g_object_set (settings, "gtk-theme-name", "Adwaita", NULL);
+  g_object_set (settings, "gtk-theme-name", "Cached", NULL);
+
+  label = gtk_label_new ("");
+  g_object_ref_sink (label);
+
+  gtk_style_context_get_color (gtk_widget_get_style_context (label), &color);
+  gdk_rgba_parse (&rgba, expected);
+  g_assert_true (gdk_rgba_equal (&color, &rgba));
+
+  g_object_unref (label);
+}
+
+static guint64
+get_mtime (GFile *file)
+{
+  GFileInfo *info;
+  guint64 mtime;
+
+  info = g_file_query_info (file, G_FILE_ATTRIBUTE_TIME_MODIFIED, G_FILE_QUERY_INFO_NONE, NULL, NULL);
+  g_assert_nonnull (info);
+  mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+  g_object_unref (info);
+
+  return mtime;
+}
+
+/* Themes are loaded from a cache after the first time, make sure that
+ * the cache gets written and used and that it doesn't survive changes
+ * to the theme */
+static void
+test_theme_cache (void)
+{
+  char *file, *uri, *checksum, *name, *cache_file;
+  GFile *cache;
+
+  /* Values of different types, they must all load from the cache */
+  set_theme_contents ("@define-color fg_color red;\n"
+                      "label { color: @fg_color; padding: 2px 3px;\n"
+                      "        font-family: \"Cantarell\", sans-serif;\n"
+                      "        border-style: solid; background-color: alpha(@fg_color, 0.5); }\n");
+  check_theme_color ("red");
+
+  file = get_theme_file ();
+  uri = g_filename_to_uri (file, NULL, NULL);
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA256, uri, -1);
+  name = g_strdup_printf ("%s-%u.%u.%u", checksum,
+                          gtk_get_major_version (),
+                          gtk_get_minor_version (),
+                          gtk_get_micro_version ());
+  cache_file = g_build_filename (g_get_user_cache_dir (), "gtk-4.0", "css", name, NULL);
+  g_assert_true (g_file_test (cache_file, G_FILE_TEST_IS_REGULAR));
+
+  /* The cache only gets written when it wasn't used */
+  cache = g_file_new_for_path (cache_file);
+  g_assert_true (g_file_set_attribute_uint64 (cache, G_FILE_ATTRIBUTE_TIME_MODIFIED, 1000000,
+                                              G_FILE_QUERY_INFO_NONE, NULL, NULL));
+
+  /* This time it comes from the cache */
+  check_theme_color ("red");
+  g_assert_cmpuint (get_mtime (cache), ==, 1000000);
+
+  set_theme_contents ("@define-color fg_color blue;\n"
+                      "label { color: @fg_color; }\n");
+  check_theme_color ("blue");
+  g_assert_cmpuint (get_mtime (cache), !=, 1000000);
+
+  g_object_set (gtk_settings_get_default (), "gtk-theme-name", "Adwaita", NULL);
+
+  g_object_unref (cache);
+  g_free (cache_file);
+  g_free (name);
+  g_free (checksum);
+  g_free (uri);
+  g_free (file);
+}
+
+static void
+remove_directory (const char *path)
+{
+  const char *name;
+  GDir *dir;
+
+  dir = g_dir_open (path, 0, NULL);
+  if (dir == NULL)
+    return;
+
+  while ((name = g_dir_read_name (dir)))
+    {
+      char *child = g_build_filename (path, name, NULL);
+
+      if (g_file_test (child, G_FILE_TEST_IS_DIR))
+        remove_directory (child);
+      else
+        g_remove (child);
+
+      g_free (child);
+    }
+
+  g_dir_close (dir);
+  g_rmdir (path);
+}
+
 int
 main (int argc, char *argv[])
 {
+  char *dir;
+  int result;
+
+  /* Keep the themes of the tests and their cache out of the user's directories */
+  dir = g_dir_make_tmp ("gtk-stylecontext-XXXXXX", NULL);
+  g_assert_nonnull (dir);
+  g_setenv ("XDG_DATA_HOME", dir, TRUE);
+  g_setenv ("XDG_CACHE_HOME", dir, TRUE);
+
   gtk_init ();
   g_test_init (&argc, &argv, NULL);
 
@@ -516,6 +834,10 @@ main (int argc, char *argv[])
   g_test_add_func ("/style/basic", test_basic_properties);
   g_test_add_func ("/style/widget-path-parent", test_widget_path_parent);
   g_test_add_func ("/style/classes", test_style_classes);
+  g_test_add_func ("/style/shared-values", test_shared_values);
+  g_test_add_func ("/style/invalidation", test_invalidation);
+  g_test_add_func ("/style/invalidation-widget-provider", test_invalidation_widget_provider);
+  g_test_add_func ("/style/theme-cache", test_theme_cache);
 
 #define ADD_PRIORITIES_TEST(path, func) \
   g_test_add ("/style/priorities/" path, PrioritiesFixture, NULL, test_style_priorities_setup, \
@@ -533,5 +855,10 @@ main (int argc, char *argv[])
 
 #undef ADD_PRIORITIES_TEST
 
-  return g_test_run ();
+  result = g_test_run ();
+
+  remove_directory (dir);
+  g_free (dir);
+
+  return result;
 }